@@ -30,7 +30,7 @@ MemorySubsystemException::MemorySubsystemException(MemorySubsystemException &&ot
 /**
  * Constructor for PhysicalMemoryBoundsException
  */
-PhysicalMemoryBoundsException::PhysicalMemoryBoundsException(Addr address) {
+PhysicalMemoryBoundsException::PhysicalMemoryBoundsException(uint64_t address) {
   std::stringstream description_stream;
   description_stream << "PhysicalMemoryBoundsException, block starting at 0x" 
           << std::hex << address;
@@ -96,9 +96,10 @@ public:
   /**
    * Constructor
    * 
-   * @param address of invalid access
+   * @param address of invalid access (may be a virtual address of 4 GiB or
+   *   more used in physical mode)
    */
-  PhysicalMemoryBoundsException(Addr address);
+  PhysicalMemoryBoundsException(uint64_t address);
 };
 
 /******************************************************************************/
@@ -10,11 +10,36 @@
 #include "MMU.h"
 
 #include "Exceptions.h"
+#include "Snapshot.h"
+
+#include <cstddef>
 
 namespace mem {
 
-void MMU::InitMemoryOperation(PMCB::PMCB_op op, 
-                              Addr vaddress, 
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+const int BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::kVAddrBits;
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+const int BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::kLevels;
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+const Addr BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::kPageBytes;
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+const Addr BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::kOffsetMask;
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+const Addr BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::kNumberMask;
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+const Addr BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::kTableIndexMask;
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+const int BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::kLargePageBits;
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+const Addr BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::kLargeOffsetMask;
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+const size_t BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::kPageWalkCacheSize;
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+const uint32_t BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::kSnapshotMagic;
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+void BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::InitMemoryOperation(PMCB::PMCB_op op, 
+                              VAddr vaddress, 
                               Addr count, 
                               uint8_t* user_buffer) {
   pmcb.operation_state = op;
@@ -23,152 +48,536 @@ void MMU::InitMemoryOperation(PMCB::PMCB_op op,
   pmcb.user_buffer = user_buffer;
 }
 
-void MMU::ToPhysical(Addr vaddress, Addr& paddress, bool write_op) {
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+MemoryFault BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::TryToPhysical(VAddr vaddress, Addr& paddress, bool write_op) {
   // If not in virtual memory mode, physical == virtual
   if (!pmcb.vm_enable) {
-    paddress = vaddress;
-    return;
+    if ((vaddress >> 32) != 0) {
+      throw PhysicalMemoryBoundsException(vaddress);
+    }
+    paddress = static_cast<Addr>(vaddress);
+    return MemoryFault::kNone;
+  }
+  
+  // Addresses outside the virtual address space are never mapped
+  if (!InAddressSpace(vaddress)) {
+    return MemoryFault::kPageFault;
+  }
+  
+  // If same page as last translation, reuse it
+  if (last_valid && (vaddress >> PageBits) == last_vpage
+          && (!write_op || last_writable)) {
+    if (Stats::kEnabled && HasTLB()) tlb->RecordHit();
+    paddress = last_frame | (static_cast<Addr>(vaddress) & kOffsetMask);
+    return MemoryFault::kNone;
   }
   
-  // If address translation cached in TLB, use it
-  PageTableEntry second_level_entry = 0;
+  // If address translation cached in TLB, use it. The entry which maps the 
+  // page is the 2nd level entry, or the top level entry for a large page.
+  PageTableEntry pt_entry = 0;
   bool from_tlb = false;  // true if translation from TLB
-  Addr second_level_entry_pa = 0xFFFFFFFF;  // phys addr of 2nd lvl entry
+  Addr pt_entry_pa = 0xFFFFFFFF;  // phys addr of page table entry
   
-  if (tlb) {
-    second_level_entry = tlb->Lookup(vaddress);
+  if (HasTLB()) {
+    pt_entry = tlb->Lookup(TLBKey(vaddress), pmcb.asid, Stats::kEnabled);
     // Use TLB entry if page present. If this is a write and the modified
     // bit is not set in the cache, force use of page table so that 
     // the modified bit will be updated in the page table.
-    from_tlb = (second_level_entry & kPTE_PresentMask) != 0
-            && (!write_op || ((second_level_entry & kPTE_ModifiedMask) != 0));
+    from_tlb = (pt_entry & kPTE_PresentMask) != 0
+            && (!write_op || ((pt_entry & kPTE_ModifiedMask) != 0));
   }
 
-  if (!from_tlb) {
+  if (!from_tlb && pmcb.page_table_format == PMCB::HASHED) {
+    // Find the entry in the hashed page table. It has no higher levels, so 
+    // the page walk cache is not used.
+    if((pmcb.page_table_base & kOffsetMask) != 0) { // must start at page boundary
+      throw InvalidMMUOperationException("PMCB Error: page table base must be at page boundary");
+    }
+    if (!FindHashedEntry(vaddress, pt_entry, pt_entry_pa)) {
+      return MemoryFault::kPageFault;
+    }
+  } else if (!from_tlb) {
     // Check for valid top level page table pointer
-    if((pmcb.page_table_base & kPageOffsetMask) != 0) { // must start at page boundary
+    if((pmcb.page_table_base & kOffsetMask) != 0) { // must start at page boundary
       throw InvalidMMUOperationException("PMCB Error: page table base must be at page boundary");
     }
 
-    // Get entry in top level page table
-    Addr top_level_index = (vaddress >> (kPageSizeBits + kPageTableSizeBits))
-            & kPageTableIndexMask;
-    PageTableEntry top_level_entry;
-    Addr top_level_entry_pa =
-            pmcb.page_table_base + top_level_index * sizeof(PageTableEntry);
-    phys_mem.get_32(&top_level_entry, top_level_entry_pa);
-    if((top_level_entry & kPTE_PresentMask) == 0) {
-      throw PageFaultException();
+    // Get address of last level page table from page walk cache, or by 
+    // walking the higher levels if not cached. The cache is indexed by all 
+    // the higher level indices together (the large page number).
+    Addr large_page_number = static_cast<Addr>(vaddress >> kLargePageBits);
+    Addr last_level_address;
+    bool large_page = false;
+    if (!HasTLB() 
+            || !pwc->Lookup(large_page_number, last_level_address, 
+                            Stats::kEnabled)) {
+      last_level_address = pmcb.page_table_base;
+      for (int level = kLevels - 1; level >= 1; --level) {
+        Addr index = static_cast<Addr>(vaddress >> (PageBits + level * TableBits))
+                & kTableIndexMask;
+        PageTableEntry table_entry;
+        Addr table_entry_pa = 
+                last_level_address + index * sizeof(PageTableEntry);
+        phys_mem.get_32(&table_entry, table_entry_pa);
+        if((table_entry & kPTE_PresentMask) == 0) {
+          return MemoryFault::kPageFault;
+        }
+        
+        if (level == 1 && (table_entry & kPTE_LargePageMask) != 0) {
+          // Entry maps a large page directly; it is checked and updated 
+          // below in the same way as a last level entry.
+          large_page = true;
+          pt_entry = table_entry;
+          pt_entry_pa = table_entry_pa;
+          break;
+        }
+        
+        // Set accessed and (optionally) modified flags for higher level table
+        if((table_entry & kPTE_AccessedMask) == 0) {
+          table_entry = table_entry | kPTE_AccessedMask
+                  | (write_op ? kPTE_ModifiedMask : 0);
+          phys_mem.put_bytes(table_entry_pa, sizeof(PageTableEntry),
+                             reinterpret_cast<uint8_t*> (&table_entry));
+        }
+        last_level_address = table_entry & kNumberMask;
+      }
+      if (HasTLB() && !large_page) {
+        pwc->Cache(large_page_number, last_level_address);
+      }
     }
 
-    // Set accessed and (optionally) modified flags for top level table
-    if((top_level_entry & kPTE_AccessedMask) == 0) {
-      top_level_entry = top_level_entry | kPTE_AccessedMask
-              | (write_op ? kPTE_ModifiedMask : 0);
-      phys_mem.put_bytes(top_level_entry_pa, sizeof(PageTableEntry),
-                         reinterpret_cast<uint8_t*> (&top_level_entry));
+    // Get last level page table entry
+    if (!large_page) {
+      Addr last_level_index = static_cast<Addr>(vaddress >> PageBits) 
+              & kTableIndexMask;
+      pt_entry_pa =
+              last_level_address + last_level_index * sizeof(PageTableEntry);
+      phys_mem.get_32(&pt_entry, pt_entry_pa);
     }
-
-    // Get 2nd level page table entry
-    Addr second_level_address = top_level_entry & kPTE_FrameMask;
-    Addr second_level_index = (vaddress >> kPageSizeBits) & kPageTableIndexMask;
-    second_level_entry_pa =
-            second_level_address + second_level_index * sizeof(PageTableEntry);
-    phys_mem.get_32(&second_level_entry, second_level_entry_pa);
   }
   
-  // If page not present, throw page fault exception
-  if ((second_level_entry & kPTE_PresentMask) == 0) {
-    throw PageFaultException();
+  // If page not present, report page fault
+  if ((pt_entry & kPTE_PresentMask) == 0) {
+    return MemoryFault::kPageFault;
   }
   
-  // If write operation and page not writable, throw exception
-  if (write_op && (second_level_entry & kPTE_WritableMask) == 0) {
-    throw WritePermissionFaultException();
+  // If write operation and page not writable, report write permission fault
+  if (write_op && (pt_entry & kPTE_WritableMask) == 0) {
+    return MemoryFault::kWritePermissionFault;
   }
   
   // If address not from TLB, set accessed and (optionally) modified flags 
-  // in 2nd level table, then update the TLB
+  // in page table entry, then update the TLB
   if (!from_tlb) {
-    PageTableEntry new_second_level_entry = second_level_entry | kPTE_AccessedMask
+    PageTableEntry new_pt_entry = pt_entry | kPTE_AccessedMask
             | (write_op ? kPTE_ModifiedMask : 0);
 
     // If changed, write back to page table
-    if (new_second_level_entry != second_level_entry) {
-      second_level_entry = new_second_level_entry;
-      phys_mem.put_bytes(second_level_entry_pa, sizeof(PageTableEntry),
-                        reinterpret_cast<uint8_t*>(&second_level_entry));
+    if (new_pt_entry != pt_entry) {
+      pt_entry = new_pt_entry;
+      phys_mem.put_bytes(pt_entry_pa, sizeof(PageTableEntry),
+                        reinterpret_cast<uint8_t*>(&pt_entry));
     }
     
     // Update TLB
-    if (tlb) {
-      tlb->Cache(vaddress, second_level_entry);
+    if (HasTLB()) {
+      tlb->Cache(TLBKey(vaddress), pt_entry, pmcb.asid);
     }
   }
   
+  // Save translation in last translation register. It may be used for 
+  // writes only once the modified bit has been set in the page table. For
+  // a large page, the register holds the frame of the 4 KiB page within it.
+  last_vpage = vaddress >> PageBits;
+  if ((pt_entry & kPTE_LargePageMask) != 0) {
+    last_frame = (pt_entry & ~kLargeOffsetMask)
+            | (static_cast<Addr>(vaddress) & kLargeOffsetMask & kNumberMask);
+  } else {
+    last_frame = pt_entry & kNumberMask;
+  }
+  last_writable = (pt_entry & kPTE_WritableMask) != 0
+          && (pt_entry & kPTE_ModifiedMask) != 0;
+  last_valid = true;
+  
   // Page is mapped, return physical
-  paddress = (second_level_entry & kPTE_FrameMask) | (vaddress & kPageOffsetMask);
+  paddress = last_frame | (static_cast<Addr>(vaddress) & kOffsetMask);
+  return MemoryFault::kNone;
+}
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+bool BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::FindHashedEntry(VAddr vaddress, PageTableEntry &pt_entry, Addr &pt_entry_pa) {
+  // Probe from the home entry of the page to the first unused entry, past
+  // tombstones
+  VAddr vpage = vaddress >> PageBits;
+  Addr entries = get_hashed_page_table_size();
+  Addr index = HashedPageTableIndex(pmcb.asid, vpage, entries);
+  for (Addr probes = 0; probes < entries; ++probes) {
+    HashedPageTableEntry entry;
+    Addr entry_pa = pmcb.page_table_base 
+            + index * sizeof(HashedPageTableEntry);
+    phys_mem.get_bytes(reinterpret_cast<uint8_t*>(&entry), entry_pa, 
+                       sizeof(HashedPageTableEntry));
+    if ((entry.flags & kHPTE_UsedMask) == 0) {
+      return false;
+    }
+    if (entry.vpage == vpage && entry.asid == pmcb.asid
+            && (entry.flags & kHPTE_TombstoneMask) == 0) {
+      pt_entry = entry.pt_entry & ~kPTE_LargePageMask;
+      pt_entry_pa = entry_pa + offsetof(HashedPageTableEntry, pt_entry);
+      return true;
+    }
+    index = (index + 1) & (entries - 1);
+  }
+  return false;
+}
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+bool BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::ProbeHashedTable(Addr table_base, ASID asid, VAddr vpage, Addr &index, Addr &free_index) {
+  Addr entries = get_hashed_page_table_size();
+  free_index = entries;
+  index = HashedPageTableIndex(asid, vpage, entries);
+  for (Addr probes = 0; probes < entries; ++probes) {
+    HashedPageTableEntry entry = GetHashedEntry(table_base, index);
+    if ((entry.flags & (kHPTE_UsedMask | kHPTE_TombstoneMask)) 
+            != kHPTE_UsedMask) {
+      if (free_index == entries) {
+        free_index = index;
+      }
+      if ((entry.flags & kHPTE_UsedMask) == 0) {
+        return false;
+      }
+    } else if (entry.vpage == vpage && entry.asid == asid) {
+      return true;
+    }
+    index = (index + 1) & (entries - 1);
+  }
+  return false;
+}
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+Addr BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::MapHashedPage(Addr table_base, ASID asid, VAddr vaddress, PageTableEntry pt_entry) {
+  VAddr vpage = vaddress >> PageBits;
+  Addr index;
+  Addr free_index;
+  if (!ProbeHashedTable(table_base, asid, vpage, index, free_index)) {
+    if (free_index == get_hashed_page_table_size()) {
+      throw InvalidMMUOperationException("Hashed page table is full");
+    }
+    index = free_index;
+  }
+  PutHashedEntry(table_base, index, 
+                 HashedPageTableEntry{ vpage, pt_entry, asid, kHPTE_UsedMask });
+  FlushPage(vaddress, asid);
+  return table_base + index * sizeof(HashedPageTableEntry);
+}
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+bool BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::UnmapHashedPage(Addr table_base, ASID asid, VAddr vaddress) {
+  Addr index;
+  Addr free_index;
+  if (!ProbeHashedTable(table_base, asid, vaddress >> PageBits, index, 
+                        free_index)) {
+    return false;
+  }
+  PutHashedEntry(table_base, index, kHashedTombstone);
+  ReleaseTombstones(table_base, index);
+  FlushPage(vaddress, asid);
+  return true;
 }
 
-void MMU::Execute() {
-  if (pmcb.operation_state == PMCB::NONE) return;
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+Addr BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::PurgeHashedASID(Addr table_base, ASID asid) {
+  // Replace the address space's entries with tombstones, then release the 
+  // tombstones which end no probe
+  Addr entries = get_hashed_page_table_size();
+  Addr removed = 0;
+  for (Addr index = 0; index < entries; ++index) {
+    HashedPageTableEntry entry = GetHashedEntry(table_base, index);
+    if ((entry.flags & (kHPTE_UsedMask | kHPTE_TombstoneMask)) 
+            == kHPTE_UsedMask && entry.asid == asid) {
+      PutHashedEntry(table_base, index, kHashedTombstone);
+      ++removed;
+    }
+  }
+  if (removed > 0) {
+    for (Addr index = 0; index < entries; ++index) {
+      ReleaseTombstones(table_base, index);
+    }
+  }
+  FlushASID(asid);
+  return removed;
+}
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+void BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::ReleaseTombstones(Addr table_base, Addr index) {
+  Addr entries = get_hashed_page_table_size();
+  if ((GetHashedEntry(table_base, (index + 1) & (entries - 1)).flags 
+          & kHPTE_UsedMask) != 0) {
+    return;
+  }
+  for (Addr count = 0; count < entries; ++count) {
+    if ((GetHashedEntry(table_base, index).flags & kHPTE_TombstoneMask) == 0) {
+      return;
+    }
+    PutHashedEntry(table_base, index, HashedPageTableEntry{ 0, 0, 0, 0 });
+    index = (index - 1) & (entries - 1);
+  }
+}
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+MemoryFault BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::TryExecute() {
+  if (pmcb.operation_state == PMCB::NONE) return MemoryFault::kNone;
   
-  if (pmcb.operation_state != PMCB::READ_OP && pmcb.operation_state != PMCB::WRITE_OP) {
+  if (pmcb.operation_state != PMCB::READ_OP 
+          && pmcb.operation_state != PMCB::WRITE_OP
+          && pmcb.operation_state != PMCB::FILL_OP
+          && pmcb.operation_state != PMCB::COPY_OP) {
     throw InvalidMMUOperationException("PMCB Error: operation is invalid");
   }
   
-  while (pmcb.remaining_count > 0) {
-    // Check if next page is mapped and has correct write permission
-    Addr next_paddress;
-    ToPhysical(pmcb.next_vaddress, next_paddress, 
-               pmcb.operation_state == PMCB::WRITE_OP);
-    
-    // Determine remaining count within current page
-    Addr count_in_page = std::min(pmcb.remaining_count,
-                                  kPageSize - (pmcb.next_vaddress & kPageOffsetMask));
-    
-    // Transfer bytes
-    if (pmcb.operation_state == PMCB::READ_OP) {
-      phys_mem.get_bytes(pmcb.user_buffer, next_paddress, count_in_page);
-    } else {  // write
-      phys_mem.put_bytes(next_paddress, count_in_page, pmcb.user_buffer);
+  VAddr translating = pmcb.next_vaddress;  // reported if translation faults
+  MemoryFault fault;
+  try {
+    while (pmcb.remaining_count > 0) {
+      // Determine remaining count within current page
+      Addr count_in_page = std::min(pmcb.remaining_count,
+                                    kPageBytes - (static_cast<Addr>(pmcb.next_vaddress) & kOffsetMask));
+      
+      // For a copy, also stay within the current source page, and check that
+      // it is mapped
+      Addr next_src_paddress;
+      if (pmcb.operation_state == PMCB::COPY_OP) {
+        count_in_page = std::min(count_in_page, 
+                                 kPageBytes - (static_cast<Addr>(pmcb.next_src_vaddress) & kOffsetMask));
+        translating = pmcb.next_src_vaddress;
+        fault = TryToPhysical(pmcb.next_src_vaddress, next_src_paddress, false);
+        if (fault != MemoryFault::kNone) {
+          pmcb.fault_vaddress = translating;
+          if (CallFaultHandler(fault, translating, false)) continue;
+          return fault;
+        }
+      }
+      
+      // Check if next page is mapped and has correct write permission
+      Addr next_paddress;
+      bool write_op = pmcb.operation_state != PMCB::READ_OP;
+      translating = pmcb.next_vaddress;
+      fault = TryToPhysical(pmcb.next_vaddress, next_paddress, write_op);
+      if (fault != MemoryFault::kNone) {
+        pmcb.fault_vaddress = translating;
+        if (CallFaultHandler(fault, translating, write_op)) continue;
+        return fault;
+      }
+      
+      // Transfer bytes
+      switch (pmcb.operation_state) {
+        case PMCB::READ_OP:
+          phys_mem.get_bytes(pmcb.user_buffer, next_paddress, count_in_page);
+          pmcb.user_buffer += count_in_page;
+          break;
+        case PMCB::WRITE_OP:
+          phys_mem.put_bytes(next_paddress, count_in_page, pmcb.user_buffer);
+          pmcb.user_buffer += count_in_page;
+          break;
+        case PMCB::FILL_OP:
+          phys_mem.fill_bytes(next_paddress, count_in_page, pmcb.fill_value);
+          break;
+        default:  // copy
+          phys_mem.copy_bytes(next_paddress, next_src_paddress, count_in_page);
+          pmcb.next_src_vaddress += count_in_page;
+          break;
+      }
+
+      // Advance state of transfer
+      pmcb.next_vaddress += count_in_page;
+      pmcb.remaining_count -= count_in_page;
     }
-    
-    // Advance state of transfer
-    pmcb.next_vaddress += count_in_page;
-    pmcb.user_buffer += count_in_page;
-    pmcb.remaining_count -= count_in_page;
+  } catch (MemorySubsystemException &e) {
+    pmcb.fault_vaddress = translating;
+    throw;
+  }
+  return MemoryFault::kNone;
+}
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+bool BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::CallFaultHandler(MemoryFault fault, VAddr vaddress, bool write) {
+  if (fault_handler == nullptr || handling_fault 
+          || !InAddressSpace(vaddress)) {
+    return false;
+  }
+  
+  // The handler may change the PMCB and page tables, so restore the PMCB 
+  // and discard cached translations which may be stale afterwards
+  PMCB fault_pmcb = pmcb;
+  handling_fault = true;
+  bool resolved;
+  try {
+    resolved = fault_handler->HandleFault(fault, vaddress, write, fault_pmcb);
+  } catch (...) {
+    handling_fault = false;
+    pmcb = fault_pmcb;
+    throw;
+  }
+  handling_fault = false;
+  pmcb = fault_pmcb;
+  InvalidateLastTranslation();
+  if (HasTLB()) pwc->Flush();
+  return resolved;
+}
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+void BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::ThrowFault(MemoryFault fault) {
+  if (fault == MemoryFault::kWritePermissionFault) {
+    throw WritePermissionFaultException();
   }
+  throw PageFaultException();
 }
 
-void MMU::get_byte(uint8_t *dest, Addr vaddress) {
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+void BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::get_byte(uint8_t *dest, VAddr vaddress) {
   InitMemoryOperation(PMCB::READ_OP, vaddress, 1, dest);
   Execute();
 }
 
-void MMU::get_bytes(uint8_t *dest, Addr vaddress, Addr count) {
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+void BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::get_bytes(uint8_t *dest, VAddr vaddress, Addr count) {
   InitMemoryOperation(PMCB::READ_OP, vaddress, count, dest);
   Execute();
 }
 
-void MMU::put_byte(Addr vaddress, uint8_t *data) {
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+void BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::put_byte(VAddr vaddress, uint8_t *data) {
   InitMemoryOperation(PMCB::WRITE_OP, vaddress, 1, data);
   Execute();  
 }
 
-void MMU::put_bytes(Addr vaddress, Addr count, uint8_t *src) {
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+void BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::put_bytes(VAddr vaddress, Addr count, uint8_t *src) {
   InitMemoryOperation(PMCB::WRITE_OP, vaddress, count, src);
   Execute();
 }
 
-void MMU::set_PMCB(const PMCB &new_pmcb) {
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+void BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::fill_bytes(VAddr vaddress, Addr count, uint8_t value) {
+  InitMemoryOperation(PMCB::FILL_OP, vaddress, count, nullptr);
+  pmcb.fill_value = value;
+  Execute();
+}
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+void BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::copy_bytes(VAddr dest_vaddress, VAddr src_vaddress, Addr count) {
+  InitMemoryOperation(PMCB::COPY_OP, dest_vaddress, count, nullptr);
+  pmcb.next_src_vaddress = src_vaddress;
+  Execute();
+}
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+MemoryFault BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::try_get_bytes(uint8_t *dest, VAddr vaddress, Addr count) {
+  InitMemoryOperation(PMCB::READ_OP, vaddress, count, dest);
+  return TryExecute();
+}
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+MemoryFault BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::try_put_bytes(VAddr vaddress, Addr count, uint8_t *src) {
+  InitMemoryOperation(PMCB::WRITE_OP, vaddress, count, src);
+  return TryExecute();
+}
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+MemoryFault BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::try_fill_bytes(VAddr vaddress, Addr count, uint8_t value) {
+  InitMemoryOperation(PMCB::FILL_OP, vaddress, count, nullptr);
+  pmcb.fill_value = value;
+  return TryExecute();
+}
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+MemoryFault BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::try_copy_bytes(VAddr dest_vaddress, VAddr src_vaddress, 
+                                Addr count) {
+  InitMemoryOperation(PMCB::COPY_OP, dest_vaddress, count, nullptr);
+  pmcb.next_src_vaddress = src_vaddress;
+  return TryExecute();
+}
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+std::pair<uint8_t*, Addr> BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::map_page(VAddr vaddress, Addr count, bool write) {
+  std::pair<uint8_t*, Addr> mapping;
+  MemoryFault fault = try_map_page(vaddress, count, write, mapping);
+  if (fault != MemoryFault::kNone) {
+    ThrowFault(fault);
+  }
+  return mapping;
+}
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+MemoryFault BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::try_map_page(VAddr vaddress, Addr count, bool write,
+                              std::pair<uint8_t*, Addr> &mapping) {
+  Addr paddress;
+  try {
+    MemoryFault fault;
+    while ((fault = TryToPhysical(vaddress, paddress, write)) 
+            != MemoryFault::kNone) {
+      pmcb.fault_vaddress = vaddress;
+      if (!CallFaultHandler(fault, vaddress, write)) {
+        return fault;
+      }
+    }
+  } catch (MemorySubsystemException &e) {
+    pmcb.fault_vaddress = vaddress;
+    throw;
+  }
+  mapping = phys_mem.map_page(paddress, count, write);
+  return MemoryFault::kNone;
+}
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+void BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::set_PMCB(const PMCB &new_pmcb) {
+  MemoryFault fault = try_set_PMCB(new_pmcb);
+  if (fault != MemoryFault::kNone) {
+    ThrowFault(fault);
+  }
+}
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+MemoryFault BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::try_set_PMCB(const PMCB &new_pmcb) {
+  if (new_pmcb.asid > kMaxASID) {
+    throw InvalidMMUOperationException("PMCB Error: ASID out of range");
+  }
+  InvalidateLastTranslation();
+  
+  // Cached 2nd level page table addresses belong to the old page table
+  if (HasTLB() && (new_pmcb.page_table_base != pmcb.page_table_base
+          || new_pmcb.page_table_format != pmcb.page_table_format)) {
+    pwc->Flush();
+  }
+  
   pmcb = new_pmcb;
   if (pmcb.remaining_count > 0) {
-    Execute();
+    return TryExecute();
   }
+  return MemoryFault::kNone;
+}
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+void BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::FlushASID(ASID asid) {
+  InvalidateLastTranslation();
+  if (HasTLB()) tlb->FlushASID(asid);
+  if (HasTLB()) pwc->Flush();
+}
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+void BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::FlushPage(VAddr vaddress) {
+  FlushPage(vaddress, pmcb.asid);
+}
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+void BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::FlushPage(VAddr vaddress, ASID asid) {
+  InvalidateLastTranslation();
+  if (HasTLB()) tlb->FlushPage(TLBKey(vaddress), asid);
+  if (HasTLB()) pwc->Flush();
 }
 
-void MMU::get_TLBStats(TLB::TLBStats& stats) {
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+void BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::get_TLBStats(TLB::TLBStats& stats) {
   if (tlb.get() != nullptr) {
     tlb->get_stats(stats);
   } else {
@@ -176,4 +585,101 @@ void MMU::get_TLBStats(TLB::TLBStats& stats) {
   }
 }
 
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+void BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::get_PWCStats(PageWalkCache::PWCStats& stats) {
+  if (pwc.get() != nullptr) {
+    pwc->get_stats(stats);
+  } else {
+    throw InvalidMMUOperationException("TLB is not enabled, page walk cache stats not available");
+  }
+}
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+void BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::SaveSnapshot(std::ostream &out) {
+  if ((pmcb.operation_state == PMCB::READ_OP 
+          || pmcb.operation_state == PMCB::WRITE_OP)
+          && pmcb.remaining_count > 0) {
+    throw InvalidMMUOperationException(
+            "Snapshot Error: cannot save a pending read or write operation");
+  }
+  
+  WriteSnapshotValue(out, kSnapshotMagic);
+  WriteSnapshotValue(out, frame_count);
+  
+  // Save PMCB (except user buffer, which is unused)
+  WriteSnapshotValue(out, pmcb.vm_enable);
+  WriteSnapshotValue(out, pmcb.page_table_base);
+  WriteSnapshotValue(out, pmcb.asid);
+  WriteSnapshotValue(out, pmcb.page_table_format);
+  WriteSnapshotValue(out, pmcb.operation_state);
+  WriteSnapshotValue(out, pmcb.next_vaddress);
+  WriteSnapshotValue(out, pmcb.remaining_count);
+  WriteSnapshotValue(out, pmcb.next_src_vaddress);
+  WriteSnapshotValue(out, pmcb.fill_value);
+  WriteSnapshotValue(out, pmcb.fault_vaddress);
+  
+  // Save TLB
+  WriteSnapshotValue(out, HasTLB());
+  if (HasTLB()) {
+    tlb->Save(out);
+  }
+  
+  phys_mem.SaveContents(out);
+}
+
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, int VABits>
+void BasicMMU<PageBits, TableBits, TLBPolicy, Stats, VABits>::RestoreSnapshot(std::istream &in) {
+  uint32_t magic;
+  Addr saved_frame_count;
+  ReadSnapshotValue(in, magic);
+  ReadSnapshotValue(in, saved_frame_count);
+  if (magic != kSnapshotMagic || saved_frame_count != frame_count) {
+    throw InvalidMMUOperationException("Snapshot Error: snapshot does not match MMU");
+  }
+  
+  // Restore PMCB
+  PMCB saved_pmcb;
+  ReadSnapshotValue(in, saved_pmcb.vm_enable);
+  ReadSnapshotValue(in, saved_pmcb.page_table_base);
+  ReadSnapshotValue(in, saved_pmcb.asid);
+  ReadSnapshotValue(in, saved_pmcb.page_table_format);
+  ReadSnapshotValue(in, saved_pmcb.operation_state);
+  ReadSnapshotValue(in, saved_pmcb.next_vaddress);
+  ReadSnapshotValue(in, saved_pmcb.remaining_count);
+  ReadSnapshotValue(in, saved_pmcb.next_src_vaddress);
+  ReadSnapshotValue(in, saved_pmcb.fill_value);
+  ReadSnapshotValue(in, saved_pmcb.fault_vaddress);
+  
+  // Restore TLB; cached translations which were not saved are discarded
+  bool saved_tlb;
+  ReadSnapshotValue(in, saved_tlb);
+  if (saved_tlb != HasTLB()) {
+    throw InvalidMMUOperationException("Snapshot Error: TLB configuration does not match");
+  }
+  if (HasTLB()) {
+    tlb->Restore(in);
+  }
+  if (HasTLB()) pwc->Flush();
+  InvalidateLastTranslation();
+  
+  // Translations restored above must not outlive a failed memory restore
+  try {
+    phys_mem.RestoreContents(in);
+  } catch (...) {
+    if (HasTLB()) tlb->Flush();
+    throw;
+  }
+  pmcb = saved_pmcb;
+}
+
+// Configurations declared in MMU.h
+template class BasicMMU<12, 10, DynamicTLB, CountStats>;
+template class BasicMMU<12, 10, DynamicTLB, NoStats>;
+template class BasicMMU<12, 10, NoTLB, NoStats>;
+template class BasicMMU<14, 10, DynamicTLB, CountStats>;
+template class BasicMMU<14, 10, DynamicTLB, NoStats>;
+template class BasicMMU<16, 10, DynamicTLB, CountStats>;
+template class BasicMMU<16, 10, DynamicTLB, NoStats>;
+template class BasicMMU<12, 9, DynamicTLB, CountStats, 48>;
+
 }  // namespace mem
\ No newline at end of file
@@ -11,16 +11,170 @@
 #ifndef MEM_MMU_H
 #define MEM_MMU_H
 
+#include "MultiNodeMemory.h"
 #include "PageTable.h"
+#include "PageWalkCache.h"
 #include "PMCB.h"
 #include "TLB.h"
 
+#include <iosfwd>
 #include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace mem {
 
-class MMU {
+// Fault reported by the non-throwing MMU operations (try_get_bytes, etc.)
+enum class MemoryFault {
+  kNone,                 // operation completed
+  kPageFault,            // page not present
+  kWritePermissionFault  // write to a page which is not writable
+};
+
+// Handler called by the MMU when an access faults, before the fault is 
+// reported to the caller (like an operating system's fault handler). See 
+// MMU::set_fault_handler.
+class FaultHandler {
+public:
+  virtual ~FaultHandler() {}
+  
+  /**
+   * HandleFault - handle a fault in an MMU operation. The handler may use 
+   *   the MMU in any mode (e.g. physical mode, to update the page table);
+   *   the MMU restores the PMCB of the interrupted operation when the 
+   *   handler returns. Faults in the handler's own MMU operations are not
+   *   passed to the handler.
+   * 
+   * @param fault page fault or write permission fault
+   * @param vaddress virtual address which faulted
+   * @param write true if the faulting access was a write
+   * @param fault_pmcb PMCB of the interrupted operation, with fault_vaddress
+   *   set
+   * @return true if the fault was resolved, so the access is retried and
+   *   the operation continues; false to stop the operation and report the
+   *   fault to the caller
+   */
+  virtual bool HandleFault(MemoryFault fault, VAddr vaddress, bool write,
+                           const PMCB &fault_pmcb) = 0;
+};
+
+// TLB policies for BasicMMU. With DynamicTLB, the MMU has a TLB (and page
+// walk cache) if it is constructed with a TLB size or geometry. With NoTLB,
+// it never has one, and the TLB size or geometry is ignored.
+struct DynamicTLB { static const bool kEnabled = true; };
+struct NoTLB { static const bool kEnabled = false; };
+
+// Statistics policies for BasicMMU. With NoStats, TLB and page walk cache 
+// hits and misses are not counted (get_TLBStats and get_PWCStats return 
+// counts of 0).
+struct CountStats { static const bool kEnabled = true; };
+struct NoStats { static const bool kEnabled = false; };
+
+/*
+ * MMUInterface - operations of an MMU of any configuration, so that code 
+ * such as an operating system can use each BasicMMU configuration without
+ * being a template itself. See BasicMMU for descriptions of the operations.
+ * BasicMMU is final, so calls made through a BasicMMU are not virtual.
+ */
+class MMUInterface {
+public:
+  virtual ~MMUInterface() {}
+  
+  // Page table geometry (see BasicMMU): virtual address bits, page offset
+  // bits, number of page table levels, and number of index bits of each 
+  // page table
+  virtual int get_vaddr_bits() const = 0;
+  virtual int get_page_bits() const = 0;
+  virtual int get_page_table_levels() const = 0;
+  virtual int get_page_table_bits() const = 0;
+  
+  virtual Addr get_frame_count() const = 0;
+  
+  // Memory operations
+  virtual void get_byte(uint8_t *dest, VAddr vaddress) = 0;
+  virtual void get_bytes(uint8_t *dest, VAddr vaddress, Addr count) = 0;
+  virtual void put_byte(VAddr vaddress, uint8_t *data) = 0;
+  virtual void put_bytes(VAddr vaddress, Addr count, uint8_t *src) = 0;
+  virtual void fill_bytes(VAddr vaddress, Addr count, uint8_t value) = 0;
+  virtual void copy_bytes(VAddr dest_vaddress, VAddr src_vaddress, 
+                          Addr count) = 0;
+  virtual std::pair<uint8_t*, Addr> map_page(VAddr vaddress, Addr count, 
+                                             bool write) = 0;
+  virtual MemoryFault try_get_bytes(uint8_t *dest, VAddr vaddress, 
+                                    Addr count) = 0;
+  virtual MemoryFault try_put_bytes(VAddr vaddress, Addr count, 
+                                    uint8_t *src) = 0;
+  virtual MemoryFault try_fill_bytes(VAddr vaddress, Addr count, 
+                                     uint8_t value) = 0;
+  virtual MemoryFault try_copy_bytes(VAddr dest_vaddress, VAddr src_vaddress,
+                                     Addr count) = 0;
+  virtual MemoryFault try_map_page(VAddr vaddress, Addr count, bool write,
+                                   std::pair<uint8_t*, Addr> &mapping) = 0;
+  
+  // Control
+  virtual void set_PMCB(const PMCB &new_pmcb) = 0;
+  virtual MemoryFault try_set_PMCB(const PMCB &new_pmcb) = 0;
+  virtual void get_PMCB(PMCB &cur_pmcb) const = 0;
+  virtual void set_fault_handler(FaultHandler *handler) = 0;
+  virtual FaultHandler *get_fault_handler() const = 0;
+  virtual void FlushTLB() = 0;
+  virtual void FlushASID(ASID asid) = 0;
+  virtual void FlushPage(VAddr vaddress) = 0;
+  virtual void FlushPage(VAddr vaddress, ASID asid) = 0;
+  
+  // Physical memory node configuration
+  virtual size_t get_node_count() const = 0;
+  virtual Addr get_node_base(size_t node) const = 0;
+  virtual Addr get_node_frame_count(size_t node) const = 0;
+  virtual size_t get_node(Addr paddress) const = 0;
+  virtual void set_current_node(size_t node) = 0;
+  virtual size_t get_current_node() const = 0;
+};
+
+/*
+ * BasicMMU - MMU with page geometry and policies fixed at compile time.
+ * 
+ * Virtual addresses are VABits wide, pages are 2^PageBits bytes, and each 
+ * page table has 2^TableBits entries. The page table has as many levels as
+ * are needed to map the virtual address space; the top level table is 
+ * indexed by the remaining high bits of the virtual address. Entries in the
+ * level above the last may map large pages of 2^(PageBits + TableBits) 
+ * bytes. Page table entries have the same format for all geometries (flags
+ * in the low 12 bits), and frame counts are in pages of the MMU's page size.
+ * In place of the multi-level table, the PMCB may select a hashed page table,
+ * which maps pages of the MMU's page size but no large pages.
+ * 
+ * The member functions are compiled for the configurations instantiated at
+ * the end of MMU.cpp. MMU is the standard configuration (32 bit virtual 
+ * addresses and two levels), and MMU64 has an x86-64 like layout.
+ */
+template <int PageBits, int TableBits, class TLBPolicy, class Stats, 
+          int VABits = 32>
+class BasicMMU final : public MMUInterface {
+  static_assert(PageBits >= kPageSizeBits, 
+                "page offset must hold page table entry flags and ASID");
+  static_assert(TableBits <= kPageTableSizeBits
+                && PageBits + TableBits < 32
+                && (VABits > 32 || PageBits + TableBits >= kLargePageSizeBits)
+                && VABits <= 64 && VABits - (PageBits + TableBits) <= 32,
+                "unsupported page table geometry");
 public:
+  // Page and page table geometry
+  static const int kVAddrBits = VABits;
+  static const int kLevels = (VABits - PageBits + TableBits - 1) / TableBits;
+  static const Addr kPageBytes = Addr(1) << PageBits;
+  static const Addr kOffsetMask = kPageBytes - 1;
+  static const Addr kNumberMask = ~kOffsetMask;
+  static const Addr kTableIndexMask = (Addr(1) << TableBits) - 1;
+  static const int kLargePageBits = PageBits + TableBits;
+  static const Addr kLargeOffsetMask = (Addr(1) << kLargePageBits) - 1;
+  int get_vaddr_bits() const override { return kVAddrBits; }
+  int get_page_bits() const override { return PageBits; }
+  int get_page_table_levels() const override { return kLevels; }
+  int get_page_table_bits() const override { return TableBits; }
+  
 /**
    * Constructor (TLB enabled)
    * 
@@ -29,43 +183,199 @@ public:
    * 
    * @param frame_count_ number of page frames to allocate in physical memory
    * @param tlb_size_ number of entries in TLB (must be > 0)
+   * @param backing dense or sparse physical memory
    * @throws std::bad_alloc if insufficient memory
    */
-  MMU(Addr frame_count_, size_t tlb_size)
+  BasicMMU(Addr frame_count_, size_t tlb_size, 
+      PhysicalMemory::Backing backing = PhysicalMemory::Backing::kDense)
   : frame_count(frame_count_),
-    phys_mem(frame_count_ * kPageSize),
-    tlb(std::make_unique<TLB>(tlb_size)) {
+    phys_mem(static_cast<uint64_t>(frame_count_) << PageBits, backing),
+    tlb(MakeTLB(tlb_size)),
+    pwc(MakePWC()) {
+    InvalidateLastTranslation();
+  };
+  
+  /**
+   * Constructor (set associative TLB enabled)
+   * 
+   * MMU is initialized with virtual memory disabled (pmcb is 0). 
+   * Set the PMCB non-zero to enable it.
+   * 
+   * @param frame_count_ number of page frames to allocate in physical memory
+   * @param tlb_geometry number of sets and ways in TLB, and size of optional
+   *   level 1 TLB
+   * @param backing dense or sparse physical memory
+   * @throws std::bad_alloc if insufficient memory
+   * @throws InvalidMMUOperationException if TLB geometry is invalid
+   */
+  BasicMMU(Addr frame_count_, const TLBGeometry &tlb_geometry,
+      PhysicalMemory::Backing backing = PhysicalMemory::Backing::kDense)
+  : frame_count(frame_count_),
+    phys_mem(static_cast<uint64_t>(frame_count_) << PageBits, backing),
+    tlb(MakeTLB(tlb_geometry)),
+    pwc(MakePWC()) {
+    InvalidateLastTranslation();
   };
   
   /**
    * Constructor (TLB disabled)
    * 
    * MMU is initialized with virtual memory disabled (pmcb is 0). 
-   * Set the PMCB non-zero to enable it. No TLB is used with MMU.
+   * Set the PMCB non-zero to enable it. No TLB or page walk cache is used 
+   * with MMU.
    * 
    * @param frame_count_ number of page frames to allocate in physical memory
+   * @param backing dense or sparse physical memory
    * @throws std::bad_alloc if insufficient memory
    */
-  MMU(Addr frame_count_) 
+  BasicMMU(Addr frame_count_, 
+      PhysicalMemory::Backing backing = PhysicalMemory::Backing::kDense) 
   : frame_count(frame_count_), 
-    phys_mem(frame_count_ * kPageSize),
-    tlb(nullptr)
+    phys_mem(static_cast<uint64_t>(frame_count_) << PageBits, backing),
+    tlb(nullptr),
+    pwc(nullptr)
   {
+    InvalidateLastTranslation();
   };
   
-  ~MMU() { }
+  /**
+   * Constructor (TLB enabled, physical memory mapped from a file)
+   * 
+   * MMU is initialized with virtual memory disabled (pmcb is 0). 
+   * Set the PMCB non-zero to enable it. The file holds the contents of
+   * physical memory (see PhysicalMemory), which persist after the MMU is
+   * destroyed.
+   * 
+   * @param frame_count_ number of page frames in physical memory
+   * @param tlb_size_ number of entries in TLB (must be > 0)
+   * @param memory_file file mapped as physical memory
+   * @throws std::system_error if the file cannot be mapped
+   */
+  BasicMMU(Addr frame_count_, size_t tlb_size, const std::string &memory_file)
+  : frame_count(frame_count_),
+    phys_mem(static_cast<uint64_t>(frame_count_) << PageBits, memory_file),
+    tlb(MakeTLB(tlb_size)),
+    pwc(MakePWC()) {
+    InvalidateLastTranslation();
+  };
+  
+  /**
+   * Constructor (TLB disabled, physical memory mapped from a file)
+   * 
+   * @param frame_count_ number of page frames in physical memory
+   * @param memory_file file mapped as physical memory
+   * @throws std::system_error if the file cannot be mapped
+   */
+  BasicMMU(Addr frame_count_, const std::string &memory_file)
+  : frame_count(frame_count_),
+    phys_mem(static_cast<uint64_t>(frame_count_) << PageBits, memory_file),
+    tlb(nullptr),
+    pwc(nullptr) {
+    InvalidateLastTranslation();
+  };
   
-  MMU(const MMU &other) = delete;  // no copy constructor
-  MMU(MMU &&other) = delete;       // no move constructor
-  MMU operator=(const MMU &other) = delete;  // no copy assign
-  MMU operator=(MMU &&other) = delete;       // no move assign
+  /**
+   * Constructor (TLB enabled, physical memory made up of nodes)
+   * 
+   * MMU is initialized with virtual memory disabled (pmcb is 0), and the 
+   * current node set to node 0. Set the PMCB non-zero to enable it.
+   * 
+   * @param nodes configuration of each node (see MultiNodeMemory)
+   * @param tlb_size_ number of entries in TLB (must be > 0)
+   * @param backing dense or sparse physical memory
+   * @throws InvalidMMUOperationException if node configuration is invalid
+   * @throws std::bad_alloc if insufficient memory
+   */
+  BasicMMU(const std::vector<MemoryNode> &nodes, size_t tlb_size,
+      PhysicalMemory::Backing backing = PhysicalMemory::Backing::kDense)
+  : frame_count(TotalFrameCount(nodes)),
+    phys_mem(nodes, backing),
+    tlb(MakeTLB(tlb_size)),
+    pwc(MakePWC()) {
+    InvalidateLastTranslation();
+  };
+  
+  /**
+   * Constructor (TLB disabled, physical memory made up of nodes)
+   * 
+   * @param nodes configuration of each node (see MultiNodeMemory)
+   * @param backing dense or sparse physical memory
+   * @throws InvalidMMUOperationException if node configuration is invalid
+   * @throws std::bad_alloc if insufficient memory
+   */
+  BasicMMU(const std::vector<MemoryNode> &nodes,
+      PhysicalMemory::Backing backing = PhysicalMemory::Backing::kDense)
+  : frame_count(TotalFrameCount(nodes)),
+    phys_mem(nodes, backing),
+    tlb(nullptr),
+    pwc(nullptr) {
+    InvalidateLastTranslation();
+  };
+  
+  ~BasicMMU() { }
+  
+  BasicMMU(const BasicMMU &other) = delete;  // no copy constructor
+  BasicMMU(BasicMMU &&other) = delete;       // no move constructor
+  BasicMMU operator=(const BasicMMU &other) = delete;  // no copy assign
+  BasicMMU operator=(BasicMMU &&other) = delete;       // no move assign
 
   /**
    * get_frame_count - return number of page frames allocated
    * 
    * @return number of page frames in physical memory 
    */
-  Addr get_frame_count() const { return frame_count; }
+  Addr get_frame_count() const override { return frame_count; }
+  
+  /**
+   * get_hashed_page_table_size - return number of entries in a hashed page
+   *   table for this MMU (see PMCB page_table_format)
+   * 
+   * @return number of entries (each sizeof(HashedPageTableEntry) bytes)
+   */
+  Addr get_hashed_page_table_size() const { 
+    return HashedPageTableSize(frame_count); 
+  }
+  
+  /**
+   * MapHashedPage - map a page in a hashed page table (see 
+   *   HashedPageTableEntry), in the page's existing entry, or else the first
+   *   tombstone or unused entry from its home entry, and invalidate any 
+   *   cached translation of the page. The table is accessed in physical 
+   *   memory, whatever the PMCB.
+   * 
+   * @param table_base physical address of hashed page table
+   * @param asid address space of page
+   * @param vaddress virtual address in page
+   * @param pt_entry page table entry for page
+   * @return physical address of the table entry
+   * @throws InvalidMMUOperationException if the table is full
+   */
+  Addr MapHashedPage(Addr table_base, ASID asid, VAddr vaddress, 
+                     PageTableEntry pt_entry);
+  
+  /**
+   * UnmapHashedPage - remove a page from a hashed page table, leaving a 
+   *   tombstone in its entry, and invalidate any cached translation of the
+   *   page. The table is accessed in physical memory, whatever the PMCB.
+   * 
+   * @param table_base physical address of hashed page table
+   * @param asid address space of page
+   * @param vaddress virtual address in page
+   * @return true if the page was removed, false if it was not in the table
+   */
+  bool UnmapHashedPage(Addr table_base, ASID asid, VAddr vaddress);
+  
+  /**
+   * PurgeHashedASID - remove every page of an address space from a hashed
+   *   page table (e.g. before its ASID is reused for another address 
+   *   space), and invalidate cached translations of the address space. The
+   *   table is accessed in physical memory, whatever the PMCB.
+   * 
+   * @param table_base physical address of hashed page table
+   * @param asid address space identifier
+   * @return number of pages removed
+   */
+  Addr PurgeHashedASID(Addr table_base, ASID asid);
   
   /**
    * get_byte - get a single byte from the specified virtual address
@@ -73,7 +383,7 @@ public:
    * @param dest - destination byte
    * @param vaddress - address of data in memory
    */
-  void get_byte(uint8_t *dest, Addr vaddress);
+  void get_byte(uint8_t *dest, VAddr vaddress) override;
   
   /**
    * get_bytes - copy a range of bytes to caller buffer
@@ -82,7 +392,7 @@ public:
    * @param address source virtual address
    * @param count number of bytes to copy
    */
-  void get_bytes(uint8_t *dest, Addr vaddress, Addr count);
+  void get_bytes(uint8_t *dest, VAddr vaddress, Addr count) override;
 
   /**
    * put_byte - store a single byte to the specified virtual address
@@ -90,7 +400,7 @@ public:
    * @param vaddress - address of data in memory
    * @param data - pointer to data to store at address
    */
-  void put_byte(Addr vaddress, uint8_t *data);
+  void put_byte(VAddr vaddress, uint8_t *data) override;
 
   /**
    * put_bytes - copy a range of bytes into physical memory
@@ -99,13 +409,88 @@ public:
    * @param count number of bytes to copy
    * @param src source buffer
    */
-  void put_bytes(Addr vaddress, Addr count, uint8_t *src);
+  void put_bytes(VAddr vaddress, Addr count, uint8_t *src) override;
+  
+  /**
+   * fill_bytes - store count copies of value starting at a virtual address.
+   *   Each page is translated once. On a fault, the PMCB holds the state 
+   *   needed to resume the fill.
+   * 
+   * @param vaddress virtual address destination
+   * @param count number of bytes to store
+   * @param value value to store in each byte
+   */
+  void fill_bytes(VAddr vaddress, Addr count, uint8_t value) override;
+  
+  /**
+   * copy_bytes - copy a range of bytes between virtual addresses. Each page
+   *   is translated once. The source and destination ranges must not 
+   *   overlap. On a fault, the PMCB holds the state needed to resume the 
+   *   copy, and fault_vaddress identifies the source or destination address
+   *   which faulted.
+   * 
+   * @param dest_vaddress virtual address destination
+   * @param src_vaddress virtual address source
+   * @param count number of bytes to copy
+   */
+  void copy_bytes(VAddr dest_vaddress, VAddr src_vaddress, 
+                  Addr count) override;
+  
+  /**
+   * map_page - get a pointer for direct access to a range of bytes within
+   *   one virtual page, translating the address once. The range is truncated 
+   *   at the end of the page. The pointer must not be used after the page 
+   *   table mapping of the page changes, nor outside of the returned range.
+   * 
+   * @param vaddress virtual address of first byte
+   * @param count maximum number of bytes to access (must be > 0)
+   * @param write true if bytes will be written
+   * @return pointer to byte at vaddress, and number of bytes in range
+   * @throws PageFaultException if address unmapped; PMCB fault_vaddress is 
+   *   set to vaddress
+   * @throws WritePermissionFaultException if write and page is not writable
+   */
+  std::pair<uint8_t*, Addr> map_page(VAddr vaddress, Addr count, 
+                                     bool write) override;
+  
+  /**
+   * try_get_bytes, try_put_bytes, try_fill_bytes, try_copy_bytes - as for 
+   *   get_bytes, etc., but a page fault or write permission fault is 
+   *   returned instead of thrown. The PMCB holds the state needed to resume
+   *   the operation (see try_set_PMCB), as after an exception. Other errors
+   *   are still thrown.
+   * 
+   * @return MemoryFault::kNone if the operation completed, else the fault
+   */
+  MemoryFault try_get_bytes(uint8_t *dest, VAddr vaddress, 
+                            Addr count) override;
+  MemoryFault try_put_bytes(VAddr vaddress, Addr count, uint8_t *src) override;
+  MemoryFault try_fill_bytes(VAddr vaddress, Addr count, 
+                             uint8_t value) override;
+  MemoryFault try_copy_bytes(VAddr dest_vaddress, VAddr src_vaddress, 
+                             Addr count) override;
+  
+  /**
+   * try_map_page - as for map_page, but a fault is returned instead of 
+   *   thrown
+   * 
+   * @param vaddress virtual address of first byte
+   * @param count maximum number of bytes to access (must be > 0)
+   * @param write true if bytes will be written
+   * @param mapping set to pointer to byte at vaddress, and number of bytes in
+   *   range (unchanged if fault)
+   * @return MemoryFault::kNone if mapped, else the fault; PMCB fault_vaddress
+   *   is set to vaddress
+   */
+  MemoryFault try_map_page(VAddr vaddress, Addr count, bool write,
+                           std::pair<uint8_t*, Addr> &mapping) override;
   
   /**
    * set_PMCB - set the Processor Memory Control Block to be used by the MMU
    * 
    * If the remaining_count is > 0, the read or write operation will
-   * resume. The specified PMCB is copied into the MMU.
+   * resume. The specified PMCB is copied into the MMU. The TLB does not need
+   * to be flushed when switching between page tables with different ASIDs.
    * 
    * IMPORTANT: for a resumed operation, make sure that the user_buffer still
    * points to a valid location within the original buffer, and that the
@@ -115,26 +500,61 @@ public:
    * resumed operation; calling code must be able to handle this correctly.
    * 
    * @param new_pmcb - start using this PMCB
+   * @throws InvalidMMUOperationException if ASID is greater than kMaxASID
    */
-  void set_PMCB(const PMCB &new_pmcb);
+  void set_PMCB(const PMCB &new_pmcb) override;
+  
+  /**
+   * try_set_PMCB - as for set_PMCB, but a fault in a resumed operation is 
+   *   returned instead of thrown
+   * 
+   * @param new_pmcb - start using this PMCB
+   * @return MemoryFault::kNone if no operation is pending or it completed,
+   *   else the fault
+   * @throws InvalidMMUOperationException if ASID is greater than kMaxASID
+   */
+  MemoryFault try_set_PMCB(const PMCB &new_pmcb) override;
+  
+  /**
+   * set_fault_handler - set handler to be called when an access faults. A 
+   *   fault which the handler resolves is not reported to the caller of the 
+   *   operation, and the operation continues without interruption. Faults 
+   *   on addresses outside the virtual address space are not passed to the
+   *   handler.
+   * 
+   * @param handler fault handler, or nullptr to report all faults
+   */
+  void set_fault_handler(FaultHandler *handler) override { 
+    fault_handler = handler; 
+  }
+  FaultHandler *get_fault_handler() const override { return fault_handler; }
   
   /**
    * get_PMCB - get a copy of the current PMCB contents
    * 
    * @param cur_pmcb location to store PMCB contents
    */
-  void get_PMCB(PMCB &cur_pmcb) const { cur_pmcb = pmcb; }
+  void get_PMCB(PMCB &cur_pmcb) const override { cur_pmcb = pmcb; }
   
   /**
    * ToPhysical - convert virtual address to physical address.
    * 
    * If virtual mode is enabled, map a virtual address to a physical address. 
+   * If the page is the same as the one most recently translated, the saved
+   * translation is reused (and counted as a TLB hit if the TLB is enabled).
    * If the TLB is enabled and the page containing the virtual address is in 
    * the TLB, the page table is not consulted. Otherwise, the address is mapped
    * using the page table, and the mapping is cached in the TLB (if enabled).
+   * When the TLB is enabled, the page walk cache supplies the last level 
+   * page table address if it is cached, so only the last level entry is 
+   * read. If the entry in the level above the last has the LargePage flag 
+   * set, it maps a large page directly and there is no last level entry; 
+   * large pages are cached in the TLB, but not in the page walk cache. An 
+   * address outside the virtual address space causes a page fault.
    * 
    * If virtual mode is disabled, paddress is set to vaddress. The TLB is
-   * unused and unchanged in this case.
+   * unused and unchanged in this case, and an address of 4 GiB or more 
+   * throws PhysicalMemoryBoundsException.
    * 
    * @param vaddress virtual address to map
    * @param paddress returns corresponding physical address (undefined if not mapped)
@@ -143,7 +563,24 @@ public:
    * @throws WritePermissionFaultException if write op and page is not writable
    * @throws InvalidMMUOperationException if bad page table or other errors
    */
-  void ToPhysical(Addr vaddress, Addr &paddress, bool write_op);
+  void ToPhysical(VAddr vaddress, Addr &paddress, bool write_op) {
+    MemoryFault fault = TryToPhysical(vaddress, paddress, write_op);
+    if (fault != MemoryFault::kNone) {
+      ThrowFault(fault);
+    }
+  }
+  
+  /**
+   * TryToPhysical - as for ToPhysical, but a page fault or write permission 
+   *   fault is returned instead of thrown
+   * 
+   * @param vaddress virtual address to map
+   * @param paddress returns corresponding physical address (undefined if not mapped)
+   * @param write_op true if mapping for a write operation
+   * @return MemoryFault::kNone if mapped, else the fault
+   * @throws InvalidMMUOperationException if bad page table or other errors
+   */
+  MemoryFault TryToPhysical(VAddr vaddress, Addr &paddress, bool write_op);
   
   /**
    * get_byte_count - return total number of bytes transferred so far 
@@ -153,17 +590,109 @@ public:
    */
   uint64_t get_byte_count() const { return phys_mem.get_byte_count(); }
   
+  /**
+   * get_committed_frame_count - return number of page frames for which 
+   *   physical memory storage has been allocated
+   * 
+   * @return number of frames (all frames unless memory is sparse)
+   */
+  Addr get_committed_frame_count() const { 
+    return phys_mem.get_committed_frame_count(); 
+  }
+  
+  // Physical memory node configuration (see MultiNodeMemory)
+  size_t get_node_count() const override { 
+    return phys_mem.get_node_count(); 
+  }
+  Addr get_node_base(size_t node) const override { 
+    return phys_mem.get_node_base(node); 
+  }
+  Addr get_node_frame_count(size_t node) const override { 
+    return phys_mem.get_node_frame_count(node); 
+  }
+  size_t get_node(Addr paddress) const override { 
+    return phys_mem.get_node(paddress); 
+  }
+  
+  /**
+   * set_current_node - set node of the CPU using the MMU. Physical memory
+   *   accesses (including page table accesses) to other nodes are remote.
+   * 
+   * @param node node number
+   * @throws InvalidMMUOperationException if node does not exist
+   */
+  void set_current_node(size_t node) override { 
+    phys_mem.set_current_node(node); 
+  }
+  size_t get_current_node() const override { 
+    return phys_mem.get_current_node(); 
+  }
+  
+  /**
+   * get_node_byte_count - return number of bytes transferred so far to/from
+   *   one node of physical memory
+   * 
+   * @param node node number
+   * @return count of bytes transferred
+   */
+  uint64_t get_node_byte_count(size_t node) const { 
+    return phys_mem.get_node_byte_count(node); 
+  }
+  
+  /**
+   * get_node_stats - get local and remote access counts and access cost for
+   *   one node of physical memory
+   * 
+   * @param node node number
+   * @param stats statistics for node
+   */
+  void get_node_stats(size_t node, MultiNodeMemory::NodeStats &stats) const {
+    stats = phys_mem.get_node_stats(node);
+  }
+  
   /**
    * isTLBEnabled - query whether MMU has TLB enabled
    * 
    * @return true if TLB enabled, false otherwise
    */
-  bool isTLBEnabled() const { return tlb.get() != nullptr; }
+  bool isTLBEnabled() const { return HasTLB(); }
   
   /**
-   * FlushTLB - flush the TLB
+   * FlushTLB - flush the TLB (and the page walk cache and last translation
+   *   register)
    */
-  void FlushTLB() { if (tlb) tlb->Flush(); }
+  void FlushTLB() override { 
+    InvalidateLastTranslation();
+    if (HasTLB()) {
+      tlb->Flush(); 
+      pwc->Flush();
+    }
+  }
+  
+  /**
+   * FlushASID - invalidate cached translations for one address space
+   * 
+   * @param asid address space identifier
+   */
+  void FlushASID(ASID asid) override;
+  
+  /**
+   * FlushPage - invalidate cached translation for one page in the current
+   *   address space (e.g. after changing its page table entry)
+   * 
+   * @param vaddress virtual address in page
+   */
+  void FlushPage(VAddr vaddress) override;
+  
+  /**
+   * FlushPage - invalidate cached translation for one page in any address
+   *   space. May be used in physical mode, e.g. by a page fault handler 
+   *   which has changed the page table of the faulting process.
+   * 
+   * @param vaddress virtual address in page
+   * @param asid address space identifier
+   */
+  void FlushPage(VAddr vaddress, ASID asid) override;
   
   /**
    * get_TLBStats - get TLB statistics
@@ -173,24 +702,199 @@ public:
    */
   void get_TLBStats(TLB::TLBStats &stats);
   
+  /**
+   * get_PWCStats - get page walk cache statistics
+   * 
+   * @param stats statistics from page walk cache
+   * @throws InvalidMMUOperationException if TLB (and so page walk cache) not
+   *   enabled
+   */
+  void get_PWCStats(PageWalkCache::PWCStats &stats);
+  
+  /**
+   * SaveSnapshot - write the state of the machine to a stream: the PMCB, 
+   *   the TLB contents and statistics, and the contents of physical memory.
+   *   If physical memory is a mapped file, its contents are saved in a new
+   *   copy of the file instead of the stream (see 
+   *   PhysicalMemory::SaveContents). Without reflink support in the file 
+   *   system, this copies the whole file.
+   * 
+   * @param out snapshot stream
+   * @throws InvalidMMUOperationException if a read or write operation is
+   *   pending (its user buffer cannot be saved)
+   */
+  void SaveSnapshot(std::ostream &out);
+  
+  /**
+   * RestoreSnapshot - restore the state of the machine from a stream 
+   *   written by SaveSnapshot. The MMU must have the same frame count,
+   *   physical memory kind and TLB geometry as the MMU which was saved. A
+   *   mapped file is replaced by the copy saved with the snapshot, so a
+   *   machine may be rolled back to the snapshot after running on. If 
+   *   memory can't be restored, the TLB is flushed and the PMCB is left as
+   *   it was. A pending fill or copy operation in the restored PMCB is not
+   *   resumed until set_PMCB is called.
+   * 
+   * @param in snapshot stream
+   * @throws InvalidMMUOperationException if the snapshot does not match
+   *   this MMU or is truncated
+   * @throws std::system_error if the copy of a mapped file can't be read
+   */
+  void RestoreSnapshot(std::istream &in);
+  
 private:
   Addr frame_count;  // number of frames allocated in physical memory
-  PhysicalMemory phys_mem;
+  MultiNodeMemory phys_mem;
   PMCB pmcb;  // current MMU control information
   
+  // TLB tags are normalized page addresses (see TLBKey), which fit in an 
+  // Addr for 32 bit virtual addresses
+  typedef typename std::conditional<
+          VABits - (PageBits + TableBits) + kLargePageSizeBits <= 32, 
+          Addr, VAddr>::type TLBTag;
+  
   // TLB (null if TLB disabled)
-  std::unique_ptr<TLB> tlb;
+  std::unique_ptr<BasicTLB<TLBTag>> tlb;
+  
+  // Identifies the start of a snapshot written by SaveSnapshot
+  static const uint32_t kSnapshotMagic = 0x4D4D5557;
+  
+  // Page walk cache (null if TLB disabled)
+  static const size_t kPageWalkCacheSize = 16;
+  std::unique_ptr<PageWalkCache> pwc;
+  
+  // Last translation register - the page and frame of the most recent
+  // translation, so that repeated accesses to one page skip the TLB and page
+  // table. Invalidated by set_PMCB (which is also required to switch to
+  // physical mode to write a page table) and by FlushTLB.
+  VAddr last_vpage;     // virtual page number
+  Addr last_frame;      // physical address of start of page frame
+  bool last_valid;      // true if register holds a translation
+  bool last_writable;   // true if translation may be used for a write
+  
+  // Fault handler (null if none), and true while it is running
+  FaultHandler *fault_handler = nullptr;
+  bool handling_fault = false;
+  
+  /**
+   * TotalFrameCount - get number of page frames in all nodes
+   * 
+   * @param nodes configuration of each node (frame counts of 4 KiB frames)
+   * @return total number of frames of the MMU's page size
+   */
+  static Addr TotalFrameCount(const std::vector<MemoryNode> &nodes) {
+    uint64_t total = 0;
+    for (const MemoryNode &node : nodes) {
+      total += static_cast<uint64_t>(node.frame_count) << kPageSizeBits;
+    }
+    return static_cast<Addr>(total >> PageBits);
+  }
+  
+  /**
+   * MakeTLB, MakePWC - create the TLB and page walk cache, unless the TLB 
+   *   policy is NoTLB
+   * 
+   * @param tlb_config TLB size or geometry
+   * @return TLB or page walk cache, or nullptr
+   */
+  template <class TLBConfig>
+  static std::unique_ptr<BasicTLB<TLBTag>> MakeTLB(const TLBConfig &tlb_config) {
+    return TLBPolicy::kEnabled 
+            ? std::make_unique<BasicTLB<TLBTag>>(tlb_config) : nullptr;
+  }
+  static std::unique_ptr<PageWalkCache> MakePWC() {
+    return TLBPolicy::kEnabled 
+            ? std::make_unique<PageWalkCache>(kPageWalkCacheSize) : nullptr;
+  }
+  
+  /**
+   * HasTLB - check whether the MMU has a TLB and page walk cache. Constant 
+   *   false with the NoTLB policy, so TLB code is compiled away.
+   * 
+   * @return true if TLB enabled
+   */
+  bool HasTLB() const { return TLBPolicy::kEnabled && tlb; }
+  
+  /**
+   * TLBKey - get the address under which the TLB caches a page. The TLB
+   *   works on 4 KiB pages with 4 MiB large pages, so the page number and 
+   *   large page number are moved to those positions.
+   * 
+   * @param vaddress virtual address in page
+   * @return key address
+   */
+  static TLBTag TLBKey(VAddr vaddress) {
+    return static_cast<TLBTag>(
+            ((vaddress >> kLargePageBits) << kLargePageSizeBits)
+            | (((vaddress >> PageBits) & kTableIndexMask) << kPageSizeBits));
+  }
+  
+  /**
+   * FindHashedEntry - find the entry for a page in the hashed page table of 
+   *   the current PMCB
+   * 
+   * @param vaddress virtual address in page
+   * @param pt_entry set to the page table entry
+   * @param pt_entry_pa set to physical address of the page table entry
+   * @return true if found, false if the page has no entry
+   */
+  bool FindHashedEntry(VAddr vaddress, PageTableEntry &pt_entry, 
+                       Addr &pt_entry_pa);
+  
+  /**
+   * ProbeHashedTable - search a hashed page table for the entry of a page
+   * 
+   * @param table_base physical address of hashed page table
+   * @param asid address space of page
+   * @param vpage virtual page number
+   * @param index set to index of the page's entry if found
+   * @param free_index set to index of the first tombstone or unused entry
+   *   from the page's home entry (table size if none)
+   * @return true if found
+   */
+  bool ProbeHashedTable(Addr table_base, ASID asid, VAddr vpage, Addr &index,
+                        Addr &free_index);
+  
+  /**
+   * ReleaseTombstones - make a tombstone unused if it is followed by an 
+   *   unused entry (so it ends no probe), and likewise the tombstones 
+   *   before it
+   * 
+   * @param table_base physical address of hashed page table
+   * @param index index of entry which may be a tombstone
+   */
+  void ReleaseTombstones(Addr table_base, Addr index);
+  
+  // Hashed page table entry access, in physical memory
+  HashedPageTableEntry GetHashedEntry(Addr table_base, Addr index) {
+    HashedPageTableEntry entry;
+    phys_mem.get_bytes(reinterpret_cast<uint8_t*>(&entry), 
+                       table_base + index * sizeof(HashedPageTableEntry), 
+                       sizeof(HashedPageTableEntry));
+    return entry;
+  }
+  void PutHashedEntry(Addr table_base, Addr index, 
+                      const HashedPageTableEntry &entry) {
+    phys_mem.put_bytes(table_base + index * sizeof(HashedPageTableEntry), 
+                       sizeof(HashedPageTableEntry), 
+                       reinterpret_cast<const uint8_t*>(&entry));
+  }
+  
+  /**
+   * InvalidateLastTranslation - clear the last translation register
+   */
+  void InvalidateLastTranslation() { last_valid = false; }
   
   /**
    * InitMemoryOperation - setup memory operation in PMCB
    * 
-   * @param op - READ_OP or WRITE_OP
+   * @param op - READ_OP, WRITE_OP, FILL_OP or COPY_OP
    * @param vaddress virtual address
    * @param count number of bytes
    * @param user_buffer pointer to caller buffer (must be at least count bytes)
    */
   void InitMemoryOperation(PMCB::PMCB_op op, 
-                           Addr vaddress, 
+                           VAddr vaddress, 
                            Addr count, 
                            uint8_t *user_buffer);
   
@@ -202,9 +906,73 @@ private:
    *           (PMCB.operation_state == NONE) will result in an 
    *           InvalidMMUOperationException.
    */
-  void Execute(void);
+  void Execute(void) {
+    MemoryFault fault = TryExecute();
+    if (fault != MemoryFault::kNone) {
+      ThrowFault(fault);
+    }
+  }
+  
+  /**
+   * TryExecute - as for Execute, but a page fault or write permission fault
+   *   is returned instead of thrown
+   * 
+   * @return MemoryFault::kNone if the operation completed, else the fault; 
+   *   PMCB fault_vaddress is set to the address which faulted
+   */
+  MemoryFault TryExecute(void);
+  
+  /**
+   * CallFaultHandler - pass a fault to the fault handler, saving the PMCB
+   *   while the handler runs. The PMCB fault_vaddress must already be set.
+   * 
+   * @param fault page fault or write permission fault
+   * @param vaddress virtual address which faulted
+   * @param write true if the faulting access was a write
+   * @return true if the handler resolved the fault, false if not (or no 
+   *   handler, or the address is outside the virtual address space)
+   */
+  bool CallFaultHandler(MemoryFault fault, VAddr vaddress, bool write);
+  
+  /**
+   * InAddressSpace - check whether a virtual address is within the virtual
+   *   address space (less than 2^VABits)
+   * 
+   * @param vaddress virtual address
+   * @return true if the address may be mapped
+   */
+  static bool InAddressSpace(VAddr vaddress) {
+    return VABits == 64 || (vaddress >> (VABits % 64)) == 0;
+  }
+  
+  /**
+   * ThrowFault - throw the exception for a fault
+   * 
+   * @param fault page fault or write permission fault
+   * @throws PageFaultException or WritePermissionFaultException
+   */
+  [[noreturn]] static void ThrowFault(MemoryFault fault);
 };
 
+// Configurations compiled in MMU.cpp
+extern template class BasicMMU<12, 10, DynamicTLB, CountStats>;
+extern template class BasicMMU<12, 10, DynamicTLB, NoStats>;
+extern template class BasicMMU<12, 10, NoTLB, NoStats>;
+extern template class BasicMMU<14, 10, DynamicTLB, CountStats>;
+extern template class BasicMMU<14, 10, DynamicTLB, NoStats>;
+extern template class BasicMMU<16, 10, DynamicTLB, CountStats>;
+extern template class BasicMMU<16, 10, DynamicTLB, NoStats>;
+extern template class BasicMMU<12, 9, DynamicTLB, CountStats, 48>;
+
+// Standard MMU: 4 KiB pages, 1024 entry page tables, optional TLB, 
+// statistics counted
+typedef BasicMMU<kPageSizeBits, kPageTableSizeBits, DynamicTLB, CountStats> MMU;
+
+// MMU with 48 bit virtual addresses mapped by 4 levels of 512 entry page 
+// tables (as in x86-64), and 2 MiB large pages. Each page table fills the
+// first half of a page frame.
+typedef BasicMMU<kPageSizeBits, 9, DynamicTLB, CountStats, 48> MMU64;
+
 }  // namespace mem
 
 #endif /* MEM_MMU_H */
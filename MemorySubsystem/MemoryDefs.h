@@ -18,6 +18,10 @@ namespace mem {
 // Define address type (32 bits)
 typedef uint32_t Addr;
 
+// Define virtual address type (64 bits). Physical addresses are always Addr;
+// an MMU with 32 bit virtual addresses faults on any address of 4 GiB or more.
+typedef uint64_t VAddr;
+
 // Define size of page (and page frame) in bytes (0x1000 == 4096).
 // Also define masks for page number and offset.
 const int  kPageSizeBits = 12;  // shift count for page size
@@ -25,6 +29,12 @@ const Addr kPageSize = (1 << kPageSizeBits);
 const Addr kPageOffsetMask = (kPageSize - 1);
 const Addr kPageNumberMask = ~kPageOffsetMask;
 
+// Define address space identifier type. An ASID tags cached translations
+// with the page table they came from. ASIDs are limited to the width of the 
+// page offset (0 to kMaxASID).
+typedef uint16_t ASID;
+const ASID kMaxASID = kPageOffsetMask;
+
 }  // namespace mem
 
 #endif /* MEM_MEMORYDEFS_H */
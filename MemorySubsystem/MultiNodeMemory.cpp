@@ -0,0 +1,226 @@
+/* Physical memory made up of one or more nodes
+ *
+ * File:   MultiNodeMemory.cpp
+ * Author: agent <agent@local>
+ *
+ * Created on October 18, 2026
+ */
+
+#include "MultiNodeMemory.h"
+
+#include "Exceptions.h"
+
+#include <algorithm>
+#include <array>
+
+namespace mem {
+
+MultiNodeMemory::MultiNodeMemory(uint64_t size, PhysicalMemory::Backing backing)
+: mem_size(size), current_node(0) {
+  nodes.push_back(Node{ MemoryNode{ static_cast<Addr>(size / kPageSize), 1, 1 },
+                        0, size, std::make_unique<PhysicalMemory>(size, backing),
+                        NodeStats() });
+}
+
+MultiNodeMemory::MultiNodeMemory(uint64_t size, const std::string &file_name)
+: mem_size(size), current_node(0) {
+  nodes.push_back(Node{ MemoryNode{ static_cast<Addr>(size / kPageSize), 1, 1 },
+                        0, size, 
+                        std::make_unique<PhysicalMemory>(size, file_name),
+                        NodeStats() });
+}
+
+MultiNodeMemory::MultiNodeMemory(const std::vector<MemoryNode> &node_configs,
+                                 PhysicalMemory::Backing backing)
+: mem_size(0), current_node(0) {
+  if (node_configs.empty()) {
+    throw InvalidMMUOperationException("MultiNodeMemory: no nodes");
+  }
+  for (const MemoryNode &config : node_configs) {
+    uint64_t node_size = static_cast<uint64_t>(config.frame_count) * kPageSize;
+    if (config.frame_count == 0 || mem_size + node_size > (1ULL << 32)) {
+      throw InvalidMMUOperationException(
+              "MultiNodeMemory: node is empty or memory is too large");
+    }
+    nodes.push_back(Node{ config, static_cast<Addr>(mem_size), node_size,
+                          std::make_unique<PhysicalMemory>(node_size, backing),
+                          NodeStats() });
+    mem_size += node_size;
+  }
+}
+
+void MultiNodeMemory::get_bytes(uint8_t *dest, Addr address, Addr count) {
+  ValidateAddressRange(address, count);
+  while (count > 0) {
+    Addr chunk;
+    Node &node = NodeChunk(address, count, chunk);
+    node.memory->get_bytes(dest, address - node.base, chunk);
+    RecordAccess(node, chunk);
+    dest += chunk;
+    address += chunk;
+    count -= chunk;
+  }
+}
+
+void MultiNodeMemory::put_bytes(Addr address, Addr count, const uint8_t *src) {
+  ValidateAddressRange(address, count);
+  while (count > 0) {
+    Addr chunk;
+    Node &node = NodeChunk(address, count, chunk);
+    node.memory->put_bytes(address - node.base, chunk, src);
+    RecordAccess(node, chunk);
+    src += chunk;
+    address += chunk;
+    count -= chunk;
+  }
+}
+
+void MultiNodeMemory::fill_bytes(Addr address, Addr count, uint8_t value) {
+  ValidateAddressRange(address, count);
+  while (count > 0) {
+    Addr chunk;
+    Node &node = NodeChunk(address, count, chunk);
+    node.memory->fill_bytes(address - node.base, chunk, value);
+    RecordAccess(node, chunk);
+    address += chunk;
+    count -= chunk;
+  }
+}
+
+void MultiNodeMemory::copy_bytes(Addr dest, Addr src, Addr count) {
+  ValidateAddressRange(dest, count);
+  ValidateAddressRange(src, count);
+
+  // Copy within a node with the node's copy, which handles overlap
+  if (nodes.size() == 1) {
+    nodes[0].memory->copy_bytes(dest, src, count);
+    RecordAccess(nodes[0], count);
+    RecordAccess(nodes[0], count);
+    return;
+  }
+
+  // Otherwise copy through a buffer, in chunks within one node of both
+  // ranges. Copy from the end if the destination overlaps the end of the
+  // source, so source bytes are read before they are overwritten.
+  bool backward = dest > src && dest - src < count;
+  std::array<uint8_t, kPageSize> buffer;
+  while (count > 0) {
+    Addr chunk = std::min(count, kPageSize);
+    Addr dest_start = dest;
+    Addr src_start = src;
+    if (backward) {
+      // Chunk ends at the end of both ranges, within the nodes holding the
+      // last bytes
+      chunk = std::min({ chunk, 
+                         dest + count - nodes[get_node(dest + count - 1)].base,
+                         src + count - nodes[get_node(src + count - 1)].base });
+      dest_start = dest + count - chunk;
+      src_start = src + count - chunk;
+    }
+    Addr src_chunk, dest_chunk;
+    Node &src_node = NodeChunk(src_start, chunk, src_chunk);
+    Node &dest_node = NodeChunk(dest_start, chunk, dest_chunk);
+    chunk = std::min(src_chunk, dest_chunk);
+    src_node.memory->get_bytes(buffer.data(), src_start - src_node.base, chunk);
+    RecordAccess(src_node, chunk);
+    dest_node.memory->put_bytes(dest_start - dest_node.base, chunk,
+                                buffer.data());
+    RecordAccess(dest_node, chunk);
+    if (!backward) {
+      dest += chunk;
+      src += chunk;
+    }
+    count -= chunk;
+  }
+}
+
+std::pair<uint8_t*, Addr> MultiNodeMemory::map_page(Addr address, Addr count,
+                                                    bool write) {
+  Addr span = std::min(count, kPageSize - (address & kPageOffsetMask));
+  ValidateAddressRange(address, span);
+  Node &node = nodes[get_node(address)];
+  std::pair<uint8_t*, Addr> mapping =
+          node.memory->map_page(address - node.base, span, write);
+  RecordAccess(node, mapping.second);
+  return mapping;
+}
+
+void MultiNodeMemory::SaveContents(std::ostream &out) {
+  for (Node &node : nodes) {
+    node.memory->SaveContents(out);
+  }
+}
+
+void MultiNodeMemory::RestoreContents(std::istream &in) {
+  for (Node &node : nodes) {
+    node.memory->RestoreContents(in);
+  }
+}
+
+uint64_t MultiNodeMemory::get_byte_count() const {
+  uint64_t total = 0;
+  for (const Node &node : nodes) {
+    total += node.memory->get_byte_count();
+  }
+  return total;
+}
+
+Addr MultiNodeMemory::get_committed_frame_count() const {
+  Addr total = 0;
+  for (const Node &node : nodes) {
+    total += node.memory->get_committed_frame_count();
+  }
+  return total;
+}
+
+size_t MultiNodeMemory::get_node(Addr address) const {
+  if (address >= mem_size) {
+    throw PhysicalMemoryBoundsException(address);
+  }
+
+  // Last node starting at or before address
+  auto next = std::upper_bound(nodes.begin(), nodes.end(), address,
+                               [](Addr a, const Node &node) {
+                                 return a < node.base;
+                               });
+  return (next - nodes.begin()) - 1;
+}
+
+void MultiNodeMemory::set_current_node(size_t node) {
+  if (node >= nodes.size()) {
+    throw InvalidMMUOperationException("MultiNodeMemory: invalid node");
+  }
+  current_node = node;
+}
+
+void MultiNodeMemory::ValidateAddressRange(Addr address, Addr count) const {
+  // Invalid if either end address is past end of memory, or if wrap-around
+  // or 0 size block
+  uint64_t end = static_cast<uint64_t>(address) + count;
+  if (end > mem_size || count == 0) {
+    throw PhysicalMemoryBoundsException(address);
+  }
+}
+
+MultiNodeMemory::Node &MultiNodeMemory::NodeChunk(Addr address, Addr count,
+                                                  Addr &chunk) {
+  Node &node = nodes[get_node(address)];
+  uint64_t node_end = node.base + node.size;
+  chunk = static_cast<Addr>(
+          std::min<uint64_t>(count, node_end - address));
+  return node;
+}
+
+void MultiNodeMemory::RecordAccess(Node &node, Addr count) {
+  if (&node == &nodes[current_node]) {
+    ++node.stats.local_accesses;
+    node.stats.local_bytes += count;
+    node.stats.cost += node.config.local_cost;
+  } else {
+    ++node.stats.remote_accesses;
+    node.stats.remote_bytes += count;
+    node.stats.cost += node.config.remote_cost;
+  }
+}
+
+} // namespace mem
@@ -0,0 +1,219 @@
+/* Physical memory made up of one or more nodes
+ *
+ * Each node is a bank of physical memory holding a contiguous range of page
+ * frames, with the first node starting at physical address 0. The node of
+ * the CPU using the memory is the current node; accesses to it are local,
+ * and accesses to any other node are remote (as in a NUMA machine). Each
+ * node counts its local and remote accesses and the bytes transferred, and
+ * adds a configurable cost for each access.
+ *
+ * Memory with a single node behaves exactly like PhysicalMemory.
+ *
+ * File:   MultiNodeMemory.h
+ * Author: agent <agent@local>
+ *
+ * Created on October 18, 2026
+ */
+
+#ifndef MEM_MULTINODEMEMORY_H
+#define MEM_MULTINODEMEMORY_H
+
+#include "MemoryDefs.h"
+#include "PhysicalMemory.h"
+
+#include <cstddef>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mem {
+
+// Configuration of one memory node
+struct MemoryNode {
+  Addr frame_count;      // number of page frames in node
+  uint32_t local_cost;   // cost of each access from a CPU on the node
+  uint32_t remote_cost;  // cost of each access from a CPU on another node
+};
+
+class MultiNodeMemory {
+public:
+  // Access statistics for a node. Each transfer within one node is one
+  // access (a copy is a read and a write).
+  struct NodeStats {
+    uint64_t local_accesses;
+    uint64_t remote_accesses;
+    uint64_t local_bytes;
+    uint64_t remote_bytes;
+    uint64_t cost;  // total cost of all accesses
+  };
+
+  /**
+   * Constructor - single node memory, with cost 1 for each access
+   *
+   * @param size number of bytes of memory (see PhysicalMemory)
+   * @param backing dense or sparse storage
+   * @throws std::bad_alloc if insufficient memory
+   */
+  MultiNodeMemory(uint64_t size, PhysicalMemory::Backing backing);
+
+  /**
+   * Constructor - single node memory mapped from a file, with cost 1 for
+   *   each access (see PhysicalMemory)
+   *
+   * @param size number of bytes of memory
+   * @param file_name file to map
+   * @throws std::system_error if the file cannot be opened or mapped
+   */
+  MultiNodeMemory(uint64_t size, const std::string &file_name);
+
+  /**
+   * Constructor - memory with one or more nodes. The current node is
+   *   node 0.
+   *
+   * @param nodes configuration of each node, in order of physical address
+   * @param backing dense or sparse storage for every node
+   * @throws InvalidMMUOperationException if there are no nodes, a node has
+   *   no frames, or the total size is more than 4 GiB
+   * @throws std::bad_alloc if insufficient memory
+   */
+  MultiNodeMemory(const std::vector<MemoryNode> &nodes,
+                  PhysicalMemory::Backing backing);
+
+  MultiNodeMemory(const MultiNodeMemory &other) = delete;
+  MultiNodeMemory(MultiNodeMemory &&other) = delete;
+
+  // Memory operations, as for PhysicalMemory. A range may span nodes.
+  void get_32(uint32_t *dest, Addr address) {
+    get_bytes(reinterpret_cast<uint8_t*>(dest), address, 4);
+  }
+  void get_bytes(uint8_t *dest, Addr address, Addr count);
+  void put_bytes(Addr address, Addr count, const uint8_t *src);
+  void fill_bytes(Addr address, Addr count, uint8_t value);
+  void copy_bytes(Addr dest, Addr src, Addr count);
+  std::pair<uint8_t*, Addr> map_page(Addr address, Addr count, bool write);
+
+  /**
+   * SaveContents - write contents of each node to a snapshot stream (see
+   *   PhysicalMemory::SaveContents)
+   *
+   * @param out snapshot stream
+   */
+  void SaveContents(std::ostream &out);
+
+  /**
+   * RestoreContents - read contents of each node written by SaveContents
+   *
+   * @param in snapshot stream
+   * @throws InvalidMMUOperationException if the snapshot does not match
+   */
+  void RestoreContents(std::istream &in);
+
+  /**
+   * get_byte_count - return total number of bytes transferred so far
+   *   to/from all nodes.
+   *
+   * @return count of bytes transferred.
+   */
+  uint64_t get_byte_count() const;
+
+  /**
+   * get_committed_frame_count - return number of page frames for which
+   *   storage has been allocated, in all nodes
+   *
+   * @return number of frames
+   */
+  Addr get_committed_frame_count() const;
+
+  // Node configuration
+  size_t get_node_count() const { return nodes.size(); }
+  Addr get_node_base(size_t node) const { return nodes.at(node).base; }
+  Addr get_node_frame_count(size_t node) const {
+    return nodes.at(node).config.frame_count;
+  }
+
+  /**
+   * get_node - get node holding a physical address
+   *
+   * @param address physical address
+   * @return node number
+   * @throws PhysicalMemoryBoundsException if address is past end of memory
+   */
+  size_t get_node(Addr address) const;
+
+  /**
+   * set_current_node - set node of the CPU using the memory
+   *
+   * @param node node number
+   * @throws InvalidMMUOperationException if node does not exist
+   */
+  void set_current_node(size_t node);
+  size_t get_current_node() const { return current_node; }
+
+  /**
+   * get_node_stats - get access statistics for a node
+   *
+   * @param node node number
+   * @return statistics
+   */
+  const NodeStats &get_node_stats(size_t node) const {
+    return nodes.at(node).stats;
+  }
+
+  /**
+   * get_node_byte_count - return number of bytes transferred so far to/from
+   *   a node
+   *
+   * @param node node number
+   * @return count of bytes transferred
+   */
+  uint64_t get_node_byte_count(size_t node) const {
+    return nodes.at(node).memory->get_byte_count();
+  }
+
+private:
+  struct Node {
+    MemoryNode config;
+    Addr base;                               // first physical address
+    uint64_t size;                           // number of bytes
+    std::unique_ptr<PhysicalMemory> memory;  // addressed from base
+    NodeStats stats;
+  };
+
+  std::vector<Node> nodes;
+  uint64_t mem_size;    // total of all nodes
+  size_t current_node;  // node of CPU using the memory
+
+  /**
+   * ValidateAddressRange - check that address range is within memory, throw
+   *   PhysicalMemoryBoundsException if not
+   *
+   * @param address first address
+   * @param count number of bytes (must be > 0)
+   */
+  void ValidateAddressRange(Addr address, Addr count) const;
+
+  /**
+   * NodeChunk - get node holding an address, and the number of bytes of a
+   *   range which are in the node
+   *
+   * @param address first address (must be valid)
+   * @param count number of bytes in range
+   * @param chunk set to number of bytes in node, starting at address
+   * @return node holding address
+   */
+  Node &NodeChunk(Addr address, Addr count, Addr &chunk);
+
+  /**
+   * RecordAccess - update statistics for an access to a node
+   *
+   * @param node node accessed
+   * @param count number of bytes transferred
+   */
+  void RecordAccess(Node &node, Addr count);
+};
+
+} // namespace mem
+
+#endif /* MEM_MULTINODEMEMORY_H */
@@ -27,39 +27,74 @@ public:
   PMCB()
   : vm_enable(false),
     page_table_base(0),
+    asid(0),
+    page_table_format(MULTI_LEVEL),
     operation_state(NONE),
     next_vaddress(0),
     remaining_count(0),
-    user_buffer(nullptr) {
+    user_buffer(nullptr),
+    next_src_vaddress(0),
+    fill_value(0),
+    fault_vaddress(0) {
   };
 
-  PMCB(bool vm_enable_, Addr page_table_base_)
+  // Page table formats (see page_table_format)
+  typedef enum { MULTI_LEVEL, HASHED } PageTableFormat;
+
+  PMCB(bool vm_enable_, Addr page_table_base_, ASID asid_ = 0,
+       PageTableFormat page_table_format_ = MULTI_LEVEL)
   : vm_enable(vm_enable_),
     page_table_base(page_table_base_),
+    asid(asid_),
+    page_table_format(page_table_format_),
     operation_state(NONE),
     next_vaddress(0),
     remaining_count(0),
-    user_buffer(nullptr) {
+    user_buffer(nullptr),
+    next_src_vaddress(0),
+    fill_value(0),
+    fault_vaddress(0) {
   };
   
   // Virtual memory enable
   bool vm_enable;
   
-  // Address in physical memory of page table.
+  // Address in physical memory of top level page table.
   // Must point to the start of a page frame (multiple of 0x1000).
-  // Page table always has 0x400 (1024) entries (exactly one page frame).
+  // With the standard MMU, the page table has 0x400 (1024) entries (exactly 
+  // one page frame); see BasicMMU for other page table layouts.
   Addr page_table_base;
   
+  // Address space identifier (0 to kMaxASID). TLB entries are tagged with
+  // the ASID, so switching to a page table with a different ASID does not
+  // require a TLB flush. Each page table in use should have its own ASID.
+  ASID asid;
+  
+  // Page table format. With MULTI_LEVEL, page_table_base is the top level 
+  // table of this address space. With HASHED, it is the hashed page table 
+  // shared by all address spaces (see HashedPageTableEntry), which has
+  // MMU::get_hashed_page_table_size() entries and must start at a page 
+  // boundary; the asid selects this address space's entries.
+  PageTableFormat page_table_format;
+  
   // Partial operation state.  This is set when an operation is unable
   // to complete due to a virtual memory fault (page fault, write permission 
   // fault, etc.). The address is the next virtual address to process, the count 
   // is the remaining byte count, and the user buffer is a pointer to the buffer 
-  // supplied by the user.
-  typedef enum { NONE, READ_OP, WRITE_OP } PMCB_op;
+  // supplied by the user. A fill operation stores fill_value instead of using
+  // the user buffer, and a copy operation reads from next_src_vaddress.
+  typedef enum { NONE, READ_OP, WRITE_OP, FILL_OP, COPY_OP } PMCB_op;
   PMCB_op operation_state;
-  Addr next_vaddress;    // virtual address at which to resume
+  VAddr next_vaddress;   // virtual address at which to resume
   Addr remaining_count;  // number of bytes left to process
   uint8_t *user_buffer;  // caller buffer virtual address
+  VAddr next_src_vaddress; // copy source virtual address at which to resume
+  uint8_t fill_value;    // value stored by fill operation
+  
+  // Virtual address being translated when the most recent fault occurred.
+  // For a copy operation, this identifies whether the source or the 
+  // destination caused the fault.
+  VAddr fault_vaddress;
 };
 
 }  // namespace mem
@@ -3,7 +3,11 @@
  * 
  * MMU uses a two-level page table.  The top level (directory) consists of 1024
  * entries, each of which points to a second level 1024K-entry page table 
- * (if present).
+ * (if present). A top level entry with the LargePage flag set instead maps a
+ * 4 MiB large page directly.
+ * 
+ * Alternatively, a single hashed page table maps the pages of all address
+ * spaces (see HashedPageTableEntry).
  * 
  * File:   PageTable.h
  * Author: Mike Goss <mikegoss@cs.du.edu>
@@ -31,10 +35,19 @@ static_assert(kPageTableEntries == kPageSize / sizeof(PageTableEntry),
 const Addr kPageTableSizeBytes = kPageSize;
 const Addr kPageTableIndexMask = kPageTableEntries - 1;
 
+// A large page is mapped directly by a top level entry, and covers the range
+// of addresses otherwise mapped by a whole 2nd level page table (4 MiB).
+const int  kLargePageSizeBits = kPageSizeBits + kPageTableSizeBits;
+const Addr kLargePageSize = (1 << kLargePageSizeBits);
+const Addr kLargePageOffsetMask = (kLargePageSize - 1);
+const Addr kLargePageNumberMask = ~kLargePageOffsetMask;
+
 // Define bit masks and shifts for fields in page table entry
 
-// The page frame number is stored in the upper 20 bits
+// The page frame number is stored in the upper 20 bits. For a large page,
+// the frame number must be a multiple of kPageTableEntries.
 const uint32_t kPTE_FrameMask = kPageNumberMask;
+const uint32_t kPTE_LargeFrameMask = kLargePageNumberMask;
 
 // Bit masks for other flags
 const uint32_t kPTE_Present = 0;            // page present in memory
@@ -45,6 +58,73 @@ const uint32_t kPTE_Accessed = 5;           // set when page is accessed
 const uint32_t kPTE_AccessedMask = (1 << kPTE_Accessed);
 const uint32_t kPTE_Modified = 6;           // set when page is modified
 const uint32_t kPTE_ModifiedMask = (1 << kPTE_Modified);
+const uint32_t kPTE_LargePage = 7;          // top level entry maps large page
+const uint32_t kPTE_LargePageMask = (1 << kPTE_LargePage);
+
+// Bits 9-11 are ignored by the MMU and are available to the OS
+const uint32_t kPTE_CopyOnWrite = 9;        // shared read-only, copy on write
+const uint32_t kPTE_CopyOnWriteMask = (1 << kPTE_CopyOnWrite);
+const uint32_t kPTE_SwappedOut = 10;        // page in swap; frame field is slot
+const uint32_t kPTE_SwappedOutMask = (1 << kPTE_SwappedOut);
+
+// Hashed page table
+//
+// A hashed page table is one global table, sized to physical memory, with an
+// entry for each mapped page of any address space (PMCB page_table_format 
+// HASHED). A page's home entry is chosen by hashing its ASID and virtual page
+// number; collisions are resolved by linear probing, so the MMU searches from 
+// the home entry until it finds the page's entry or an unused entry. Pages 
+// are added and removed with MMU::MapHashedPage, UnmapHashedPage and 
+// PurgeHashedASID. A removed page's entry becomes a tombstone, which probes
+// continue past and which may be reused for another page; tombstones which
+// no longer end a probe become unused again. An entry may also be updated in
+// place (e.g. with Present clear), keeping its address. Large pages cannot
+// be mapped.
+struct HashedPageTableEntry {
+  VAddr vpage;              // virtual page number
+  PageTableEntry pt_entry;  // same format as a last level entry
+  ASID asid;                // address space of page
+  uint16_t flags;           // kHPTE_UsedMask if entry holds a page or is a 
+                            // tombstone, with kHPTE_TombstoneMask if tombstone
+};
+static_assert(sizeof(HashedPageTableEntry) == 16, 
+              "Hashed page table entry size mismatch");
+const uint16_t kHPTE_UsedMask = 1;
+const uint16_t kHPTE_TombstoneMask = 2;
+const HashedPageTableEntry kHashedTombstone = 
+        { 0, 0, 0, kHPTE_UsedMask | kHPTE_TombstoneMask };
+
+/**
+ * HashedPageTableSize - get number of entries in the hashed page table for 
+ *   a physical memory: twice the number of page frames, rounded up to a 
+ *   power of 2, so the table is at most half full while each frame is mapped
+ *   by one page
+ * 
+ * @param frame_count number of page frames in physical memory
+ * @return number of entries
+ */
+inline Addr HashedPageTableSize(Addr frame_count) {
+  Addr entries = 1;
+  while (entries < frame_count * 2ULL) {
+    entries <<= 1;
+  }
+  return entries;
+}
+
+/**
+ * HashedPageTableIndex - get index of the home entry of a page in a hashed
+ *   page table
+ * 
+ * @param asid address space of page
+ * @param vpage virtual page number
+ * @param entries number of entries in table (a power of 2)
+ * @return index of entry
+ */
+inline Addr HashedPageTableIndex(ASID asid, VAddr vpage, Addr entries) {
+  uint64_t key = vpage ^ (static_cast<uint64_t>(asid) << 48);
+  return static_cast<Addr>((key * 0x9E3779B97F4A7C15ULL) >> 32) 
+          & (entries - 1);
+}
 
 // Define type for a page table as a derived class from std::array.
 // The page table is initialized to zero.
@@ -0,0 +1,55 @@
+/* 
+ * PageWalkCache - paging structure cache for MMU
+ * 
+ * File:   PageWalkCache.cpp
+ * Author: agent <agent@local>
+ * 
+ * Created on October 17, 2026
+ */
+
+#include "PageWalkCache.h"
+
+namespace mem {
+
+PageWalkCache::PageWalkCache(size_t entry_count_)
+: entries(entry_count_) {
+  if (entry_count_ == 0 || (entry_count_ & (entry_count_ - 1)) != 0) {
+    throw InvalidMMUOperationException(
+            "Page walk cache size must be a power of 2");
+  }
+}
+
+bool PageWalkCache::Lookup(Addr top_level_index, Addr &second_level_address,
+                           bool record_stats) {
+  const PWCEntry &entry = entries[top_level_index & (entries.size() - 1)];
+  if (entry.valid && entry.top_level_index == top_level_index) {
+    if (record_stats) {
+      ++stats.recent_hits;
+      ++stats.total_hits;
+    }
+    second_level_address = entry.second_level_address;
+    return true;
+  } else {
+    if (record_stats) {
+      ++stats.recent_misses;
+      ++stats.total_misses;
+    }
+    return false;
+  }
+}
+
+void PageWalkCache::Cache(Addr top_level_index, Addr second_level_address) {
+  PWCEntry &entry = entries[top_level_index & (entries.size() - 1)];
+  entry.top_level_index = top_level_index;
+  entry.second_level_address = second_level_address;
+  entry.valid = true;
+}
+
+void PageWalkCache::Flush() {
+  stats.recent_hits = stats.recent_misses = 0;
+  for (PWCEntry &entry : entries) {
+    entry.valid = false;
+  }
+}
+
+}  // namespace mem
@@ -0,0 +1,117 @@
+/* 
+ * PageWalkCache - paging structure cache for MMU
+ * 
+ * The page walk cache holds the physical addresses of recently used 2nd level
+ * page tables, indexed by top level page table index, so that a TLB miss only
+ * needs to read the 2nd level page table entry from physical memory. It is 
+ * direct mapped. Like the TLB, it should be flushed whenever there is a change 
+ * to the current page table, or when a different page table comes into use.
+ * 
+ * File:   PageWalkCache.h
+ * Author: agent <agent@local>
+ *
+ * Created on October 17, 2026
+ */
+
+#ifndef MEM_PAGEWALKCACHE_H
+#define MEM_PAGEWALKCACHE_H
+
+#include "Exceptions.h"
+#include "PageTable.h"
+
+#include <vector>
+
+namespace mem {
+
+class PageWalkCache {
+public:
+  /**
+   * Constructor - create page walk cache with specified number of entries
+   * 
+   * @param entry_count_ number of entries (must be a power of 2)
+   * @throws InvalidMMUOperationException if entry_count_ is not a power of 2
+   */
+  PageWalkCache(size_t entry_count_);
+  
+  // Prevent copy/move/assign
+  ~PageWalkCache() { }
+  PageWalkCache(const PageWalkCache &other) = delete;
+  PageWalkCache(PageWalkCache &&other) = delete;
+  PageWalkCache operator=(const PageWalkCache &other) = delete;
+  PageWalkCache operator=(PageWalkCache &&other) = delete;
+  
+  /**
+   * Lookup - find 2nd level page table for top level page table index
+   * 
+   * @param top_level_index index of entry in top level page table
+   * @param second_level_address set to physical address of 2nd level page
+   *   table if found
+   * @param record_stats false to skip counting the hit or miss
+   * @return true if found, false if not in cache
+   */
+  bool Lookup(Addr top_level_index, Addr &second_level_address,
+              bool record_stats = true);
+  
+  /**
+   * Cache - store 2nd level page table address for top level index
+   * 
+   * @param top_level_index index of entry in top level page table
+   * @param second_level_address physical address of 2nd level page table
+   */
+  void Cache(Addr top_level_index, Addr second_level_address);
+  
+  /**
+   * Flush - invalidate all entries
+   */
+  void Flush();
+  
+  /**
+   * PWCStats - statistics on page walk cache operations
+   */
+  class PWCStats {
+  public:
+    // Constructor
+    PWCStats()
+    : recent_hits(0),
+    recent_misses(0),
+    total_hits(0),
+    total_misses(0) {
+    }
+    
+    uint64_t recent_hits;     // count of hits since last flush
+    uint64_t recent_misses;   // count of misses since last flush
+    uint64_t total_hits;      // count of total hits
+    uint64_t total_misses;    // count of total misses
+  };
+  
+  /**
+   * get_stats - get page walk cache statistics
+   * 
+   * @param stats set to a copy of the current statistics
+   */
+  void get_stats(PWCStats &stats_) { stats_ = stats; }
+  
+private:
+  /**
+   * PWCEntry - contents of an entry in the page walk cache
+   */
+  class PWCEntry {
+  public:
+    // Constructor
+    PWCEntry() : top_level_index(0), second_level_address(0), valid(false) {}
+    
+    Addr top_level_index;       // index of entry in top level page table
+    Addr second_level_address;  // physical address of 2nd level page table
+    bool valid;                 // true if entry in use
+  };
+  
+  // Cache entries, indexed by low bits of top level index
+  std::vector<PWCEntry> entries;
+  
+  // Statistics
+  PWCStats stats;
+};
+
+}  // namespace mem
+
+#endif /* MEM_PAGEWALKCACHE_H */
@@ -9,41 +9,400 @@
 #include "PhysicalMemory.h"
 
 #include "Exceptions.h"
+#include "Snapshot.h"
+
+#include <algorithm>
+#include <cerrno>
 #include <cstring>
+#include <system_error>
+
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace mem {
 
+namespace {
+
+// Page of zeros, read in place of frames of sparse memory which have not
+// been written
+const uint8_t kZeroPage[kPageSize] = { 0 };
+
+/**
+ * CloneFile - make the contents of one open file the same as another. The
+ *   files share their storage if the file system supports it (reflink), 
+ *   which takes time independent of the file size; otherwise the contents
+ *   are copied. 
+ * 
+ * @param dest_fd file to replace the contents of (at least size bytes)
+ * @param src_fd file to clone
+ * @param size number of bytes to clone
+ * @param dest_data mapping of dest_fd to copy into, or null to write to the
+ *   file
+ * @return true if success, false if a read or write failed (errno is set)
+ */
+bool CloneFile(int dest_fd, int src_fd, uint64_t size, uint8_t *dest_data) {
+  if (ioctl(dest_fd, FICLONE, src_fd) == 0) {
+    return true;
+  }
+  std::vector<uint8_t> buffer(std::min<uint64_t>(size, 1 << 20));
+  for (uint64_t offset = 0; offset < size; ) {
+    ssize_t count = pread(src_fd, dest_data != nullptr ? dest_data + offset
+                                                       : buffer.data(), 
+                          std::min<uint64_t>(buffer.size(), size - offset), 
+                          offset);
+    if (count <= 0
+            || (dest_data == nullptr 
+                && pwrite(dest_fd, buffer.data(), count, offset) != count)) {
+      if (count == 0) errno = EIO;  // file is shorter than size
+      return false;
+    }
+    offset += count;
+  }
+  return true;
+}
+
+}  // namespace
+
+const int  PhysicalMemory::kFrameTableSizeBits;
+const Addr PhysicalMemory::kFrameTableEntries;
+
+PhysicalMemory::PhysicalMemory(uint64_t size, Backing backing_)
+: mem_size(size), backing(backing_), flat_data(nullptr), 
+  committed_frame_count(0), byte_count(0) {
+  if (backing == Backing::kSparse) {
+    uint64_t frames = (mem_size + kPageSize - 1) / kPageSize;
+    frame_tables.resize((frames + kFrameTableEntries - 1) / kFrameTableEntries);
+  } else if (backing == Backing::kDense) {
+    mem_data.resize(mem_size);
+    flat_data = mem_data.data();
+    committed_frame_count = (mem_size + kPageSize - 1) / kPageSize;
+  } else {
+    throw InvalidMMUOperationException(
+            "PhysicalMemory: a file name is required for a mapped file");
+  }
+}
+
+PhysicalMemory::PhysicalMemory(uint64_t size, const std::string &file_name)
+: mem_size(size), backing(Backing::kMappedFile), flat_data(nullptr), 
+  mapped_file_name(file_name),
+  committed_frame_count((size + kPageSize - 1) / kPageSize), byte_count(0) {
+  int fd = open(file_name.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), 
+                            "PhysicalMemory: cannot open " + file_name);
+  }
+  
+  // Extend file to size of memory, then map it
+  struct stat file_stat;
+  void *mapping = MAP_FAILED;
+  if (fstat(fd, &file_stat) == 0
+          && (static_cast<uint64_t>(file_stat.st_size) >= mem_size
+              || ftruncate(fd, mem_size) == 0)) {
+    mapping = mmap(nullptr, mem_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  int map_errno = errno;
+  close(fd);  // mapping remains valid after file is closed
+  if (mapping == MAP_FAILED) {
+    throw std::system_error(map_errno, std::generic_category(), 
+                            "PhysicalMemory: cannot map " + file_name);
+  }
+  flat_data = static_cast<uint8_t*>(mapping);
+}
+
+PhysicalMemory::~PhysicalMemory() {
+  if (backing == Backing::kMappedFile) {
+    munmap(flat_data, mem_size);
+  }
+}
+
 void PhysicalMemory::ValidateAddressRange(Addr address, Addr count) const {
   // Invalid if either end address is past end of memory, or if wrap-around
   // or 0 size block
-  Addr end = address + count;
-  if (end > mem_data.size() || end <= address) {
+  uint64_t end = static_cast<uint64_t>(address) + count;
+  if (end > mem_size || count == 0) {
     throw PhysicalMemoryBoundsException(address);
   }
 }
 
+const uint8_t *PhysicalMemory::ReadPtr(Addr address) const {
+  if (flat_data != nullptr) {
+    return &flat_data[address];
+  }
+  Addr frame = address >> kPageSizeBits;
+  const std::unique_ptr<FrameTable> &table =
+          frame_tables[frame >> kFrameTableSizeBits];
+  if (table) {
+    const std::unique_ptr<uint8_t[]> &frame_data =
+            (*table)[frame & (kFrameTableEntries - 1)];
+    if (frame_data) {
+      return &frame_data[address & kPageOffsetMask];
+    }
+  }
+  return &kZeroPage[address & kPageOffsetMask];
+}
+
+bool PhysicalMemory::IsCommitted(Addr address) const {
+  if (flat_data != nullptr) {
+    return true;
+  }
+  Addr frame = address >> kPageSizeBits;
+  const std::unique_ptr<FrameTable> &table =
+          frame_tables[frame >> kFrameTableSizeBits];
+  return table && (*table)[frame & (kFrameTableEntries - 1)];
+}
+
+uint8_t *PhysicalMemory::WritePtr(Addr address) {
+  if (flat_data != nullptr) {
+    return &flat_data[address];
+  }
+  Addr frame = address >> kPageSizeBits;
+  std::unique_ptr<FrameTable> &table = frame_tables[frame >> kFrameTableSizeBits];
+  if (!table) {
+    table = std::make_unique<FrameTable>();
+  }
+  std::unique_ptr<uint8_t[]> &frame_data = (*table)[frame & (kFrameTableEntries - 1)];
+  if (!frame_data) {
+    frame_data.reset(new uint8_t[kPageSize]());  // zero initialized
+    ++committed_frame_count;
+  }
+  return &frame_data[address & kPageOffsetMask];
+}
+
 void PhysicalMemory::get_byte(uint8_t *dest, Addr address) {
   ValidateAddressRange(address, 1);
   ++byte_count;
-  *dest = mem_data[address];
+  *dest = *ReadPtr(address);
 }
 
 void PhysicalMemory::get_bytes(uint8_t *dest, Addr address, Addr count) {
   ValidateAddressRange(address, count);
   byte_count += count;
-  memcpy(dest, &mem_data[address], count);
+  if (flat_data != nullptr) {
+    memcpy(dest, &flat_data[address], count);
+    return;
+  }
+  while (count > 0) {
+    Addr chunk = std::min(count, kPageSize - (address & kPageOffsetMask));
+    memcpy(dest, ReadPtr(address), chunk);
+    dest += chunk;
+    address += chunk;
+    count -= chunk;
+  }
 }
 
 void PhysicalMemory::put_byte(Addr address, uint8_t *data) {
   ValidateAddressRange(address, 1);
   ++byte_count;
-  mem_data[address] = *data;
+  *WritePtr(address) = *data;
 }
 
 void PhysicalMemory::put_bytes(Addr address, Addr count, const uint8_t *src) {
   ValidateAddressRange(address, count);
   byte_count += count;
-  memcpy(&mem_data[address], src, count);
+  if (flat_data != nullptr) {
+    memcpy(&flat_data[address], src, count);
+    return;
+  }
+  while (count > 0) {
+    Addr chunk = std::min(count, kPageSize - (address & kPageOffsetMask));
+    memcpy(WritePtr(address), src, chunk);
+    src += chunk;
+    address += chunk;
+    count -= chunk;
+  }
+}
+
+void PhysicalMemory::fill_bytes(Addr address, Addr count, uint8_t value) {
+  ValidateAddressRange(address, count);
+  byte_count += count;
+  if (flat_data != nullptr) {
+    memset(&flat_data[address], value, count);
+    return;
+  }
+  while (count > 0) {
+    // A frame which is not allocated already reads as 0, so filling it 
+    // with 0 does not allocate it
+    Addr chunk = std::min(count, kPageSize - (address & kPageOffsetMask));
+    if (value != 0 || IsCommitted(address)) {
+      memset(WritePtr(address), value, chunk);
+    }
+    address += chunk;
+    count -= chunk;
+  }
+}
+
+void PhysicalMemory::copy_bytes(Addr dest, Addr src, Addr count) {
+  ValidateAddressRange(dest, count);
+  ValidateAddressRange(src, count);
+  byte_count += 2 * count;  // each byte is read and written
+  if (flat_data != nullptr) {
+    memmove(&flat_data[dest], &flat_data[src], count);
+    return;
+  }
+
+  // Copy in chunks which do not cross a page boundary in either range. If
+  // the destination overlaps the end of the source, copy from the end so
+  // source bytes are read before they are overwritten.
+  bool backward = dest > src && dest - src < count;
+  while (count > 0) {
+    Addr chunk;
+    if (backward) {
+      Addr dest_last = dest + count - 1;
+      Addr src_last = src + count - 1;
+      chunk = std::min({count, (dest_last & kPageOffsetMask) + 1,
+                        (src_last & kPageOffsetMask) + 1});
+      memmove(WritePtr(dest_last - chunk + 1), ReadPtr(src_last - chunk + 1),
+              chunk);
+    } else {
+      chunk = std::min({count, kPageSize - (dest & kPageOffsetMask),
+                        kPageSize - (src & kPageOffsetMask)});
+      memmove(WritePtr(dest), ReadPtr(src), chunk);
+      dest += chunk;
+      src += chunk;
+    }
+    count -= chunk;
+  }
+}
+
+void PhysicalMemory::Sync() {
+  if (backing == Backing::kMappedFile 
+          && msync(flat_data, mem_size, MS_SYNC) != 0) {
+    throw std::system_error(errno, std::generic_category(), 
+                            "PhysicalMemory: cannot sync mapped file");
+  }
+}
+
+void PhysicalMemory::SaveContents(std::ostream &out) {
+  WriteSnapshotValue(out, mem_size);
+  WriteSnapshotValue(out, backing);
+  
+  // Contents of a mapped file are saved in a copy of the file (see
+  // CopyMappedFile); the stream records its name
+  if (backing == Backing::kMappedFile) {
+    std::string copy_name = CopyMappedFile();
+    WriteSnapshotValue(out, static_cast<Addr>(0));
+    WriteSnapshotValue(out, static_cast<uint32_t>(copy_name.size()));
+    out.write(copy_name.data(), copy_name.size());
+    return;
+  }
+  
+  // Write each allocated frame, preceded by its frame number
+  WriteSnapshotValue(out, committed_frame_count);
+  Addr frame_total = (mem_size + kPageSize - 1) / kPageSize;
+  for (Addr frame = 0; frame < frame_total; ++frame) {
+    Addr address = frame << kPageSizeBits;
+    if (backing == Backing::kSparse) {
+      const std::unique_ptr<FrameTable> &table = 
+              frame_tables[frame >> kFrameTableSizeBits];
+      if (!table || !(*table)[frame & (kFrameTableEntries - 1)]) continue;
+    }
+    WriteSnapshotValue(out, frame);
+    out.write(reinterpret_cast<const char*> (ReadPtr(address)), 
+              std::min<uint64_t>(kPageSize, mem_size - address));
+  }
+}
+
+void PhysicalMemory::RestoreContents(std::istream &in) {
+  uint64_t saved_size;
+  Backing saved_backing;
+  ReadSnapshotValue(in, saved_size);
+  ReadSnapshotValue(in, saved_backing);
+  if (saved_size != mem_size || saved_backing != backing) {
+    throw InvalidMMUOperationException(
+            "Snapshot Error: physical memory size or kind does not match");
+  }
+  
+  // Clear memory, then read saved frames
+  Addr frame_count;
+  ReadSnapshotValue(in, frame_count);
+  if (backing == Backing::kMappedFile) {
+    uint32_t name_size;
+    ReadSnapshotValue(in, name_size);
+    std::string copy_name(name_size, '\0');
+    in.read(&copy_name[0], name_size);
+    if (!in) {
+      throw InvalidMMUOperationException("Snapshot Error: snapshot is truncated");
+    }
+    RestoreMappedFile(copy_name);
+  } else if (backing == Backing::kDense) {
+    std::fill(mem_data.begin(), mem_data.end(), 0);
+  } else if (backing == Backing::kSparse) {
+    for (std::unique_ptr<FrameTable> &table : frame_tables) {
+      table.reset();
+    }
+    committed_frame_count = 0;
+  }
+  while (frame_count-- > 0) {
+    Addr frame;
+    ReadSnapshotValue(in, frame);
+    Addr address = frame << kPageSizeBits;
+    if (address >= mem_size) {
+      throw InvalidMMUOperationException("Snapshot Error: invalid frame number");
+    }
+    in.read(reinterpret_cast<char*> (WritePtr(address)), 
+            std::min<uint64_t>(kPageSize, mem_size - address));
+    if (!in) {
+      throw InvalidMMUOperationException("Snapshot Error: snapshot is truncated");
+    }
+  }
+}
+
+std::string PhysicalMemory::CopyMappedFile() {
+  Sync();
+  std::string copy_name = mapped_file_name + ".snapXXXXXX";
+  int copy_fd = mkstemp(&copy_name[0]);
+  int file_fd = open(mapped_file_name.c_str(), O_RDONLY);
+  bool copied = copy_fd >= 0 && file_fd >= 0
+          && CloneFile(copy_fd, file_fd, mem_size, nullptr);
+  int copy_errno = errno;
+  if (file_fd >= 0) close(file_fd);
+  if (copy_fd >= 0) close(copy_fd);
+  if (!copied) {
+    if (copy_fd >= 0) unlink(copy_name.c_str());
+    throw std::system_error(copy_errno, std::generic_category(), 
+                            "PhysicalMemory: cannot copy " + mapped_file_name);
+  }
+  return copy_name;
+}
+
+void PhysicalMemory::RestoreMappedFile(const std::string &copy_name) {
+  int copy_fd = open(copy_name.c_str(), O_RDONLY);
+  struct stat copy_stat;
+  if (copy_fd < 0 || fstat(copy_fd, &copy_stat) != 0 
+          || static_cast<uint64_t>(copy_stat.st_size) != mem_size) {
+    if (copy_fd >= 0) close(copy_fd);
+    throw InvalidMMUOperationException(
+            "Snapshot Error: cannot open memory file copy " + copy_name);
+  }
+  
+  // Clone the copy's storage into the file (the kernel replaces the pages 
+  // of the mapping), or copy it in through the mapping
+  int file_fd = open(mapped_file_name.c_str(), O_RDWR);
+  bool restored = file_fd >= 0 
+          && CloneFile(file_fd, copy_fd, mem_size, flat_data);
+  int restore_errno = errno;
+  if (file_fd >= 0) close(file_fd);
+  close(copy_fd);
+  if (!restored) {
+    throw std::system_error(restore_errno, std::generic_category(), 
+                            "PhysicalMemory: cannot restore " + mapped_file_name);
+  }
+}
+
+std::pair<uint8_t*, Addr> PhysicalMemory::map_page(Addr address, Addr count,
+                                                   bool write) {
+  Addr span = std::min(count, kPageSize - (address & kPageOffsetMask));
+  ValidateAddressRange(address, span);
+  byte_count += span;
+
+  // A read-only span of sparse memory may point to the shared zero page
+  uint8_t *data = write ? WritePtr(address)
+                        : const_cast<uint8_t*>(ReadPtr(address));
+  return std::make_pair(data, span);
 }
 
 } // namespace mem
\ No newline at end of file
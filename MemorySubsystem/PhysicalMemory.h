@@ -1,4 +1,18 @@
 /* Interface to physical memory
+ * 
+ * Physical memory may be dense, where all of memory is allocated (and
+ * zeroed) when it is constructed, or sparse, where each page frame is
+ * allocated on the first write to it. Frames which have not been written
+ * read as zero. Sparse memory allows large physical address spaces (up to
+ * 4 GiB) to be simulated when only a few frames are used. Memory may also be
+ * a file mapped into the host address space, so that its contents persist
+ * after the simulation ends and frames are paged by the host.
+ * 
+ * A snapshot of a mapped file is a copy of the file, made beside it. On
+ * file systems which support reflinks (e.g. Btrfs, XFS) the copy shares the
+ * file's storage, so saving and restoring take time independent of the 
+ * memory size. On other file systems (e.g. ext4) the whole file is copied
+ * each time, which is O(memory size).
  *  
  * File:   PhysicalMemory.h
  * Author: Mike Goss <mikegoss@cs.du.edu>
@@ -11,23 +25,49 @@
 
 #include "MemoryDefs.h"
 
+#include <array>
 #include <cstddef>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace mem {
 
 class PhysicalMemory {
 public:
+  // Kind of storage used for memory contents
+  enum class Backing {
+    kDense,       // all memory allocated on construction
+    kSparse,      // page frames allocated on first write
+    kMappedFile   // memory is a shared mapping of a file
+  };
+  
   /**
    * Constructor
    * 
    * @param size number of bytes of memory to allocate (must be a multiple
-   *             of 16)
+   *             of 16, and no more than 4 GiB)
+   * @param backing_ dense or sparse storage
    * @throws std::bad_alloc if insufficient memory
    */
-  PhysicalMemory(Addr size) : mem_data(size), byte_count(0) { };
+  PhysicalMemory(uint64_t size, Backing backing_ = Backing::kDense);
+  
+  /**
+   * Constructor - use a file as memory. The file is created if it does not
+   *   exist, and extended with zeros if it is smaller than size. Existing 
+   *   contents of the file become the initial contents of memory, and all
+   *   changes to memory are written to the file.
+   * 
+   * @param size number of bytes of memory (must be a multiple of 16, and no
+   *             more than 4 GiB)
+   * @param file_name file to map
+   * @throws std::system_error if the file cannot be opened or mapped
+   */
+  PhysicalMemory(uint64_t size, const std::string &file_name);
   
-  ~PhysicalMemory() { }
+  ~PhysicalMemory();
   
   PhysicalMemory(const PhysicalMemory &other) = delete;  // no copy constructor
   PhysicalMemory(PhysicalMemory &&other) = delete;       // no move constructor
@@ -37,7 +77,22 @@ public:
    * 
    * @return number of bytes in physical memory 
    */
-  Addr size() const { return mem_data.size(); }
+  uint64_t size() const { return mem_size; }
+  
+  /**
+   * get_backing - return kind of storage used for memory
+   * 
+   * @return dense or sparse
+   */
+  Backing get_backing() const { return backing; }
+  
+  /**
+   * get_committed_frame_count - return number of page frames for which 
+   *   storage has been allocated
+   * 
+   * @return number of frames (all frames for dense memory)
+   */
+  Addr get_committed_frame_count() const { return committed_frame_count; }
   
   /**
    * get_byte - get a single byte from the specified address
@@ -83,6 +138,74 @@ public:
    */
   void put_bytes(Addr address, Addr count, const uint8_t *src);
   
+  /**
+   * fill_bytes - store count copies of value into physical memory
+   * 
+   * @param address destination in physical memory
+   * @param count number of bytes to store
+   * @param value value to store in each byte
+   */
+  void fill_bytes(Addr address, Addr count, uint8_t value);
+  
+  /**
+   * copy_bytes - copy a range of bytes within physical memory. The ranges
+   *   may overlap.
+   * 
+   * @param dest destination in physical memory
+   * @param src source in physical memory
+   * @param count number of bytes to copy
+   */
+  void copy_bytes(Addr dest, Addr src, Addr count);
+  
+  /**
+   * map_page - get a pointer for direct access to a range of bytes within
+   *   one page of physical memory. The range is truncated at the end of the
+   *   page containing address. The bytes in the returned range are counted
+   *   as transferred. The pointer remains valid for the life of the memory, 
+   *   but must not be used outside of the returned range.
+   * 
+   * @param address physical address of first byte
+   * @param count maximum number of bytes to access (must be > 0)
+   * @param write true if bytes will be written
+   * @return pointer to byte at address, and number of bytes in range
+   */
+  std::pair<uint8_t*, Addr> map_page(Addr address, Addr count, bool write);
+  
+  /**
+   * Sync - write changed contents of a mapped file back to the file. No 
+   *   effect unless memory is a mapped file.
+   * 
+   * @throws std::system_error if the write fails
+   */
+  void Sync();
+  
+  /**
+   * SaveContents - write memory contents to a snapshot stream. For sparse 
+   *   memory, only allocated frames are written. The contents of a mapped 
+   *   file are saved in a new copy of the file (named file.snapXXXXXX), and
+   *   the stream records the copy's name. The copy is not deleted; remove
+   *   it when the snapshot is no longer needed.
+   * 
+   * @param out snapshot stream
+   * @throws std::system_error if a mapped file cannot be copied
+   */
+  void SaveContents(std::ostream &out);
+  
+  /**
+   * RestoreContents - read memory contents written by SaveContents. Memory
+   *   must be the same size and kind as when the contents were saved. 
+   *   Frames not in the snapshot are cleared to 0. A mapped file is 
+   *   replaced by the copy made when the contents were saved, which may be
+   *   restored any number of times.
+   * 
+   * @param in snapshot stream
+   * @throws InvalidMMUOperationException if the snapshot does not match,
+   *   or the copy of a mapped file is missing
+   * @throws std::system_error if the copy cannot be read (memory is left
+   *   partly restored)
+   */
+  void RestoreContents(std::istream &in);
+  
   /**
    * ValidateAddressRange - check that address range is valid, throw
    *   PhysicalMemoryBoundsException if not.
@@ -100,8 +223,85 @@ public:
   uint64_t get_byte_count() const { return byte_count; }
   
 private:
+  // Number of frame pointers in each table of the sparse frame directory
+  static const int  kFrameTableSizeBits = 10;
+  static const Addr kFrameTableEntries = (1 << kFrameTableSizeBits);
+  typedef std::array<std::unique_ptr<uint8_t[]>, kFrameTableEntries> FrameTable;
+  
+  // Size of memory in bytes
+  uint64_t mem_size;
+  
+  // Storage type
+  Backing backing;
+  
+  // Dense storage for all of memory (empty unless dense)
   std::vector<uint8_t> mem_data;
   
+  // Start of contiguous memory: the dense storage or mapped file (null if
+  // sparse)
+  uint8_t *flat_data;
+  
+  // Name of mapped file (empty unless a mapped file)
+  std::string mapped_file_name;
+  
+  // Sparse storage. Each table holds pointers to the storage for 
+  // kFrameTableEntries consecutive frames; tables and frames are allocated
+  // on first write.
+  std::vector<std::unique_ptr<FrameTable>> frame_tables;
+  
+  // Number of frames with storage allocated
+  Addr committed_frame_count;
+  
+  /**
+   * CopyMappedFile - sync a mapped file, and copy it to a new file beside
+   *   it, sharing its storage if the file system supports reflinks
+   * 
+   * @return name of copy
+   * @throws std::system_error if the copy fails
+   */
+  std::string CopyMappedFile();
+  
+  /**
+   * RestoreMappedFile - replace the contents of a mapped file with a copy
+   *   made by CopyMappedFile
+   * 
+   * @param copy_name name of copy
+   * @throws InvalidMMUOperationException if the copy is missing or the 
+   *   wrong size
+   * @throws std::system_error if the copy cannot be read
+   */
+  void RestoreMappedFile(const std::string &copy_name);
+  
+  /**
+   * ReadPtr - get pointer to byte in memory for reading. For sparse memory,
+   *   the pointer is into a shared zero page if the frame is not allocated.
+   *   The caller must not access beyond the end of the page.
+   * 
+   * @param address physical address (must be valid)
+   * @return pointer to byte
+   */
+  const uint8_t *ReadPtr(Addr address) const;
+  
+  /**
+   * IsCommitted - check whether storage is allocated for a frame (always 
+   *   true unless memory is sparse)
+   * 
+   * @param address physical address in frame (must be valid)
+   * @return true if the frame is allocated
+   */
+  bool IsCommitted(Addr address) const;
+  
+  /**
+   * WritePtr - get pointer to byte in memory for writing, allocating the
+   *   frame if necessary. The caller must not access beyond the end of the 
+   *   page.
+   * 
+   * @param address physical address (must be valid)
+   * @return pointer to byte
+   * @throws std::bad_alloc if insufficient memory
+   */
+  uint8_t *WritePtr(Addr address);
+  
   // Define counter for number of bytes transferred.  Can be used as
   // pseudo-clock for ordering of cache entries.
   uint64_t byte_count;  // increments by one for every request
@@ -0,0 +1,52 @@
+/*
+ * Helpers for reading and writing MMU snapshots
+ *
+ * A snapshot is a binary stream holding the state of the simulated machine
+ * (see MMU::SaveSnapshot). Values are written in host byte order, so a
+ * snapshot can only be restored on the same kind of host.
+ *
+ * File:   Snapshot.h
+ * Author: agent <agent@local>
+ *
+ * Created on October 17, 2026
+ */
+
+#ifndef MEM_SNAPSHOT_H
+#define MEM_SNAPSHOT_H
+
+#include "Exceptions.h"
+
+#include <istream>
+#include <ostream>
+
+namespace mem {
+
+/**
+ * WriteSnapshotValue - write a value of a trivially copyable type
+ *
+ * @param out snapshot stream
+ * @param value value to write
+ */
+template <typename T>
+void WriteSnapshotValue(std::ostream &out, const T &value) {
+  out.write(reinterpret_cast<const char*> (&value), sizeof(T));
+}
+
+/**
+ * ReadSnapshotValue - read a value written by WriteSnapshotValue
+ *
+ * @param in snapshot stream
+ * @param value set to value read
+ * @throws InvalidMMUOperationException if the stream ends early
+ */
+template <typename T>
+void ReadSnapshotValue(std::istream &in, T &value) {
+  in.read(reinterpret_cast<char*> (&value), sizeof(T));
+  if (!in) {
+    throw InvalidMMUOperationException("Snapshot Error: snapshot is truncated");
+  }
+}
+
+}  // namespace mem
+
+#endif /* MEM_SNAPSHOT_H */
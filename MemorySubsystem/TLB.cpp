@@ -13,88 +13,445 @@
 
 #include "TLB.h"
 
-using std::next;
+#include "Snapshot.h"
 
 namespace mem {
 
-TLB::TLB(size_t entry_count_)
-: entry_count(entry_count_), req_seq(0), tlb_map(entry_count_) {
-  if(entry_count == 0) {
+template <class Tag>
+BasicTLB<Tag>::BasicTLB(size_t entry_count_)
+: BasicTLB(TLBGeometry(1, entry_count_)) {
+}
+
+template <class Tag>
+BasicTLB<Tag>::BasicTLB(const TLBGeometry &geometry_)
+: geometry(geometry_), used_count(0), large_cached(false), slab(nullptr) {
+  if(geometry.get_entry_count() == 0) {
     throw InvalidMMUOperationException("TLB size specified as 0");
   }
+  if((geometry.sets & (geometry.sets - 1)) != 0) {
+    throw InvalidMMUOperationException("TLB set count must be a power of 2");
+  }
+  if((geometry.l1_entries & (geometry.l1_entries - 1)) != 0) {
+    throw InvalidMMUOperationException("L1 TLB size must be a power of 2");
+  }
+  
+  // Allocate slab with enough spare entries to start it on a cache line
+  const size_t kLineEntries = kCacheLineSize / sizeof(TLBEntry);
+  slab_storage.resize(geometry.get_entry_count() + kLineEntries);
+  uintptr_t misalign = 
+          reinterpret_cast<uintptr_t>(slab_storage.data()) % kCacheLineSize;
+  slab = slab_storage.data() 
+          + (misalign == 0 ? 0 : (kCacheLineSize - misalign) / sizeof(TLBEntry));
+  
+  sets.resize(geometry.sets);
+  if (geometry.sets == 1) {
+    tlb_index.reserve(geometry.ways);
+  }
+  l1.resize(geometry.l1_entries);
 }
 
-PageTableEntry TLB::Lookup(Addr vaddr) {
-  // Clear offset bits in vaddr
-  Addr vaddr_page = vaddr & kPageNumberMask;
+template <class Tag>
+PageTableEntry BasicTLB<Tag>::Lookup(Tag vaddr, ASID asid, bool record_stats) {
+  // Clear offset bits in vaddr and add ASID
+  int level;
+  PageTableEntry pt_entry = Probe(MakeTag(vaddr, asid), 0, level);
   
-  // Try to find address in TLB
-  auto tlb_loc = tlb_map.find(vaddr_page);
+  // A large page is cached under the tag of its first page; only accept an
+  // entry found there if it really is for a large page.
+  if (level == 0 && large_cached) {
+    pt_entry = Probe(MakeLargeTag(vaddr, asid), kPTE_LargePageMask, level);
+  }
+  
+  if (!record_stats) {
+    return pt_entry;
+  }
   
-  // If found in TLB
-  if (tlb_loc != tlb_map.end()) {
+  // Update stats for the level which supplied the entry
+  if (level == 1) {
+    ++stats.recent_l1_hits;
+    ++stats.total_l1_hits;
+  } else if (!l1.empty()) {
+    ++stats.recent_l1_misses;
+    ++stats.total_l1_misses;
+  }
+  if (level == 2) {
+    ++stats.recent_l2_hits;
+    ++stats.total_l2_hits;
+  } else if (level == 0) {
+    ++stats.recent_l2_misses;
+    ++stats.total_l2_misses;
+  }
+  if (level != 0) {
     ++stats.recent_hits;
     ++stats.total_hits;
-    tlb_loc->second.last_ref_seq = ++req_seq; // update last reference
-    return tlb_loc->second.pt_entry;          // return cached page table entry
   } else {
-    // Not found in TLB
     ++stats.recent_misses;
     ++stats.total_misses;
-    return static_cast<PageTableEntry>(0);
   }
+  return pt_entry;
 }
 
-void TLB::Cache(Addr vaddr, PageTableEntry pt_entry) {
-  // Clear offset bits in vaddr
-  Addr vaddr_page = vaddr & kPageNumberMask;
+template <class Tag>
+void BasicTLB<Tag>::Cache(Tag vaddr, PageTableEntry pt_entry, ASID asid) {
+  // Clear offset bits in vaddr and add ASID
+  Tag tag;
+  if ((pt_entry & kPTE_LargePageMask) != 0) {
+    tag = MakeLargeTag(vaddr, asid);
+    large_cached = true;
+  } else {
+    tag = MakeTag(vaddr, asid);
+  }
+  
+  if (!l1.empty()) {
+    // If entry already in level 1, update mapping and exit
+    L1Entry &l1_entry = l1[L1Index(tag)];
+    if (l1_entry.valid && l1_entry.tag == tag) {
+      l1_entry.pt_entry = pt_entry;
+      return;
+    }
+    
+    // New entries are filled into level 1; remove any copy in level 2 and
+    // demote the level 1 entry being replaced.
+    uint32_t index = Find(tag);
+    if (index != kNoEntry) {
+      Remove(index);
+    }
+    if (l1_entry.valid) {
+      Insert(l1_entry.tag, l1_entry.pt_entry);
+    } else {
+      ++used_count;
+    }
+    l1_entry.tag = tag;
+    l1_entry.pt_entry = pt_entry;
+    l1_entry.valid = true;
+    UpdateMaxSize();
+    return;
+  }
 
   // If entry already in TLB, update mapping and exit
-  auto tlb_loc = tlb_map.find(vaddr_page);
-  if (tlb_loc != tlb_map.end()) {  // if already in TLB
-    tlb_loc->second.last_ref_seq = ++req_seq; // update last reference
-    tlb_loc->second.pt_entry = pt_entry;      // update cached page table entry
+  uint32_t index = Find(tag);
+  if (index != kNoEntry) {           // if already in TLB
+    TLBSet &set = sets[SetIndex(tag)];
+    if (index != set.lru_head) {     // update last reference
+      Unlink(set, index);
+      PushFront(set, index);
+    }
+    slab[index].pt_entry = pt_entry; // update cached page table entry
     return;
   }
   
-  // If TLB is full, remove an entry
-  if (tlb_map.size() >= entry_count) {
-    RemoveLRUEntry();
+  Insert(tag, pt_entry);
+  UpdateMaxSize();
+}
+
+template <class Tag>
+void BasicTLB<Tag>::Flush() {
+  stats.recent_hits = stats.recent_misses = stats.recent_max_size = 0;
+  stats.recent_l1_hits = stats.recent_l1_misses = 0;
+  stats.recent_l2_hits = stats.recent_l2_misses = 0;
+  tlb_index.clear();
+  used_count = 0;
+  large_cached = false;
+  for (TLBSet &set : sets) {
+    set = TLBSet();
+  }
+  for (L1Entry &l1_entry : l1) {
+    l1_entry.valid = false;
+  }
+}
+
+template <class Tag>
+void BasicTLB<Tag>::FlushASID(ASID asid) {
+  for (L1Entry &l1_entry : l1) {
+    if (l1_entry.valid && (l1_entry.tag & kPageOffsetMask) == asid) {
+      l1_entry.valid = false;
+      --used_count;
+    }
+  }
+  
+  // Scan each set from the end, since Remove moves the last entry of the
+  // set (which has already been checked) into the hole
+  for (size_t set_index = 0; set_index < geometry.sets; ++set_index) {
+    uint32_t base = set_index * geometry.ways;
+    for (uint32_t index = base + sets[set_index].used_count; index-- > base; ) {
+      if ((slab[index].tag & kPageOffsetMask) == asid) {
+        Remove(index);
+      }
+    }
+  }
+}
+
+template <class Tag>
+void BasicTLB<Tag>::FlushPage(Tag vaddr, ASID asid) {
+  FlushTag(MakeTag(vaddr, asid), 0);
+  if (large_cached) {
+    FlushTag(MakeLargeTag(vaddr, asid), kPTE_LargePageMask);
+  }
+}
+
+template <class Tag>
+PageTableEntry BasicTLB<Tag>::Probe(Tag tag, PageTableEntry required, int &level) {
+  // Check level 1 TLB first
+  if (!l1.empty()) {
+    L1Entry &l1_entry = l1[L1Index(tag)];
+    if (l1_entry.valid && l1_entry.tag == tag
+            && (l1_entry.pt_entry & required) == required) {
+      level = 1;
+      return l1_entry.pt_entry;
+    }
+  }
+  
+  // Try to find address in level 2 TLB
+  uint32_t index = Find(tag);
+  if (index == kNoEntry || (slab[index].pt_entry & required) != required) {
+    level = 0;
+    return static_cast<PageTableEntry>(0);
+  }
+  
+  level = 2;
+  PageTableEntry pt_entry = slab[index].pt_entry;
+  if (!l1.empty()) {
+    Promote(index);
+  } else {
+    // Move entry to front of LRU list
+    TLBSet &set = sets[SetIndex(tag)];
+    if (index != set.lru_head) {
+      Unlink(set, index);
+      PushFront(set, index);
+    }
+  }
+  return pt_entry;  // return cached page table entry
+}
+
+template <class Tag>
+void BasicTLB<Tag>::FlushTag(Tag tag, PageTableEntry required) {
+  if (!l1.empty()) {
+    L1Entry &l1_entry = l1[L1Index(tag)];
+    if (l1_entry.valid && l1_entry.tag == tag
+            && (l1_entry.pt_entry & required) == required) {
+      l1_entry.valid = false;
+      --used_count;
+      return;
+    }
+  }
+  uint32_t index = Find(tag);
+  if (index != kNoEntry && (slab[index].pt_entry & required) == required) {
+    Remove(index);
+  }
+}
+
+template <class Tag>
+void BasicTLB<Tag>::Save(std::ostream &out) const {
+  WriteSnapshotValue(out, static_cast<uint64_t>(geometry.sets));
+  WriteSnapshotValue(out, static_cast<uint64_t>(geometry.ways));
+  WriteSnapshotValue(out, static_cast<uint64_t>(geometry.l1_entries));
+  WriteSnapshotValue(out, stats);
+  
+  // Write entries of each set from least to most recently used
+  for (const TLBSet &set : sets) {
+    WriteSnapshotValue(out, set.used_count);
+    for (uint32_t index = set.lru_tail; index != kNoEntry; 
+         index = slab[index].prev) {
+      WriteSnapshotValue(out, slab[index].tag);
+      WriteSnapshotValue(out, slab[index].pt_entry);
+    }
+  }
+  for (const L1Entry &l1_entry : l1) {
+    WriteSnapshotValue(out, l1_entry.valid);
+    WriteSnapshotValue(out, l1_entry.tag);
+    WriteSnapshotValue(out, l1_entry.pt_entry);
+  }
+}
+
+template <class Tag>
+void BasicTLB<Tag>::Restore(std::istream &in) {
+  uint64_t saved_sets, saved_ways, saved_l1_entries;
+  ReadSnapshotValue(in, saved_sets);
+  ReadSnapshotValue(in, saved_ways);
+  ReadSnapshotValue(in, saved_l1_entries);
+  if (saved_sets != geometry.sets || saved_ways != geometry.ways
+          || saved_l1_entries != geometry.l1_entries) {
+    throw InvalidMMUOperationException("Snapshot Error: TLB geometry does not match");
+  }
+  
+  Flush();
+  ReadSnapshotValue(in, stats);
+  
+  // Reinsert entries in the order saved, so the last is most recently used
+  for (size_t set_index = 0; set_index < geometry.sets; ++set_index) {
+    uint32_t count;
+    ReadSnapshotValue(in, count);
+    if (count > geometry.ways) {
+      throw InvalidMMUOperationException("Snapshot Error: invalid TLB set size");
+    }
+    while (count-- > 0) {
+      Tag tag;
+      PageTableEntry pt_entry;
+      ReadSnapshotValue(in, tag);
+      ReadSnapshotValue(in, pt_entry);
+      if (SetIndex(tag) != set_index) {
+        throw InvalidMMUOperationException("Snapshot Error: invalid TLB entry");
+      }
+      Insert(tag, pt_entry);
+      large_cached |= (pt_entry & kPTE_LargePageMask) != 0;
+    }
+  }
+  for (L1Entry &l1_entry : l1) {
+    ReadSnapshotValue(in, l1_entry.valid);
+    ReadSnapshotValue(in, l1_entry.tag);
+    ReadSnapshotValue(in, l1_entry.pt_entry);
+    if (l1_entry.valid) {
+      ++used_count;
+      large_cached |= (l1_entry.pt_entry & kPTE_LargePageMask) != 0;
+    }
+  }
+}
+
+template <class Tag>
+void BasicTLB<Tag>::Insert(Tag tag, PageTableEntry pt_entry) {
+  size_t set_index = SetIndex(tag);
+  TLBSet &set = sets[set_index];
+  
+  // Get a free slot in the set, removing an entry if the set is full
+  uint32_t index;
+  if (set.used_count >= geometry.ways) {
+    index = RemoveLRUEntry(set_index);
+  } else {
+    index = set_index * geometry.ways + set.used_count++;
+    ++used_count;
   }
   
   // Add new entry to TLB
-  tlb_map[vaddr_page] = TLBEntry(++req_seq, pt_entry);
+  slab[index].tag = tag;
+  slab[index].pt_entry = pt_entry;
+  PushFront(set, index);
+  if (geometry.sets == 1) {
+    tlb_index[tag] = index;
+  }
+}
+
+template <class Tag>
+void BasicTLB<Tag>::Remove(uint32_t index) {
+  size_t set_index = SetIndex(slab[index].tag);
+  TLBSet &set = sets[set_index];
+  Unlink(set, index);
+  if (geometry.sets == 1) {
+    tlb_index.erase(slab[index].tag);
+  }
   
-  // Update TLB size stats
-  if (tlb_map.size() > stats.recent_max_size)
-    stats.recent_max_size = tlb_map.size();
+  // Keep the valid entries of the set contiguous by moving the last entry
+  // of the set into the hole
+  uint32_t last = set_index * geometry.ways + set.used_count - 1;
+  if (index != last) {
+    slab[index] = slab[last];
+    TLBEntry &moved = slab[index];
+    if (moved.prev != kNoEntry) {
+      slab[moved.prev].next = index;
+    } else {
+      set.lru_head = index;
+    }
+    if (moved.next != kNoEntry) {
+      slab[moved.next].prev = index;
+    } else {
+      set.lru_tail = index;
+    }
+    if (geometry.sets == 1) {
+      tlb_index[moved.tag] = index;
+    }
+  }
+  --set.used_count;
+  --used_count;
+}
+
+template <class Tag>
+void BasicTLB<Tag>::Promote(uint32_t index) {
+  TLBEntry promoted = slab[index];
+  L1Entry &l1_entry = l1[L1Index(promoted.tag)];
+  
+  // Remove from level 2 first, so the demoted entry can reuse its slot
+  Remove(index);
+  if (l1_entry.valid) {
+    Insert(l1_entry.tag, l1_entry.pt_entry);
+  } else {
+    ++used_count;
+  }
+  l1_entry.tag = promoted.tag;
+  l1_entry.pt_entry = promoted.pt_entry;
+  l1_entry.valid = true;
+}
+
+template <class Tag>
+void BasicTLB<Tag>::UpdateMaxSize() {
+  if (used_count > stats.recent_max_size)
+    stats.recent_max_size = used_count;
   if (stats.recent_max_size > stats.total_max_size)
     stats.total_max_size = stats.recent_max_size;
 }
 
-void TLB::Flush() {
-  stats.recent_hits = stats.recent_misses = stats.recent_max_size = 0;
-  tlb_map.clear();
-}
-
-void TLB::RemoveLRUEntry() {
-  if (!tlb_map.empty()) {
-    // Search sequentially through the TLB entries for the least recent access
-    // time.
-    //
-    // TODO: see if another data structure such as a priority queue would be
-    //       faster (normally the TLB is fairly small, so it may not make a
-    //       difference).
-    auto victim = tlb_map.begin();
-    for (auto cur = next(tlb_map.begin()); cur != tlb_map.end(); ++cur) {
-      if (cur->second.last_ref_seq < victim->second.last_ref_seq) {
-        victim = cur;
-      }
+template <class Tag>
+uint32_t BasicTLB<Tag>::Find(Tag tag) const {
+  if (geometry.sets == 1) {
+    // Fully associative - use hash table
+    auto tlb_loc = tlb_index.find(tag);
+    return tlb_loc != tlb_index.end() ? tlb_loc->second : kNoEntry;
+  }
+  
+  // Set associative - compare against each valid way in the set
+  size_t set_index = SetIndex(tag);
+  const TLBEntry *way = slab + set_index * geometry.ways;
+  const TLBEntry *end = way + sets[set_index].used_count;
+  for (; way != end; ++way) {
+    if (way->tag == tag) {
+      return way - slab;
     }
-    
-    // Delete the victim (entry with oldest reference time)
-    tlb_map.erase(victim);
   }
+  return kNoEntry;
 }
 
-} // namespace mem
\ No newline at end of file
+template <class Tag>
+uint32_t BasicTLB<Tag>::RemoveLRUEntry(size_t set_index) {
+  // The victim (entry with oldest reference time) is at the tail of the
+  // LRU list for the set
+  TLBSet &set = sets[set_index];
+  uint32_t victim = set.lru_tail;
+  Unlink(set, victim);
+  if (geometry.sets == 1) {
+    tlb_index.erase(slab[victim].tag);
+  }
+  return victim;
+}
+
+template <class Tag>
+void BasicTLB<Tag>::Unlink(TLBSet &set, uint32_t index) {
+  TLBEntry &entry = slab[index];
+  if (entry.prev != kNoEntry) {
+    slab[entry.prev].next = entry.next;
+  } else {
+    set.lru_head = entry.next;
+  }
+  if (entry.next != kNoEntry) {
+    slab[entry.next].prev = entry.prev;
+  } else {
+    set.lru_tail = entry.prev;
+  }
+  entry.prev = entry.next = kNoEntry;
+}
+
+template <class Tag>
+void BasicTLB<Tag>::PushFront(TLBSet &set, uint32_t index) {
+  TLBEntry &entry = slab[index];
+  entry.prev = kNoEntry;
+  entry.next = set.lru_head;
+  if (set.lru_head != kNoEntry) {
+    slab[set.lru_head].prev = index;
+  } else {
+    set.lru_tail = index;
+  }
+  set.lru_head = index;
+}
+
+// Tag types declared in TLB.h
+template class BasicTLB<Addr>;
+template class BasicTLB<VAddr>;
+
+} // namespace mem
@@ -1,9 +1,15 @@
 /* 
  * TLB - Translation Lookaside Buffer for MMU
  * 
- * The TLB caches recent MMU address translation results. It uses the LRU
- * replacement algorithm. The TLB should be flushed whenever there is a change
- * to the current page table, or when a different page table comes into use.
+ * The TLB caches recent MMU address translation results. It may be fully
+ * associative or set associative (see TLBGeometry), and uses the LRU
+ * replacement algorithm within each set; lookup, caching and replacement
+ * are all constant time. Entries are tagged with an address space identifier
+ * (ASID), so translations for several page tables may be cached at once. A
+ * large page is cached in a single entry covering the whole large page. The
+ * TLB (or the affected ASID or page) should be flushed whenever there is a
+ * change to a page table, or when an ASID is reused for a different page
+ * table.
  * 
  * File:   TLB.h
  * Author: Mike Goss <mikegoss@cs.du.edu>
@@ -17,71 +23,209 @@
 #include "Exceptions.h"
 #include "PageTable.h"
 
+#include <iosfwd>
 #include <unordered_map>
+#include <vector>
 
 namespace mem {
 
-class TLB {
+/**
+ * TLBGeometry - organization of the TLB entries into sets of ways. A page is
+ *   cached only in the set selected by the low bits of its page number. A TLB
+ *   with a single set is fully associative.
+ * 
+ *   Optionally, a small direct mapped level 1 TLB (micro-TLB) may be placed
+ *   in front of the main (level 2) TLB. The two levels are exclusive: an entry
+ *   found in level 2 is promoted to level 1, and the level 1 entry it replaces
+ *   is demoted to level 2.
+ */
+class TLBGeometry {
+public:
+  /**
+   * Constructor
+   * 
+   * @param sets_ number of sets (must be a power of 2)
+   * @param ways_ number of entries in each set (must be > 0)
+   * @param l1_entries_ number of entries in the direct mapped level 1 TLB 
+   *   (must be 0 or a power of 2; 0 if no level 1 TLB)
+   */
+  TLBGeometry(size_t sets_, size_t ways_, size_t l1_entries_ = 0) 
+  : sets(sets_), ways(ways_), l1_entries(l1_entries_) {}
+  
+  /**
+   * get_entry_count - return total number of entries in level 2 TLB
+   * 
+   * @return number of TLB entries
+   */
+  size_t get_entry_count() const { return sets * ways; }
+  
+  size_t sets;        // number of sets
+  size_t ways;        // number of entries per set
+  size_t l1_entries;  // number of entries in level 1 TLB
+};
+
+/**
+ * TLBStats - statistics on TLB operations. The hits and misses count 
+ *   lookups in the TLB as a whole (a hit in either level is a hit). The 
+ *   l1 and l2 counts are per level; only lookups which miss in level 1 are
+ *   counted in level 2. Without a level 1 TLB, the l1 counts are 0.
+ */
+class TLBStats {
+public:
+  // Constructor
+
+  TLBStats()
+  : recent_hits(0),
+  recent_misses(0),
+  recent_max_size(0),
+  total_hits(0),
+  total_misses(0),
+  total_max_size(0),
+  recent_l1_hits(0),
+  recent_l1_misses(0),
+  recent_l2_hits(0),
+  recent_l2_misses(0),
+  total_l1_hits(0),
+  total_l1_misses(0),
+  total_l2_hits(0),
+  total_l2_misses(0) {
+  }
+
+  uint64_t recent_hits;     // count of TLB hits since last flush
+  uint64_t recent_misses;   // count of TLB misses since last flush
+  uint64_t recent_max_size; // max size of TLB since last flush
+  uint64_t total_hits;      // count of total TLB hits
+  uint64_t total_misses;    // count of total TLB misses
+  uint64_t total_max_size;  // max size of TLB
+  
+  uint64_t recent_l1_hits;    // level 1 hits since last flush
+  uint64_t recent_l1_misses;  // level 1 misses since last flush
+  uint64_t recent_l2_hits;    // level 2 hits since last flush
+  uint64_t recent_l2_misses;  // level 2 misses since last flush
+  uint64_t total_l1_hits;     // count of total level 1 hits
+  uint64_t total_l1_misses;   // count of total level 1 misses
+  uint64_t total_l2_hits;     // count of total level 2 hits
+  uint64_t total_l2_misses;   // count of total level 2 misses
+};
+
+/**
+ * BasicTLB - TLB with tags of type Tag, which must be wide enough for a 
+ *   virtual page address (Addr for 32 bit virtual addresses, VAddr for 
+ *   wider ones). TLB is the TLB for 32 bit virtual addresses.
+ */
+template <class Tag>
+class BasicTLB {
 public:
+  typedef mem::TLBStats TLBStats;
+  
   /**
-   * Constructor - create TLB with specified number of entries > 0
+   * Constructor - create fully associative TLB with specified number of 
+   *   entries > 0
    * 
    * @param entry_count number of TLB entries
    */
-  TLB(size_t entry_count_);
+  BasicTLB(size_t entry_count_);
+  
+  /**
+   * Constructor - create set associative TLB
+   * 
+   * @param geometry_ number of sets and ways, and level 1 TLB size
+   * @throws InvalidMMUOperationException if sets or l1_entries is not a
+   *   power of 2, or if sets or ways is 0
+   */
+  BasicTLB(const TLBGeometry &geometry_);
   
   // Prevent copy/move/assign
-  ~TLB() { }
-  TLB(const TLB &other) = delete;  // no copy constructor
-  TLB(TLB &&other) = delete;       // no move constructor
-  TLB operator=(const TLB &other) = delete;  // no copy assign
-  TLB operator=(TLB &&other) = delete;       // no move assign
+  ~BasicTLB() { }
+  BasicTLB(const BasicTLB &other) = delete;  // no copy constructor
+  BasicTLB(BasicTLB &&other) = delete;       // no move constructor
+  BasicTLB operator=(const BasicTLB &other) = delete;  // no copy assign
+  BasicTLB operator=(BasicTLB &&other) = delete;       // no move assign
   
   /**
    * Lookup - find mapping for specified virtual address
    * 
    * @param vaddr virtual address to look up
-   * @return cached 2nd level page table entry for vaddr, or 0 if not in TLB
+   * @param asid address space to which vaddr belongs
+   * @param record_stats false to skip counting the hit or miss
+   * @return cached 2nd level page table entry for vaddr (or top level entry
+   *   if vaddr is in a large page), or 0 if not in TLB
    */
-  PageTableEntry Lookup(Addr vaddr);
+  PageTableEntry Lookup(Tag vaddr, ASID asid = 0, bool record_stats = true);
   
   /**
    * Cache - store 2nd level page table entry for virtual address of page 
-   *   starting at vaddr
+   *   starting at vaddr. If pt_entry has the LargePage flag set, it is the
+   *   top level entry for the large page containing vaddr.
    * 
    * @param vaddr starting virtual address of page
    * @param pt_entry 2nd level page table entry for page
+   * @param asid address space to which vaddr belongs
    */
-  void Cache(Addr vaddr, PageTableEntry pt_entry);
+  void Cache(Tag vaddr, PageTableEntry pt_entry, ASID asid = 0);
   
   /**
    * Flush - invalidate all TLB entries
    */
   void Flush();
   
-/**
-   * TLBStats - statistics on TLB operations
+  /**
+   * FlushASID - invalidate all TLB entries for one address space. Unlike
+   *   Flush, statistics are not reset.
+   * 
+   * @param asid address space to invalidate
    */
-  class TLBStats {
-  public:
-    // Constructor
-
-    TLBStats()
-    : recent_hits(0),
-    recent_misses(0),
-    recent_max_size(0),
-    total_hits(0),
-    total_misses(0),
-    total_max_size(0) {
+  void FlushASID(ASID asid);
+  
+  /**
+   * FlushPage - invalidate the TLB entry (if any) for one page, or for the
+   *   large page containing it. Statistics are not reset.
+   * 
+   * @param vaddr virtual address in page
+   * @param asid address space to which vaddr belongs
+   */
+  void FlushPage(Tag vaddr, ASID asid = 0);
+  
+  /**
+   * Save - write TLB geometry, statistics and entries to a snapshot stream
+   * 
+   * @param out snapshot stream
+   */
+  void Save(std::ostream &out) const;
+  
+  /**
+   * Restore - replace TLB contents and statistics with those written by
+   *   Save. The LRU order of entries is preserved.
+   * 
+   * @param in snapshot stream
+   * @throws InvalidMMUOperationException if the saved TLB geometry differs
+   *   or the snapshot is truncated
+   */
+  void Restore(std::istream &in);
+  
+  /**
+   * RecordHit - count a hit for a translation which the MMU reused from its
+   *   last translation register instead of calling Lookup. The page is the
+   *   most recently used one, so it is counted in the first level checked.
+   */
+  void RecordHit() {
+    ++stats.recent_hits;
+    ++stats.total_hits;
+    if (!l1.empty()) {
+      ++stats.recent_l1_hits;
+      ++stats.total_l1_hits;
+    } else {
+      ++stats.recent_l2_hits;
+      ++stats.total_l2_hits;
     }
-
-    uint64_t recent_hits;     // count of TLB hits since last flush
-    uint64_t recent_misses;   // count of TLB misses since last flush
-    uint64_t recent_max_size; // max size of TLB since last flush
-    uint64_t total_hits;      // count of total TLB hits
-    uint64_t total_misses;    // count of total TLB misses
-    uint64_t total_max_size;  // max size of TLB
-  };
+  }
+  
+  /**
+   * get_geometry - return organization of TLB
+   * 
+   * @return number of sets and ways
+   */
+  const TLBGeometry &get_geometry() const { return geometry; }
   
   /**
    * get_stats - get TLB statistics
@@ -93,41 +237,229 @@ public:
 private:
   /**
    * TLBEntry - contents of an entry in the TLB.  Private class used only
-   *   inside of TLB.  TLB entries may be copied and moved.
+   *   inside of TLB.  Entries live in a preallocated slab and are linked
+   *   into a doubly linked list per set in order of last reference, so the
+   *   least recently used entry of a set is always at the tail of its list.
    */
   class TLBEntry {
   public:
-    // Constructors
-    TLBEntry() : last_ref_seq(0), pt_entry(0) {}
-    TLBEntry(uint64_t lrseq, PageTableEntry pte)
-    : last_ref_seq(lrseq), pt_entry(pte) {
-    }
+    // Constructor
+    TLBEntry() : tag(0), pt_entry(0), prev(kNoEntry), next(kNoEntry) {}
+    
+    Tag tag;                      // page address and ASID (see MakeTag)
+    PageTableEntry pt_entry;      // copy of 2nd level page table entry
+    uint32_t prev;                // slab index of next more recently used entry
+    uint32_t next;                // slab index of next less recently used entry
+  };
+  
+  /**
+   * TLBSet - LRU state of one set. The set owns a contiguous run of ways
+   *   entries in the slab; slots are handed out in order, so the first
+   *   used_count of them are valid.
+   */
+  class TLBSet {
+  public:
+    // Constructor
+    TLBSet() : lru_head(kNoEntry), lru_tail(kNoEntry), used_count(0) {}
+    
+    uint32_t lru_head;    // most recently used entry
+    uint32_t lru_tail;    // least recently used entry
+    uint32_t used_count;  // number of valid entries in set
+  };
+  
+  /**
+   * L1Entry - contents of an entry in the direct mapped level 1 TLB
+   */
+  class L1Entry {
+  public:
+    // Constructor
+    L1Entry() : tag(0), pt_entry(0), valid(false) {}
     
-    uint64_t last_ref_seq;        // last sequence number at which entry used
+    Tag tag;                      // page address and ASID (see MakeTag)
     PageTableEntry pt_entry;      // copy of 2nd level page table entry
+    bool valid;                   // true if entry in use
   };
   
+  // Slab index used as a null link
+  static const uint32_t kNoEntry = 0xFFFFFFFF;
+  
+  // Size of a host cache line; the slab is aligned to this boundary so with
+  // 32 bit tags each set of 4 ways occupies exactly one line.
+  static const size_t kCacheLineSize = 64;
+  
+  /**
+   * MakeTag - make the tag under which a page is cached. The ASID is stored
+   *   in the page offset bits of the virtual address of the page.
+   * 
+   * @param vaddr virtual address in page
+   * @param asid address space identifier
+   * @return tag for page
+   */
+  static Tag MakeTag(Tag vaddr, ASID asid) {
+    return (vaddr & ~Tag(kPageOffsetMask)) | asid;
+  }
+  
+  /**
+   * MakeLargeTag - make the tag under which a large page is cached. This is
+   *   the tag of the first page in the large page.
+   * 
+   * @param vaddr virtual address in large page
+   * @param asid address space identifier
+   * @return tag for large page
+   */
+  static Tag MakeLargeTag(Tag vaddr, ASID asid) {
+    return (vaddr & ~Tag(kLargePageOffsetMask)) | asid;
+  }
+  
+  /**
+   * Probe - look up tag in both levels, updating LRU order if found. Stats
+   *   are not updated.
+   * 
+   * @param tag tag of page (see MakeTag)
+   * @param required flags which must be set in the cached entry for it to
+   *   match
+   * @param level set to level (1 or 2) in which entry was found, or 0 if not
+   *   found
+   * @return cached page table entry, or 0 if not found
+   */
+  PageTableEntry Probe(Tag tag, PageTableEntry required, int &level);
+  
   /**
-   * RemoveLRUEntry - remove Least Recently Used entry in TLB
+   * FlushTag - invalidate entry for tag (if any) in either level
+   * 
+   * @param tag tag of page (see MakeTag)
+   * @param required flags which must be set in the cached entry for it to
+   *   be invalidated
    */
-  void RemoveLRUEntry();
+  void FlushTag(Tag tag, PageTableEntry required);
   
-  // Max number of entries in TLB
-  size_t entry_count;
+  /**
+   * Find - find slab index of entry for page
+   * 
+   * @param tag tag of page (see MakeTag)
+   * @return slab index of entry, or kNoEntry if not in TLB
+   */
+  uint32_t Find(Tag tag) const;
   
-  // Request sequence number, used by LRU replacement policy as pseudo-time
-  uint64_t req_seq;
+  /**
+   * SetIndex - return index of set in which page may be cached. The large
+   *   page number is folded in, so that large pages (whose tags have the low
+   *   bits of the page number clear) are spread across the sets.
+   * 
+   * @param tag tag of page (see MakeTag)
+   * @return set number
+   */
+  size_t SetIndex(Tag tag) const {
+    return ((tag >> kPageSizeBits) ^ (tag >> kLargePageSizeBits))
+            & (geometry.sets - 1);
+  }
+  
+  /**
+   * L1Index - return index of level 1 entry in which page may be cached
+   *   (folded in the same way as SetIndex)
+   * 
+   * @param tag tag of page (see MakeTag)
+   * @return index in l1
+   */
+  size_t L1Index(Tag tag) const {
+    return ((tag >> kPageSizeBits) ^ (tag >> kLargePageSizeBits))
+            & (geometry.l1_entries - 1);
+  }
+  
+  /**
+   * Insert - store entry in level 2 TLB, replacing the LRU entry of the set
+   *   if the set is full. The page must not already be in level 2.
+   * 
+   * @param tag tag of page (see MakeTag)
+   * @param pt_entry 2nd level page table entry for page
+   */
+  void Insert(Tag tag, PageTableEntry pt_entry);
+  
+  /**
+   * Remove - remove entry from level 2 TLB
+   * 
+   * @param index slab index of entry
+   */
+  void Remove(uint32_t index);
+  
+  /**
+   * Promote - move entry found in level 2 into level 1, demoting the level 1
+   *   entry it replaces
+   * 
+   * @param index slab index of level 2 entry
+   */
+  void Promote(uint32_t index);
+  
+  /**
+   * UpdateMaxSize - update TLB size stats
+   */
+  void UpdateMaxSize();
+  
+  /**
+   * RemoveLRUEntry - remove Least Recently Used entry in a set
+   * 
+   * @param set_index set from which to remove an entry
+   * @return slab index of the removed entry, which may be reused
+   */
+  uint32_t RemoveLRUEntry(size_t set_index);
+  
+  /**
+   * Unlink - remove entry from the LRU list of its set
+   * 
+   * @param set LRU state of set containing entry
+   * @param index slab index of entry
+   */
+  void Unlink(TLBSet &set, uint32_t index);
+  
+  /**
+   * PushFront - insert entry at the most recently used end of the LRU list
+   *   of its set
+   * 
+   * @param set LRU state of set containing entry
+   * @param index slab index of entry
+   */
+  void PushFront(TLBSet &set, uint32_t index);
+  
+  // Organization of TLB
+  TLBGeometry geometry;
+  
+  // Total number of entries currently in use in both levels
+  size_t used_count;
+  
+  // True if a large page may be cached (set when one is cached, cleared by 
+  // Flush). Lookups check for a large page only when this is set.
+  bool large_cached;
+  
+  // Level 1 TLB (empty if no level 1)
+  std::vector<L1Entry> l1;
+  
+  // Preallocated storage for all TLB entries. The set with index s occupies
+  // entries [s * ways, (s+1) * ways) of the slab. The slab points into
+  // slab_storage at the first cache line boundary.
+  std::vector<TLBEntry> slab_storage;
+  TLBEntry *slab;
+  
+  // LRU state for each set
+  std::vector<TLBSet> sets;
   
   // Since we can't implement a true associative memory in software, we emulate
-  // one using a hash table (unordered_map), where the key is the virtual
-  // address of the start of the page, and the value is the 2nd level page table
-  // entry.
-  std::unordered_map<Addr,TLBEntry> tlb_map;
+  // a fully associative TLB using a hash table (unordered_map), where the key
+  // is the tag of the page, and the value is the slab
+  // index of the entry holding the 2nd level page table entry. A set
+  // associative TLB has few ways per set, so the set is searched directly
+  // and the hash table is not used.
+  std::unordered_map<Tag,uint32_t> tlb_index;
   
   // TLB statistics
   TLBStats stats;
 };
 
+// Tag types compiled in TLB.cpp
+extern template class BasicTLB<Addr>;
+extern template class BasicTLB<VAddr>;
+
+typedef BasicTLB<Addr> TLB;
+
 } // namespace mem
 
 #endif /* MEM_TLB_H */
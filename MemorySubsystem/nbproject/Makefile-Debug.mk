@@ -37,6 +37,8 @@ OBJECTDIR=${CND_BUILDDIR}/${CND_CONF}/${CND_PLATFORM}
 OBJECTFILES= \
 	${OBJECTDIR}/Exceptions.o \
 	${OBJECTDIR}/MMU.o \
+	${OBJECTDIR}/MultiNodeMemory.o \
+	${OBJECTDIR}/PageWalkCache.o \
 	${OBJECTDIR}/PhysicalMemory.o \
 	${OBJECTDIR}/TLB.o
 
@@ -89,6 +91,16 @@ ${OBJECTDIR}/MMU.o: MMU.cpp
 	${RM} "$@.d"
 	$(COMPILE.cc) -g -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/MMU.o MMU.cpp
 
+${OBJECTDIR}/MultiNodeMemory.o: MultiNodeMemory.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/MultiNodeMemory.o MultiNodeMemory.cpp
+
+${OBJECTDIR}/PageWalkCache.o: PageWalkCache.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/PageWalkCache.o PageWalkCache.cpp
+
 ${OBJECTDIR}/PhysicalMemory.o: PhysicalMemory.cpp
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
@@ -155,6 +167,32 @@ ${OBJECTDIR}/MMU_nomain.o: ${OBJECTDIR}/MMU.o MMU.cpp
 	    ${CP} ${OBJECTDIR}/MMU.o ${OBJECTDIR}/MMU_nomain.o;\
 	fi
 
+${OBJECTDIR}/MultiNodeMemory_nomain.o: ${OBJECTDIR}/MultiNodeMemory.o MultiNodeMemory.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	@NMOUTPUT=`${NM} ${OBJECTDIR}/MultiNodeMemory.o`; \
+	if (echo "$$NMOUTPUT" | ${GREP} '|main$$') || \
+	   (echo "$$NMOUTPUT" | ${GREP} 'T main$$') || \
+	   (echo "$$NMOUTPUT" | ${GREP} 'T _main$$'); \
+	then  \
+	    ${RM} "$@.d";\
+	    $(COMPILE.cc) -g -std=c++14 -Dmain=__nomain -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/MultiNodeMemory_nomain.o MultiNodeMemory.cpp;\
+	else  \
+	    ${CP} ${OBJECTDIR}/MultiNodeMemory.o ${OBJECTDIR}/MultiNodeMemory_nomain.o;\
+	fi
+
+${OBJECTDIR}/PageWalkCache_nomain.o: ${OBJECTDIR}/PageWalkCache.o PageWalkCache.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	@NMOUTPUT=`${NM} ${OBJECTDIR}/PageWalkCache.o`; \
+	if (echo "$$NMOUTPUT" | ${GREP} '|main$$') || \
+	   (echo "$$NMOUTPUT" | ${GREP} 'T main$$') || \
+	   (echo "$$NMOUTPUT" | ${GREP} 'T _main$$'); \
+	then  \
+	    ${RM} "$@.d";\
+	    $(COMPILE.cc) -g -std=c++14 -Dmain=__nomain -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/PageWalkCache_nomain.o PageWalkCache.cpp;\
+	else  \
+	    ${CP} ${OBJECTDIR}/PageWalkCache.o ${OBJECTDIR}/PageWalkCache_nomain.o;\
+	fi
+
 ${OBJECTDIR}/PhysicalMemory_nomain.o: ${OBJECTDIR}/PhysicalMemory.o PhysicalMemory.cpp 
 	${MKDIR} -p ${OBJECTDIR}
 	@NMOUTPUT=`${NM} ${OBJECTDIR}/PhysicalMemory.o`; \
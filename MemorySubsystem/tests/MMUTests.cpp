@@ -9,7 +9,16 @@
 #include "Exceptions.h"
 
 #include <gtest/gtest.h>
+#include <chrono>
 #include <cstring>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <glob.h>
+#include <unistd.h>
 
 using namespace mem;
 
@@ -29,6 +38,112 @@ void RandBuf(uint8_t *buf, Addr buf_len) {
   }
 }
 
+/**
+ * CheckPageGeometry - map two pages and a large page in an MMU of any 
+ *   geometry, and check the physical addresses accessed through them. The
+ *   MMU must have 2 large pages of physical memory and a TLB of at least 2
+ *   entries (if it has one).
+ * 
+ * @param vm MMU to check
+ */
+template <class VM>
+void CheckPageGeometry(VM &vm) {
+  const Addr kPage = VM::kPageBytes;
+  const Addr kLarge = Addr(1) << VM::kLargePageBits;
+  const Addr kPageTableBase = 1 * kPage;
+  const Addr kPageTableL2 = 2 * kPage;
+  const Addr kVAddrSmall = 5 * kLarge + 7 * kPage;
+  const Addr kVAddrLarge = 6 * kLarge;
+  ASSERT_EQ(2 * kLarge / kPage, vm.get_frame_count());
+  
+  // Pages 7 and 8 of the 2nd level table map to frames 4 and 3; the top 
+  // level entry after it maps the second large page of memory
+  std::vector<PageTableEntry> page_table_l1(kPage / sizeof(PageTableEntry));
+  page_table_l1[5] = kPageTableL2 | kPTE_PresentMask | kPTE_WritableMask;
+  page_table_l1[6] = kLarge 
+          | kPTE_PresentMask | kPTE_WritableMask | kPTE_LargePageMask;
+  vm.put_bytes(kPageTableBase, kPage, 
+               reinterpret_cast<uint8_t*> (page_table_l1.data()));
+  std::vector<PageTableEntry> page_table_l2(kPage / sizeof(PageTableEntry));
+  page_table_l2[7] = 4 * kPage | kPTE_PresentMask | kPTE_WritableMask;
+  page_table_l2[8] = 3 * kPage | kPTE_PresentMask | kPTE_WritableMask;
+  vm.put_bytes(kPageTableL2, kPage, 
+               reinterpret_cast<uint8_t*> (page_table_l2.data()));
+  PMCB vm_pmcb(true, kPageTableBase);
+  vm.set_PMCB(vm_pmcb);
+  
+  // Write across the boundary between the two pages, and into the last 
+  // page of the large page
+  uint8_t data[] = { 1, 2, 3, 4 };
+  vm.put_bytes(kVAddrSmall + kPage - 2, sizeof(data), data);
+  uint8_t val = 0x77;
+  vm.put_byte(kVAddrLarge + kLarge - kPage + 5, &val);
+  uint8_t result[sizeof(data)];
+  vm.get_bytes(result, kVAddrSmall + kPage - 2, sizeof(result));
+  ASSERT_EQ(0, std::memcmp(data, result, sizeof(data)));
+  ASSERT_EQ(MemoryFault::kPageFault, 
+            vm.try_get_bytes(&val, kVAddrSmall + 2 * kPage, 1));
+  
+  PMCB phys_pmcb;
+  vm.set_PMCB(phys_pmcb);
+  vm.get_bytes(result, 5 * kPage - 2, 2);
+  vm.get_bytes(result + 2, 3 * kPage, 2);
+  ASSERT_EQ(0, std::memcmp(data, result, sizeof(data)));
+  vm.get_byte(&val, 2 * kLarge - kPage + 5);
+  ASSERT_EQ(0x77, val);
+}
+
+/**
+ * TimePerByte - time single byte writes to one page, and alternating between
+ *   two pages, through an MMU with 4 KiB pages; print ns per byte
+ * 
+ * @param name configuration name to print
+ */
+template <class VM>
+void TimePerByte(const char *name) {
+  const Addr kPageCount = 32;  // number of physical memory pages
+  const Addr kPageTableBase = 19 * kPageSize;
+  const Addr kPageTableL2 = 11 * kPageSize;
+  const Addr kVAddrStart = 0x3456 * kPageSize;
+  const int kIterations = 1 << 20;
+  
+  VM vm(kPageCount, kPageCount/4);
+  PageTable page_table_l1;
+  Addr l1_offset = (kVAddrStart >> (kPageSizeBits + kPageTableSizeBits)) & kPageTableIndexMask;
+  page_table_l1[l1_offset] = kPageTableL2 | kPTE_PresentMask | kPTE_WritableMask;
+  vm.put_bytes(kPageTableBase, kPageTableSizeBytes,
+               reinterpret_cast<uint8_t*> (&page_table_l1));
+  PageTable page_table_l2;
+  for (Addr page = 0; page < 2; ++page) {
+    Addr l2_offset = ((kVAddrStart >> kPageSizeBits) + page) & kPageTableIndexMask;
+    page_table_l2[l2_offset] = (28 + page) * kPageSize 
+            | kPTE_PresentMask | kPTE_WritableMask;
+  }
+  vm.put_bytes(kPageTableL2, kPageTableSizeBytes,
+               reinterpret_cast<uint8_t*> (&page_table_l2));
+  PMCB vm_pmcb(true, kPageTableBase);
+  vm.set_PMCB(vm_pmcb);
+  
+  uint8_t val = 0x3C;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; ++i) {
+    vm.put_byte(kVAddrStart + (i & kPageOffsetMask), &val);
+  }
+  auto same_page = std::chrono::steady_clock::now() - start;
+  
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; ++i) {
+    vm.put_byte(kVAddrStart + ((i & 1) << kPageSizeBits) + (i & kPageOffsetMask), &val);
+  }
+  auto alternating = std::chrono::steady_clock::now() - start;
+  
+  std::cout << name << " ns per byte: same page = " 
+          << std::chrono::duration<double, std::nano>(same_page).count() / kIterations
+          << ", alternating pages = "
+          << std::chrono::duration<double, std::nano>(alternating).count() / kIterations
+          << "\n";
+}
+
 }  // namespace
 
 class MMUTests : public testing::Test {
@@ -529,6 +644,35 @@ TEST_F(MMUTests, SinglePageTLB) {
   ASSERT_NE(0, stats.total_max_size);
 }
 
+TEST_F(MMUTests, SinglePageSetAssociativeTLB) {
+  const Addr kPageCount = 32;  // number of physical memory pages
+  // Run tests with 2-way set associative TLB enabled
+  MMU vm(kPageCount, TLBGeometry(kPageCount/8, 2));
+  ASSERT_TRUE(vm.isTLBEnabled());
+  VMSinglePageTests(vm);
+
+  // Check that TLB was used by making sure that stats are not zero
+  TLB::TLBStats stats;
+  vm.get_TLBStats(stats);
+  ASSERT_NE(0, stats.total_hits);
+  ASSERT_NE(0, stats.total_misses);
+  ASSERT_NE(0, stats.total_max_size);
+}
+
+TEST_F(MMUTests, SinglePageTwoLevelTLB) {
+  const Addr kPageCount = 32;  // number of physical memory pages
+  // Run tests with level 1 micro-TLB in front of set associative TLB
+  MMU vm(kPageCount, TLBGeometry(kPageCount/8, 2, 4));
+  VMSinglePageTests(vm);
+
+  // Check that both levels were used
+  TLB::TLBStats stats;
+  vm.get_TLBStats(stats);
+  ASSERT_NE(0, stats.total_l1_hits);
+  ASSERT_NE(0, stats.total_l2_misses);
+  ASSERT_EQ(stats.total_hits, stats.total_l1_hits + stats.total_l2_hits);
+}
+
 // Test with three pages which cross a boundary in the first level page table
 TEST_F(MMUTests, MultiPage) {
   const Addr kPageCount = 32;  // number of physical memory pages
@@ -550,3 +694,1304 @@ TEST_F(MMUTests, MultiPageTLB) {
   ASSERT_NE(0, stats.total_misses);
   ASSERT_NE(0, stats.total_max_size);
 }
+
+TEST_F(MMUTests, MultiPageSetAssociativeTLB) {
+  const Addr kPageCount = 32;  // number of physical memory pages
+  // Run tests with direct mapped TLB enabled
+  MMU vm(kPageCount, TLBGeometry(kPageCount/4, 1));
+  VMMultiPageTests(vm);
+
+  // Check that TLB was used by making sure that stats are not zero
+  TLB::TLBStats stats;
+  vm.get_TLBStats(stats);
+  ASSERT_NE(0, stats.total_hits);
+  ASSERT_NE(0, stats.total_misses);
+  ASSERT_NE(0, stats.total_max_size);
+}
+
+// Check that the last translation register is used for repeated accesses to
+// a page and is counted as TLB hits
+TEST_F(MMUTests, LastTranslation) {
+  const Addr kPageCount = 32;  // number of physical memory pages
+  MMU vm(kPageCount, kPageCount/4);
+  const Addr kPageTableBase = 19 * kPageSize;
+  const Addr kPageTableL2 = 11 * kPageSize;
+  const Addr kVAddrStart = 0x2345 * kPageSize;
+  const Addr kPhysStart = 30 * kPageSize;
+
+  PageTable page_table_l1;
+  Addr l1_offset = (kVAddrStart >> (kPageSizeBits + kPageTableSizeBits)) & kPageTableIndexMask;
+  page_table_l1[l1_offset] = kPageTableL2 | kPTE_PresentMask | kPTE_WritableMask;
+  vm.put_bytes(kPageTableBase, kPageTableSizeBytes,
+               reinterpret_cast<uint8_t*> (&page_table_l1));
+  PageTable page_table_l2;
+  Addr l2_offset = (kVAddrStart >> kPageSizeBits) & kPageTableIndexMask;
+  page_table_l2[l2_offset] = kPhysStart | kPTE_PresentMask;  // read only
+  vm.put_bytes(kPageTableL2, kPageTableSizeBytes,
+               reinterpret_cast<uint8_t*> (&page_table_l2));
+  PMCB vm_pmcb(true, kPageTableBase);
+  vm.set_PMCB(vm_pmcb);
+  
+  // Read every byte of the page; only the first access should miss
+  uint8_t byte_read;
+  for (Addr i = 0; i < kPageSize; ++i) {
+    vm.get_byte(&byte_read, kVAddrStart + i);
+  }
+  TLB::TLBStats stats;
+  vm.get_TLBStats(stats);
+  ASSERT_EQ(1, stats.total_misses);
+  ASSERT_EQ(kPageSize - 1, stats.total_hits);
+  
+  // A read translation must not be reused for a write to a read only page
+  uint8_t write_byte = 0xA5;
+  ASSERT_THROW(vm.put_byte(kVAddrStart, &write_byte), WritePermissionFaultException);
+  
+  // Make the page writable. Switching PMCBs to change the page table 
+  // invalidates the register.
+  PMCB phys_pmcb;
+  vm.set_PMCB(phys_pmcb);
+  page_table_l2[l2_offset] = kPhysStart | kPTE_PresentMask | kPTE_WritableMask;
+  vm.put_bytes(kPageTableL2, kPageTableSizeBytes,
+               reinterpret_cast<uint8_t*> (&page_table_l2));
+  vm.set_PMCB(vm_pmcb);
+  vm.FlushTLB();
+  for (Addr i = 0; i < kPageSize; ++i) {
+    vm.put_byte(kVAddrStart + i, &write_byte);
+  }
+  vm.get_TLBStats(stats);
+  ASSERT_EQ(1, stats.recent_misses);
+  ASSERT_EQ(kPageSize - 1, stats.recent_hits);
+  
+  // Check data and modified bit
+  vm.set_PMCB(phys_pmcb);
+  vm.get_byte(&byte_read, kPhysStart + kPageSize - 1);
+  ASSERT_EQ(write_byte, byte_read);
+  vm.get_bytes(reinterpret_cast<uint8_t*> (&page_table_l2),
+               kPageTableL2, kPageTableSizeBytes);
+  ASSERT_NE(0, page_table_l2[l2_offset] & kPTE_ModifiedMask);
+}
+
+// Microbenchmark of single byte accesses. Accesses that stay on one page use
+// the last translation register; alternating between two pages forces a TLB
+// lookup on every access (or a page table walk without a TLB).
+TEST_F(MMUTests, PerByteThroughput) {
+  TimePerByte<MMU>("counted stats");
+  TimePerByte<BasicMMU<kPageSizeBits, kPageTableSizeBits, 
+                       DynamicTLB, NoStats>>("no stats");
+  TimePerByte<BasicMMU<kPageSizeBits, kPageTableSizeBits, 
+                       NoTLB, NoStats>>("no TLB");
+}
+
+// Check the non-throwing operations, which return faults and leave the 
+// resume state in the PMCB, and compare the cost of a fault reported each way
+TEST_F(MMUTests, NonThrowingFaults) {
+  const Addr kPageCount = 32;  // number of physical memory pages
+  const Addr kPageTableBase = 19 * kPageSize;
+  const Addr kPageTableL2 = 11 * kPageSize;
+  const Addr kVAddrStart = 0x5678 * kPageSize;
+  const int kIterations = 1 << 16;
+  
+  // First page writable, second read-only, third not present
+  MMU vm(kPageCount, kPageCount/4);
+  PageTable page_table_l1;
+  Addr l1_offset = (kVAddrStart >> (kPageSizeBits + kPageTableSizeBits)) & kPageTableIndexMask;
+  page_table_l1[l1_offset] = kPageTableL2 | kPTE_PresentMask | kPTE_WritableMask;
+  vm.put_bytes(kPageTableBase, kPageTableSizeBytes,
+               reinterpret_cast<uint8_t*> (&page_table_l1));
+  PageTable page_table_l2;
+  Addr l2_offset = (kVAddrStart >> kPageSizeBits) & kPageTableIndexMask;
+  page_table_l2[l2_offset] = 27 * kPageSize | kPTE_PresentMask | kPTE_WritableMask;
+  page_table_l2[l2_offset + 1] = 28 * kPageSize | kPTE_PresentMask;
+  vm.put_bytes(kPageTableL2, kPageTableSizeBytes,
+               reinterpret_cast<uint8_t*> (&page_table_l2));
+  PMCB vm_pmcb(true, kPageTableBase);
+  vm.set_PMCB(vm_pmcb);
+  
+  // Write spanning first two pages stops at the read-only page
+  std::vector<uint8_t> data(16, 0x5A);
+  Addr vaddr = kVAddrStart + kPageSize - 8;
+  ASSERT_EQ(MemoryFault::kWritePermissionFault, 
+            vm.try_put_bytes(vaddr, data.size(), data.data()));
+  PMCB fault_pmcb;
+  vm.get_PMCB(fault_pmcb);
+  ASSERT_EQ(PMCB::WRITE_OP, fault_pmcb.operation_state);
+  ASSERT_EQ(kVAddrStart + kPageSize, fault_pmcb.fault_vaddress);
+  ASSERT_EQ(8, fault_pmcb.remaining_count);
+  
+  // Make the page writable and resume
+  PMCB phys_pmcb;
+  vm.set_PMCB(phys_pmcb);
+  page_table_l2[l2_offset + 1] |= kPTE_WritableMask;
+  vm.put_bytes(kPageTableL2, kPageTableSizeBytes,
+               reinterpret_cast<uint8_t*> (&page_table_l2));
+  vm.FlushPage(kVAddrStart + kPageSize, 0);
+  ASSERT_EQ(MemoryFault::kNone, vm.try_set_PMCB(fault_pmcb));
+  std::vector<uint8_t> result(data.size());
+  ASSERT_EQ(MemoryFault::kNone, 
+            vm.try_get_bytes(result.data(), vaddr, result.size()));
+  ASSERT_EQ(data, result);
+  
+  // Faults on a page which is not present
+  Addr unmapped = kVAddrStart + 2 * kPageSize;
+  ASSERT_EQ(MemoryFault::kPageFault, vm.try_fill_bytes(unmapped, 4, 0));
+  ASSERT_EQ(MemoryFault::kPageFault, 
+            vm.try_copy_bytes(kVAddrStart, unmapped, 4));
+  vm.get_PMCB(fault_pmcb);
+  ASSERT_EQ(unmapped, fault_pmcb.fault_vaddress);
+  std::pair<uint8_t*, Addr> mapping(nullptr, 0);
+  ASSERT_EQ(MemoryFault::kPageFault, 
+            vm.try_map_page(unmapped + 4, 4, false, mapping));
+  ASSERT_EQ(nullptr, mapping.first);
+  ASSERT_THROW(vm.set_PMCB(fault_pmcb), PageFaultException);
+  
+  // Time page faults thrown and returned
+  vm.set_PMCB(vm_pmcb);
+  uint8_t val = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; ++i) {
+    try {
+      vm.put_byte(unmapped + (i & kPageOffsetMask), &val);
+    } catch (PageFaultException &e) {
+    }
+  }
+  auto thrown = std::chrono::steady_clock::now() - start;
+  
+  start = std::chrono::steady_clock::now();
+  int faults = 0;
+  for (int i = 0; i < kIterations; ++i) {
+    faults += vm.try_put_bytes(unmapped + (i & kPageOffsetMask), 1, &val)
+            == MemoryFault::kPageFault;
+  }
+  auto returned = std::chrono::steady_clock::now() - start;
+  ASSERT_EQ(kIterations, faults);
+  
+  std::cout << "ns per fault: thrown = " 
+          << std::chrono::duration<double, std::nano>(thrown).count() / kIterations
+          << ", returned = "
+          << std::chrono::duration<double, std::nano>(returned).count() / kIterations
+          << "\n";
+}
+
+// Fault handler which maps each faulting page to the next free frame, in
+// physical mode, until it runs out of frames
+class MapPageHandler : public FaultHandler {
+public:
+  MapPageHandler(MMU &vm_, Addr page_table_l2_, Addr next_frame_, Addr last_frame_)
+  : vm(vm_), page_table_l2(page_table_l2_), next_frame(next_frame_), 
+    last_frame(last_frame_), calls(0) {}
+  
+  bool HandleFault(MemoryFault fault, VAddr vaddress, bool /*write*/,
+                   const PMCB &fault_pmcb) override {
+    ++calls;
+    last_fault_pmcb = fault_pmcb;
+    if (fault != MemoryFault::kPageFault || next_frame > last_frame) {
+      return false;
+    }
+    PMCB phys_pmcb;
+    vm.set_PMCB(phys_pmcb);
+    PageTableEntry entry = next_frame | kPTE_PresentMask | kPTE_WritableMask;
+    Addr l2_offset = (vaddress >> kPageSizeBits) & kPageTableIndexMask;
+    vm.put_bytes(page_table_l2 + l2_offset * sizeof(PageTableEntry),
+                 sizeof(PageTableEntry), reinterpret_cast<uint8_t*> (&entry));
+    next_frame += kPageSize;
+    return true;
+  }
+  
+  MMU &vm;
+  Addr page_table_l2;
+  Addr next_frame;
+  Addr last_frame;
+  int calls;
+  PMCB last_fault_pmcb;
+};
+
+// Check that a fault handler resolves faults inline, so that operations
+// complete without reporting the faults
+TEST_F(MMUTests, FaultHandler) {
+  const Addr kPageCount = 32;  // number of physical memory pages
+  const Addr kPageTableBase = 19 * kPageSize;
+  const Addr kPageTableL2 = 11 * kPageSize;
+  const Addr kVAddrStart = 0x2468 * kPageSize;
+  
+  // L2 table with no pages mapped
+  MMU vm(kPageCount, kPageCount/4);
+  PageTable page_table_l1;
+  Addr l1_offset = (kVAddrStart >> (kPageSizeBits + kPageTableSizeBits)) & kPageTableIndexMask;
+  page_table_l1[l1_offset] = kPageTableL2 | kPTE_PresentMask | kPTE_WritableMask;
+  vm.put_bytes(kPageTableBase, kPageTableSizeBytes,
+               reinterpret_cast<uint8_t*> (&page_table_l1));
+  PageTable page_table_l2;
+  vm.put_bytes(kPageTableL2, kPageTableSizeBytes,
+               reinterpret_cast<uint8_t*> (&page_table_l2));
+  
+  // Handler maps 3 pages
+  MapPageHandler handler(vm, kPageTableL2, 24 * kPageSize, 26 * kPageSize);
+  vm.set_fault_handler(&handler);
+  PMCB vm_pmcb(true, kPageTableBase);
+  vm.set_PMCB(vm_pmcb);
+  
+  // Fill spanning two unmapped pages completes, with virtual mode restored
+  vm.fill_bytes(kVAddrStart + kPageSize - 4, 8, 0x77);
+  ASSERT_EQ(2, handler.calls);
+  ASSERT_EQ(PMCB::FILL_OP, handler.last_fault_pmcb.operation_state);
+  ASSERT_EQ(kVAddrStart + kPageSize, handler.last_fault_pmcb.fault_vaddress);
+  ASSERT_EQ(4, handler.last_fault_pmcb.remaining_count);
+  PMCB current;
+  vm.get_PMCB(current);
+  ASSERT_TRUE(current.vm_enable);
+  ASSERT_EQ(0, current.remaining_count);
+  uint8_t val = 0;
+  vm.get_byte(&val, kVAddrStart + kPageSize + 3);
+  ASSERT_EQ(0x77, val);
+  
+  // Copy source fault is a read
+  ASSERT_EQ(MemoryFault::kNone, 
+            vm.try_copy_bytes(kVAddrStart, kVAddrStart + 2 * kPageSize, 4));
+  ASSERT_EQ(3, handler.calls);
+  ASSERT_EQ(kVAddrStart + 2 * kPageSize, 
+            handler.last_fault_pmcb.next_src_vaddress);
+  
+  // Unresolved faults are reported to the caller
+  ASSERT_EQ(MemoryFault::kPageFault, 
+            vm.try_put_bytes(kVAddrStart + 3 * kPageSize, 1, &val));
+  ASSERT_EQ(4, handler.calls);
+  ASSERT_THROW(vm.map_page(kVAddrStart + 3 * kPageSize, 1, false), 
+               PageFaultException);
+  ASSERT_EQ(5, handler.calls);
+  
+  // Without a handler, faults are not resolved
+  vm.set_fault_handler(nullptr);
+  handler.last_frame = 31 * kPageSize;
+  ASSERT_EQ(MemoryFault::kPageFault, 
+            vm.try_put_bytes(kVAddrStart + 3 * kPageSize, 1, &val));
+  ASSERT_EQ(5, handler.calls);
+}
+
+// Check that the page walk cache supplies 2nd level page table addresses on
+// TLB misses, and is invalidated when the page table changes
+TEST_F(MMUTests, PageWalkCache) {
+  const Addr kPageCount = 32;  // number of physical memory pages
+  const Addr kPageTableBase = 19 * kPageSize;
+  const Addr kPageTableBase2 = 20 * kPageSize;
+  const Addr kPageTableL2 = 11 * kPageSize;
+  const Addr kVAddrStart = 0x4567 * kPageSize;
+  const Addr kVPageCount = 4;
+  
+  MMU vm(kPageCount, 1);  // single entry TLB, so every new page misses
+  PageWalkCache::PWCStats pwc_stats;
+  
+  PageTable page_table_l1;
+  Addr l1_offset = (kVAddrStart >> (kPageSizeBits + kPageTableSizeBits)) & kPageTableIndexMask;
+  page_table_l1[l1_offset] = kPageTableL2 | kPTE_PresentMask | kPTE_WritableMask;
+  vm.put_bytes(kPageTableBase, kPageTableSizeBytes,
+               reinterpret_cast<uint8_t*> (&page_table_l1));
+  vm.put_bytes(kPageTableBase2, kPageTableSizeBytes,
+               reinterpret_cast<uint8_t*> (&page_table_l1));
+  PageTable page_table_l2;
+  for (Addr page = 0; page < kVPageCount; ++page) {
+    Addr l2_offset = ((kVAddrStart >> kPageSizeBits) + page) & kPageTableIndexMask;
+    page_table_l2[l2_offset] = (24 + page) * kPageSize 
+            | kPTE_PresentMask | kPTE_WritableMask;
+  }
+  vm.put_bytes(kPageTableL2, kPageTableSizeBytes,
+               reinterpret_cast<uint8_t*> (&page_table_l2));
+  PMCB vm_pmcb(true, kPageTableBase);
+  vm.set_PMCB(vm_pmcb);
+  
+  // Write to every page; only the first walk reads the top level table
+  uint8_t val = 0x77;
+  for (Addr page = 0; page < kVPageCount; ++page) {
+    vm.put_byte(kVAddrStart + page * kPageSize, &val);
+  }
+  vm.get_PWCStats(pwc_stats);
+  ASSERT_EQ(1, pwc_stats.total_misses);
+  ASSERT_EQ(kVPageCount - 1, pwc_stats.total_hits);
+  
+  // Using a different page table invalidates the cache
+  PMCB vm_pmcb2(true, kPageTableBase2);
+  vm.set_PMCB(vm_pmcb2);
+  vm.get_PWCStats(pwc_stats);
+  ASSERT_EQ(0, pwc_stats.recent_hits + pwc_stats.recent_misses);
+  vm.FlushTLB();
+  uint8_t byte_read;
+  vm.get_byte(&byte_read, kVAddrStart);
+  ASSERT_EQ(val, byte_read);
+  vm.get_PWCStats(pwc_stats);
+  ASSERT_EQ(1, pwc_stats.recent_misses);
+  
+  // Remove the top level entry; after a flush the page must fault
+  PMCB phys_pmcb;
+  vm.set_PMCB(phys_pmcb);
+  page_table_l1[l1_offset] = 0;
+  vm.put_bytes(kPageTableBase2, kPageTableSizeBytes,
+               reinterpret_cast<uint8_t*> (&page_table_l1));
+  vm.set_PMCB(vm_pmcb2);
+  vm.FlushTLB();
+  ASSERT_THROW(vm.get_byte(&byte_read, kVAddrStart + kPageSize), PageFaultException);
+  
+  // No page walk cache without a TLB
+  MMU vm_no_tlb(kPageCount);
+  ASSERT_THROW(vm_no_tlb.get_PWCStats(pwc_stats), InvalidMMUOperationException);
+}
+
+// Check that two address spaces with different ASIDs can share the TLB
+// without flushing when switching between them
+TEST_F(MMUTests, ASIDSwitch) {
+  const Addr kPageCount = 32;  // number of physical memory pages
+  const Addr kPageTableBase[] = { 19 * kPageSize, 20 * kPageSize };
+  const Addr kPageTableL2[] = { 11 * kPageSize, 12 * kPageSize };
+  const Addr kPhysPage[] = { 28 * kPageSize, 29 * kPageSize };
+  const Addr kVAddr = 0x5678 * kPageSize;
+  
+  MMU vm(kPageCount, 8);
+  
+  // Map the same virtual page to a different frame in each address space
+  PMCB vm_pmcb[2];
+  for (int as = 0; as < 2; ++as) {
+    PageTable page_table_l1;
+    Addr l1_offset = (kVAddr >> (kPageSizeBits + kPageTableSizeBits)) & kPageTableIndexMask;
+    page_table_l1[l1_offset] = kPageTableL2[as] | kPTE_PresentMask | kPTE_WritableMask;
+    vm.put_bytes(kPageTableBase[as], kPageTableSizeBytes,
+                 reinterpret_cast<uint8_t*> (&page_table_l1));
+    PageTable page_table_l2;
+    Addr l2_offset = (kVAddr >> kPageSizeBits) & kPageTableIndexMask;
+    page_table_l2[l2_offset] = kPhysPage[as] | kPTE_PresentMask | kPTE_WritableMask;
+    vm.put_bytes(kPageTableL2[as], kPageTableSizeBytes,
+                 reinterpret_cast<uint8_t*> (&page_table_l2));
+    vm_pmcb[as] = PMCB(true, kPageTableBase[as], as + 1);
+  }
+  
+  // Write a different value in each address space
+  for (int as = 0; as < 2; ++as) {
+    vm.set_PMCB(vm_pmcb[as]);
+    uint8_t val = 0x10 + as;
+    vm.put_byte(kVAddr, &val);
+  }
+  
+  // Switch back and forth; each address space sees its own data, and all
+  // translations come from the TLB
+  TLB::TLBStats stats_before, stats_after;
+  vm.get_TLBStats(stats_before);
+  for (int i = 0; i < 8; ++i) {
+    int as = i % 2;
+    vm.set_PMCB(vm_pmcb[as]);
+    uint8_t val;
+    vm.get_byte(&val, kVAddr);
+    ASSERT_EQ(0x10 + as, val);
+  }
+  vm.get_TLBStats(stats_after);
+  ASSERT_EQ(stats_before.total_misses, stats_after.total_misses);
+  ASSERT_EQ(stats_before.total_hits + 8, stats_after.total_hits);
+  
+  // Flushing one address space leaves the other cached
+  vm.FlushASID(1);
+  vm.set_PMCB(vm_pmcb[1]);
+  uint8_t val;
+  vm.get_byte(&val, kVAddr);
+  vm.set_PMCB(vm_pmcb[0]);
+  vm.get_byte(&val, kVAddr);
+  vm.get_TLBStats(stats_before);
+  ASSERT_EQ(stats_after.total_misses + 1, stats_before.total_misses);
+  
+  // Unmap the page in address space 1; after FlushPage it must fault
+  PMCB phys_pmcb;
+  vm.set_PMCB(phys_pmcb);
+  PageTableEntry zero_pte = 0;
+  vm.put_bytes(kPageTableL2[0] + ((kVAddr >> kPageSizeBits) & kPageTableIndexMask) 
+                 * sizeof(PageTableEntry), 
+               sizeof(PageTableEntry), reinterpret_cast<uint8_t*> (&zero_pte));
+  vm.set_PMCB(vm_pmcb[0]);
+  vm.FlushPage(kVAddr);
+  ASSERT_THROW(vm.get_byte(&val, kVAddr), PageFaultException);
+  vm.set_PMCB(vm_pmcb[1]);
+  vm.get_byte(&val, kVAddr);
+  ASSERT_EQ(0x11, val);
+  
+  // ASID must be in range
+  ASSERT_THROW(vm.set_PMCB(PMCB(true, kPageTableBase[0], kMaxASID + 1)),
+               InvalidMMUOperationException);
+}
+
+// Check that a frame shared copy-on-write by two address spaces can be
+// copied by a write fault handler, and the write resumed
+TEST_F(MMUTests, CopyOnWrite) {
+  const Addr kPageCount = 32;  // number of physical memory pages
+  const Addr kPageTableBase[] = { 19 * kPageSize, 20 * kPageSize };
+  const Addr kPageTableL2[] = { 11 * kPageSize, 12 * kPageSize };
+  const Addr kSharedPage = 28 * kPageSize;
+  const Addr kCopyPage = 29 * kPageSize;
+  const Addr kVAddr = 0x5678 * kPageSize;
+  const Addr kL2EntryOffset = ((kVAddr >> kPageSizeBits) & kPageTableIndexMask) 
+          * sizeof(PageTableEntry);
+  
+  MMU vm(kPageCount, 8);
+  uint8_t shared_data[kPageSize];
+  RandBuf(shared_data, kPageSize);
+  vm.put_bytes(kSharedPage, kPageSize, shared_data);
+  
+  // Map the same frame read-only and copy-on-write in both address spaces
+  PMCB vm_pmcb[2];
+  for (int as = 0; as < 2; ++as) {
+    PageTable page_table_l1;
+    Addr l1_offset = (kVAddr >> (kPageSizeBits + kPageTableSizeBits)) & kPageTableIndexMask;
+    page_table_l1[l1_offset] = kPageTableL2[as] | kPTE_PresentMask | kPTE_WritableMask;
+    vm.put_bytes(kPageTableBase[as], kPageTableSizeBytes,
+                 reinterpret_cast<uint8_t*> (&page_table_l1));
+    PageTable page_table_l2;
+    page_table_l2[kL2EntryOffset / sizeof(PageTableEntry)] = 
+            kSharedPage | kPTE_PresentMask | kPTE_CopyOnWriteMask;
+    vm.put_bytes(kPageTableL2[as], kPageTableSizeBytes,
+                 reinterpret_cast<uint8_t*> (&page_table_l2));
+    vm_pmcb[as] = PMCB(true, kPageTableBase[as], as + 1);
+  }
+  
+  // Read in address space 1 so the translation is cached, then write
+  uint8_t val;
+  vm.set_PMCB(vm_pmcb[0]);
+  vm.get_byte(&val, kVAddr);
+  ASSERT_EQ(shared_data[0], val);
+  uint8_t put_data[16];
+  RandBuf(put_data, sizeof(put_data));
+  ASSERT_THROW(vm.put_bytes(kVAddr + 0x100, sizeof(put_data), put_data),
+               WritePermissionFaultException);
+  PMCB fault_pmcb;
+  vm.get_PMCB(fault_pmcb);
+  ASSERT_EQ(kVAddr + 0x100, fault_pmcb.fault_vaddress);
+  
+  // Handle the fault in physical mode: copy the frame, make the private 
+  // copy writable, and drop the cached translation
+  vm.set_PMCB(PMCB());
+  vm.copy_bytes(kCopyPage, kSharedPage, kPageSize);
+  PageTableEntry l2_entry = kCopyPage | kPTE_PresentMask | kPTE_WritableMask;
+  vm.put_bytes(kPageTableL2[0] + kL2EntryOffset, sizeof(PageTableEntry), 
+               reinterpret_cast<uint8_t*> (&l2_entry));
+  vm.FlushPage(kVAddr, vm_pmcb[0].asid);
+  
+  // Resume the write; only the private copy is changed
+  vm.set_PMCB(fault_pmcb);
+  uint8_t get_data[sizeof(put_data)];
+  vm.get_bytes(get_data, kVAddr + 0x100, sizeof(get_data));
+  ASSERT_EQ(0, memcmp(put_data, get_data, sizeof(put_data)));
+  vm.set_PMCB(vm_pmcb[1]);
+  vm.get_bytes(get_data, kVAddr + 0x100, sizeof(get_data));
+  ASSERT_EQ(0, memcmp(&shared_data[0x100], get_data, sizeof(get_data)));
+  ASSERT_THROW(vm.put_byte(kVAddr, &val), WritePermissionFaultException);
+}
+
+// Check that a cleared Accessed bit is set again on the next access only
+// after the cached translation is flushed (as a page reclaimer must do)
+TEST_F(MMUTests, ClearAccessedBit) {
+  const Addr kPageCount = 32;  // number of physical memory pages
+  const Addr kPageTableBase = 19 * kPageSize;
+  const Addr kPageTableL2 = 11 * kPageSize;
+  const Addr kPhysPage = 28 * kPageSize;
+  const Addr kVAddr = 0x5678 * kPageSize;
+  const Addr kL2EntryAddr = kPageTableL2 
+          + ((kVAddr >> kPageSizeBits) & kPageTableIndexMask) * sizeof(PageTableEntry);
+  
+  MMU vm(kPageCount, 8);
+  PageTable page_table_l1;
+  Addr l1_offset = (kVAddr >> (kPageSizeBits + kPageTableSizeBits)) & kPageTableIndexMask;
+  page_table_l1[l1_offset] = kPageTableL2 | kPTE_PresentMask | kPTE_WritableMask;
+  vm.put_bytes(kPageTableBase, kPageTableSizeBytes,
+               reinterpret_cast<uint8_t*> (&page_table_l1));
+  PageTableEntry l2_entry = kPhysPage | kPTE_PresentMask | kPTE_WritableMask;
+  vm.put_bytes(kL2EntryAddr, sizeof(PageTableEntry), 
+               reinterpret_cast<uint8_t*> (&l2_entry));
+  PMCB vm_pmcb(true, kPageTableBase, 1);
+  PMCB phys_pmcb;
+  
+  // Access the page, then clear its Accessed bit in physical mode
+  uint8_t val;
+  vm.set_PMCB(vm_pmcb);
+  vm.get_byte(&val, kVAddr);
+  vm.set_PMCB(phys_pmcb);
+  vm.get_bytes(reinterpret_cast<uint8_t*> (&l2_entry), kL2EntryAddr, 
+               sizeof(PageTableEntry));
+  ASSERT_NE(0, l2_entry & kPTE_AccessedMask);
+  l2_entry &= ~kPTE_AccessedMask;
+  vm.put_bytes(kL2EntryAddr, sizeof(PageTableEntry), 
+               reinterpret_cast<uint8_t*> (&l2_entry));
+  
+  // The TLB still holds the translation, so the bit is not set again
+  vm.set_PMCB(vm_pmcb);
+  vm.get_byte(&val, kVAddr);
+  vm.set_PMCB(phys_pmcb);
+  vm.get_bytes(reinterpret_cast<uint8_t*> (&l2_entry), kL2EntryAddr, 
+               sizeof(PageTableEntry));
+  ASSERT_EQ(0, l2_entry & kPTE_AccessedMask);
+  
+  // After the translation is flushed, the next access sets the bit
+  vm.FlushPage(kVAddr, vm_pmcb.asid);
+  vm.set_PMCB(vm_pmcb);
+  vm.get_byte(&val, kVAddr);
+  vm.set_PMCB(phys_pmcb);
+  vm.get_bytes(reinterpret_cast<uint8_t*> (&l2_entry), kL2EntryAddr, 
+               sizeof(PageTableEntry));
+  ASSERT_NE(0, l2_entry & kPTE_AccessedMask);
+}
+
+// Check translation through a large page mapped by a top level entry
+TEST_F(MMUTests, LargePage) {
+  const Addr kPageCount = 2 * kPageTableEntries;  // 8 MiB of physical memory
+  const Addr kPageTableBase = 3 * kPageSize;
+  const Addr kPageTableL2 = 4 * kPageSize;
+  const Addr kLargeFrame = kLargePageSize;  // second 4 MiB of memory
+  const Addr kVAddrLarge = 0x123 * kLargePageSize;
+  const Addr kVAddrSmall = 0x124 * kLargePageSize;
+  const Addr kSmallFrame = 5 * kPageSize;
+  
+  MMU vm(kPageCount, 8);
+  
+  // Map a large page, and a 4 KiB page in the following 4 MiB region
+  PageTable page_table_l1;
+  Addr l1_large = kVAddrLarge >> kLargePageSizeBits;
+  Addr l1_small = kVAddrSmall >> kLargePageSizeBits;
+  page_table_l1[l1_large] = kLargeFrame 
+          | kPTE_PresentMask | kPTE_WritableMask | kPTE_LargePageMask;
+  page_table_l1[l1_small] = kPageTableL2 | kPTE_PresentMask | kPTE_WritableMask;
+  vm.put_bytes(kPageTableBase, kPageTableSizeBytes,
+               reinterpret_cast<uint8_t*> (&page_table_l1));
+  PageTable page_table_l2;
+  page_table_l2[0] = kSmallFrame | kPTE_PresentMask | kPTE_WritableMask;
+  vm.put_bytes(kPageTableL2, kPageTableSizeBytes,
+               reinterpret_cast<uint8_t*> (&page_table_l2));
+  PMCB vm_pmcb(true, kPageTableBase);
+  vm.set_PMCB(vm_pmcb);
+  
+  // Write one byte in every page of the large page. Only the first write
+  // misses the TLB.
+  for (Addr page = 0; page < kPageTableEntries; ++page) {
+    uint8_t val = page & 0xFF;
+    vm.put_byte(kVAddrLarge + page * kPageSize + (page & kPageOffsetMask), &val);
+  }
+  TLB::TLBStats stats;
+  vm.get_TLBStats(stats);
+  ASSERT_EQ(1, stats.total_misses);
+  ASSERT_EQ(kPageTableEntries - 1, stats.total_hits);
+  
+  // Access the 4 KiB page; the large page remains cached
+  uint8_t val = 0x5A;
+  vm.put_byte(kVAddrSmall + 0x10, &val);
+  for (Addr page = 0; page < kPageTableEntries; page += 0x100) {
+    vm.get_byte(&val, kVAddrLarge + page * kPageSize + (page & kPageOffsetMask));
+    ASSERT_EQ(page & 0xFF, val);
+  }
+  vm.get_TLBStats(stats);
+  ASSERT_EQ(2, stats.total_misses);
+  
+  // Check physical memory and accessed/modified bits of the top level entry
+  PMCB phys_pmcb;
+  vm.set_PMCB(phys_pmcb);
+  for (Addr page = 0; page < kPageTableEntries; page += 0x55) {
+    vm.get_byte(&val, kLargeFrame + page * kPageSize + (page & kPageOffsetMask));
+    ASSERT_EQ(page & 0xFF, val);
+  }
+  vm.get_byte(&val, kSmallFrame + 0x10);
+  ASSERT_EQ(0x5A, val);
+  PageTableEntry l1_entry;
+  vm.get_bytes(reinterpret_cast<uint8_t*> (&l1_entry), 
+               kPageTableBase + l1_large * sizeof(PageTableEntry), 
+               sizeof(PageTableEntry));
+  ASSERT_EQ(kPTE_AccessedMask | kPTE_ModifiedMask, 
+            l1_entry & (kPTE_AccessedMask | kPTE_ModifiedMask));
+  
+  // Make the large page read-only; after flushing it writes must fault
+  l1_entry &= ~(kPTE_WritableMask | kPTE_ModifiedMask);
+  vm.put_bytes(kPageTableBase + l1_large * sizeof(PageTableEntry), 
+               sizeof(PageTableEntry), reinterpret_cast<uint8_t*> (&l1_entry));
+  vm.set_PMCB(vm_pmcb);
+  vm.FlushPage(kVAddrLarge + 0x2345);
+  ASSERT_THROW(vm.put_byte(kVAddrLarge + 0x3FF000, &val), 
+               WritePermissionFaultException);
+  vm.get_byte(&val, kVAddrLarge + kPageSize + 1);
+  ASSERT_EQ(1, val);
+  vm.get_byte(&val, kVAddrSmall + 0x10);
+  ASSERT_EQ(0x5A, val);
+}
+
+// Check page sizes other than 4 KiB, and the configurations without a TLB
+// or statistics
+TEST_F(MMUTests, PageSizes) {
+  const Addr kTableEntries = 1 << kPageTableSizeBits;
+  
+  BasicMMU<14, 10, DynamicTLB, CountStats> vm16k(2 * kTableEntries, 4, 
+                                                 PhysicalMemory::Backing::kSparse);
+  ASSERT_EQ(16 * 1024, vm16k.kPageBytes);
+  CheckPageGeometry(vm16k);
+  TLB::TLBStats stats;
+  vm16k.get_TLBStats(stats);
+  ASSERT_LT(0, stats.total_hits);
+  ASSERT_EQ(4, stats.total_misses);  // 3 pages and the page fault
+  
+  BasicMMU<16, 10, DynamicTLB, NoStats> vm64k(2 * kTableEntries, 4, 
+                                              PhysicalMemory::Backing::kSparse);
+  ASSERT_EQ(64 * 1024, vm64k.kPageBytes);
+  CheckPageGeometry(vm64k);
+  vm64k.get_TLBStats(stats);
+  ASSERT_EQ(0, stats.total_hits);
+  ASSERT_EQ(0, stats.total_misses);
+  
+  BasicMMU<kPageSizeBits, kPageTableSizeBits, NoTLB, NoStats> vm_no_tlb(
+          2 * kTableEntries, 4, PhysicalMemory::Backing::kSparse);
+  ASSERT_FALSE(vm_no_tlb.isTLBEnabled());
+  CheckPageGeometry(vm_no_tlb);
+  ASSERT_THROW(vm_no_tlb.get_TLBStats(stats), InvalidMMUOperationException);
+  
+  MMU vm(2 * kTableEntries, 4, PhysicalMemory::Backing::kSparse);
+  CheckPageGeometry(vm);
+}
+
+// Check the 4 level page table of the MMU with 48 bit virtual addresses,
+// and that addresses beyond the virtual address space are not truncated
+TEST_F(MMUTests, FourLevelPageTable) {
+  const Addr kPageCount = 1024;  // 4 MiB, so one 2 MiB large page fits
+  const Addr kTableFrames[] = { 1 * kPageSize, 2 * kPageSize, 
+                                3 * kPageSize, 4 * kPageSize };
+  const Addr kDataFrame = 5 * kPageSize;
+  const Addr kLargeFrame = 512 * kPageSize;
+  const VAddr kVAddrSmall = 0x7F1234567000;
+  const VAddr kVAddrLarge = kVAddrSmall + 0x400000 - 0x167000;  // 2 MiB aligned
+  ASSERT_EQ(4, MMU64::kLevels);
+  ASSERT_EQ(0, kVAddrLarge % 0x200000);
+  
+  MMU64 vm(kPageCount, 8, PhysicalMemory::Backing::kSparse);
+  
+  // Link the tables of each level, from the top level down; the level above
+  // the last also maps the large page
+  for (int level = 3; level >= 0; --level) {
+    Addr index = (kVAddrSmall >> (kPageSizeBits + 9 * level)) & 0x1FF;
+    PageTableEntry entry = (level > 0 ? kTableFrames[4 - level] : kDataFrame)
+            | kPTE_PresentMask | kPTE_WritableMask;
+    vm.put_bytes(kTableFrames[3 - level] + index * sizeof(PageTableEntry), 
+                 sizeof(PageTableEntry), reinterpret_cast<uint8_t*> (&entry));
+  }
+  Addr large_index = (kVAddrLarge >> (kPageSizeBits + 9)) & 0x1FF;
+  PageTableEntry large_entry = kLargeFrame 
+          | kPTE_PresentMask | kPTE_WritableMask | kPTE_LargePageMask;
+  vm.put_bytes(kTableFrames[2] + large_index * sizeof(PageTableEntry),
+               sizeof(PageTableEntry), reinterpret_cast<uint8_t*> (&large_entry));
+  
+  PMCB vm_pmcb(true, kTableFrames[0]);
+  vm.set_PMCB(vm_pmcb);
+  uint8_t data[] = { 0x11, 0x22, 0x33, 0x44 };
+  vm.put_bytes(kVAddrSmall + 0x10, sizeof(data), data);
+  vm.put_bytes(kVAddrLarge + 0x1FFFFE, 2, data);
+  uint8_t result[sizeof(data)];
+  vm.get_bytes(result, kVAddrSmall + 0x10, sizeof(result));
+  ASSERT_EQ(0, std::memcmp(data, result, sizeof(data)));
+  
+  // Another page in the same last level table uses the page walk cache,
+  // and faults because it is not mapped
+  PageWalkCache::PWCStats pwc_stats;
+  vm.get_PWCStats(pwc_stats);
+  ASSERT_EQ(0, pwc_stats.total_hits);
+  ASSERT_EQ(MemoryFault::kPageFault, 
+            vm.try_get_bytes(result, kVAddrSmall + kPageSize, 1));
+  vm.get_PWCStats(pwc_stats);
+  ASSERT_EQ(1, pwc_stats.total_hits);
+  
+  // Addresses past 48 bits fault, and the full address is reported
+  const VAddr kVAddrHigh = kVAddrSmall | (VAddr(1) << 48);
+  ASSERT_EQ(MemoryFault::kPageFault, 
+            vm.try_get_bytes(result, kVAddrHigh, 1));
+  PMCB fault_pmcb;
+  vm.get_PMCB(fault_pmcb);
+  ASSERT_EQ(kVAddrHigh, fault_pmcb.fault_vaddress);
+  
+  // Check physical memory, and accessed bits in every level
+  PMCB phys_pmcb;
+  vm.set_PMCB(phys_pmcb);
+  vm.get_bytes(result, kDataFrame + 0x10, sizeof(result));
+  ASSERT_EQ(0, std::memcmp(data, result, sizeof(data)));
+  vm.get_bytes(result, kLargeFrame + 0x1FFFFE, 2);
+  ASSERT_EQ(0, std::memcmp(data, result, 2));
+  for (int level = 3; level >= 1; --level) {
+    Addr index = (kVAddrSmall >> (kPageSizeBits + 9 * level)) & 0x1FF;
+    PageTableEntry entry;
+    vm.get_bytes(reinterpret_cast<uint8_t*> (&entry), 
+                 kTableFrames[3 - level] + index * sizeof(PageTableEntry),
+                 sizeof(PageTableEntry));
+    ASSERT_NE(0, entry & kPTE_AccessedMask);
+  }
+  ASSERT_THROW(vm.get_bytes(result, VAddr(1) << 32, 1), 
+               PhysicalMemoryBoundsException);
+  
+  // The 32 bit MMU faults on an address of 4 GiB or more, rather than 
+  // using the page it would alias
+  MMU vm32(32, 8);
+  const Addr kPageTableBase = 1 * kPageSize;
+  const Addr kPageTableL2 = 2 * kPageSize;
+  PageTableEntry entry = kPageTableL2 | kPTE_PresentMask | kPTE_WritableMask;
+  vm32.put_bytes(kPageTableBase, sizeof(entry), 
+                 reinterpret_cast<uint8_t*> (&entry));
+  entry = kDataFrame | kPTE_PresentMask | kPTE_WritableMask;
+  vm32.put_bytes(kPageTableL2, sizeof(entry), 
+                 reinterpret_cast<uint8_t*> (&entry));
+  vm32.set_PMCB(vm_pmcb);
+  vm32.put_bytes(0x10, sizeof(data), data);
+  ASSERT_EQ(MemoryFault::kPageFault, 
+            vm32.try_get_bytes(result, (VAddr(1) << 32) + 0x10, 1));
+  vm32.get_PMCB(fault_pmcb);
+  ASSERT_EQ((VAddr(1) << 32) + 0x10, fault_pmcb.fault_vaddress);
+}
+
+// Check a hashed page table shared by two address spaces, with the pages 
+// touched by trace4v_multi-l2-tables.txt and trace3v_high-addr.txt, and 
+// report its size against the two level page tables for the same pages
+TEST_F(MMUTests, HashedPageTable) {
+  const Addr kPageCount = 1024;  // number of physical memory pages
+  const Addr kTableBase = 1 * kPageSize;
+  const std::vector<std::vector<Addr>> kPages = {
+    { 0x40000000, 0x753ff000, 0x75400000, 0x75401000, 0x0affe000, 
+      0x0afff000, 0x0b000000, 0x0b001000, 0xfffff000 },
+    { 0xfffff000 } };
+  MMU vm(kPageCount, 16);
+  const Addr kTableBytes = 
+          vm.get_hashed_page_table_size() * sizeof(HashedPageTableEntry);
+  ASSERT_EQ(2048, vm.get_hashed_page_table_size());
+  
+  // Map each page of ASID 1 and 2 to its own frame following the table.
+  // Also map a page of ASID 1 with the same home entry as the first page,
+  // so that it is found by probing.
+  VAddr vpage_collision = 1;
+  while (HashedPageTableIndex(1, vpage_collision, 2048) 
+          != HashedPageTableIndex(1, kPages[0][0] >> kPageSizeBits, 2048)) {
+    ++vpage_collision;
+  }
+  std::vector<std::vector<Addr>> pages = kPages;
+  pages[0].push_back(vpage_collision << kPageSizeBits);
+  Addr frame = kTableBase + kTableBytes;
+  std::vector<Addr> entry_addrs;
+  for (ASID asid = 1; asid <= 2; ++asid) {
+    for (Addr vaddress : pages[asid - 1]) {
+      entry_addrs.push_back(vm.MapHashedPage(kTableBase, asid, vaddress, 
+              frame | kPTE_PresentMask | kPTE_WritableMask));
+      frame += kPageSize;
+    }
+  }
+  
+  // Write the ASID and page index to each page, then read them back
+  PMCB vm_pmcbs[] = { PMCB(true, kTableBase, 1, PMCB::HASHED),
+                      PMCB(true, kTableBase, 2, PMCB::HASHED) };
+  for (int pass = 0; pass < 2; ++pass) {
+    for (ASID asid = 1; asid <= 2; ++asid) {
+      vm.set_PMCB(vm_pmcbs[asid - 1]);
+      for (size_t i = 0; i < pages[asid - 1].size(); ++i) {
+        uint8_t data[] = { static_cast<uint8_t>(asid), 
+                           static_cast<uint8_t>(i) };
+        if (pass == 0) {
+          vm.put_bytes(pages[asid - 1][i] + kPageSize - 1, 1, &data[0]);
+          vm.put_bytes(pages[asid - 1][i] + 0x10, 1, &data[1]);
+        } else {
+          uint8_t result[2];
+          vm.get_bytes(&result[0], pages[asid - 1][i] + kPageSize - 1, 1);
+          vm.get_bytes(&result[1], pages[asid - 1][i] + 0x10, 1);
+          ASSERT_EQ(0, std::memcmp(data, result, sizeof(data)));
+        }
+      }
+    }
+  }
+  
+  // Unmapped pages fault, including a page mapped only in the other ASID
+  uint8_t val;
+  ASSERT_EQ(MemoryFault::kPageFault, 
+            vm.try_get_bytes(&val, 0x40001000, 1));
+  ASSERT_EQ(MemoryFault::kPageFault, 
+            vm.try_get_bytes(&val, 0x40000000, 1));
+  
+  // The MMU sets the accessed and modified bits in the hashed entries, and
+  // the format is kept by a snapshot
+  std::stringstream snapshot;
+  vm.set_PMCB(vm_pmcbs[1]);
+  vm.SaveSnapshot(snapshot);
+  PMCB phys_pmcb;
+  vm.set_PMCB(phys_pmcb);
+  for (Addr entry_pa : entry_addrs) {
+    HashedPageTableEntry entry;
+    vm.get_bytes(reinterpret_cast<uint8_t*> (&entry), entry_pa, sizeof(entry));
+    ASSERT_EQ(kPTE_AccessedMask | kPTE_ModifiedMask, 
+              entry.pt_entry & (kPTE_AccessedMask | kPTE_ModifiedMask));
+  }
+  MMU restored(kPageCount, 16);
+  restored.RestoreSnapshot(snapshot);
+  PMCB restored_pmcb;
+  restored.get_PMCB(restored_pmcb);
+  ASSERT_EQ(PMCB::HASHED, restored_pmcb.page_table_format);
+  restored.get_bytes(&val, kPages[1][0] + 0x10, 1);
+  ASSERT_EQ(0, val);
+  
+  // Report page table memory. Two level tables take a top level table for 
+  // each address space and a 2nd level table for each 4 MiB region touched;
+  // the hashed table is a fixed size shared by all address spaces.
+  Addr multi_level_bytes = 0;
+  Addr page_count = 0;
+  for (const std::vector<Addr> &trace_pages : kPages) {
+    std::set<Addr> regions;
+    for (Addr vaddress : trace_pages) {
+      regions.insert(vaddress >> kLargePageSizeBits);
+    }
+    multi_level_bytes += (1 + regions.size()) * kPageTableSizeBytes;
+    page_count += trace_pages.size();
+  }
+  ASSERT_EQ(9 * kPageTableSizeBytes, multi_level_bytes);
+  std::cout << "page table bytes for " << page_count 
+          << " pages in 2 address spaces: two level = " << multi_level_bytes
+          << ", hashed = " << kTableBytes << " ("
+          << page_count * sizeof(HashedPageTableEntry) << " in use)\n";
+}
+
+// Check removing pages from a hashed page table, singly and by ASID. A 
+// removed page's entry becomes a tombstone, so pages probed past it are 
+// still found, and cached translations are invalidated.
+TEST_F(MMUTests, HashedPageTableUnmap) {
+  const Addr kPageCount = 64;
+  const Addr kTableBase = 1 * kPageSize;
+  MMU vm(kPageCount, 16);
+  const Addr kEntries = vm.get_hashed_page_table_size();
+  const Addr kFrame = kTableBase + kPageSize;
+  ASSERT_GE(kPageSize, kEntries * sizeof(HashedPageTableEntry));
+  
+  // Three pages of ASID 1 with the same home entry, and a page of ASID 2 
+  // with a home entry away from theirs
+  const VAddr kVPage = 0x12345;
+  std::vector<VAddr> pages(1, kVPage << kPageSizeBits);
+  Addr home = HashedPageTableIndex(1, kVPage, kEntries);
+  for (VAddr vpage = 1; pages.size() < 3; ++vpage) {
+    if (vpage != kVPage && HashedPageTableIndex(1, vpage, kEntries) == home) {
+      pages.push_back(vpage << kPageSizeBits);
+    }
+  }
+  std::vector<Addr> entry_addrs;
+  for (size_t i = 0; i < pages.size(); ++i) {
+    entry_addrs.push_back(vm.MapHashedPage(kTableBase, 1, pages[i], 
+            (kFrame + i * kPageSize) | kPTE_PresentMask | kPTE_WritableMask));
+    ASSERT_EQ(kTableBase + ((home + i) & (kEntries - 1)) 
+                    * sizeof(HashedPageTableEntry), 
+              entry_addrs.back());
+  }
+  VAddr other_vpage = kVPage + 1;
+  while (((HashedPageTableIndex(2, other_vpage, kEntries) - home) 
+          & (kEntries - 1)) < 4) {
+    ++other_vpage;
+  }
+  vm.MapHashedPage(kTableBase, 2, other_vpage << kPageSizeBits, 
+          (kFrame + 3 * kPageSize) | kPTE_PresentMask | kPTE_WritableMask);
+  
+  // Mapping a page again updates its entry
+  ASSERT_EQ(entry_addrs[1], vm.MapHashedPage(kTableBase, 1, pages[1], 
+          (kFrame + kPageSize) | kPTE_PresentMask | kPTE_WritableMask));
+  
+  // Write a byte to each page of ASID 1, caching the translations
+  PMCB vm_pmcb(true, kTableBase, 1, PMCB::HASHED);
+  vm.set_PMCB(vm_pmcb);
+  for (size_t i = 0; i < pages.size(); ++i) {
+    uint8_t data = 0x10 + i;
+    vm.put_bytes(pages[i], 1, &data);
+  }
+  
+  // Removing the first page leaves the others reachable, and a tombstone 
+  // which is reused when a page is mapped again
+  uint8_t val;
+  ASSERT_TRUE(vm.UnmapHashedPage(kTableBase, 1, pages[0]));
+  ASSERT_FALSE(vm.UnmapHashedPage(kTableBase, 1, pages[0]));
+  ASSERT_EQ(MemoryFault::kPageFault, vm.try_get_bytes(&val, pages[0], 1));
+  vm.FlushTLB();
+  vm.get_bytes(&val, pages[2], 1);
+  ASSERT_EQ(0x12, val);
+  ASSERT_EQ(entry_addrs[0], vm.MapHashedPage(kTableBase, 1, pages[0], 
+          kFrame | kPTE_PresentMask | kPTE_WritableMask));
+  vm.get_bytes(&val, pages[0], 1);
+  ASSERT_EQ(0x10, val);
+  
+  // Purging ASID 1 removes its pages but not ASID 2's, and no tombstones 
+  // are left at the end of a probe sequence
+  ASSERT_EQ(3, vm.PurgeHashedASID(kTableBase, 1));
+  for (VAddr vaddress : pages) {
+    ASSERT_EQ(MemoryFault::kPageFault, vm.try_get_bytes(&val, vaddress, 1));
+  }
+  vm.set_PMCB(PMCB(true, kTableBase, 2, PMCB::HASHED));
+  vm.get_bytes(&val, other_vpage << kPageSizeBits, 1);
+  ASSERT_EQ(0, val);
+  vm.set_PMCB(PMCB());
+  for (size_t i = 0; i < pages.size(); ++i) {
+    HashedPageTableEntry entry;
+    vm.get_bytes(reinterpret_cast<uint8_t*> (&entry), entry_addrs[i], 
+                 sizeof(entry));
+    ASSERT_EQ(0, entry.flags);
+  }
+  
+  // Tombstones before an entry still in use are kept
+  vm.MapHashedPage(kTableBase, 1, pages[1], 
+          kFrame | kPTE_PresentMask | kPTE_WritableMask);
+  vm.MapHashedPage(kTableBase, 1, pages[2], 
+          kFrame | kPTE_PresentMask | kPTE_WritableMask);
+  ASSERT_TRUE(vm.UnmapHashedPage(kTableBase, 1, pages[1]));
+  HashedPageTableEntry entry;
+  vm.get_bytes(reinterpret_cast<uint8_t*> (&entry), entry_addrs[0], 
+               sizeof(entry));
+  ASSERT_EQ(kHPTE_UsedMask | kHPTE_TombstoneMask, entry.flags);
+  ASSERT_TRUE(vm.UnmapHashedPage(kTableBase, 1, pages[2]));
+  vm.get_bytes(reinterpret_cast<uint8_t*> (&entry), entry_addrs[0], 
+               sizeof(entry));
+  ASSERT_EQ(0, entry.flags);
+}
+
+// Check fill and copy, including resuming after page faults
+TEST_F(MMUTests, FillAndCopy) {
+  const Addr kPageCount = 32;  // number of physical memory pages
+  const Addr kPageTableBase = 19 * kPageSize;
+  const Addr kPageTableL2 = 11 * kPageSize;
+  const Addr kVAddrStart = 0x2345 * kPageSize;
+  const Addr kVPageCount = 6;
+  
+  MMU vm(kPageCount, 4);
+  PMCB phys_pmcb;
+  
+  // Map virtual pages to frames 24 and up, leaving pages 2 and 4 unmapped
+  PageTable page_table_l1;
+  Addr l1_offset = (kVAddrStart >> (kPageSizeBits + kPageTableSizeBits)) & kPageTableIndexMask;
+  page_table_l1[l1_offset] = kPageTableL2 | kPTE_PresentMask | kPTE_WritableMask;
+  vm.put_bytes(kPageTableBase, kPageTableSizeBytes,
+               reinterpret_cast<uint8_t*> (&page_table_l1));
+  PageTable page_table_l2;
+  Addr l2_offset = (kVAddrStart >> kPageSizeBits) & kPageTableIndexMask;
+  for (Addr page = 0; page < kVPageCount; ++page) {
+    if (page != 2 && page != 4) {
+      page_table_l2[l2_offset + page] = (24 + page) * kPageSize 
+              | kPTE_PresentMask | kPTE_WritableMask;
+    }
+  }
+  vm.put_bytes(kPageTableL2, kPageTableSizeBytes,
+               reinterpret_cast<uint8_t*> (&page_table_l2));
+  auto map_page = [&](Addr page) {
+    page_table_l2[l2_offset + page] = (24 + page) * kPageSize 
+            | kPTE_PresentMask | kPTE_WritableMask;
+    PMCB vm_pmcb;
+    vm.get_PMCB(vm_pmcb);
+    vm.set_PMCB(phys_pmcb);
+    vm.put_bytes(kPageTableL2, kPageTableSizeBytes,
+                 reinterpret_cast<uint8_t*> (&page_table_l2));
+    return vm_pmcb;
+  };
+  PMCB vm_pmcb(true, kPageTableBase);
+  vm.set_PMCB(vm_pmcb);
+  
+  // Fill across pages 0 to 2, faulting at page 2
+  const Addr kFillStart = kVAddrStart + 0x800;
+  const Addr kFillCount = 2 * kPageSize + 0x100;
+  try {
+    vm.fill_bytes(kFillStart, kFillCount, 0xC3);
+    FAIL() << "fill_bytes did not fault";
+  } catch (PageFaultException e) {
+    PMCB fault_pmcb;
+    vm.get_PMCB(fault_pmcb);
+    ASSERT_EQ(PMCB::FILL_OP, fault_pmcb.operation_state);
+    ASSERT_EQ(kVAddrStart + 2 * kPageSize, fault_pmcb.next_vaddress);
+    ASSERT_EQ(kVAddrStart + 2 * kPageSize, fault_pmcb.fault_vaddress);
+    ASSERT_EQ(0x900, fault_pmcb.remaining_count);
+  }
+  
+  // Map the page and resume
+  vm.set_PMCB(map_page(2));
+  uint8_t buffer[kVPageCount * kPageSize];
+  vm.get_bytes(buffer, kVAddrStart, 3 * kPageSize);
+  for (Addr i = 0; i < 3 * kPageSize; ++i) {
+    bool filled = i >= 0x800 && i < 0x800 + kFillCount;
+    ASSERT_EQ(filled ? 0xC3 : 0, buffer[i]) << "at offset " << std::hex << i;
+  }
+  
+  // Copy pages 0-1 to pages 3-4 at a different page offset, faulting on the
+  // destination at page 4
+  uint8_t random_bytes[2 * kPageSize];
+  RandBuf(random_bytes, 2 * kPageSize);
+  vm.put_bytes(kVAddrStart, 2 * kPageSize, random_bytes);
+  const Addr kCopyDest = kVAddrStart + 3 * kPageSize + 0x123;
+  const Addr kCopyCount = 2 * kPageSize - 0x200;
+  try {
+    vm.copy_bytes(kCopyDest, kVAddrStart, kCopyCount);
+    FAIL() << "copy_bytes did not fault";
+  } catch (PageFaultException e) {
+    PMCB fault_pmcb;
+    vm.get_PMCB(fault_pmcb);
+    ASSERT_EQ(PMCB::COPY_OP, fault_pmcb.operation_state);
+    ASSERT_EQ(kVAddrStart + 4 * kPageSize, fault_pmcb.next_vaddress);
+    ASSERT_EQ(fault_pmcb.next_vaddress, fault_pmcb.fault_vaddress);
+    ASSERT_EQ(kVAddrStart + kPageSize - 0x123, fault_pmcb.next_src_vaddress);
+  }
+  vm.set_PMCB(map_page(4));
+  vm.get_bytes(buffer, kCopyDest, kCopyCount);
+  ASSERT_EQ(0, memcmp(random_bytes, buffer, kCopyCount));
+  
+  // Source faults are reported at the source address
+  try {
+    vm.copy_bytes(kVAddrStart, kVAddrStart + 6 * kPageSize - 0x10, 0x20);
+    FAIL() << "copy_bytes did not fault";
+  } catch (PageFaultException e) {
+    PMCB fault_pmcb;
+    vm.get_PMCB(fault_pmcb);
+    ASSERT_EQ(kVAddrStart + 6 * kPageSize, fault_pmcb.fault_vaddress);
+    ASSERT_EQ(fault_pmcb.next_src_vaddress, fault_pmcb.fault_vaddress);
+    ASSERT_EQ(0x10, fault_pmcb.remaining_count);
+  }
+  
+  // Fill and copy are translated once per page
+  vm.set_PMCB(vm_pmcb);
+  vm.FlushTLB();
+  vm.fill_bytes(kVAddrStart, kVPageCount * kPageSize, 0x3C);
+  vm.copy_bytes(kVAddrStart + 3 * kPageSize, kVAddrStart, 3 * kPageSize);
+  TLB::TLBStats stats;
+  vm.get_TLBStats(stats);
+  ASSERT_EQ(kVPageCount + 2 * 3, stats.recent_hits + stats.recent_misses);
+  vm.get_bytes(buffer, kVAddrStart, kVPageCount * kPageSize);
+  for (Addr i = 0; i < kVPageCount * kPageSize; ++i) {
+    ASSERT_EQ(0x3C, buffer[i]);
+  }
+}
+
+// Check direct access to virtual pages
+TEST_F(MMUTests, MapPage) {
+  const Addr kPageCount = 32;  // number of physical memory pages
+  const Addr kPageTableBase = 19 * kPageSize;
+  const Addr kPageTableL2 = 11 * kPageSize;
+  const Addr kVAddrStart = 0x3456 * kPageSize;
+  const Addr kPhysStart = 24 * kPageSize;
+  
+  MMU vm(kPageCount, 4);
+  
+  // Map two writable pages and one read-only page
+  PageTable page_table_l1;
+  Addr l1_offset = (kVAddrStart >> (kPageSizeBits + kPageTableSizeBits)) & kPageTableIndexMask;
+  page_table_l1[l1_offset] = kPageTableL2 | kPTE_PresentMask | kPTE_WritableMask;
+  vm.put_bytes(kPageTableBase, kPageTableSizeBytes,
+               reinterpret_cast<uint8_t*> (&page_table_l1));
+  PageTable page_table_l2;
+  Addr l2_offset = (kVAddrStart >> kPageSizeBits) & kPageTableIndexMask;
+  for (Addr page = 0; page < 3; ++page) {
+    page_table_l2[l2_offset + page] = (kPhysStart + page * kPageSize) 
+            | kPTE_PresentMask | (page < 2 ? kPTE_WritableMask : 0);
+  }
+  vm.put_bytes(kPageTableL2, kPageTableSizeBytes,
+               reinterpret_cast<uint8_t*> (&page_table_l2));
+  PMCB vm_pmcb(true, kPageTableBase);
+  vm.set_PMCB(vm_pmcb);
+  
+  // Write through spans covering the first two pages
+  uint8_t random_bytes[2 * kPageSize];
+  RandBuf(random_bytes, 2 * kPageSize);
+  Addr offset = 0x20;
+  while (offset < 2 * kPageSize) {
+    auto span = vm.map_page(kVAddrStart + offset, 2 * kPageSize - offset, true);
+    ASSERT_EQ(std::min(2 * kPageSize - offset, kPageSize - (offset & kPageOffsetMask)),
+              span.second);
+    memcpy(span.first, random_bytes + offset, span.second);
+    offset += span.second;
+  }
+  uint8_t read_back[2 * kPageSize];
+  vm.get_bytes(read_back, kVAddrStart, 2 * kPageSize);
+  ASSERT_EQ(0, memcmp(random_bytes + 0x20, read_back + 0x20, 2 * kPageSize - 0x20));
+  
+  // Modified bit is set by a write span
+  PMCB phys_pmcb;
+  vm.set_PMCB(phys_pmcb);
+  vm.get_bytes(reinterpret_cast<uint8_t*> (&page_table_l2),
+               kPageTableL2, kPageTableSizeBytes);
+  ASSERT_NE(0, page_table_l2[l2_offset + 1] & kPTE_ModifiedMask);
+  vm.set_PMCB(vm_pmcb);
+  
+  // Read-only page can be read but not written; unmapped page faults
+  auto span = vm.map_page(kVAddrStart + 2 * kPageSize, 1, false);
+  ASSERT_EQ(1, span.second);
+  ASSERT_THROW(vm.map_page(kVAddrStart + 2 * kPageSize, 1, true),
+               WritePermissionFaultException);
+  ASSERT_THROW(vm.map_page(kVAddrStart + 3 * kPageSize + 5, 1, false),
+               PageFaultException);
+  PMCB fault_pmcb;
+  vm.get_PMCB(fault_pmcb);
+  ASSERT_EQ(kVAddrStart + 3 * kPageSize + 5, fault_pmcb.fault_vaddress);
+}
+
+// Run the virtual memory tests on sparse physical memory, with a 4 GiB
+// physical address space
+TEST_F(MMUTests, SparseMemory) {
+  const Addr kPageCount = 0x100000;
+  MMU vm(kPageCount, 8, PhysicalMemory::Backing::kSparse);
+  ASSERT_EQ(kPageCount, vm.get_frame_count());
+  ASSERT_EQ(0, vm.get_committed_frame_count());
+  
+  VMSinglePageTests(vm);
+  Addr committed = vm.get_committed_frame_count();
+  ASSERT_LT(0, committed);
+  ASSERT_GT(8, committed);
+  
+  PMCB phys_pmcb;
+  vm.set_PMCB(phys_pmcb);
+  VMMultiPageTests(vm);
+  
+  // High physical addresses are usable
+  vm.set_PMCB(phys_pmcb);
+  uint8_t val = 0xAB;
+  vm.put_byte(0xFFFFFFFF, &val);
+  val = 0;
+  vm.get_byte(&val, 0xFFFFFFFF);
+  ASSERT_EQ(0xAB, val);
+}
+
+// Check physical memory with two nodes
+TEST_F(MMUTests, MultiNode) {
+  const Addr kNodePages = 16;
+  std::vector<MemoryNode> nodes{ MemoryNode{ kNodePages, 1, 4 },
+                                 MemoryNode{ kNodePages, 2, 8 } };
+  MMU vm(nodes, 4);
+  ASSERT_EQ(2 * kNodePages, vm.get_frame_count());
+  ASSERT_EQ(2, vm.get_node_count());
+  ASSERT_EQ(0, vm.get_node_base(0));
+  ASSERT_EQ(kNodePages * kPageSize, vm.get_node_base(1));
+  ASSERT_EQ(kNodePages, vm.get_node_frame_count(1));
+  ASSERT_EQ(0, vm.get_node(kNodePages * kPageSize - 1));
+  ASSERT_EQ(1, vm.get_node(kNodePages * kPageSize));
+  ASSERT_THROW(vm.get_node(2 * kNodePages * kPageSize),
+               PhysicalMemoryBoundsException);
+  ASSERT_EQ(0, vm.get_current_node());
+  ASSERT_THROW(vm.set_current_node(2), InvalidMMUOperationException);
+  
+  // Local write to node 0, and remote write to node 1
+  std::vector<uint8_t> data(16);
+  for (size_t i = 0; i < data.size(); ++i) data[i] = i + 1;
+  vm.put_bytes(0x100, data.size(), data.data());
+  Addr node1_addr = vm.get_node_base(1) + 0x200;
+  vm.put_bytes(node1_addr, data.size(), data.data());
+  
+  MultiNodeMemory::NodeStats stats0, stats1;
+  vm.get_node_stats(0, stats0);
+  vm.get_node_stats(1, stats1);
+  ASSERT_EQ(0, stats0.remote_accesses);
+  ASSERT_EQ(data.size(), stats0.local_bytes);
+  ASSERT_EQ(stats0.local_accesses * 1, stats0.cost);
+  ASSERT_EQ(0, stats1.local_accesses);
+  ASSERT_EQ(data.size(), stats1.remote_bytes);
+  ASSERT_EQ(stats1.remote_accesses * 8, stats1.cost);
+  
+  // Copy a range spanning the node boundary; from node 1, node 1 accesses 
+  // are local
+  vm.set_current_node(1);
+  Addr boundary = vm.get_node_base(1);
+  vm.put_bytes(boundary - 8, data.size(), data.data());
+  vm.copy_bytes(boundary + 0x100 - 4, boundary - 8, data.size());
+  std::vector<uint8_t> result(data.size());
+  vm.get_bytes(result.data(), boundary + 0x100 - 4, result.size());
+  ASSERT_EQ(data, result);
+  vm.get_node_stats(1, stats1);
+  ASSERT_LT(0, stats1.local_accesses);
+  ASSERT_EQ(stats1.remote_accesses * 8 + stats1.local_accesses * 2, 
+            stats1.cost);
+  
+  // Per node byte counts add up to the total
+  ASSERT_EQ(vm.get_byte_count(), 
+            vm.get_node_byte_count(0) + vm.get_node_byte_count(1));
+  
+  // Virtual memory tests run across both nodes
+  PMCB phys_pmcb;
+  vm.set_PMCB(phys_pmcb);
+  VMSinglePageTests(vm);
+}
+
+// Check saving and restoring machine state
+TEST_F(MMUTests, Snapshot) {
+  const Addr kPageCount = 32;  // number of physical memory pages
+  const Addr kPageTableBase = 19 * kPageSize;
+  const Addr kPageTableL2 = 11 * kPageSize;
+  const Addr kVAddrStart = 0x4321 * kPageSize;
+  const Addr kVPageCount = 4;
+  std::string file_name = "/tmp/MMUTests_" + std::to_string(getpid()) + ".mem";
+  unlink(file_name.c_str());
+  
+  uint8_t random_bytes[kVPageCount * kPageSize];
+  RandBuf(random_bytes, kVPageCount * kPageSize);
+  std::stringstream snapshot, file_snapshot;
+  TLB::TLBStats saved_stats;
+  PMCB vm_pmcb(true, kPageTableBase, 3);
+  {
+    MMU vm(kPageCount, 8);
+    MMU vm_file(kPageCount, 8, file_name);
+    for (MMU *m : { &vm, &vm_file }) {
+      PageTable page_table_l1;
+      Addr l1_offset = (kVAddrStart >> (kPageSizeBits + kPageTableSizeBits)) & kPageTableIndexMask;
+      page_table_l1[l1_offset] = kPageTableL2 | kPTE_PresentMask | kPTE_WritableMask;
+      m->put_bytes(kPageTableBase, kPageTableSizeBytes,
+                   reinterpret_cast<uint8_t*> (&page_table_l1));
+      PageTable page_table_l2;
+      for (Addr page = 0; page < kVPageCount; ++page) {
+        Addr l2_offset = ((kVAddrStart >> kPageSizeBits) + page) & kPageTableIndexMask;
+        page_table_l2[l2_offset] = (24 + page) * kPageSize 
+                | kPTE_PresentMask | kPTE_WritableMask;
+      }
+      m->put_bytes(kPageTableL2, kPageTableSizeBytes,
+                   reinterpret_cast<uint8_t*> (&page_table_l2));
+      m->set_PMCB(vm_pmcb);
+      m->put_bytes(kVAddrStart, kVPageCount * kPageSize, random_bytes);
+    }
+    vm.get_TLBStats(saved_stats);
+    vm.SaveSnapshot(snapshot);
+    vm_file.SaveSnapshot(file_snapshot);
+    
+    // A pending read or write can't be saved
+    ASSERT_THROW(vm.get_bytes(random_bytes, kVAddrStart + kVPageCount * kPageSize, 1),
+                 PageFaultException);
+    std::stringstream bad_snapshot;
+    ASSERT_THROW(vm.SaveSnapshot(bad_snapshot), InvalidMMUOperationException);
+  }
+  
+  // Restored machines have the same PMCB, TLB and memory contents
+  MMU vm(kPageCount, 8);
+  MMU vm_file(kPageCount, 8, file_name);
+  vm.RestoreSnapshot(snapshot);
+  vm_file.RestoreSnapshot(file_snapshot);
+  for (MMU *m : { &vm, &vm_file }) {
+    PMCB restored_pmcb;
+    m->get_PMCB(restored_pmcb);
+    ASSERT_TRUE(restored_pmcb.vm_enable);
+    ASSERT_EQ(kPageTableBase, restored_pmcb.page_table_base);
+    ASSERT_EQ(3, restored_pmcb.asid);
+    uint8_t read_back[kVPageCount * kPageSize];
+    m->get_bytes(read_back, kVAddrStart, kVPageCount * kPageSize);
+    ASSERT_EQ(0, memcmp(random_bytes, read_back, kVPageCount * kPageSize));
+  }
+  TLB::TLBStats stats;
+  vm.get_TLBStats(stats);
+  ASSERT_EQ(saved_stats.total_misses, stats.total_misses);  // all cached
+  
+  // A mapped file can be rolled back to the snapshot after running on,
+  // more than once
+  for (int i = 0; i < 2; ++i) {
+    uint8_t changed = random_bytes[0] ^ 0xFF;
+    vm_file.put_bytes(kVAddrStart, 1, &changed);
+    file_snapshot.clear();
+    file_snapshot.seekg(0);
+    vm_file.RestoreSnapshot(file_snapshot);
+    uint8_t val;
+    vm_file.get_byte(&val, kVAddrStart);
+    ASSERT_EQ(random_bytes[0], val);
+  }
+  
+  // The copy of the file must still exist
+  glob_t copies;
+  ASSERT_EQ(0, glob((file_name + ".snap*").c_str(), 0, nullptr, &copies));
+  ASSERT_EQ(1, copies.gl_pathc);
+  unlink(copies.gl_pathv[0]);
+  globfree(&copies);
+  file_snapshot.clear();
+  file_snapshot.seekg(0);
+  ASSERT_THROW(vm_file.RestoreSnapshot(file_snapshot), InvalidMMUOperationException);
+  
+  // Snapshot must match the MMU configuration
+  snapshot.clear();
+  snapshot.seekg(0);
+  MMU vm_no_tlb(kPageCount);
+  ASSERT_THROW(vm_no_tlb.RestoreSnapshot(snapshot), InvalidMMUOperationException);
+  snapshot.clear();
+  snapshot.seekg(0);
+  MMU vm_small(kPageCount / 2, 8);
+  ASSERT_THROW(vm_small.RestoreSnapshot(snapshot), InvalidMMUOperationException);
+  unlink(file_name.c_str());
+}
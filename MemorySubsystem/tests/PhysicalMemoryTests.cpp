@@ -9,6 +9,10 @@
 
 #include <gtest/gtest.h>
 #include <cstring>
+#include <sstream>
+#include <string>
+
+#include <unistd.h>
 
 using mem::PhysicalMemory;
 using mem::PhysicalMemoryBoundsException;
@@ -223,4 +227,199 @@ TEST_F(PhysicalMemoryTests, AddressCheck) {
   }
   
   ASSERT_EQ(0, pm.get_byte_count());  // no reads/writes should succeed
-}
\ No newline at end of file
+}
+TEST_F(PhysicalMemoryTests, FillCopyBytes) {
+  const Addr kSize = 1024;
+  PhysicalMemory pm(kSize);
+  
+  // Fill a block and check it and its neighbors
+  pm.fill_bytes(0x100, 0x80, 0xA5);
+  uint8_t buf[kSize];
+  pm.get_bytes(buf, 0, kSize);
+  for (Addr i = 0; i < kSize; ++i) {
+    ASSERT_EQ((i >= 0x100 && i < 0x180) ? 0xA5 : 0, buf[i]);
+  }
+  
+  // Copy to non-overlapping and overlapping destinations
+  for (Addr i = 0; i < 0x80; ++i) {
+    uint8_t val = i;
+    pm.put_byte(0x100 + i, &val);
+  }
+  pm.copy_bytes(0x300, 0x100, 0x80);
+  pm.copy_bytes(0x110, 0x100, 0x80);
+  pm.get_bytes(buf, 0, kSize);
+  for (Addr i = 0; i < 0x80; ++i) {
+    ASSERT_EQ(i, buf[0x300 + i]);
+    ASSERT_EQ(i, buf[0x110 + i]);
+  }
+  
+  // Ranges are checked
+  ASSERT_THROW(pm.fill_bytes(kSize - 1, 2, 0), PhysicalMemoryBoundsException);
+  ASSERT_THROW(pm.copy_bytes(0, kSize - 1, 2), PhysicalMemoryBoundsException);
+  ASSERT_THROW(pm.copy_bytes(kSize - 1, 0, 2), PhysicalMemoryBoundsException);
+}
+
+TEST_F(PhysicalMemoryTests, MapPage) {
+  const Addr kSize = 4 * mem::kPageSize;
+  PhysicalMemory pm(kSize);
+  
+  // Range is truncated at end of page
+  auto span = pm.map_page(mem::kPageSize + 0xF00, 0x400, true);
+  ASSERT_EQ(0x100, span.second);
+  ASSERT_EQ(0x100, pm.get_byte_count());
+  memset(span.first, 0x5A, span.second);
+  span = pm.map_page(2 * mem::kPageSize, 0x10, false);
+  ASSERT_EQ(0x10, span.second);
+  
+  // Writes through the pointer are visible to get_bytes
+  uint8_t buf[0x102];
+  pm.get_bytes(buf, mem::kPageSize + 0xEFF, 0x102);
+  ASSERT_EQ(0, buf[0]);
+  for (Addr i = 1; i <= 0x100; ++i) {
+    ASSERT_EQ(0x5A, buf[i]);
+  }
+  ASSERT_EQ(0, buf[0x101]);
+  
+  // Range is checked
+  ASSERT_THROW(pm.map_page(kSize, 1, false), PhysicalMemoryBoundsException);
+}
+
+TEST_F(PhysicalMemoryTests, SparseBacking) {
+  // 4 GiB of sparse memory; nothing is allocated until written
+  const uint64_t kSize = 0x100000000ULL;
+  PhysicalMemory pm(kSize, PhysicalMemory::Backing::kSparse);
+  ASSERT_EQ(kSize, pm.size());
+  ASSERT_EQ(PhysicalMemory::Backing::kSparse, pm.get_backing());
+  ASSERT_EQ(0, pm.get_committed_frame_count());
+  
+  // Unwritten memory reads as zero
+  uint8_t buf[3 * mem::kPageSize];
+  memset(buf, 0xFF, sizeof(buf));
+  pm.get_bytes(buf, 0x80000000, sizeof(buf));
+  for (Addr i = 0; i < sizeof(buf); ++i) {
+    ASSERT_EQ(0, buf[i]);
+  }
+  auto span = pm.map_page(0x12345678, 0x10, false);
+  ASSERT_EQ(0, span.first[0]);
+  ASSERT_EQ(0, pm.get_committed_frame_count());
+  
+  // Writes across a page boundary commit both frames
+  for (Addr i = 0; i < 0x20; ++i) {
+    buf[i] = i + 1;
+  }
+  pm.put_bytes(0xFFFFEFF0, 0x20, buf);
+  ASSERT_EQ(2, pm.get_committed_frame_count());
+  uint8_t read_back[0x40];
+  pm.get_bytes(read_back, 0xFFFFEFE0, 0x40);
+  for (Addr i = 0; i < 0x40; ++i) {
+    ASSERT_EQ((i >= 0x10 && i < 0x30) ? i - 0xF : 0, read_back[i]);
+  }
+  
+  // Last byte of memory is accessible
+  uint8_t val = 0x99;
+  pm.put_byte(0xFFFFFFFF, &val);
+  pm.get_byte(&val, 0xFFFFFFFF);
+  ASSERT_EQ(0x99, val);
+  ASSERT_EQ(2, pm.get_committed_frame_count());
+  
+  // Fill and overlapping copies across frames
+  pm.fill_bytes(0x1FF0, 0x20, 0x77);
+  for (Addr i = 0; i < 0x20; ++i) {
+    val = i;
+    pm.put_byte(0x5FF0 + i, &val);
+  }
+  pm.copy_bytes(0x5FF8, 0x5FF0, 0x20);  // destination after source
+  pm.get_bytes(read_back, 0x5FF8, 0x20);
+  for (Addr i = 0; i < 0x20; ++i) {
+    ASSERT_EQ(i, read_back[i]);
+  }
+  pm.copy_bytes(0x5FF0, 0x5FF8, 0x20);  // destination before source
+  pm.get_bytes(read_back, 0x5FF0, 0x20);
+  for (Addr i = 0; i < 0x20; ++i) {
+    ASSERT_EQ(i, read_back[i]);
+  }
+  pm.get_bytes(read_back, 0x1FF0, 0x20);
+  for (Addr i = 0; i < 0x20; ++i) {
+    ASSERT_EQ(0x77, read_back[i]);
+  }
+  
+  // Filling with 0 (e.g. clearing a frame being allocated) does not commit
+  // frames, but clears frames which are committed
+  Addr committed = pm.get_committed_frame_count();
+  pm.fill_bytes(0x10000000, 4 * mem::kPageSize, 0);
+  ASSERT_EQ(committed, pm.get_committed_frame_count());
+  pm.fill_bytes(0x1FF8, 0x10, 0);
+  ASSERT_EQ(committed, pm.get_committed_frame_count());
+  pm.get_bytes(read_back, 0x1FF0, 0x20);
+  for (Addr i = 0; i < 0x20; ++i) {
+    ASSERT_EQ((i >= 8 && i < 0x18) ? 0 : 0x77, read_back[i]);
+  }
+}
+
+TEST_F(PhysicalMemoryTests, MappedFile) {
+  const Addr kSize = 8 * mem::kPageSize;
+  std::string file_name = "/tmp/PhysicalMemoryTests_" 
+          + std::to_string(getpid()) + ".mem";
+  unlink(file_name.c_str());
+  
+  // Contents written to mapped memory persist in the file
+  uint8_t buf[0x100];
+  for (Addr i = 0; i < sizeof(buf); ++i) {
+    buf[i] = i ^ 0x5A;
+  }
+  {
+    PhysicalMemory pm(kSize, file_name);
+    ASSERT_EQ(PhysicalMemory::Backing::kMappedFile, pm.get_backing());
+    ASSERT_EQ(kSize, pm.size());
+    pm.put_bytes(kSize - sizeof(buf), sizeof(buf), buf);
+    pm.fill_bytes(0x1000, 0x10, 0xEE);
+  }
+  {
+    PhysicalMemory pm(kSize, file_name);
+    uint8_t read_back[sizeof(buf)];
+    pm.get_bytes(read_back, kSize - sizeof(buf), sizeof(buf));
+    ASSERT_EQ(0, memcmp(buf, read_back, sizeof(buf)));
+    uint8_t val;
+    pm.get_byte(&val, 0x100F);
+    ASSERT_EQ(0xEE, val);
+    pm.get_byte(&val, 0x1010);
+    ASSERT_EQ(0, val);
+    ASSERT_THROW(pm.get_byte(&val, kSize), PhysicalMemoryBoundsException);
+  }
+  unlink(file_name.c_str());
+  
+  // Mapped file backing needs a file name
+  ASSERT_THROW(PhysicalMemory(kSize, PhysicalMemory::Backing::kMappedFile),
+               mem::InvalidMMUOperationException);
+}
+
+TEST_F(PhysicalMemoryTests, SaveRestoreContents) {
+  const Addr kSize = 16 * mem::kPageSize;
+  for (auto backing : { PhysicalMemory::Backing::kDense, 
+                        PhysicalMemory::Backing::kSparse }) {
+    PhysicalMemory pm(kSize, backing);
+    pm.fill_bytes(0x3FF0, 0x20, 0x42);
+    std::stringstream snapshot;
+    pm.SaveContents(snapshot);
+    
+    // Restore into memory with different contents
+    PhysicalMemory restored(kSize, backing);
+    restored.fill_bytes(0, kSize, 0x99);
+    restored.RestoreContents(snapshot);
+    uint8_t buf[kSize];
+    restored.get_bytes(buf, 0, kSize);
+    for (Addr i = 0; i < kSize; ++i) {
+      ASSERT_EQ((i >= 0x3FF0 && i < 0x4010) ? 0x42 : 0, buf[i]);
+    }
+    if (backing == PhysicalMemory::Backing::kSparse) {
+      ASSERT_EQ(2, restored.get_committed_frame_count());
+    }
+    
+    // Size must match
+    snapshot.clear();
+    snapshot.seekg(0);
+    PhysicalMemory smaller(kSize / 2, backing);
+    ASSERT_THROW(smaller.RestoreContents(snapshot), 
+                 mem::InvalidMMUOperationException);
+  }
+}
@@ -8,11 +8,15 @@
 
 #include <gtest/gtest.h>
 
+#include <list>
 #include <random>
 
 using mem::TLB;
 using mem::Addr;
+using mem::kLargePageSize;
+using mem::kPageSize;
 using mem::kPageSizeBits;
+using mem::kPTE_LargePageMask;
 using mem::kPTE_PresentMask;
 using mem::kPTE_WritableMask;
 using mem::PageTableEntry;
@@ -201,3 +205,277 @@ TEST_F(TLBTests, RandomTest) {
 
   std::cout << "hits2 = " << hits2 << ", misses2 = " << misses2 << "\n";  
 }
+
+TEST_F(TLBTests, LargeEvictionStressTest) {
+  const int tlb_size = 4096;
+  
+  // Set up test data covering several times the TLB size
+  vector<TLBData> test_data;
+  for (int i = 0; i < tlb_size*4; ++i) {
+    test_data.push_back(TLBData((i+1) << kPageSizeBits, 
+                                (0x5A3C1 - i) << kPageSizeBits));
+  }
+  
+  // Reference LRU model: list of test_data indices, most recent at front
+  std::list<int> lru_list;
+  vector<std::list<int>::iterator> lru_pos(test_data.size(), lru_list.end());
+  
+  std::mt19937 gen;  // standard Mersenne Twister engine
+  std::uniform_int_distribution<> rand_int(-tlb_size/2, tlb_size/2);
+  
+  // Make many random queries, caching any values that are not found, and
+  // check that the TLB evicts exactly the entries the model says it should.
+  TLB tlb(tlb_size);
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  int t_index = 0;
+  for (int j = 0; j < tlb_size*64; ++j) {
+    t_index = (t_index + rand_int(gen) + test_data.size()) % test_data.size();
+    const TLBData &mem_ref = test_data[t_index];
+    bool in_model = lru_pos[t_index] != lru_list.end();
+    
+    PageTableEntry pt_entry = tlb.Lookup(mem_ref.vaddr);
+    if (in_model) {
+      ++hits;
+      ASSERT_EQ(mem_ref.pt_entry, pt_entry);
+      lru_list.erase(lru_pos[t_index]);
+    } else {
+      ++misses;
+      ASSERT_EQ(0, pt_entry);
+      tlb.Cache(mem_ref.vaddr, mem_ref.pt_entry);
+      if (lru_list.size() == tlb_size) {
+        lru_pos[lru_list.back()] = lru_list.end();
+        lru_list.pop_back();
+      }
+    }
+    lru_list.push_front(t_index);
+    lru_pos[t_index] = lru_list.begin();
+  }
+  
+  // Check stats
+  TLB::TLBStats stats;
+  tlb.get_stats(stats);
+  EXPECT_EQ(hits, stats.total_hits);
+  EXPECT_EQ(misses, stats.total_misses);
+  EXPECT_EQ(tlb_size, stats.total_max_size);
+  
+  // Every entry in the model should still be in the TLB
+  for (int index : lru_list) {
+    EXPECT_EQ(test_data[index].pt_entry, tlb.Lookup(test_data[index].vaddr));
+  }
+  
+  std::cout << "hits = " << hits << ", misses = " << misses << "\n";
+}
+
+TEST_F(TLBTests, SetAssociativeTest) {
+  const int sets = 4;
+  const int ways = 2;
+  TLB tlb(mem::TLBGeometry(sets, ways));
+  EXPECT_EQ(sets * ways, tlb.get_geometry().get_entry_count());
+  
+  // Pages whose page numbers differ by a multiple of sets map to the same set
+  auto vaddr = [](int set, int n) -> Addr {
+    return (set + n * sets) << kPageSizeBits;
+  };
+  auto pte = [](int set, int n) -> PageTableEntry {
+    return ((0x3A100 + set * 0x10 + n) << kPageSizeBits) | kPTE_PresentMask;
+  };
+  
+  // Fill every way of every set, and check all entries are present
+  for (int s = 0; s < sets; ++s) {
+    for (int n = 0; n < ways; ++n) {
+      tlb.Cache(vaddr(s, n), pte(s, n));
+    }
+  }
+  for (int s = 0; s < sets; ++s) {
+    for (int n = 0; n < ways; ++n) {
+      EXPECT_EQ(pte(s, n), tlb.Lookup(vaddr(s, n)));
+    }
+  }
+  
+  // Touch way 0 of set 1, then add another page to set 1. Way 1 was least 
+  // recently used in set 1, so it should be the one replaced.
+  EXPECT_EQ(pte(1, 0), tlb.Lookup(vaddr(1, 0)));
+  tlb.Cache(vaddr(1, ways), pte(1, ways));
+  EXPECT_EQ(pte(1, 0), tlb.Lookup(vaddr(1, 0)));
+  EXPECT_EQ(0, tlb.Lookup(vaddr(1, 1)));
+  EXPECT_EQ(pte(1, ways), tlb.Lookup(vaddr(1, ways)));
+  
+  // Other sets are not affected by the conflict in set 1
+  for (int s = 0; s < sets; ++s) {
+    if (s == 1) continue;
+    for (int n = 0; n < ways; ++n) {
+      EXPECT_EQ(pte(s, n), tlb.Lookup(vaddr(s, n)));
+    }
+  }
+  
+  // Check stats
+  TLB::TLBStats stats;
+  tlb.get_stats(stats);
+  EXPECT_EQ(sets * ways * 2 + 1, stats.total_hits);
+  EXPECT_EQ(1, stats.total_misses);
+  EXPECT_EQ(sets * ways, stats.total_max_size);
+  
+  // Flush empties every set
+  tlb.Flush();
+  for (int s = 0; s < sets; ++s) {
+    EXPECT_EQ(0, tlb.Lookup(vaddr(s, 0)));
+  }
+  
+  // Invalid geometries are rejected
+  EXPECT_THROW(TLB(mem::TLBGeometry(3, 2)), mem::InvalidMMUOperationException);
+  EXPECT_THROW(TLB(mem::TLBGeometry(4, 0)), mem::InvalidMMUOperationException);
+}
+
+TEST_F(TLBTests, TwoLevelTest) {
+  const int l1_size = 4;
+  const int l2_size = 8;
+  TLB tlb(mem::TLBGeometry(1, l2_size, l1_size));
+  TLB::TLBStats stats;
+  
+  // Pages a and b map to the same level 1 entry
+  const Addr a = 3 << kPageSizeBits;
+  const Addr b = (3 + l1_size) << kPageSizeBits;
+  const PageTableEntry pte_a = (0x2A000 << kPageSizeBits) | kPTE_PresentMask;
+  const PageTableEntry pte_b = (0x2B000 << kPageSizeBits) | kPTE_PresentMask;
+  
+  // New entries are filled into level 1
+  tlb.Cache(a, pte_a);
+  EXPECT_EQ(pte_a, tlb.Lookup(a));
+  tlb.get_stats(stats);
+  EXPECT_EQ(1, stats.total_l1_hits);
+  EXPECT_EQ(0, stats.total_l2_hits + stats.total_l2_misses);
+  
+  // Caching b demotes a to level 2; a lookup of a promotes it again and
+  // demotes b
+  tlb.Cache(b, pte_b);
+  EXPECT_EQ(pte_a, tlb.Lookup(a));
+  EXPECT_EQ(pte_a, tlb.Lookup(a));
+  EXPECT_EQ(pte_b, tlb.Lookup(b));
+  tlb.get_stats(stats);
+  EXPECT_EQ(2, stats.total_l1_hits);
+  EXPECT_EQ(2, stats.total_l1_misses);
+  EXPECT_EQ(2, stats.total_l2_hits);
+  EXPECT_EQ(0, stats.total_l2_misses);
+  EXPECT_EQ(4, stats.total_hits);
+  EXPECT_EQ(0, stats.total_misses);
+  EXPECT_EQ(2, stats.total_max_size);
+  
+  // Updating an entry keeps a single copy
+  tlb.Cache(a, pte_a | kPTE_WritableMask);
+  EXPECT_EQ(pte_a | kPTE_WritableMask, tlb.Lookup(a));
+  EXPECT_EQ(pte_b, tlb.Lookup(b));
+  tlb.get_stats(stats);
+  EXPECT_EQ(2, stats.total_max_size);
+  
+  // The levels are exclusive, so the TLB holds l1_size + l2_size entries
+  vector<TLBData> test_data;
+  for (int i = 0; i < l1_size + l2_size; ++i) {
+    test_data.push_back(TLBData((i+0x100) << kPageSizeBits, 
+                                (0x6E100 + i) << kPageSizeBits));
+    tlb.Cache(test_data[i].vaddr, test_data[i].pt_entry);
+  }
+  for (const TLBData &data : test_data) {
+    EXPECT_EQ(data.pt_entry, tlb.Lookup(data.vaddr));
+  }
+  EXPECT_EQ(0, tlb.Lookup(a));
+  EXPECT_EQ(0, tlb.Lookup(b));
+  tlb.get_stats(stats);
+  EXPECT_EQ(l1_size + l2_size, stats.total_max_size);
+  EXPECT_EQ(stats.total_hits, stats.total_l1_hits + stats.total_l2_hits);
+  EXPECT_EQ(stats.total_misses, stats.total_l2_misses);
+  
+  // Flush clears both levels and the recent counts
+  tlb.Flush();
+  tlb.get_stats(stats);
+  EXPECT_EQ(0, stats.recent_l1_hits + stats.recent_l1_misses);
+  EXPECT_EQ(0, stats.recent_l2_hits + stats.recent_l2_misses);
+  EXPECT_EQ(0, tlb.Lookup(test_data[0].vaddr));
+  
+  EXPECT_THROW(TLB(mem::TLBGeometry(1, 8, 3)), mem::InvalidMMUOperationException);
+}
+
+TEST_F(TLBTests, ASIDTest) {
+  // Run with a fully associative TLB, and with a two level set associative TLB
+  vector<mem::TLBGeometry> geometries = 
+      { mem::TLBGeometry(1, 16), mem::TLBGeometry(4, 4, 2) };
+  for (const mem::TLBGeometry &geometry : geometries) {
+    TLB tlb(geometry);
+    const int kPages = 6;
+    auto pte = [](int asid, int page) -> PageTableEntry {
+      return ((0x10000 + asid * 0x100 + page) << kPageSizeBits) | kPTE_PresentMask;
+    };
+    
+    // Same virtual pages cached for two address spaces
+    for (int page = 0; page < kPages; ++page) {
+      tlb.Cache(page << kPageSizeBits, pte(1, page), 1);
+      tlb.Cache(page << kPageSizeBits, pte(2, page), 2);
+    }
+    for (int page = 0; page < kPages; ++page) {
+      EXPECT_EQ(pte(1, page), tlb.Lookup(page << kPageSizeBits, 1));
+      EXPECT_EQ(pte(2, page), tlb.Lookup(page << kPageSizeBits, 2));
+      EXPECT_EQ(0, tlb.Lookup(page << kPageSizeBits, 3));
+    }
+    
+    // Flush one page in one address space
+    tlb.FlushPage(2 << kPageSizeBits, 1);
+    EXPECT_EQ(0, tlb.Lookup(2 << kPageSizeBits, 1));
+    EXPECT_EQ(pte(2, 2), tlb.Lookup(2 << kPageSizeBits, 2));
+    
+    // Flush one address space
+    tlb.FlushASID(2);
+    for (int page = 0; page < kPages; ++page) {
+      EXPECT_EQ(0, tlb.Lookup(page << kPageSizeBits, 2));
+      if (page != 2) {
+        EXPECT_EQ(pte(1, page), tlb.Lookup(page << kPageSizeBits, 1));
+      }
+    }
+    
+    // Flushed entries are reusable
+    for (int page = 0; page < kPages; ++page) {
+      tlb.Cache(page << kPageSizeBits, pte(3, page), 3);
+    }
+    for (int page = 0; page < kPages; ++page) {
+      EXPECT_EQ(pte(3, page), tlb.Lookup(page << kPageSizeBits, 3));
+    }
+    TLB::TLBStats stats;
+    tlb.get_stats(stats);
+    EXPECT_EQ(kPages * 2, stats.total_max_size);
+  }
+}
+
+TEST_F(TLBTests, LargePageTest) {
+  vector<mem::TLBGeometry> geometries = 
+      { mem::TLBGeometry(1, 8), mem::TLBGeometry(4, 2, 2) };
+  for (const mem::TLBGeometry &geometry : geometries) {
+    TLB tlb(geometry);
+    const PageTableEntry kLargeEntry = 
+        kLargePageSize | kPTE_PresentMask | kPTE_LargePageMask;
+    const PageTableEntry kSmallEntry = 0x12345000 | kPTE_PresentMask;
+    const Addr kLargeVAddr = 0x5 * kLargePageSize;
+    const Addr kSmallVAddr = 0x6 * kLargePageSize;
+    
+    // Large page entry covers every page in the large page
+    tlb.Cache(kLargeVAddr + 0x3000, kLargeEntry, 1);
+    tlb.Cache(kSmallVAddr, kSmallEntry, 1);
+    for (Addr offset = 0; offset < kLargePageSize; offset += 0x1F000) {
+      EXPECT_EQ(kLargeEntry, tlb.Lookup(kLargeVAddr + offset, 1));
+    }
+    EXPECT_EQ(0, tlb.Lookup(kLargeVAddr, 2));
+    EXPECT_EQ(0, tlb.Lookup(kLargeVAddr + kLargePageSize + kLargePageSize, 1));
+    
+    // A small page at the start of a large region does not cover the region
+    EXPECT_EQ(kSmallEntry, tlb.Lookup(kSmallVAddr, 1));
+    EXPECT_EQ(0, tlb.Lookup(kSmallVAddr + kPageSize, 1));
+    
+    // Flushing any page in the large page removes it
+    tlb.FlushPage(kLargeVAddr + 0x234567, 1);
+    EXPECT_EQ(0, tlb.Lookup(kLargeVAddr, 1));
+    EXPECT_EQ(kSmallEntry, tlb.Lookup(kSmallVAddr, 1));
+    
+    TLB::TLBStats stats;
+    tlb.get_stats(stats);
+    EXPECT_EQ(stats.total_hits + stats.total_misses, 
+              stats.total_l2_hits + stats.total_l2_misses + stats.total_l1_hits);
+  }
+}
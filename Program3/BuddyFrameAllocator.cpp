@@ -0,0 +1,261 @@
+/*  BuddyFrameAllocator - allocate page frames with a binary buddy system
+ *
+ * File:   BuddyFrameAllocator.cpp
+ * Author: agent <agent@local>
+ *
+ * Created on October 18, 2026
+ */
+
+#include "BuddyFrameAllocator.h"
+
+#include <algorithm>
+#include <sstream>
+
+using mem::Addr;
+using mem::kPageSizeBits;
+
+const Addr BuddyFrameAllocator::kNone;
+const uint8_t BuddyFrameAllocator::kNotFree;
+
+BuddyFrameAllocator::BuddyFrameAllocator(mem::MMUInterface &mmu, 
+                                         bool memory_is_zero)
+: FrameAllocatorBase(mmu, 0, memory_is_zero),
+  page_frames_total(memory.get_frame_count()),
+  page_frames_free(0),
+  node_frames_free(memory.get_node_count(), 0),
+  local_frames_allocated(0),
+  remote_frames_allocated(0),
+  next_block(page_frames_total, kNone),
+  prev_block(page_frames_total, kNone),
+  block_order(page_frames_total, kNotFree)
+{
+  // Largest order is the largest block which fits in memory
+  uint32_t max_order = 0;
+  while ((Addr(2) << max_order) <= page_frames_total) {
+    ++max_order;
+  }
+  free_heads.assign(memory.get_node_count(),
+                    std::vector<Addr>(max_order + 1, kNone));
+  free_blocks.assign(max_order + 1, 0);
+
+  // Add the largest aligned blocks which fit in each node, lowest frames 
+  // first
+  for (size_t node = 0; node < memory.get_node_count(); ++node) {
+    Addr frame_number = memory.get_node_base(node) >> kPageSizeBits;
+    Addr node_end = frame_number + memory.get_node_frame_count(node);
+    while (frame_number < node_end) {
+      uint32_t order = max_order;
+      while ((frame_number & ((Addr(1) << order) - 1)) != 0
+             || frame_number + (Addr(1) << order) > node_end) {
+        --order;
+      }
+      PushBlock(frame_number, order);
+      frame_number += Addr(1) << order;
+    }
+    node_frames_free[node] = memory.get_node_frame_count(node);
+  }
+  page_frames_free = page_frames_total;
+}
+
+bool BuddyFrameAllocator::AllocateRuns(Addr count,
+                                       std::vector<FrameRun> &runs) {
+  if (count > page_frames_free) {
+    return false;  // do nothing and return error
+  }
+
+  // Take as many frames as possible from the current node, then from the 
+  // following nodes in turn
+  size_t first_run = runs.size();
+  size_t node = memory.get_current_node();
+  for (size_t i = 0; count > 0; ++i) {
+    Addr node_count = std::min(count, node_frames_free[node]);
+    if (node_count > 0) {
+      AllocateNodeRuns(node, node_count, runs, first_run);
+      count -= node_count;
+      if (i == 0) {
+        local_frames_allocated += node_count;
+      } else {
+        remote_frames_allocated += node_count;
+      }
+    }
+    node = (node + 1) % node_frames_free.size();
+  }
+  
+  for (size_t i = first_run; i < runs.size(); ++i) {
+    PrepareRun(runs[i]);
+  }
+  return true;
+}
+
+void BuddyFrameAllocator::AllocateNodeRuns(size_t node, Addr count,
+                                           std::vector<FrameRun> &runs,
+                                           size_t first_run) {
+  std::vector<Addr> &heads = free_heads[node];
+  while (count > 0) {
+    // Largest order which fits in the count
+    uint32_t order = 0;
+    while (order + 1 < heads.size() && (Addr(2) << order) <= count) {
+      ++order;
+    }
+    
+    // Take the largest free block no larger than that, or else split a 
+    // larger block
+    uint32_t block_order = order;
+    while (block_order > 0 && heads[block_order] == kNone) {
+      --block_order;
+    }
+    Addr frame_number;
+    if (heads[block_order] != kNone) {
+      frame_number = heads[block_order];
+      RemoveBlock(frame_number);
+      page_frames_free -= Addr(1) << block_order;
+      node_frames_free[node] -= Addr(1) << block_order;
+    } else {
+      block_order = order;
+      frame_number = TakeBlock(node, order);
+    }
+    
+    // Extend the last run if the block follows it
+    Addr frame = frame_number << kPageSizeBits;
+    Addr block_size = Addr(1) << block_order;
+    if (runs.size() > first_run 
+        && runs.back().frame + (runs.back().count << kPageSizeBits) == frame) {
+      runs.back().count += block_size;
+    } else {
+      runs.push_back(FrameRun{ frame, block_size });
+    }
+    count -= block_size;
+  }
+}
+
+bool BuddyFrameAllocator::AllocateContiguous(Addr count,
+                                             std::vector<Addr> &page_frames) {
+  if (count == 0 || (count & (count - 1)) != 0 || count > page_frames_free) {
+    return false;
+  }
+
+  uint32_t order = 0;
+  while ((Addr(1) << order) < count) {
+    ++order;
+  }
+  
+  // Take the block from the current node if possible
+  size_t node = memory.get_current_node();
+  Addr run_start = kNone;
+  for (size_t i = 0; i < free_heads.size() && run_start == kNone; ++i) {
+    run_start = TakeBlock(node, order);
+    if (run_start != kNone) {
+      if (i == 0) {
+        local_frames_allocated += count;
+      } else {
+        remote_frames_allocated += count;
+      }
+    }
+    node = (node + 1) % free_heads.size();
+  }
+  if (run_start == kNone) {
+    return false;  // do nothing and return error
+  }
+
+  PrepareRun(FrameRun{ run_start << kPageSizeBits, count });
+  for (Addr frame_number = run_start; frame_number < run_start + count;
+       ++frame_number) {
+    page_frames.push_back(frame_number << kPageSizeBits);
+  }
+  return true;
+}
+
+std::string BuddyFrameAllocator::FreeListToString(void) const {
+  std::vector<Addr> free_frames;
+  free_frames.reserve(page_frames_free);
+  for (const std::vector<Addr> &heads : free_heads) {
+    for (uint32_t order = 0; order < heads.size(); ++order) {
+      for (Addr block = heads[order]; block != kNone;
+           block = next_block[block]) {
+        for (Addr i = 0; i < (Addr(1) << order); ++i) {
+          free_frames.push_back((block + i) << kPageSizeBits);
+        }
+      }
+    }
+  }
+  std::sort(free_frames.begin(), free_frames.end());
+
+  std::ostringstream out_string;
+  for (Addr frame : free_frames) {
+    out_string << " " << std::hex << frame;
+  }
+  return out_string.str();
+}
+
+void BuddyFrameAllocator::FreeFrame(Addr frame) {
+  Addr frame_number = frame >> kPageSizeBits;
+  size_t node = NodeOf(frame_number);
+
+  // Merge with buddy while the buddy is a free block of the same size in the
+  // same node
+  uint32_t order = 0;
+  while (order + 1 < free_blocks.size()) {
+    Addr buddy = frame_number ^ (Addr(1) << order);
+    if (buddy >= page_frames_total || block_order[buddy] != order
+        || NodeOf(buddy) != node) {
+      break;
+    }
+    RemoveBlock(buddy);
+    frame_number = std::min(frame_number, buddy);
+    ++order;
+  }
+  PushBlock(frame_number, order);
+  ++page_frames_free;
+  ++node_frames_free[node];
+}
+
+void BuddyFrameAllocator::PushBlock(Addr frame_number, uint32_t order) {
+  Addr &head = free_heads[NodeOf(frame_number)][order];
+  next_block[frame_number] = head;
+  prev_block[frame_number] = kNone;
+  if (head != kNone) {
+    prev_block[head] = frame_number;
+  }
+  head = frame_number;
+  block_order[frame_number] = order;
+  ++free_blocks[order];
+}
+
+void BuddyFrameAllocator::RemoveBlock(Addr frame_number) {
+  uint32_t order = block_order[frame_number];
+  Addr next = next_block[frame_number];
+  Addr prev = prev_block[frame_number];
+  if (prev == kNone) {
+    free_heads[NodeOf(frame_number)][order] = next;
+  } else {
+    next_block[prev] = next;
+  }
+  if (next != kNone) {
+    prev_block[next] = prev;
+  }
+  block_order[frame_number] = kNotFree;
+  --free_blocks[order];
+}
+
+Addr BuddyFrameAllocator::TakeBlock(size_t node, uint32_t order) {
+  // Find smallest free block which is large enough
+  std::vector<Addr> &heads = free_heads[node];
+  uint32_t block_size = order;
+  while (block_size < heads.size() && heads[block_size] == kNone) {
+    ++block_size;
+  }
+  if (block_size >= heads.size()) {
+    return kNone;
+  }
+
+  // Split block, keeping the lower half and freeing the upper half
+  Addr frame_number = heads[block_size];
+  RemoveBlock(frame_number);
+  while (block_size > order) {
+    --block_size;
+    PushBlock(frame_number + (Addr(1) << block_size), block_size);
+  }
+  page_frames_free -= Addr(1) << order;
+  node_frames_free[node] -= Addr(1) << order;
+  return frame_number;
+}
@@ -0,0 +1,184 @@
+/*  BuddyFrameAllocator - allocate page frames with a binary buddy system
+ *
+ * Free page frames are kept in blocks of 2^order frames, each starting at a
+ * frame number which is a multiple of its size. Allocating splits a larger
+ * block as needed, and freeing a frame merges it with its free buddy blocks,
+ * so a contiguous run of frames is found in O(log n) time without searching.
+ *
+ * The free lists are kept in host memory rather than in the free frames, so
+ * the MMU is only accessed to clear frames, and clean frames are allocated
+ * without accessing it.
+ *
+ * If the MMU's physical memory has several nodes, each node has its own
+ * free lists, and blocks never span nodes. Frames are allocated from the
+ * MMU's current node if possible, falling back to the other nodes in turn.
+ *
+ * File:   BuddyFrameAllocator.h
+ * Author: agent <agent@local>
+ *
+ * Created on October 18, 2026
+ */
+
+#ifndef BUDDYFRAMEALLOCATOR_H
+#define BUDDYFRAMEALLOCATOR_H
+
+#include "FrameAllocator.h"
+
+#include <MMU.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class BuddyFrameAllocator : public FrameAllocatorBase {
+public:
+  /**
+   * Constructor
+   *
+   * Adds all page frames to the free lists, as the largest possible blocks.
+   *
+   * @param mmu memory containing the page frames
+   * @param memory_is_zero true if all page frames hold 0 (see FrameAllocator)
+   */
+  BuddyFrameAllocator(mem::MMUInterface &mmu, bool memory_is_zero = true);
+
+  virtual ~BuddyFrameAllocator() {}
+
+  /**
+   * AllocateRuns - allocate page frames (see FrameAllocator), taking the 
+   *   largest free blocks which fit in the count, so that few runs are 
+   *   needed. A block is only split for the last part of the count. Frames
+   *   are taken from the current node first.
+   */
+  bool AllocateRuns(mem::Addr count, std::vector<FrameRun> &runs) override;
+
+  /**
+   * AllocateContiguous - allocate a run of consecutive page frames (see
+   *   FrameAllocator). The run is a single block of the free lists, from
+   *   the current node if it has one.
+   */
+  bool AllocateContiguous(mem::Addr count,
+                          std::vector<mem::Addr> &page_frames) override;
+
+  // Access to private values
+  mem::Addr get_page_frames_free(void) const override { return page_frames_free; }
+
+  /**
+   * FreeListToString - get string representation of free frames
+   *
+   * @return hex addresses of all free page frames, in ascending order
+   */
+  std::string FreeListToString(void) const override;
+
+  /**
+   * get_free_blocks - get number of free blocks of a given size
+   *
+   * @param order blocks of 2^order frames
+   * @return number of free blocks
+   */
+  mem::Addr get_free_blocks(uint32_t order) const {
+    return order < free_blocks.size() ? free_blocks[order] : 0;
+  }
+
+  /**
+   * get_node_frames_free - get number of free page frames in a node
+   *
+   * @param node memory node number
+   * @return number of free frames
+   */
+  mem::Addr get_node_frames_free(size_t node) const {
+    return node_frames_free.at(node);
+  }
+
+  // Number of frames allocated from the current node, and from other nodes
+  // because the current node had too few free frames
+  uint64_t get_local_frames_allocated(void) const { return local_frames_allocated; }
+  uint64_t get_remote_frames_allocated(void) const { return remote_frames_allocated; }
+
+protected:
+  /**
+   * FreeFrame - return page frame to the free lists, merging it with free
+   *   buddy blocks
+   *
+   * @param frame address of page frame
+   */
+  void FreeFrame(mem::Addr frame) override;
+
+private:
+  // Marks end of a free list, and frames which do not start a free block
+  static const mem::Addr kNone = 0xFFFFFFFF;
+  static const uint8_t kNotFree = 0xFF;
+
+  // Total number of page frames, and current number of free page frames
+  mem::Addr page_frames_total;
+  mem::Addr page_frames_free;
+
+  // For each node and order, first frame number of each free block of that
+  // order (doubly linked through next_block and prev_block). Number of
+  // blocks of each order in all nodes.
+  std::vector<std::vector<mem::Addr>> free_heads;
+  std::vector<mem::Addr> free_blocks;
+
+  // For each node, number of free page frames
+  std::vector<mem::Addr> node_frames_free;
+
+  uint64_t local_frames_allocated;
+  uint64_t remote_frames_allocated;
+
+  // Indexed by frame number. Only valid for the first frame of a free block.
+  std::vector<mem::Addr> next_block;
+  std::vector<mem::Addr> prev_block;
+
+  // Indexed by frame number. Order of free block starting at the frame, or
+  // kNotFree.
+  std::vector<uint8_t> block_order;
+
+  /**
+   * NodeOf - get memory node holding a frame
+   *
+   * @param frame_number frame number
+   * @return node number
+   */
+  size_t NodeOf(mem::Addr frame_number) const {
+    return memory.get_node(frame_number << mem::kPageSizeBits);
+  }
+
+  /**
+   * PushBlock - add a block to the free list for its node and order
+   *
+   * @param frame_number first frame number of block
+   * @param order block contains 2^order frames
+   */
+  void PushBlock(mem::Addr frame_number, uint32_t order);
+
+  /**
+   * RemoveBlock - remove a block from the free list for its node and order
+   *
+   * @param frame_number first frame number of a free block
+   */
+  void RemoveBlock(mem::Addr frame_number);
+
+  /**
+   * TakeBlock - remove a free block of a given order from a node, splitting
+   *   a larger block if needed
+   *
+   * @param node memory node number
+   * @param order block contains 2^order frames
+   * @return first frame number of block, or kNone if no block is large enough
+   */
+  mem::Addr TakeBlock(size_t node, uint32_t order);
+
+  /**
+   * AllocateNodeRuns - allocate page frames from one node as runs (see 
+   *   AllocateRuns), without clearing them
+   *
+   * @param node memory node number
+   * @param count number of page frames (must be no more than free in node)
+   * @param runs runs allocated are pushed on back
+   * @param first_run index in runs of first run of the current allocation
+   */
+  void AllocateNodeRuns(size_t node, mem::Addr count,
+                        std::vector<FrameRun> &runs, size_t first_run);
+};
+
+#endif /* BUDDYFRAMEALLOCATOR_H */
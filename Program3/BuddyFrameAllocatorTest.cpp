@@ -0,0 +1,137 @@
+/*
+ * File:   BuddyFrameAllocatorTest
+ * Author: agent <agent@local>
+ *
+ * Created on October 18, 2026
+ */
+
+#include <gtest/gtest.h>
+
+#include "BuddyFrameAllocator.h"
+
+#include <MMU.h>
+
+#include <vector>
+
+using mem::Addr;
+using mem::kPageSize;
+using std::vector;
+
+class BuddyFrameAllocatorTest : public testing::Test {
+protected:
+
+  void SetUp() {
+    // Setup ...
+  }
+
+  void TearDown() {
+    // Teardown ...
+  }
+
+};
+
+TEST_F(BuddyFrameAllocatorTest, SplitCoalesce) {
+  // Frames are added as the largest aligned blocks
+  const Addr kNFrames = 12;
+  mem::MMU memory(kNFrames);
+  BuddyFrameAllocator allocator(memory);
+  ASSERT_EQ(kNFrames, allocator.get_page_frames_free());
+  ASSERT_EQ(1, allocator.get_free_blocks(3));
+  ASSERT_EQ(1, allocator.get_free_blocks(2));
+  ASSERT_EQ(0, allocator.get_free_blocks(0));
+
+  // A single frame is taken from the smallest block
+  vector<Addr> frame1;
+  ASSERT_TRUE(allocator.Allocate(1, frame1));
+  ASSERT_EQ(8 * kPageSize, frame1[0]);
+  ASSERT_EQ(0, allocator.get_free_blocks(2));
+  ASSERT_EQ(1, allocator.get_free_blocks(1));
+  ASSERT_EQ(1, allocator.get_free_blocks(0));
+
+  // With no small block free, the 8 frame block is split
+  vector<Addr> frames3;
+  ASSERT_TRUE(allocator.Allocate(3, frames3));
+  vector<Addr> frame2;
+  ASSERT_TRUE(allocator.Allocate(1, frame2));
+  ASSERT_EQ(0, allocator.get_free_blocks(3));
+  ASSERT_EQ(1, allocator.get_free_blocks(2));
+  ASSERT_EQ(1, allocator.get_free_blocks(1));
+  ASSERT_EQ(1, allocator.get_free_blocks(0));
+  ASSERT_EQ(kNFrames - 5, allocator.get_page_frames_free());
+
+  // Freeing merges buddies back into the original blocks
+  ASSERT_TRUE(allocator.Deallocate(1, frame2));
+  ASSERT_EQ(1, allocator.get_free_blocks(3));
+  ASSERT_TRUE(allocator.Deallocate(3, frames3));
+  ASSERT_EQ(0, allocator.get_free_blocks(2));
+  ASSERT_TRUE(allocator.Deallocate(1, frame1));
+  ASSERT_EQ(1, allocator.get_free_blocks(3));
+  ASSERT_EQ(1, allocator.get_free_blocks(2));
+  ASSERT_EQ(0, allocator.get_free_blocks(1));
+  ASSERT_EQ(0, allocator.get_free_blocks(0));
+  ASSERT_EQ(kNFrames, allocator.get_page_frames_free());
+}
+
+TEST_F(BuddyFrameAllocatorTest, Contiguous) {
+  const Addr kNFrames = 16;
+  mem::MMU memory(kNFrames);
+  BuddyFrameAllocator allocator(memory);
+
+  // Contiguous runs are aligned to their size
+  vector<Addr> frame;
+  ASSERT_TRUE(allocator.Allocate(1, frame));
+  vector<Addr> run;
+  ASSERT_TRUE(allocator.AllocateContiguous(4, run));
+  ASSERT_EQ(4, run.size());
+  ASSERT_EQ(0, (run[0] / kPageSize) % 4);
+  for (Addr i = 1; i < run.size(); ++i) {
+    ASSERT_EQ(run[0] + i * kPageSize, run[i]);
+  }
+
+  // Memory is only contiguous again once every frame has been merged
+  vector<Addr> all;
+  ASSERT_FALSE(allocator.AllocateContiguous(kNFrames, all));
+  ASSERT_TRUE(all.empty());
+  ASSERT_TRUE(allocator.Deallocate(1, frame));
+  ASSERT_FALSE(allocator.AllocateContiguous(kNFrames, all));
+  ASSERT_TRUE(allocator.Deallocate(run.size(), run));
+  ASSERT_TRUE(allocator.AllocateContiguous(kNFrames, all));
+  ASSERT_EQ(0, all[0]);
+  ASSERT_EQ(0, allocator.get_page_frames_free());
+}
+
+TEST_F(BuddyFrameAllocatorTest, NodeFallback) {
+  const Addr kNodeFrames = 8;
+  mem::MMU memory(vector<mem::MemoryNode>{ { kNodeFrames, 1, 4 },
+                                           { kNodeFrames, 1, 4 } });
+  BuddyFrameAllocator allocator(memory);
+
+  // Blocks never span nodes
+  ASSERT_EQ(2, allocator.get_free_blocks(3));
+  ASSERT_EQ(0, allocator.get_free_blocks(4));
+
+  // Frames come from the current node while it has any free
+  memory.set_current_node(1);
+  vector<Addr> frames;
+  ASSERT_TRUE(allocator.Allocate(6, frames));
+  for (Addr frame : frames) {
+    ASSERT_EQ(1, memory.get_node(frame));
+  }
+  ASSERT_EQ(6, allocator.get_local_frames_allocated());
+  ASSERT_EQ(0, allocator.get_remote_frames_allocated());
+  ASSERT_EQ(kNodeFrames - 6, allocator.get_node_frames_free(1));
+
+  // Then from the other node
+  ASSERT_TRUE(allocator.Allocate(4, frames));
+  ASSERT_EQ(8, allocator.get_local_frames_allocated());
+  ASSERT_EQ(2, allocator.get_remote_frames_allocated());
+  ASSERT_EQ(0, allocator.get_node_frames_free(1));
+  ASSERT_EQ(kNodeFrames - 2, allocator.get_node_frames_free(0));
+  ASSERT_EQ(0, memory.get_node(frames.back()));
+
+  // Freed frames return to their own node
+  ASSERT_TRUE(allocator.Deallocate(frames.size(), frames));
+  ASSERT_EQ(kNodeFrames, allocator.get_node_frames_free(0));
+  ASSERT_EQ(kNodeFrames, allocator.get_node_frames_free(1));
+  ASSERT_EQ(2, allocator.get_free_blocks(3));
+}
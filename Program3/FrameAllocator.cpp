@@ -0,0 +1,166 @@
+/*  FrameAllocator - interface to page frame allocators
+ * 
+ * File:   FrameAllocator.cpp
+ * Author: agent <agent@local>
+ *
+ * Created on October 18, 2026
+ */
+
+#include "FrameAllocator.h"
+
+#include <algorithm>
+
+using mem::Addr;
+using mem::kPageSize;
+using mem::kPageSizeBits;
+
+FrameAllocatorBase::FrameAllocatorBase(mem::MMUInterface &mmu, 
+                                       Addr free_frame_header_, 
+                                       bool memory_is_zero)
+: memory(mmu),
+  reference_counts(mmu.get_frame_count(), 0),
+  free_frame_header(free_frame_header_),
+  dirty(mmu.get_frame_count(), !memory_is_zero),
+  in_dirty_free_frames(mmu.get_frame_count(), false),
+  clean_frames_free(memory_is_zero ? mmu.get_frame_count() : 0),
+  zeroing_avoided(0),
+  frames_zeroed(0),
+  frames_prezeroed(0)
+{
+  if (!memory_is_zero) {
+    for (Addr frame_number = 0; frame_number < dirty.size(); ++frame_number) {
+      dirty_free_frames.push_back(frame_number);
+      in_dirty_free_frames[frame_number] = true;
+    }
+  }
+}
+
+bool FrameAllocatorBase::Allocate(Addr count, std::vector<Addr> &page_frames) {
+  allocated_runs.clear();
+  if (!AllocateRuns(count, allocated_runs)) {
+    return false;
+  }
+  for (const FrameRun &run : allocated_runs) {
+    for (Addr i = 0; i < run.count; ++i) {
+      page_frames.push_back(run.frame + i * kPageSize);
+    }
+  }
+  return true;
+}
+
+bool FrameAllocatorBase::Deallocate(Addr count, std::vector<Addr> &page_frames) {
+  // If enough to deallocate
+  if (count <= page_frames.size()) {
+    released_frames.clear();
+    for (auto it = page_frames.end() - count; it != page_frames.end(); ++it) {
+      released_frames.push_back(*it >> kPageSizeBits);
+    }
+    if (!ReleaseFrames()) {
+      return false;  // a frame was not allocated
+    }
+    page_frames.resize(page_frames.size() - count);
+    return true;
+  } else {
+    return false; // do nothing and return error
+  }
+}
+
+bool FrameAllocatorBase::DeallocateRuns(const std::vector<FrameRun> &runs) {
+  released_frames.clear();
+  for (const FrameRun &run : runs) {
+    Addr frame_number = run.frame >> kPageSizeBits;
+    for (Addr i = 0; i < run.count; ++i) {
+      released_frames.push_back(frame_number + i);
+    }
+  }
+  return ReleaseFrames();
+}
+
+Addr FrameAllocatorBase::ZeroFreeFrames(Addr max_count) {
+  Addr cleared = 0;
+  while (cleared < max_count && !dirty_free_frames.empty()) {
+    Addr frame_number = dirty_free_frames.back();
+    dirty_free_frames.pop_back();
+    in_dirty_free_frames[frame_number] = false;
+    if (reference_counts[frame_number] != 0) {
+      continue;  // allocated (and cleared) since it was freed
+    }
+    
+    memory.fill_bytes((frame_number << kPageSizeBits) + free_frame_header,
+                      kPageSize - free_frame_header, 0);
+    dirty[frame_number] = false;
+    ++clean_frames_free;
+    ++frames_prezeroed;
+    ++cleared;
+  }
+  return cleared;
+}
+
+void FrameAllocatorBase::PrepareRun(const FrameRun &run) {
+  Addr first = run.frame >> kPageSizeBits;
+  Addr end = first + run.count;
+  Addr frame_number = first;
+  while (frame_number < end) {
+    if (dirty[frame_number]) {
+      // Clear consecutive dirty frames together
+      Addr dirty_end = frame_number + 1;
+      while (dirty_end < end && dirty[dirty_end]) {
+        ++dirty_end;
+      }
+      memory.fill_bytes(frame_number << kPageSizeBits, 
+                        (dirty_end - frame_number) * kPageSize, 0);
+      frames_zeroed += dirty_end - frame_number;
+      frame_number = dirty_end;
+    } else {
+      // Only the allocator's header needs clearing
+      if (free_frame_header > 0) {
+        memory.fill_bytes(frame_number << kPageSizeBits, free_frame_header, 0);
+      }
+      --clean_frames_free;
+      ++zeroing_avoided;
+      ++frame_number;
+    }
+  }
+  std::fill(dirty.begin() + first, dirty.begin() + end, true);
+  std::fill(reference_counts.begin() + first, reference_counts.begin() + end, 1);
+}
+
+bool FrameAllocatorBase::ReleaseFrames() {
+  // Check that each frame has a reference to release (a frame may be
+  // listed more than once), then undo the check
+  size_t checked = 0;
+  while (checked < released_frames.size()) {
+    Addr frame_number = released_frames[checked];
+    if (frame_number >= reference_counts.size() 
+            || reference_counts[frame_number] == 0) {
+      break;
+    }
+    --reference_counts[frame_number];
+    ++checked;
+  }
+  bool valid = (checked == released_frames.size());
+  while (checked-- > 0) {
+    ++reference_counts[released_frames[checked]];
+  }
+  if (!valid) {
+    return false;
+  }
+  
+  for (Addr frame_number : released_frames) {
+    ReleaseFrame(frame_number);
+  }
+  return true;
+}
+
+void FrameAllocatorBase::ReleaseFrame(Addr frame_number) {
+  // Free frame, unless it is still shared
+  if (--reference_counts[frame_number] == 0) {
+    FreeFrame(frame_number << kPageSizeBits);
+    
+    // Frame may have been written while allocated
+    if (!in_dirty_free_frames[frame_number]) {
+      dirty_free_frames.push_back(frame_number);
+      in_dirty_free_frames[frame_number] = true;
+    }
+  }
+}
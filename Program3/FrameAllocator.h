@@ -0,0 +1,274 @@
+/*  FrameAllocator - interface to page frame allocators
+ * 
+ * Allocators keep a reference count for each allocated page frame, so that
+ * frames may be shared (e.g. copy-on-write). A frame is returned to the
+ * free frames when its last reference is deallocated.
+ * 
+ * Allocated frames must be cleared to 0. A free frame is clean if it is 
+ * known to hold all 0 (apart from any header the allocator keeps in free 
+ * frames), and dirty otherwise. Frames never written since boot are clean,
+ * so are allocated without clearing them. Dirty free frames may be cleared 
+ * ahead of time with ZeroFreeFrames, e.g. while the system is idle.
+ * 
+ * FrameAllocator is the interface used by processes. FrameAllocatorBase 
+ * implements the reference counts and zeroing for allocators which manage
+ * the page frames of an MMU themselves; it must be used in physical mode.
+ *
+ * File:   FrameAllocator.h
+ * Author: agent <agent@local>
+ *
+ * Created on October 18, 2026
+ */
+
+#ifndef FRAMEALLOCATOR_H
+#define FRAMEALLOCATOR_H
+
+#include <MMU.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Run of consecutive page frames
+struct FrameRun {
+  mem::Addr frame;  // address of first page frame
+  mem::Addr count;  // number of page frames
+};
+
+// Numbers of page frames cleared, and allocated without clearing
+struct ZeroingStats {
+  uint64_t zeroing_avoided;   // frames allocated clean, without clearing
+  uint64_t frames_zeroed;     // frames cleared when allocated
+  uint64_t frames_prezeroed;  // free frames cleared ahead of time
+};
+
+class FrameAllocator {
+public:
+  FrameAllocator() {}
+  virtual ~FrameAllocator() {}
+  
+  // Disallow copy/move
+  FrameAllocator(const FrameAllocator &other) = delete;
+  FrameAllocator(FrameAllocator &&other) = delete;
+  FrameAllocator &operator=(const FrameAllocator &other) = delete;
+  FrameAllocator &operator=(FrameAllocator &&other) = delete;
+  
+  /**
+   * Allocate - allocate page frames.  Allocated pages are cleared to all 0.
+   * 
+   * @param count number of page frames to allocate
+   * @param page_frames page frame addresses allocated are pushed on back
+   * @return true if success, false if insufficient page frames (no frames allocated)
+   */
+  virtual bool Allocate(mem::Addr count, std::vector<mem::Addr> &page_frames) = 0;
+  
+  /**
+   * AllocateRuns - allocate page frames as runs of consecutive frames, 
+   *   using as few runs as the free frames allow.  Allocated pages are 
+   *   cleared to all 0, with one write for each run of dirty frames.
+   * 
+   * @param count number of page frames to allocate
+   * @param runs runs allocated are pushed on back (the caller may reuse the
+   *   vector, so that no memory is allocated once it has grown)
+   * @return true if success, false if insufficient page frames (no frames allocated)
+   */
+  virtual bool AllocateRuns(mem::Addr count, std::vector<FrameRun> &runs) = 0;
+  
+  /**
+   * AllocateContiguous - allocate a run of consecutive page frames, starting
+   *   at a frame number which is a multiple of count (e.g. 1024 frames for a 
+   *   large page).  Allocated pages are cleared to all 0.
+   * 
+   * @param count number of page frames to allocate (must be a power of 2)
+   * @param page_frames page frame addresses allocated are pushed on back, in
+   *   ascending order
+   * @return true if success, false if no suitable run of free page frames
+   *   (no frames allocated)
+   */
+  virtual bool AllocateContiguous(mem::Addr count, 
+                                  std::vector<mem::Addr> &page_frames) = 0;
+  
+  /**
+   * Deallocate - release one reference to each page frame, returning frames
+   *   with no remaining references to the free frames
+   * 
+   * @param count number of page frames to free
+   * @param page_frames contains page frame addresses to deallocate; numbers are
+   *   popped from back of vector
+   * @return true if success, false if insufficient page frames in vector or
+   *   a page frame is not allocated (no frames deallocated)
+   */
+  virtual bool Deallocate(mem::Addr count, std::vector<mem::Addr> &page_frames) = 0;
+  
+  /**
+   * DeallocateRuns - release one reference to each page frame in runs of
+   *   frames (see Deallocate)
+   * 
+   * @param runs runs of page frames to deallocate
+   * @return true if success, false if a page frame is not allocated (no 
+   *   frames deallocated)
+   */
+  virtual bool DeallocateRuns(const std::vector<FrameRun> &runs) = 0;
+  
+  /**
+   * AddReference - add a reference to an allocated page frame, so that it is
+   *   shared (e.g. copy-on-write) until each reference has been deallocated
+   * 
+   * @param frame address of allocated page frame
+   */
+  virtual void AddReference(mem::Addr frame) = 0;
+  
+  /**
+   * get_reference_count - get number of references to a page frame
+   * 
+   * @param frame address of page frame
+   * @return number of references (0 if frame is free)
+   */
+  virtual uint32_t get_reference_count(mem::Addr frame) const = 0;
+  
+  /**
+   * ZeroFreeFrames - clear dirty free frames, so that they can be allocated
+   *   without clearing them. Most recently freed frames are cleared first.
+   * 
+   * @param max_count maximum number of frames to clear
+   * @return number of frames cleared
+   */
+  virtual mem::Addr ZeroFreeFrames(mem::Addr max_count) = 0;
+  
+  /**
+   * get_zeroing_stats - get numbers of page frames cleared since the 
+   *   allocator was created, and of frames allocated without clearing
+   * 
+   * @return zeroing statistics
+   */
+  virtual ZeroingStats get_zeroing_stats(void) const = 0;
+  
+  /**
+   * get_page_frames_free - get number of free page frames
+   * 
+   * @return number of free frames
+   */
+  virtual mem::Addr get_page_frames_free(void) const = 0;
+  
+  /**
+   * FreeListToString - get string representation of free frames
+   * 
+   * @return hex addresses of all free page frames
+   */
+  virtual std::string FreeListToString(void) const = 0;
+};
+
+class FrameAllocatorBase : public FrameAllocator {
+public:
+  /**
+   * Constructor
+   * 
+   * @param mmu memory containing the page frames
+   * @param free_frame_header_ number of bytes at start of each free frame
+   *   used by the allocator (not cleared when a free frame is zeroed)
+   * @param memory_is_zero true if all page frames hold 0 (e.g. not restored 
+   *   from a snapshot or mapped file)
+   */
+  FrameAllocatorBase(mem::MMUInterface &mmu, mem::Addr free_frame_header_, 
+                     bool memory_is_zero);
+  
+  virtual ~FrameAllocatorBase() {}
+  
+  /**
+   * Allocate - allocate page frames (see FrameAllocator), as runs from 
+   *   AllocateRuns
+   */
+  bool Allocate(mem::Addr count, std::vector<mem::Addr> &page_frames) override;
+  
+  // Reference counting (see FrameAllocator)
+  bool Deallocate(mem::Addr count, std::vector<mem::Addr> &page_frames) override;
+  bool DeallocateRuns(const std::vector<FrameRun> &runs) override;
+  void AddReference(mem::Addr frame) override { 
+    ++reference_counts.at(frame >> mem::kPageSizeBits); 
+  }
+  uint32_t get_reference_count(mem::Addr frame) const override {
+    return reference_counts.at(frame >> mem::kPageSizeBits);
+  }
+  
+  mem::Addr ZeroFreeFrames(mem::Addr max_count) override;
+  ZeroingStats get_zeroing_stats(void) const override {
+    return ZeroingStats{ zeroing_avoided, frames_zeroed, frames_prezeroed };
+  }
+  
+  // Access to zeroing statistics
+  mem::Addr get_clean_frames_free(void) const { return clean_frames_free; }
+  uint64_t get_zeroing_avoided(void) const { return zeroing_avoided; }
+  uint64_t get_frames_zeroed(void) const { return frames_zeroed; }
+  uint64_t get_frames_prezeroed(void) const { return frames_prezeroed; }
+  
+protected:
+  /**
+   * FreeFrame - return a page frame with no remaining references to the 
+   *   free frames
+   * 
+   * @param frame address of page frame
+   */
+  virtual void FreeFrame(mem::Addr frame) = 0;
+  
+  /**
+   * PrepareRun - clear page frames being allocated to 0 (except frames 
+   *   which are clean) and set their reference counts to 1. Must be called 
+   *   for each frame allocated, after it is removed from the free frames.
+   * 
+   * @param run frames allocated
+   */
+  void PrepareRun(const FrameRun &run);
+  
+  mem::MMUInterface &memory;
+  
+  // Number of references to each page frame, indexed by frame number.
+  // Allocate sets the count of each frame allocated to 1.
+  std::vector<uint32_t> reference_counts;
+  
+private:
+  /**
+   * ReleaseFrames - release one reference to each page frame in
+   *   released_frames, unless one of them has no reference to release
+   * 
+   * @return true if success, false if a page frame is not allocated (no 
+   *   frames released)
+   */
+  bool ReleaseFrames();
+  
+  /**
+   * ReleaseFrame - release one reference to a page frame, freeing it if no
+   *   references remain
+   * 
+   * @param frame_number page frame number (must be allocated)
+   */
+  void ReleaseFrame(mem::Addr frame_number);
+  
+  // Number of bytes at start of each free frame used by the allocator
+  mem::Addr free_frame_header;
+  
+  // Runs allocated by Allocate, reused by each call
+  std::vector<FrameRun> allocated_runs;
+  
+  // Frame numbers being deallocated, reused by each call
+  std::vector<mem::Addr> released_frames;
+  
+  // Indexed by frame number. A frame is dirty from when it is allocated 
+  // until it is cleared after being freed.
+  std::vector<bool> dirty;
+  
+  // Dirty free frames, most recently freed at back, and whether each frame 
+  // is in the list. Frames which have since been allocated are skipped.
+  std::vector<mem::Addr> dirty_free_frames;
+  std::vector<bool> in_dirty_free_frames;
+  
+  // Number of clean free frames
+  mem::Addr clean_frames_free;
+  
+  // Frames allocated without clearing, cleared when allocated, and cleared
+  // by ZeroFreeFrames
+  uint64_t zeroing_avoided;
+  uint64_t frames_zeroed;
+  uint64_t frames_prezeroed;
+};
+
+#endif /* FRAMEALLOCATOR_H */
@@ -0,0 +1,356 @@
+/*  FrameMagazine - per-thread caches of page frames from a shared pool
+ *
+ * File:   FrameMagazine.cpp
+ * Author: agent <agent@local>
+ *
+ * Created on October 18, 2026
+ */
+
+#include "FrameMagazine.h"
+
+#include <algorithm>
+#include <sstream>
+
+using mem::Addr;
+using mem::kPageSize;
+
+SharedFramePool::PhysicalAccess::PhysicalAccess(const SharedFramePool &pool_)
+: pool(pool_), lock(pool_.mutex)
+{
+  pool.memory.get_PMCB(saved_pmcb);
+  if (saved_pmcb.vm_enable) {
+    pool.memory.set_PMCB(mem::PMCB());
+  }
+}
+
+SharedFramePool::PhysicalAccess::~PhysicalAccess() {
+  if (saved_pmcb.vm_enable) {
+    pool.memory.set_PMCB(saved_pmcb);
+  }
+}
+
+SharedFramePool::SharedFramePool(mem::MMUInterface &memory_, 
+                                 FrameAllocator &allocator_)
+: memory(memory_), allocator(allocator_), 
+  frame_count(memory_.get_frame_count()),
+  frame_owners(new std::atomic<uintptr_t>[frame_count]), lock_count(0),
+  frames_zeroed(0), frames_prezeroed(0),
+  frames_free(allocator_.get_page_frames_free())
+{
+  for (Addr i = 0; i < frame_count; ++i) {
+    frame_owners[i] = kNoOwner;
+  }
+}
+
+bool SharedFramePool::AllocateContiguous(Addr count,
+                                         std::vector<Addr> &page_frames) {
+  PhysicalAccess access(*this);
+  ++lock_count;
+  bool result = allocator.AllocateContiguous(count, page_frames);
+  frames_free = allocator.get_page_frames_free();
+  return result;
+}
+
+void SharedFramePool::AddReference(Addr frame) {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  ++lock_count;
+
+  // A shared frame can no longer be freed by the magazine which allocated it
+  uintptr_t owner = frame_owners[frame >> mem::kPageSizeBits];
+  if (owner != kNoOwner && (owner & kHeldBit) == 0) {
+    frame_owners[frame >> mem::kPageSizeBits].compare_exchange_strong(owner, 
+                                                                      kNoOwner);
+  }
+  allocator.AddReference(frame);
+}
+
+uint32_t SharedFramePool::get_reference_count(Addr frame) const {
+  if (frame_owners[frame >> mem::kPageSizeBits] != kNoOwner) {
+    return 1;
+  }
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  return allocator.get_reference_count(frame);
+}
+
+Addr SharedFramePool::ZeroFreeFrames(Addr max_count) {
+  PhysicalAccess access(*this);
+  ++lock_count;
+  return allocator.ZeroFreeFrames(max_count);
+}
+
+std::string SharedFramePool::FreeListToString(void) const {
+  PhysicalAccess access(*this);
+  return allocator.FreeListToString();
+}
+
+bool SharedFramePool::Refill(const FrameMagazine *magazine, 
+                             std::vector<Addr> &dirty,
+                             std::vector<Addr> &clear, Addr count, Addr extra) {
+  PhysicalAccess access(*this);
+  ++lock_count;
+
+  // Reuse the most recently freed frames
+  Addr cleared = std::min<Addr>(count + extra, dirty.size());
+  for (auto it = dirty.end() - cleared; it != dirty.end(); ++it) {
+    memory.fill_bytes(*it, kPageSize, 0);
+  }
+  clear.insert(clear.end(), dirty.end() - cleared, dirty.end());
+  dirty.resize(dirty.size() - cleared);
+  frames_zeroed += cleared;
+  if (clear.size() >= count) {
+    return true;
+  }
+
+  // Fetch enough for the request and a full magazine, or failing that, just
+  // enough for the request
+  size_t first_fetched = clear.size();
+  Addr shortfall = count - clear.size();
+  if (!allocator.Allocate(shortfall + extra, clear)
+          && !allocator.Allocate(shortfall, clear)) {
+    return false;
+  }
+  for (auto it = clear.begin() + first_fetched; it != clear.end(); ++it) {
+    frame_owners[*it >> mem::kPageSizeBits] = OwnerTag(magazine) | kHeldBit;
+  }
+  frames_free = allocator.get_page_frames_free();
+  return true;
+}
+
+bool SharedFramePool::Release(const FrameMagazine *magazine,
+                              std::vector<Addr> &page_frames,
+                              std::vector<Addr> &unshared) {
+  PhysicalAccess access(*this);
+  ++lock_count;
+
+  // Check that each frame has a reference for each time it is listed. A
+  // frame held free by a magazine has none.
+  std::sort(page_frames.begin(), page_frames.end());
+  for (auto it = page_frames.begin(); it != page_frames.end(); ) {
+    auto group_end = std::upper_bound(it, page_frames.end(), *it);
+    Addr frame_number = *it >> mem::kPageSizeBits;
+    if (frame_number >= frame_count
+            || (frame_owners[frame_number] & kHeldBit) != 0
+            || get_reference_count(*it) < static_cast<uint32_t>(group_end - it)) {
+      return false;
+    }
+    it = group_end;
+  }
+
+  // Take frames allocated by other magazines back into the pool. Failure
+  // means the other magazine has just freed the frame itself.
+  for (Addr frame : page_frames) {
+    uintptr_t owner = frame_owners[frame >> mem::kPageSizeBits];
+    if (owner != kNoOwner 
+            && !frame_owners[frame >> mem::kPageSizeBits]
+                  .compare_exchange_strong(owner, kNoOwner)) {
+      return false;
+    }
+  }
+
+  // Release the references, keeping the last reference to each frame
+  released.clear();
+  for (auto it = page_frames.begin(); it != page_frames.end(); ) {
+    auto group_end = std::upper_bound(it, page_frames.end(), *it);
+    if (allocator.get_reference_count(*it) 
+            == static_cast<uint32_t>(group_end - it)) {
+      frame_owners[*it >> mem::kPageSizeBits] = OwnerTag(magazine) | kHeldBit;
+      unshared.push_back(*it);
+      ++it;
+    }
+    released.insert(released.end(), it, group_end);
+    it = group_end;
+  }
+  bool result = allocator.Deallocate(released.size(), released);
+  frames_free = allocator.get_page_frames_free();
+  return result;
+}
+
+void SharedFramePool::Return(std::vector<Addr>::const_iterator first,
+                             std::vector<Addr>::const_iterator last) {
+  PhysicalAccess access(*this);
+  ++lock_count;
+  released.assign(first, last);
+  for (Addr frame : released) {
+    frame_owners[frame >> mem::kPageSizeBits] = kNoOwner;
+  }
+  allocator.Deallocate(released.size(), released);
+  frames_free = allocator.get_page_frames_free();
+}
+
+void SharedFramePool::ClearFrames(std::vector<Addr>::const_iterator first,
+                                  std::vector<Addr>::const_iterator last) {
+  PhysicalAccess access(*this);
+  ++lock_count;
+  for (; first != last; ++first) {
+    memory.fill_bytes(*first, kPageSize, 0);
+    ++frames_prezeroed;
+  }
+}
+
+ZeroingStats SharedFramePool::get_zeroing_stats(void) const {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  ZeroingStats stats = allocator.get_zeroing_stats();
+  stats.frames_zeroed += frames_zeroed;
+  stats.frames_prezeroed += frames_prezeroed;
+  return stats;
+}
+
+uint64_t SharedFramePool::get_lock_count(void) const {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  return lock_count;
+}
+
+SharedFramePool::LocalFreeResult 
+SharedFramePool::LocalFree(const FrameMagazine *magazine, Addr frame) {
+  Addr frame_number = frame >> mem::kPageSizeBits;
+  if (frame_number >= frame_count) {
+    return kNotAllocated;
+  }
+  
+  // Another thread may share the frame at the same time, taking it back 
+  // into the pool (see AddReference)
+  uintptr_t owner = OwnerTag(magazine);
+  if (frame_owners[frame_number].compare_exchange_strong(owner, 
+                                                          owner | kHeldBit)) {
+    return kFreedLocal;
+  }
+  return (owner & kHeldBit) != 0 ? kNotAllocated : kNotLocal;
+}
+
+FrameMagazine::FrameMagazine(SharedFramePool &pool_, Addr capacity_)
+: pool(pool_), capacity(capacity_ > 0 ? capacity_ : 1)
+{
+  cached.reserve(capacity);
+  freed.reserve(2 * capacity);
+}
+
+FrameMagazine::~FrameMagazine() {
+  Flush();
+}
+
+bool FrameMagazine::Allocate(Addr count, std::vector<Addr> &page_frames) {
+  if (cached.size() < count
+          && !pool.Refill(this, freed, cached, count, capacity)) {
+    return false;  // do nothing and return error
+  }
+  for (auto it = cached.end() - count; it != cached.end(); ++it) {
+    pool.LocalAllocate(this, *it);
+  }
+  page_frames.insert(page_frames.end(), cached.end() - count, cached.end());
+  cached.resize(cached.size() - count);
+  return true;
+}
+
+bool FrameMagazine::AllocateRuns(Addr count, std::vector<FrameRun> &runs) {
+  frames.clear();
+  if (!Allocate(count, frames)) {
+    return false;
+  }
+  size_t first_run = runs.size();
+  for (Addr frame : frames) {
+    if (runs.size() > first_run
+            && runs.back().frame + runs.back().count * kPageSize == frame) {
+      ++runs.back().count;
+    } else {
+      runs.push_back(FrameRun{ frame, 1 });
+    }
+  }
+  return true;
+}
+
+bool FrameMagazine::AllocateContiguous(Addr count,
+                                       std::vector<Addr> &page_frames) {
+  return pool.AllocateContiguous(count, page_frames);
+}
+
+bool FrameMagazine::Deallocate(Addr count, std::vector<Addr> &page_frames) {
+  if (count > page_frames.size()) {
+    return false; // do nothing and return error
+  }
+
+  // Free frames allocated by the magazine locally, and release the rest 
+  // through the pool
+  Addr freed_local = 0;
+  bool valid = true;
+  frames.clear();
+  for (auto it = page_frames.end() - count; valid && it != page_frames.end(); 
+          ++it) {
+    switch (pool.LocalFree(this, *it)) {
+      case SharedFramePool::kFreedLocal:
+        freed.push_back(*it);
+        ++freed_local;
+        break;
+      case SharedFramePool::kNotLocal:
+        frames.push_back(*it);
+        break;
+      case SharedFramePool::kNotAllocated:
+        valid = false;
+        break;
+    }
+  }
+  if (valid && !frames.empty()) {
+    valid = pool.Release(this, frames, freed);
+  }
+  if (!valid) {
+    // A frame was not allocated; undo the local frees
+    for (Addr i = 0; i < freed_local; ++i) {
+      pool.UndoLocalFree(this, freed.back());
+      freed.pop_back();
+    }
+    return false;
+  }
+  page_frames.resize(page_frames.size() - count);
+
+  // Return the least recently freed frames to the pool if too many are held
+  if (freed.size() > 2 * capacity) {
+    pool.Return(freed.begin(), freed.end() - capacity);
+    freed.erase(freed.begin(), freed.end() - capacity);
+  }
+  return true;
+}
+
+bool FrameMagazine::DeallocateRuns(const std::vector<FrameRun> &runs) {
+  run_frames.clear();
+  for (const FrameRun &run : runs) {
+    for (Addr i = 0; i < run.count; ++i) {
+      run_frames.push_back(run.frame + i * kPageSize);
+    }
+  }
+  return Deallocate(run_frames.size(), run_frames);
+}
+
+Addr FrameMagazine::ZeroFreeFrames(Addr max_count) {
+  Addr cleared = std::min<Addr>(max_count, freed.size());
+  if (cleared > 0) {
+    pool.ClearFrames(freed.end() - cleared, freed.end());
+    cached.insert(cached.end(), freed.end() - cleared, freed.end());
+    freed.resize(freed.size() - cleared);
+  }
+  if (cleared < max_count) {
+    cleared += pool.ZeroFreeFrames(max_count - cleared);
+  }
+  return cleared;
+}
+
+std::string FrameMagazine::FreeListToString(void) const {
+  std::ostringstream out_string;
+  out_string << std::hex;
+  for (const std::vector<Addr> *held : { &freed, &cached }) {
+    for (auto it = held->rbegin(); it != held->rend(); ++it) {
+      out_string << " " << *it;
+    }
+  }
+  out_string << pool.FreeListToString();
+  return out_string.str();
+}
+
+void FrameMagazine::Flush(void) {
+  if (!freed.empty()) {
+    pool.Return(freed.begin(), freed.end());
+    freed.clear();
+  }
+  if (!cached.empty()) {
+    pool.Return(cached.begin(), cached.end());
+    cached.clear();
+  }
+}
@@ -0,0 +1,345 @@
+/*  FrameMagazine - per-thread caches of page frames from a shared pool
+ *
+ * A SharedFramePool makes a FrameAllocator safe to share between threads,
+ * by holding a lock for each call. The lock also serialises use of the
+ * allocator's MMU: the pool switches the MMU to physical mode for each
+ * call, and a thread which uses the MMU directly while the pool is shared
+ * must hold the lock from LockMemory.
+ *
+ * Each thread allocates through its own FrameMagazine, which is a
+ * FrameAllocator (so it may be given to a ProcessTrace or Pager). It holds
+ * clear frames fetched from the pool and dirty frames freed by the thread.
+ * The pool records, without locking, which frames each magazine holds or
+ * has allocated with a single reference:
+ *   - Allocating a held clear frame, and freeing a frame the magazine
+ *     allocated which has not since been shared, change only this record.
+ *   - The lock is taken once per batch: to clear freed frames for reuse
+ *     (fetching more frames if too few were freed), and to return freed
+ *     frames beyond twice the capacity to the pool.
+ *   - Shared frames, frames allocated by other magazines and contiguous 
+ *     runs are freed through the pool, under its lock.
+ *
+ * File:   FrameMagazine.h
+ * Author: agent <agent@local>
+ *
+ * Created on October 18, 2026
+ */
+
+#ifndef FRAMEMAGAZINE_H
+#define FRAMEMAGAZINE_H
+
+#include "FrameAllocator.h"
+
+#include <MMU.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class FrameMagazine;
+
+class SharedFramePool {
+public:
+  /**
+   * Constructor
+   *
+   * @param memory_ MMU containing the page frames
+   * @param allocator_ allocator for the page frames of memory_, to share;
+   *   it must not be used directly while the pool is shared
+   */
+  SharedFramePool(mem::MMUInterface &memory_, FrameAllocator &allocator_);
+
+  virtual ~SharedFramePool() {}
+
+  // Disallow copy/move
+  SharedFramePool(const SharedFramePool &other) = delete;
+  SharedFramePool(SharedFramePool &&other) = delete;
+  SharedFramePool &operator=(const SharedFramePool &other) = delete;
+  SharedFramePool &operator=(SharedFramePool &&other) = delete;
+
+  /**
+   * LockMemory - lock the pool, so that the calling thread may use the MMU.
+   *   The thread may call the pool while it holds the lock.
+   *
+   * @return lock, released when destroyed
+   */
+  std::unique_lock<std::recursive_mutex> LockMemory(void) const {
+    return std::unique_lock<std::recursive_mutex>(mutex);
+  }
+
+  // Each of these calls the allocator's function, holding the pool's lock
+  // with the MMU in physical mode. No MMU operation may be pending.
+  // Frames allocated by AllocateContiguous are freed with Release.
+  bool AllocateContiguous(mem::Addr count, std::vector<mem::Addr> &page_frames);
+  void AddReference(mem::Addr frame);
+  mem::Addr ZeroFreeFrames(mem::Addr max_count);
+  std::string FreeListToString(void) const;
+
+  /**
+   * get_zeroing_stats - get zeroing statistics of the allocator (see 
+   *   FrameAllocator), including frames cleared by the pool for magazines
+   */
+  ZeroingStats get_zeroing_stats(void) const;
+
+  /**
+   * get_reference_count - get number of references to a page frame (see
+   *   FrameAllocator). Frames held or allocated by a magazine have one
+   *   reference, and are counted without taking the lock.
+   */
+  uint32_t get_reference_count(mem::Addr frame) const;
+
+  /**
+   * Refill - make clear frames available to a magazine, holding the lock
+   *   once. Dirty frames held by the magazine are cleared first, and frames
+   *   are fetched from the allocator only if too few were held.
+   *
+   * @param magazine magazine holding the frames
+   * @param dirty dirty frames held by the magazine; up to count + extra
+   *   frames are cleared, and moved from the back to the back of clear
+   * @param clear clear frames held by the magazine
+   * @param count number of frames needed in clear
+   * @param extra number of frames to clear or fetch beyond count, if
+   *   available
+   * @return true if success, false if insufficient page frames (frames
+   *   may still have been cleared)
+   */
+  bool Refill(const FrameMagazine *magazine, std::vector<mem::Addr> &dirty,
+              std::vector<mem::Addr> &clear, mem::Addr count, mem::Addr extra);
+
+  /**
+   * Release - release one reference to each page frame, except that frames
+   *   with no other references are kept allocated (with one reference),
+   *   and passed back to a magazine to hold for reuse
+   *
+   * @param magazine magazine releasing the frames
+   * @param page_frames frames to release (sorted by the call)
+   * @param unshared frames whose last reference remains are pushed on back
+   * @return true if success, false if a page frame is not allocated (no
+   *   references released)
+   */
+  bool Release(const FrameMagazine *magazine, 
+               std::vector<mem::Addr> &page_frames,
+               std::vector<mem::Addr> &unshared);
+
+  /**
+   * Return - free page frames held by a magazine
+   *
+   * @param first first of page frame addresses to free
+   * @param last end of page frame addresses to free
+   */
+  void Return(std::vector<mem::Addr>::const_iterator first,
+              std::vector<mem::Addr>::const_iterator last);
+
+  /**
+   * ClearFrames - clear page frames held by a magazine to all 0
+   *
+   * @param first first of page frame addresses to clear
+   * @param last end of page frame addresses to clear
+   */
+  void ClearFrames(std::vector<mem::Addr>::const_iterator first,
+                   std::vector<mem::Addr>::const_iterator last);
+
+  /**
+   * get_page_frames_free - get number of free page frames in the pool,
+   *   without taking the lock. Frames held by magazines are not free.
+   *
+   * @return number of free frames
+   */
+  mem::Addr get_page_frames_free(void) const { return frames_free; }
+
+  /**
+   * get_lock_count - get number of times the pool's lock has been taken
+   *   to allocate, free or clear frames
+   *
+   * @return number of calls to the pool
+   */
+  uint64_t get_lock_count(void) const;
+
+private:
+  friend class FrameMagazine;
+  
+  // Result of LocalFree
+  enum LocalFreeResult { kFreedLocal, kNotLocal, kNotAllocated };
+
+  /**
+   * LocalAllocate - record that a magazine has allocated a frame it held
+   *   (without taking the lock)
+   *
+   * @param magazine magazine holding the frame
+   * @param frame address of page frame
+   */
+  void LocalAllocate(const FrameMagazine *magazine, mem::Addr frame) {
+    frame_owners[frame >> mem::kPageSizeBits] = OwnerTag(magazine);
+  }
+
+  /**
+   * LocalFree - free a frame allocated by a magazine, and not shared since,
+   *   back to the magazine (without taking the lock)
+   *
+   * @param magazine magazine freeing the frame
+   * @param frame address of page frame
+   * @return kFreedLocal if freed, kNotLocal if the frame must be released
+   *   through the pool, kNotAllocated if the frame is not allocated
+   */
+  LocalFreeResult LocalFree(const FrameMagazine *magazine, mem::Addr frame);
+
+  /**
+   * UndoLocalFree - reverse LocalFree of a frame
+   */
+  void UndoLocalFree(const FrameMagazine *magazine, mem::Addr frame) {
+    frame_owners[frame >> mem::kPageSizeBits] = OwnerTag(magazine);
+  }
+
+  // Owner of each frame, indexed by frame number: kNoOwner if the frame is
+  // managed by the allocator, the tag of a magazine which allocated it with
+  // one reference, or that tag | kHeldBit if the magazine holds it free.
+  static const uintptr_t kNoOwner = 0;
+  static const uintptr_t kHeldBit = 1;
+  static uintptr_t OwnerTag(const FrameMagazine *magazine) {
+    return reinterpret_cast<uintptr_t>(magazine);
+  }
+
+  mem::MMUInterface &memory;
+  FrameAllocator &allocator;
+  mem::Addr frame_count;
+  std::unique_ptr<std::atomic<uintptr_t>[]> frame_owners;
+
+  // Guards memory, allocator and the counts
+  mutable std::recursive_mutex mutex;
+  uint64_t lock_count;
+  
+  // Frames held by magazines cleared for reuse by Refill, and cleared 
+  // ahead of time by ClearFrames
+  uint64_t frames_zeroed;
+  uint64_t frames_prezeroed;
+
+  // Free frames in the allocator, updated by each locked call
+  std::atomic<mem::Addr> frames_free;
+
+  // Frames to deallocate in Release and Return, reused by each call
+  std::vector<mem::Addr> released;
+
+  /**
+   * PhysicalAccess - holds the pool's lock with the MMU in physical mode,
+   *   restoring the previous PMCB when destroyed
+   */
+  class PhysicalAccess {
+  public:
+    PhysicalAccess(const SharedFramePool &pool_);
+    ~PhysicalAccess();
+  private:
+    const SharedFramePool &pool;
+    std::lock_guard<std::recursive_mutex> lock;
+    mem::PMCB saved_pmcb;
+  };
+};
+
+class FrameMagazine : public FrameAllocator {
+public:
+  /**
+   * Constructor - create an empty magazine. Each magazine must only be used
+   *   by one thread.
+   *
+   * @param pool_ shared pool of frames
+   * @param capacity_ number of frames fetched from the pool at a time;
+   *   freed frames beyond twice this are released to the pool
+   */
+  FrameMagazine(SharedFramePool &pool_, mem::Addr capacity_ = kDefaultCapacity);
+
+  /**
+   * Destructor - return all frames held by the magazine to the pool
+   */
+  virtual ~FrameMagazine();
+
+  /**
+   * Allocate - allocate page frames (see FrameAllocator) from the clear
+   *   frames held by the magazine. If it holds too few, frames freed by the
+   *   magazine's thread are cleared for reuse, and more frames are fetched
+   *   from the pool if needed (see SharedFramePool::Refill).
+   */
+  bool Allocate(mem::Addr count, std::vector<mem::Addr> &page_frames) override;
+
+  /**
+   * AllocateRuns - allocate page frames from the magazine (see Allocate).
+   *   Consecutive frames form a run.
+   */
+  bool AllocateRuns(mem::Addr count, std::vector<FrameRun> &runs) override;
+
+  /**
+   * AllocateContiguous - allocate a run of consecutive page frames directly
+   *   from the pool (see FrameAllocator)
+   */
+  bool AllocateContiguous(mem::Addr count,
+                          std::vector<mem::Addr> &page_frames) override;
+
+  /**
+   * Deallocate - release one reference to each page frame (see
+   *   FrameAllocator). Frames with no remaining references are kept in the
+   *   magazine for reuse; when it holds more than twice its capacity of
+   *   freed frames, the least recently freed are returned to the pool.
+   */
+  bool Deallocate(mem::Addr count, std::vector<mem::Addr> &page_frames) override;
+  bool DeallocateRuns(const std::vector<FrameRun> &runs) override;
+
+  // Reference counts are kept by the pool (frames held by the magazine have
+  // one reference)
+  void AddReference(mem::Addr frame) override { pool.AddReference(frame); }
+  uint32_t get_reference_count(mem::Addr frame) const override {
+    return pool.get_reference_count(frame);
+  }
+
+  /**
+   * ZeroFreeFrames - clear frames freed by the magazine's thread, and then
+   *   dirty frames free in the pool (see FrameAllocator)
+   */
+  mem::Addr ZeroFreeFrames(mem::Addr max_count) override;
+  ZeroingStats get_zeroing_stats(void) const override {
+    return pool.get_zeroing_stats();
+  }
+
+  /**
+   * get_page_frames_free - get number of frames held by the magazine, and
+   *   free in the pool
+   */
+  mem::Addr get_page_frames_free(void) const override {
+    return cached.size() + freed.size() + pool.get_page_frames_free();
+  }
+
+  /**
+   * FreeListToString - get string representation of free frames
+   *
+   * @return hex addresses of frames held by the magazine, followed by the
+   *   free frames of the pool
+   */
+  std::string FreeListToString(void) const override;
+
+  /**
+   * Flush - return all frames held by the magazine to the pool, e.g. so
+   *   that other threads can allocate them
+   */
+  void Flush(void);
+
+  // Access to private values
+  mem::Addr get_cached_count(void) const { return cached.size() + freed.size(); }
+
+  static const mem::Addr kDefaultCapacity = 32;
+private:
+  SharedFramePool &pool;
+  mem::Addr capacity;
+
+  // Frames allocated from the pool, not yet allocated by the thread (clear)
+  std::vector<mem::Addr> cached;
+
+  // Frames freed by the thread, most recently freed at back (not clear)
+  std::vector<mem::Addr> freed;
+
+  // Frames being allocated or deallocated, and frames of runs being 
+  // deallocated, reused by each call
+  std::vector<mem::Addr> frames;
+  std::vector<mem::Addr> run_frames;
+};
+
+#endif /* FRAMEMAGAZINE_H */
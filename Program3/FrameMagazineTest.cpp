@@ -0,0 +1,237 @@
+/*
+ * File:   FrameMagazineTest
+ * Author: agent <agent@local>
+ *
+ * Created on October 18, 2026
+ */
+
+#include <gtest/gtest.h>
+
+#include "BuddyFrameAllocator.h"
+#include "FrameMagazine.h"
+
+#include <MMU.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+using mem::Addr;
+using mem::kPageSize;
+using std::vector;
+
+class FrameMagazineTest : public testing::Test {
+protected:
+
+  void SetUp() {
+    // Setup ...
+  }
+
+  void TearDown() {
+    // Teardown ...
+  }
+
+  /**
+   * IsClear - check that a page frame holds all 0
+   */
+  static bool IsClear(mem::MMU &memory, Addr frame) {
+    vector<uint8_t> buf(kPageSize);
+    memory.get_bytes(buf.data(), frame, kPageSize);
+    return std::all_of(buf.begin(), buf.end(), [](uint8_t b) { return b == 0; });
+  }
+};
+
+TEST_F(FrameMagazineTest, ReuseFreed) {
+  const Addr kNFrames = 64;
+  const Addr kCapacity = 4;
+  mem::MMU memory(kNFrames);
+  BuddyFrameAllocator allocator(memory);
+  SharedFramePool pool(memory, allocator);
+  FrameMagazine magazine(pool, kCapacity);
+
+  // The first allocation fills the magazine
+  vector<Addr> frames;
+  ASSERT_TRUE(magazine.Allocate(2, frames));
+  ASSERT_EQ(kCapacity, magazine.get_cached_count());
+  ASSERT_EQ(kNFrames - kCapacity - 2, pool.get_page_frames_free());
+  ASSERT_EQ(kNFrames, magazine.get_page_frames_free() + 2);
+
+  // A freed frame is held by the magazine, without taking the pool's lock
+  Addr frame = frames.back();
+  memory.fill_bytes(frame, kPageSize, 0xEE);
+  uint64_t lock_count = pool.get_lock_count();
+  ASSERT_TRUE(magazine.Deallocate(1, frames));
+  ASSERT_EQ(1, pool.get_reference_count(frame));
+  ASSERT_EQ(kCapacity + 1, magazine.get_cached_count());
+  ASSERT_EQ(lock_count, pool.get_lock_count());
+
+  // Freeing it again is rejected
+  vector<Addr> again(1, frame);
+  ASSERT_FALSE(magazine.Deallocate(1, again));
+  ASSERT_EQ(1, again.size());
+  ASSERT_EQ(kCapacity + 1, magazine.get_cached_count());
+
+  // Once the clear frames run out, it is cleared and allocated again, once
+  Addr free_in_pool = pool.get_page_frames_free();
+  ASSERT_TRUE(magazine.Allocate(kCapacity + 1, frames));
+  ASSERT_EQ(0, magazine.get_cached_count());
+  ASSERT_EQ(free_in_pool, pool.get_page_frames_free());
+  ASSERT_EQ(lock_count + 1, pool.get_lock_count());
+  ASSERT_TRUE(IsClear(memory, frame));
+  vector<Addr> sorted(frames);
+  std::sort(sorted.begin(), sorted.end());
+  ASSERT_EQ(sorted.end(), std::adjacent_find(sorted.begin(), sorted.end()));
+  ASSERT_EQ(1, std::count(frames.begin(), frames.end(), frame));
+
+  // A shared frame keeps its other reference, and its last reference is
+  // released through the pool
+  magazine.AddReference(frame);
+  vector<Addr> shared(1, frame);
+  ASSERT_TRUE(magazine.Deallocate(1, shared));
+  ASSERT_EQ(1, magazine.get_reference_count(frame));
+  ASSERT_EQ(0, magazine.get_cached_count());
+
+  // A frame which is not allocated is rejected
+  vector<Addr> twice(2, frame);
+  ASSERT_FALSE(magazine.Deallocate(2, twice));
+  ASSERT_EQ(2, twice.size());
+  ASSERT_EQ(1, magazine.get_reference_count(frame));
+
+  // Freed frames beyond twice the capacity are returned to the pool
+  ASSERT_TRUE(magazine.Deallocate(frames.size(), frames));
+  vector<Addr> more;
+  ASSERT_TRUE(magazine.Allocate(3 * kCapacity, more));
+  ASSERT_TRUE(magazine.Deallocate(more.size(), more));
+  ASSERT_LE(magazine.get_cached_count(), 3 * kCapacity);
+  ASSERT_EQ(kNFrames, magazine.get_page_frames_free());
+
+  // Flush returns every frame
+  magazine.Flush();
+  ASSERT_EQ(0, magazine.get_cached_count());
+  ASSERT_EQ(kNFrames, pool.get_page_frames_free());
+}
+
+TEST_F(FrameMagazineTest, LockBatching) {
+  // Allocating and freeing single frames takes the pool's lock about once
+  // per capacity frames
+  const Addr kNFrames = 256;
+  const Addr kCapacity = 32;
+  const int kPairs = 1000;
+  mem::MMU memory(kNFrames);
+  BuddyFrameAllocator allocator(memory);
+  SharedFramePool pool(memory, allocator);
+  FrameMagazine magazine(pool, kCapacity);
+  vector<Addr> frames;
+  for (int i = 0; i < kPairs; ++i) {
+    ASSERT_TRUE(magazine.Allocate(1, frames));
+    memory.fill_bytes(frames[0], kPageSize, 0xEE);
+    ASSERT_TRUE(magazine.Deallocate(1, frames));
+  }
+  ASSERT_LE(pool.get_lock_count(), 2 * kPairs / kCapacity);
+  ASSERT_TRUE(magazine.Allocate(1, frames));
+  ASSERT_TRUE(IsClear(memory, frames[0]));
+}
+
+TEST_F(FrameMagazineTest, PhysicalMode) {
+  // The pool switches the MMU to physical mode, and back
+  const Addr kNFrames = 16;
+  mem::MMU memory(kNFrames);
+  BuddyFrameAllocator allocator(memory);
+  SharedFramePool pool(memory, allocator);
+  FrameMagazine magazine(pool, 2);
+  vector<Addr> page_table;
+  ASSERT_TRUE(magazine.Allocate(1, page_table));
+  memory.set_PMCB(mem::PMCB(true, page_table[0], 1));
+
+  vector<Addr> frames;
+  ASSERT_TRUE(magazine.Allocate(4, frames));
+  memory.set_PMCB(mem::PMCB());
+  memory.fill_bytes(frames[0], kPageSize, 0x77);
+  memory.set_PMCB(mem::PMCB(true, page_table[0], 1));
+  ASSERT_TRUE(magazine.Deallocate(frames.size(), frames));
+  ASSERT_TRUE(magazine.Allocate(4, frames));
+  mem::PMCB pmcb;
+  memory.get_PMCB(pmcb);
+  ASSERT_TRUE(pmcb.vm_enable);
+  ASSERT_EQ(page_table[0], pmcb.page_table_base);
+  memory.set_PMCB(mem::PMCB());
+  for (Addr frame : frames) {
+    ASSERT_TRUE(IsClear(memory, frame));
+  }
+}
+
+TEST_F(FrameMagazineTest, ThreadStress) {
+  // Threads allocate and free frames through their own magazines. Each
+  // frame is owned by at most one thread at a time, and holds 0 when it is
+  // allocated.
+  const Addr kNFrames = 256;
+  const int kNThreads = 8;
+  const int kIterations = 2000;
+  mem::MMU memory(kNFrames);
+  BuddyFrameAllocator allocator(memory);
+  SharedFramePool pool(memory, allocator);
+
+  std::unique_ptr<std::atomic<int>[]> owner(new std::atomic<int>[kNFrames]);
+  for (Addr i = 0; i < kNFrames; ++i) {
+    owner[i] = 0;
+  }
+  std::atomic<int> double_allocations(0);
+  std::atomic<int> not_cleared(0);
+  std::atomic<int> failed_deallocations(0);
+
+  vector<std::thread> threads;
+  for (int id = 1; id <= kNThreads; ++id) {
+    threads.emplace_back([&, id] {
+      FrameMagazine magazine(pool, 8);
+      std::minstd_rand rand(id);
+      vector<Addr> held;
+      vector<Addr> allocated;
+      for (int i = 0; i < kIterations; ++i) {
+        if (held.size() < 24 && rand() % 2 == 0) {
+          allocated.clear();
+          if (!magazine.Allocate(1 + rand() % 4, allocated)) {
+            continue;  // other threads hold the frames
+          }
+          for (Addr frame : allocated) {
+            int expected = 0;
+            if (!owner[frame / kPageSize].compare_exchange_strong(expected, id)) {
+              ++double_allocations;
+            }
+            std::unique_lock<std::recursive_mutex> lock = pool.LockMemory();
+            if (!IsClear(memory, frame)) {
+              ++not_cleared;
+            }
+            memory.fill_bytes(frame, kPageSize, id);
+          }
+          held.insert(held.end(), allocated.begin(), allocated.end());
+        } else if (!held.empty()) {
+          Addr count = 1 + rand() % held.size();
+          for (auto it = held.end() - count; it != held.end(); ++it) {
+            owner[*it / kPageSize] = 0;
+          }
+          if (!magazine.Deallocate(count, held)) {
+            ++failed_deallocations;
+          }
+        }
+      }
+      for (Addr frame : held) {
+        owner[frame / kPageSize] = 0;
+      }
+      magazine.Deallocate(held.size(), held);
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(0, double_allocations);
+  EXPECT_EQ(0, not_cleared);
+  EXPECT_EQ(0, failed_deallocations);
+  EXPECT_EQ(kNFrames, pool.get_page_frames_free());
+  for (Addr frame = 0; frame < kNFrames; ++frame) {
+    EXPECT_EQ(0, pool.get_reference_count(frame * kPageSize));
+  }
+}
@@ -7,8 +7,12 @@
 
 #include <gtest/gtest.h>
 
-#include "MemAllocator.h"
+#include "BuddyFrameAllocator.h"
+#include "PageFrameAllocator.h"
 
+#include <MMU.h>
+
+#include <algorithm>
 #include <vector>
 
 using mem::Addr;
@@ -29,18 +33,19 @@ protected:
 
 TEST_F(MemAllocatorTest, AllocDealloc) {
   const Addr kNFrames = 8;
-  MemAllocator allocator(kNFrames);
+  mem::MMU memory(kNFrames);
+  PageFrameAllocator allocator(memory);
   
   // Check initial counts
-  ASSERT_EQ(kNFrames, allocator.get_frame_count());
-  ASSERT_EQ(kNFrames, allocator.get_free_count());
+  ASSERT_EQ(kNFrames, memory.get_frame_count());
+  ASSERT_EQ(kNFrames, allocator.get_page_frames_free());
   
   // Allocate some frames
   const Addr kNAlloc = 3;
   vector<Addr> allocated1;
-  allocator.AllocateFrames(kNAlloc, allocated1);
-  ASSERT_EQ(kNFrames, allocator.get_frame_count());
-  ASSERT_EQ(kNFrames - kNAlloc, allocator.get_free_count());
+  ASSERT_TRUE(allocator.Allocate(kNAlloc, allocated1));
+  ASSERT_EQ(kNFrames, memory.get_frame_count());
+  ASSERT_EQ(kNFrames - kNAlloc, allocator.get_page_frames_free());
   ASSERT_EQ(kNAlloc, allocated1.size());
   for (size_t i = 0; i < allocated1.size(); ++i) {
     ASSERT_EQ(0, allocated1[i] & mem::kPageOffsetMask);
@@ -49,9 +54,9 @@ TEST_F(MemAllocatorTest, AllocDealloc) {
   
   // Allocate some more frames
   vector<Addr> allocated2;
-  allocator.AllocateFrames(kNAlloc, allocated2);
-  ASSERT_EQ(kNFrames, allocator.get_frame_count());
-  ASSERT_EQ(kNFrames - 2*kNAlloc, allocator.get_free_count());
+  ASSERT_TRUE(allocator.Allocate(kNAlloc, allocated2));
+  ASSERT_EQ(kNFrames, memory.get_frame_count());
+  ASSERT_EQ(kNFrames - 2*kNAlloc, allocator.get_page_frames_free());
   ASSERT_EQ(kNAlloc, allocated2.size());
   for (size_t i = 0; i < allocated2.size(); ++i) {
     ASSERT_EQ(0, allocated2[i] & mem::kPageOffsetMask);
@@ -60,17 +65,16 @@ TEST_F(MemAllocatorTest, AllocDealloc) {
   
   // Try to allocate more than remaining frames
   vector<Addr> allocated3;
-  ASSERT_THROW(allocator.AllocateFrames(allocator.get_free_count()+1, allocated3),
-    std::bad_alloc);
-  ASSERT_EQ(kNFrames, allocator.get_frame_count());
-  ASSERT_EQ(kNFrames - 2*kNAlloc, allocator.get_free_count());
+  ASSERT_FALSE(allocator.Allocate(allocator.get_page_frames_free()+1, allocated3));
+  ASSERT_EQ(kNFrames, memory.get_frame_count());
+  ASSERT_EQ(kNFrames - 2*kNAlloc, allocator.get_page_frames_free());
   ASSERT_TRUE(allocated3.empty());
   
   // Try to allocate all remaining frames
-  const Addr kNRemain = allocator.get_free_count();
-  allocator.AllocateFrames(allocator.get_free_count(), allocated3);
-  ASSERT_EQ(kNFrames, allocator.get_frame_count());
-  ASSERT_EQ(0, allocator.get_free_count());
+  const Addr kNRemain = allocator.get_page_frames_free();
+  ASSERT_TRUE(allocator.Allocate(allocator.get_page_frames_free(), allocated3));
+  ASSERT_EQ(kNFrames, memory.get_frame_count());
+  ASSERT_EQ(0, allocator.get_page_frames_free());
   ASSERT_EQ(kNRemain, allocated3.size());
   for (size_t i = 0; i < allocated3.size(); ++i) {
     ASSERT_EQ(0, allocated3[i] & mem::kPageOffsetMask);
@@ -78,26 +82,201 @@ TEST_F(MemAllocatorTest, AllocDealloc) {
   }
   
   // Free some  allocated frames
-  allocator.FreeFrames(allocated1);
-  ASSERT_EQ(allocated1.size(), allocator.get_free_count());
-  allocator.FreeFrames(allocated3);
-  ASSERT_EQ(allocated1.size()+allocated3.size(), allocator.get_free_count());
-  allocated1.clear();
-  allocated3.clear();
+  const Addr kNFree1 = allocated1.size();
+  ASSERT_TRUE(allocator.Deallocate(allocated1.size(), allocated1));
+  ASSERT_EQ(kNFree1, allocator.get_page_frames_free());
+  ASSERT_TRUE(allocator.Deallocate(allocated3.size(), allocated3));
+  ASSERT_EQ(kNFree1 + kNRemain, allocator.get_page_frames_free());
+  ASSERT_TRUE(allocated1.empty());
+  ASSERT_TRUE(allocated3.empty());
   
   // Allocate some more frames
-  allocator.AllocateFrames(kNAlloc, allocated1);
-  ASSERT_EQ(kNFrames, allocator.get_frame_count());
-  ASSERT_EQ(kNFrames - 2*kNAlloc, allocator.get_free_count());
+  ASSERT_TRUE(allocator.Allocate(kNAlloc, allocated1));
+  ASSERT_EQ(kNFrames, memory.get_frame_count());
+  ASSERT_EQ(kNFrames - 2*kNAlloc, allocator.get_page_frames_free());
   ASSERT_EQ(kNAlloc, allocated1.size());
   for (size_t i = 0; i < allocated1.size(); ++i) {
     ASSERT_EQ(0, allocated1[i] & mem::kPageOffsetMask);
     ASSERT_NE(allocated1[i], allocated1[(i+1)%kNAlloc]);
   }
 
-  allocator.FreeFrames(allocated1);
-  allocator.FreeFrames(allocated2);
-  ASSERT_EQ(kNFrames, allocator.get_free_count());
-  ASSERT_EQ(kNFrames, allocator.get_frame_count());
+  ASSERT_TRUE(allocator.Deallocate(allocated1.size(), allocated1));
+  ASSERT_TRUE(allocator.Deallocate(allocated2.size(), allocated2));
+  ASSERT_EQ(kNFrames, allocator.get_page_frames_free());
+  ASSERT_EQ(kNFrames, memory.get_frame_count());
+}
+
+
+TEST_F(MemAllocatorTest, DeallocateFree) {
+  const Addr kNFrames = 8;
+  mem::MMU memory(kNFrames);
+  PageFrameAllocator allocator(memory);
+  
+  vector<Addr> allocated;
+  ASSERT_TRUE(allocator.Allocate(2, allocated));
+  vector<Addr> freed(allocated);
+  ASSERT_TRUE(allocator.Deallocate(freed.size(), freed));
+  ASSERT_EQ(kNFrames, allocator.get_page_frames_free());
+  
+  // Freeing a free frame again fails and changes nothing
+  vector<Addr> again(allocated);
+  ASSERT_FALSE(allocator.Deallocate(again.size(), again));
+  ASSERT_EQ(allocated.size(), again.size());
+  ASSERT_EQ(0, allocator.get_reference_count(allocated[0]));
+  ASSERT_EQ(kNFrames, allocator.get_page_frames_free());
+  ASSERT_FALSE(allocator.DeallocateRuns({ { allocated[0], 1 } }));
+  ASSERT_EQ(kNFrames, allocator.get_page_frames_free());
+  
+  // A frame listed more than once only has references for one release
+  ASSERT_TRUE(allocator.Allocate(1, allocated));
+  vector<Addr> twice = { allocated.back(), allocated.back() };
+  ASSERT_FALSE(allocator.Deallocate(twice.size(), twice));
+  ASSERT_EQ(1, allocator.get_reference_count(allocated.back()));
+  ASSERT_EQ(kNFrames - 1, allocator.get_page_frames_free());
+  
+  // Each frame is allocated only once
+  vector<Addr> all;
+  ASSERT_TRUE(allocator.Allocate(kNFrames - 1, all));
+  all.push_back(allocated.back());
+  std::sort(all.begin(), all.end());
+  ASSERT_TRUE(std::unique(all.begin(), all.end()) == all.end());
+}
+
+TEST_F(MemAllocatorTest, CleanDirtyZeroing) {
+  const Addr kNFrames = 8;
+  mem::MMU memory(kNFrames);
+  PageFrameAllocator allocator(memory);
+  ASSERT_EQ(kNFrames, allocator.get_clean_frames_free());
+  
+  // Frames never written are allocated without clearing them
+  vector<Addr> allocated;
+  ASSERT_TRUE(allocator.Allocate(3, allocated));
+  ASSERT_EQ(3, allocator.get_zeroing_avoided());
+  ASSERT_EQ(0, allocator.get_frames_zeroed());
+  ASSERT_EQ(kNFrames - 3, allocator.get_clean_frames_free());
+  
+  // Freed frames are dirty, and cleared when allocated again
+  for (Addr frame : allocated) {
+    memory.fill_bytes(frame, mem::kPageSize, 0xA5);
+  }
+  ASSERT_TRUE(allocator.Deallocate(allocated.size(), allocated));
+  ASSERT_EQ(kNFrames - 3, allocator.get_clean_frames_free());
+  ASSERT_TRUE(allocator.Allocate(kNFrames, allocated));
+  ASSERT_EQ(3, allocator.get_frames_zeroed());
+  ASSERT_EQ(kNFrames, allocator.get_zeroing_avoided());
+  ASSERT_EQ(0, allocator.get_clean_frames_free());
+  vector<uint8_t> buf(mem::kPageSize);
+  for (Addr frame : allocated) {
+    memory.get_bytes(buf.data(), frame, mem::kPageSize);
+    ASSERT_TRUE(std::all_of(buf.begin(), buf.end(), 
+                            [](uint8_t b) { return b == 0; }));
+  }
+  
+  // Dirty free frames cleared ahead of time need no clearing when allocated
+  for (Addr frame : allocated) {
+    memory.fill_bytes(frame, mem::kPageSize, 0x5A);
+  }
+  ASSERT_TRUE(allocator.Deallocate(allocated.size(), allocated));
+  ASSERT_EQ(2, allocator.ZeroFreeFrames(2));
+  ASSERT_EQ(2, allocator.get_clean_frames_free());
+  ASSERT_EQ(kNFrames - 2, allocator.ZeroFreeFrames(kNFrames));
+  ASSERT_EQ(0, allocator.ZeroFreeFrames(kNFrames));
+  ASSERT_EQ(kNFrames, allocator.get_frames_prezeroed());
+  ASSERT_EQ(kNFrames, allocator.get_clean_frames_free());
+  ASSERT_TRUE(allocator.Allocate(kNFrames, allocated));
+  ASSERT_EQ(3, allocator.get_frames_zeroed());
+  ASSERT_EQ(2 * kNFrames, allocator.get_zeroing_avoided());
+  for (Addr frame : allocated) {
+    memory.get_bytes(buf.data(), frame, mem::kPageSize);
+    ASSERT_TRUE(std::all_of(buf.begin(), buf.end(), 
+                            [](uint8_t b) { return b == 0; }));
+  }
+}
+
+TEST_F(MemAllocatorTest, DirtyMemory) {
+  // Memory which may hold data is cleared as frames are allocated
+  const Addr kNFrames = 8;
+  mem::MMU memory(kNFrames);
+  memory.fill_bytes(0, kNFrames * mem::kPageSize, 0xC3);
+  PageFrameAllocator allocator(memory, false);
+  ASSERT_EQ(0, allocator.get_clean_frames_free());
+  vector<Addr> allocated;
+  ASSERT_TRUE(allocator.Allocate(2, allocated));
+  ASSERT_EQ(2, allocator.get_frames_zeroed());
+  ASSERT_EQ(0, allocator.get_zeroing_avoided());
+  vector<uint8_t> buf(mem::kPageSize);
+  for (Addr frame : allocated) {
+    memory.get_bytes(buf.data(), frame, mem::kPageSize);
+    ASSERT_TRUE(std::all_of(buf.begin(), buf.end(), 
+                            [](uint8_t b) { return b == 0; }));
+  }
+}
+
+TEST_F(MemAllocatorTest, AllocateRuns) {
+  const Addr kNFrames = 8;
+  mem::MMU memory(kNFrames);
+  PageFrameAllocator allocator(memory);
+  
+  // Consecutive frames in the free list form one run, appended to the runs
+  // already in the vector
+  vector<FrameRun> runs(1, FrameRun{ 0xFFFFF000, 1 });
+  ASSERT_TRUE(allocator.AllocateRuns(5, runs));
+  ASSERT_EQ(2, runs.size());
+  ASSERT_EQ(0, runs[1].frame);
+  ASSERT_EQ(5, runs[1].count);
+  ASSERT_EQ(kNFrames - 5, allocator.get_page_frames_free());
+  
+  // Freed frames are taken first, each in its own run, and then the 
+  // remaining consecutive frames as one run
+  for (Addr frame = 0; frame < runs[1].count; ++frame) {
+    memory.fill_bytes(frame * mem::kPageSize, mem::kPageSize, 0x3C);
+  }
+  ASSERT_TRUE(allocator.DeallocateRuns({ { 1 * mem::kPageSize, 1 }, 
+                                         { 3 * mem::kPageSize, 1 } }));
+  runs.clear();
+  ASSERT_TRUE(allocator.AllocateRuns(4, runs));
+  ASSERT_EQ(3, runs.size());
+  ASSERT_EQ(3 * mem::kPageSize, runs[0].frame);
+  ASSERT_EQ(1 * mem::kPageSize, runs[1].frame);
+  ASSERT_EQ(5 * mem::kPageSize, runs[2].frame);
+  ASSERT_EQ(2, runs[2].count);
+  ASSERT_EQ(2, allocator.get_frames_zeroed());
+  uint8_t val;
+  memory.get_byte(&val, 3 * mem::kPageSize + mem::kPageSize - 1);
+  ASSERT_EQ(0, val);
+  
+  // Too many frames allocates nothing
+  vector<FrameRun> more;
+  ASSERT_FALSE(allocator.AllocateRuns(allocator.get_page_frames_free() + 1, more));
+  ASSERT_TRUE(more.empty());
+  
+  // Each frame of each run is deallocated
+  ASSERT_TRUE(allocator.DeallocateRuns(runs));
+  ASSERT_EQ(kNFrames - 3, allocator.get_page_frames_free());
 }
 
+TEST_F(MemAllocatorTest, BuddyAllocateRuns) {
+  const Addr kNFrames = 16;
+  mem::MMU memory(kNFrames);
+  BuddyFrameAllocator allocator(memory);
+  
+  // Large blocks give few runs
+  vector<FrameRun> runs;
+  ASSERT_TRUE(allocator.AllocateRuns(7, runs));
+  ASSERT_LE(runs.size(), 3);
+  Addr total = 0;
+  for (const FrameRun &run : runs) {
+    total += run.count;
+  }
+  ASSERT_EQ(7, total);
+  ASSERT_TRUE(allocator.AllocateRuns(kNFrames - 7, runs));
+  ASSERT_EQ(0, allocator.get_page_frames_free());
+  ASSERT_TRUE(allocator.DeallocateRuns(runs));
+  ASSERT_EQ(kNFrames, allocator.get_page_frames_free());
+  
+  // With all frames merged again, one run holds them all
+  runs.clear();
+  ASSERT_TRUE(allocator.AllocateRuns(kNFrames, runs));
+  ASSERT_EQ(1, runs.size());
+  ASSERT_EQ(kNFrames, runs[0].count);
+}
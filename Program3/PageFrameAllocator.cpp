@@ -8,15 +8,15 @@
 
 #include "PageFrameAllocator.h"
 
-#include <array>
 #include <cstring>
 #include <sstream>
 
 using mem::Addr;
 using mem::kPageSize;
 
-PageFrameAllocator::PageFrameAllocator(mem::MMU &mmu) 
-: memory(mmu),
+PageFrameAllocator::PageFrameAllocator(mem::MMUInterface &mmu, 
+                                       bool memory_is_zero) 
+: FrameAllocatorBase(mmu, sizeof(Addr), memory_is_zero),
   page_frames_total(memory.get_frame_count()),
   page_frames_free(memory.get_frame_count()),
   free_list_head(0)
@@ -34,24 +34,30 @@ PageFrameAllocator::PageFrameAllocator(mem::MMU &mmu)
                    reinterpret_cast<uint8_t*>(&end_list));
 }
 
-bool PageFrameAllocator::Allocate(Addr count, 
-                                  std::vector<Addr> &page_frames) {
+bool PageFrameAllocator::AllocateRuns(Addr count, 
+                                      std::vector<FrameRun> &runs) {
   if (count <= page_frames_free) {  // if enough to allocate
-    std::array<uint8_t, kPageSize> zero_page;  // page of all 0
-    zero_page.fill(0);
-    
+    size_t first_run = runs.size();
+    page_frames_free -= count;
     while (count-- > 0) {
-      // Return next free frame to caller
-      page_frames.push_back(free_list_head);
+      // Return next free frame to caller, extending the last run if the 
+      // frame follows it
+      Addr frame = free_list_head;
+      if (runs.size() > first_run 
+              && runs.back().frame + runs.back().count * kPageSize == frame) {
+        ++runs.back().count;
+      } else {
+        runs.push_back(FrameRun{ frame, 1 });
+      }
       
       // De-link frame from head of free list
       memory.get_bytes(reinterpret_cast<uint8_t*>(&free_list_head), 
-                       free_list_head, sizeof(Addr));
-      
-      // Clear allocated page to all 0
-      memory.put_bytes(page_frames.back(), kPageSize, &zero_page[0]);
-      
-      --page_frames_free;
+                       frame, sizeof(Addr));
+    }
+    
+    // Clear allocated pages to all 0, unless already clear
+    for (size_t i = first_run; i < runs.size(); ++i) {
+      PrepareRun(runs[i]);
     }
     return true;
   } else {
@@ -59,23 +65,69 @@ bool PageFrameAllocator::Allocate(Addr count,
   }
 }
 
-bool PageFrameAllocator::Deallocate(Addr count,
-                                    std::vector<Addr> &page_frames) {
-  // If enough to deallocate
-  if(count <= page_frames.size()) {
-    while(count-- > 0) {
-      // Return next frame to head of free list
-      Addr frame = page_frames.back();
-      page_frames.pop_back();
-      memory.put_bytes(frame, sizeof(Addr), 
-                       reinterpret_cast<uint8_t*>(&free_list_head));
-      free_list_head = frame;
-      ++page_frames_free;
+bool PageFrameAllocator::AllocateContiguous(Addr count,
+                                            std::vector<Addr> &page_frames) {
+  if (count == 0 || (count & (count - 1)) != 0 || count > page_frames_free) {
+    return false;
+  }
+  
+  // Mark the free frames by walking the free list
+  std::vector<bool> is_free(page_frames_total, false);
+  for (Addr frame = free_list_head; frame != kEndList; ) {
+    is_free[frame / kPageSize] = true;
+    memory.get_bytes(reinterpret_cast<uint8_t*>(&frame), frame, sizeof(Addr));
+  }
+  
+  // Find the first aligned run of free frames
+  Addr run_start = kEndList;
+  for (Addr start = 0; start + count <= page_frames_total; start += count) {
+    Addr free_frames = 0;
+    while (free_frames < count && is_free[start + free_frames]) {
+      ++free_frames;
     }
-    return true;
-  } else {
-    return false; // do nothing and return error
+    if (free_frames == count) {
+      run_start = start;
+      break;
+    }
+  }
+  if (run_start == kEndList) {
+    return false;  // do nothing and return error
+  }
+  
+  // Unlink the frames in the run from the free list
+  Addr run_end = run_start + count;
+  Addr prev = kEndList;
+  for (Addr frame = free_list_head; frame != kEndList; ) {
+    Addr next;
+    memory.get_bytes(reinterpret_cast<uint8_t*>(&next), frame, sizeof(Addr));
+    Addr frame_number = frame / kPageSize;
+    if (frame_number >= run_start && frame_number < run_end) {
+      if (prev == kEndList) {
+        free_list_head = next;
+      } else {
+        memory.put_bytes(prev, sizeof(Addr), reinterpret_cast<uint8_t*>(&next));
+      }
+    } else {
+      prev = frame;
+    }
+    frame = next;
+  }
+  
+  // Clear allocated pages to all 0 and return them to caller
+  PrepareRun(FrameRun{ run_start * kPageSize, count });
+  for (Addr frame_number = run_start; frame_number < run_end; ++frame_number) {
+    page_frames.push_back(frame_number * kPageSize);
   }
+  page_frames_free -= count;
+  return true;
+}
+
+void PageFrameAllocator::FreeFrame(Addr frame) {
+  // Return frame to head of free list
+  memory.put_bytes(frame, sizeof(Addr), 
+                   reinterpret_cast<uint8_t*>(&free_list_head));
+  free_list_head = frame;
+  ++page_frames_free;
 }
 
 std::string PageFrameAllocator::FreeListToString(void) const {
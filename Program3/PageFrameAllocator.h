@@ -9,13 +9,17 @@
 #ifndef PAGEFRAMEALLOCATOR_H
 #define PAGEFRAMEALLOCATOR_H
 
+#include "FrameAllocator.h"
+
 #include <MMU.h>
 
 #include <cstdint>
 #include <string>
 #include <vector>
 
-class PageFrameAllocator {
+// Allocator which keeps the free page frames in a list linked through the 
+// free frames themselves
+class PageFrameAllocator : public FrameAllocatorBase {
 public:
   /**
    * Constructor
@@ -23,52 +27,45 @@ public:
    * Builds free list of all page frames.
    * 
    * @param page_frame_count
+   * @param memory_is_zero true if all page frames hold 0 (see FrameAllocator)
    */
-  PageFrameAllocator(mem::MMU &mmu);
+  PageFrameAllocator(mem::MMUInterface &mmu, bool memory_is_zero = true);
   
   virtual ~PageFrameAllocator() {}  // empty destrucor
   
-  // Disallow copy/move
-  PageFrameAllocator(const PageFrameAllocator &other) = delete;
-  PageFrameAllocator(PageFrameAllocator &&other) = delete;
-  PageFrameAllocator &operator=(const PageFrameAllocator &other) = delete;
-  PageFrameAllocator &operator=(PageFrameAllocator &&other) = delete;
-  
   /**
-   * Allocate - allocate page frames from the free list.  Allocated pages
-   *   are cleared to all 0.
-   * 
-   * @param count number of page frames to allocate
-   * @param page_frames page frame addresses allocated are pushed on back
-   * @return true if success, false if insufficient page frames (no frames allocated)
+   * AllocateRuns - allocate page frames from the head of the free list (see
+   *   FrameAllocator). Consecutive frames in the list form a run.
    */
-  bool Allocate(mem::Addr count, std::vector<mem::Addr> &page_frames);
+  bool AllocateRuns(mem::Addr count, std::vector<FrameRun> &runs) override;
   
   /**
-   * Deallocate - return page frames to free list
-   * 
-   * @param count number of page frames to free
-   * @param page_frames contains page frame addresses to deallocate; numbers are
-   *   popped from back of vector
-   * @return true if success, false if insufficient page frames in vector
+   * AllocateContiguous - allocate a run of consecutive page frames (see
+   *   FrameAllocator). The free list is walked to find a run.
    */
-  bool Deallocate(mem::Addr count, std::vector<mem::Addr> &page_frames);
+  bool AllocateContiguous(mem::Addr count, 
+                          std::vector<mem::Addr> &page_frames) override;
   
   // Access to private values
-  mem::Addr get_page_frames_free(void) const { return page_frames_free; }
+  mem::Addr get_page_frames_free(void) const override { return page_frames_free; }
   
   /**
    * FreeListToString - get string representation of free list
    * 
    * @return hex numbers of all free pages
    */
-  std::string FreeListToString(void) const;
+  std::string FreeListToString(void) const override;
   
   static const mem::Addr kPageSize = 0x1000;
-private:
-  // Memory to be allocated
-  mem::MMU &memory;
+protected:
+  /**
+   * FreeFrame - return page frame to head of free list
+   * 
+   * @param frame address of page frame
+   */
+  void FreeFrame(mem::Addr frame) override;
   
+private:
   // Number of first free page frame
   mem::Addr free_list_head;
   
@@ -0,0 +1,133 @@
+/*  Pager - demand paging of user pages to a swap file
+ *
+ * File:   Pager.cpp
+ * Author: agent <agent@local>
+ *
+ * Created on October 17, 2026
+ */
+
+#include "Pager.h"
+
+using mem::Addr;
+using mem::ASID;
+using mem::kPageSize;
+using mem::kPageSizeBits;
+using mem::PageTableEntry;
+using mem::VAddr;
+
+Pager::Pager(mem::MMUInterface &memory_, FrameAllocator &allocator_, 
+             SwapFile &swap_, ReplacementPolicy &policy_)
+: memory(memory_), allocator(allocator_), swap(swap_), policy(policy_),
+  resident_counts(mem::kMaxASID + 1, 0), pinned_asid(0), pinned_vaddr(0),
+  evictions(0), page_ins(0)
+{
+}
+
+void Pager::AddPage(ASID asid, VAddr vaddr, Addr entry_addr, Addr swap_slot) {
+  resident_pages.push_back(ResidentPage{ 
+          asid, vaddr & ~static_cast<VAddr>(mem::kPageOffsetMask), entry_addr, 
+          swap_slot });
+  ++resident_counts.at(asid);
+}
+
+bool Pager::AllocateFrame(Addr &frame) {
+  frame_runs.clear();
+  if (!AllocateRuns(1, frame_runs)) {
+    return false;
+  }
+  frame = frame_runs[0].frame;
+  return true;
+}
+
+bool Pager::AllocateRuns(Addr count, std::vector<FrameRun> &runs) {
+  while (allocator.get_page_frames_free() < count) {
+    if (!EvictPage(0)) {
+      return false;
+    }
+  }
+  return allocator.AllocateRuns(count, runs);
+}
+
+bool Pager::EvictPage(ASID asid) {
+  size_t victim = policy.SelectVictim(*this, asid);
+  if (victim == ReplacementPolicy::kNoVictim) {
+    return false;
+  }
+  ResidentPage page = resident_pages[victim];
+  PageTableEntry entry = GetEntry(victim);
+  Addr frame = entry & mem::kPTE_FrameMask;
+  
+  // Write the page unless swap holds an unmodified copy. A slot shared
+  // with another address space keeps the other copy.
+  if (page.swap_slot == kNoSlot || (entry & mem::kPTE_ModifiedMask) != 0) {
+    if (page.swap_slot != kNoSlot && swap.get_reference_count(page.swap_slot) > 1) {
+      swap.FreeSlot(page.swap_slot);
+      page.swap_slot = kNoSlot;
+    }
+    if (page.swap_slot == kNoSlot) {
+      page.swap_slot = swap.AllocateSlot();
+    }
+    swap.Write(page.swap_slot, memory.map_page(frame, kPageSize, false).first);
+  }
+  
+  // Mark the page swapped out, keeping its access permissions
+  SetEntry(victim, (page.swap_slot << kPageSizeBits) | mem::kPTE_SwappedOutMask
+                   | (entry & (mem::kPTE_WritableMask | mem::kPTE_CopyOnWriteMask)));
+  
+  // Remove page from resident list, and free its frame
+  resident_pages.erase(resident_pages.begin() + victim);
+  --resident_counts[page.asid];
+  policy.PageRemoved(victim);
+  std::vector<Addr> frames(1, frame);
+  allocator.Deallocate(1, frames);
+  ++evictions;
+  return true;
+}
+
+bool Pager::PageIn(ASID asid, VAddr vaddr, Addr entry_addr) {
+  Addr frame;
+  if (!AllocateFrame(frame)) {
+    return false;
+  }
+  
+  // Read the page from swap; the slot keeps a copy while the page is not
+  // modified
+  PageTableEntry entry;
+  memory.get_bytes(reinterpret_cast<uint8_t*> (&entry), 
+                   entry_addr, sizeof(PageTableEntry));
+  Addr slot = entry >> kPageSizeBits;
+  swap.Read(slot, memory.map_page(frame, kPageSize, true).first);
+  
+  entry = frame | mem::kPTE_PresentMask
+          | (entry & (mem::kPTE_WritableMask | mem::kPTE_CopyOnWriteMask));
+  memory.put_bytes(entry_addr, sizeof(PageTableEntry),
+                   reinterpret_cast<uint8_t*> (&entry));
+  AddPage(asid, vaddr, entry_addr, slot);
+  ++page_ins;
+  return true;
+}
+
+bool Pager::IsEvictable(size_t index, ASID asid) {
+  const ResidentPage &page = resident_pages[index];
+  if ((asid != 0 && page.asid != asid)
+          || (page.asid == pinned_asid && page.vaddr == pinned_vaddr)) {
+    return false;
+  }
+  
+  // A frame shared copy-on-write is mapped by more than one page table
+  return allocator.get_reference_count(GetEntry(index) & mem::kPTE_FrameMask) == 1;
+}
+
+PageTableEntry Pager::GetEntry(size_t index) {
+  PageTableEntry entry;
+  memory.get_bytes(reinterpret_cast<uint8_t*> (&entry),
+                   resident_pages[index].entry_addr, sizeof(PageTableEntry));
+  return entry;
+}
+
+void Pager::SetEntry(size_t index, PageTableEntry entry) {
+  const ResidentPage &page = resident_pages[index];
+  memory.put_bytes(page.entry_addr, sizeof(PageTableEntry),
+                   reinterpret_cast<uint8_t*> (&entry));
+  memory.FlushPage(page.vaddr, page.asid);
+}
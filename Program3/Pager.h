@@ -0,0 +1,185 @@
+/*  Pager - demand paging of user pages to a swap file
+ *
+ * The pager keeps a list of the resident pages which may be evicted. When 
+ * no page frame is free, or a process has its quota of resident pages, the
+ * replacement policy chooses a victim. The victim is written to the swap 
+ * file, unless the swap file already holds an unmodified copy, and its page 
+ * table entry is marked swapped out, with the swap slot number in place of
+ * the frame number. A later page fault on the page reads it back into a 
+ * free frame.
+ * 
+ * Pages in frames shared copy-on-write, and large pages, are never evicted.
+ * 
+ * All methods which access memory must be called in physical mode.
+ *
+ * File:   Pager.h
+ * Author: agent <agent@local>
+ *
+ * Created on October 17, 2026
+ */
+
+#ifndef PAGER_H
+#define PAGER_H
+
+#include "FrameAllocator.h"
+#include "ReplacementPolicy.h"
+#include "SwapFile.h"
+
+#include <MMU.h>
+#include <PageTable.h>
+
+#include <cstdint>
+#include <vector>
+
+// Page which may be evicted
+struct ResidentPage {
+  mem::ASID asid;             // address space of page
+  mem::VAddr vaddr;           // virtual address of page
+  mem::Addr entry_addr;       // physical address of last level page table
+                              // entry mapping page
+  mem::Addr swap_slot;        // slot holding copy of page, or kNoSlot
+};
+
+class Pager {
+public:
+  /**
+   * Constructor
+   * 
+   * @param memory_ MMU holding page tables and pages
+   * @param allocator_ allocator for page frames in memory_
+   * @param swap_ swap file for evicted pages (may be shared by pagers)
+   * @param policy_ replacement policy
+   */
+  Pager(mem::MMUInterface &memory_, FrameAllocator &allocator_, 
+        SwapFile &swap_, ReplacementPolicy &policy_);
+  
+  virtual ~Pager() {}
+  
+  // Disallow copy/move
+  Pager(const Pager &other) = delete;
+  Pager(Pager &&other) = delete;
+  Pager &operator=(const Pager &other) = delete;
+  Pager &operator=(Pager &&other) = delete;
+  
+  /**
+   * AddPage - add a page which has just been mapped to the resident list
+   * 
+   * @param asid address space of page
+   * @param vaddr virtual address of page
+   * @param entry_addr physical address of last level page table entry 
+   *   mapping page
+   * @param swap_slot slot holding an unmodified copy of page, or kNoSlot
+   */
+  void AddPage(mem::ASID asid, mem::VAddr vaddr, mem::Addr entry_addr,
+               mem::Addr swap_slot = kNoSlot);
+  
+  /**
+   * AllocateFrame - allocate a page frame, evicting a page if none is free.
+   *   The frame is cleared to all 0.
+   * 
+   * @param frame set to address of frame allocated
+   * @return true if success, false if no frame is free and no page may be
+   *   evicted
+   */
+  bool AllocateFrame(mem::Addr &frame);
+  
+  /**
+   * AllocateRuns - allocate page frames as runs of consecutive frames (see
+   *   FrameAllocator::AllocateRuns), evicting pages until enough are free
+   * 
+   * @param count number of page frames to allocate
+   * @param runs runs allocated are pushed on back
+   * @return true if success, false if too few frames are free and no more 
+   *   pages may be evicted (no frames allocated)
+   */
+  bool AllocateRuns(mem::Addr count, std::vector<FrameRun> &runs);
+  
+  /**
+   * EvictPage - evict a page chosen by the replacement policy, and free its
+   *   page frame
+   * 
+   * @param asid evict only a page of this address space, or any page if 0
+   * @return true if a page was evicted, false if no page may be evicted
+   */
+  bool EvictPage(mem::ASID asid);
+  
+  /**
+   * PageIn - read a swapped out page into a page frame, and map it
+   * 
+   * @param asid address space of page
+   * @param vaddr virtual address of page
+   * @param entry_addr physical address of last level page table entry, 
+   *   which must be marked swapped out
+   * @return true if success, false if no frame is free and no page may be
+   *   evicted
+   */
+  bool PageIn(mem::ASID asid, mem::VAddr vaddr, mem::Addr entry_addr);
+  
+  /**
+   * AddSwapReference - add a reference to the swap slot of a swapped out
+   *   page, when its page table entry is copied to another address space
+   * 
+   * @param entry page table entry marked swapped out
+   */
+  void AddSwapReference(mem::PageTableEntry entry) {
+    swap.AddReference(entry >> mem::kPageSizeBits);
+  }
+  
+  /**
+   * Pin - prevent one page from being evicted (e.g. the other page of a 
+   *   copy while a fault is handled), until Unpin is called
+   * 
+   * @param asid address space of page
+   * @param vaddr virtual address in page
+   */
+  void Pin(mem::ASID asid, mem::VAddr vaddr) {
+    pinned_asid = asid;
+    pinned_vaddr = vaddr & ~static_cast<mem::VAddr>(mem::kPageOffsetMask);
+  }
+  void Unpin(void) { pinned_asid = 0; }
+  
+  /**
+   * Access to resident pages, for replacement policies. Entries are read and
+   *   written in physical memory; SetEntry also invalidates any cached 
+   *   translation of the page.
+   */
+  const std::vector<ResidentPage> &get_resident_pages(void) const { 
+    return resident_pages; 
+  }
+  bool IsEvictable(size_t index, mem::ASID asid);
+  mem::PageTableEntry GetEntry(size_t index);
+  void SetEntry(size_t index, mem::PageTableEntry entry);
+  
+  // Access to statistics
+  mem::Addr get_resident_count(mem::ASID asid) const { 
+    return resident_counts.at(asid); 
+  }
+  uint64_t get_evictions(void) const { return evictions; }
+  uint64_t get_page_ins(void) const { return page_ins; }
+  
+  static const mem::Addr kNoSlot = 0xFFFFFFFF;
+private:
+  mem::MMUInterface &memory;
+  FrameAllocator &allocator;
+  SwapFile &swap;
+  ReplacementPolicy &policy;
+  
+  // Pages which may be evicted, in the order they were made resident
+  std::vector<ResidentPage> resident_pages;
+  
+  // Number of resident pages of each address space, indexed by ASID
+  std::vector<mem::Addr> resident_counts;
+  
+  // Runs allocated by AllocateFrame, reused by each call
+  std::vector<FrameRun> frame_runs;
+  
+  // Page which may not be evicted (none if pinned_asid is 0)
+  mem::ASID pinned_asid;
+  mem::VAddr pinned_vaddr;
+  
+  // Statistics
+  uint64_t evictions;
+  uint64_t page_ins;
+};
+
+#endif /* PAGER_H */
@@ -0,0 +1,276 @@
+/*
+ * File:   PagerTest
+ * Author: agent <agent@local>
+ *
+ * Created on October 18, 2026
+ */
+
+#include <gtest/gtest.h>
+
+#include "PageFrameAllocator.h"
+#include "Pager.h"
+#include "ReplacementPolicy.h"
+#include "SwapFile.h"
+
+#include <MMU.h>
+#include <PageTable.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using mem::Addr;
+using mem::kPageSize;
+using mem::PageTableEntry;
+
+class PagerTest : public testing::Test {
+protected:
+  static const Addr kNFrames = 8;
+  static const Addr kVAddrBase = 0x100000;
+
+  void SetUp() {
+    memory.reset(new mem::MMU(kNFrames));
+    allocator.reset(new PageFrameAllocator(*memory));
+    swap.reset(new SwapFile("/tmp/PagerTest_" + std::to_string(getpid()) + ".swap"));
+
+    // Page table entries are kept in one frame; the pager only reads and
+    // writes the entries, so no L1 table is needed
+    ASSERT_TRUE(allocator->Allocate(1, page_table));
+  }
+
+  void TearDown() {
+    pager.reset();
+    swap.reset();
+  }
+
+  /**
+   * MakePager - create the pager under test
+   *
+   * @param policy replacement policy
+   */
+  void MakePager(ReplacementPolicy &policy) {
+    pager.reset(new Pager(*memory, *allocator, *swap, policy));
+  }
+
+  /**
+   * MapPage - allocate a frame for a page, fill it with a pattern and add
+   *   it to the resident pages
+   *
+   * @param asid address space of page
+   * @param page page number (index of its entry in the page table)
+   */
+  void MapPage(mem::ASID asid, Addr page) {
+    Addr frame;
+    ASSERT_TRUE(pager->AllocateFrame(frame));
+    memory->fill_bytes(frame, kPageSize, Pattern(page));
+    SetEntry(page, frame | mem::kPTE_PresentMask | mem::kPTE_WritableMask);
+    pager->AddPage(asid, PageVAddr(page), EntryAddr(page));
+  }
+
+  Addr PageVAddr(Addr page) const { return kVAddrBase + page * kPageSize; }
+  Addr EntryAddr(Addr page) const {
+    return page_table[0] + page * sizeof(PageTableEntry);
+  }
+  static uint8_t Pattern(Addr page) { return 0x11 * (page + 1); }
+
+  PageTableEntry GetEntry(Addr page) {
+    PageTableEntry entry;
+    memory->get_bytes(reinterpret_cast<uint8_t*> (&entry),
+                      EntryAddr(page), sizeof(entry));
+    return entry;
+  }
+
+  void SetEntry(Addr page, PageTableEntry entry) {
+    memory->put_bytes(EntryAddr(page), sizeof(entry),
+                      reinterpret_cast<uint8_t*> (&entry));
+  }
+
+  /**
+   * ResidentPageNumber - get page number of a resident page
+   *
+   * @param index index in pager's resident page list
+   * @return page number
+   */
+  Addr ResidentPageNumber(size_t index) {
+    return (pager->get_resident_pages().at(index).vaddr - kVAddrBase) / kPageSize;
+  }
+
+  /**
+   * PageHolds - check that a resident page holds a single byte value
+   *
+   * @param page page number
+   * @param value expected value of every byte
+   * @return true if every byte of the page is value
+   */
+  bool PageHolds(Addr page, uint8_t value) {
+    PageTableEntry entry = GetEntry(page);
+    if ((entry & mem::kPTE_PresentMask) == 0) return false;
+    uint8_t buf[kPageSize];
+    memory->get_bytes(buf, entry & mem::kPTE_FrameMask, kPageSize);
+    for (Addr i = 0; i < kPageSize; ++i) {
+      if (buf[i] != value) return false;
+    }
+    return true;
+  }
+
+  /**
+   * PagesWritten - wait for queued swap writes, and get number of pages
+   *   written to the swap file
+   */
+  uint64_t PagesWritten(void) {
+    swap->Flush();
+    return swap->get_pages_written();
+  }
+
+  std::unique_ptr<mem::MMU> memory;
+  std::unique_ptr<PageFrameAllocator> allocator;
+  std::unique_ptr<SwapFile> swap;
+  std::unique_ptr<Pager> pager;
+  std::vector<Addr> page_table;
+};
+
+const Addr PagerTest::kNFrames;
+const Addr PagerTest::kVAddrBase;
+
+TEST_F(PagerTest, FifoVictim) {
+  FifoPolicy policy;
+  MakePager(policy);
+  for (Addr page = 0; page < kNFrames - 1; ++page) {
+    MapPage(1, page);
+  }
+  ASSERT_EQ(0, allocator->get_page_frames_free());
+
+  // The oldest page is evicted to make room
+  Addr frame;
+  ASSERT_TRUE(pager->AllocateFrame(frame));
+  ASSERT_EQ(1, pager->get_evictions());
+  ASSERT_EQ(kNFrames - 2, pager->get_resident_count(1));
+  ASSERT_NE(0, GetEntry(0) & mem::kPTE_SwappedOutMask);
+  ASSERT_EQ(0, GetEntry(0) & mem::kPTE_PresentMask);
+  ASSERT_EQ(1, ResidentPageNumber(0));
+
+  // A pinned page, or a page of another address space, is passed over
+  pager->Pin(1, PageVAddr(1));
+  ASSERT_TRUE(pager->EvictPage(1));
+  ASSERT_NE(0, GetEntry(2) & mem::kPTE_SwappedOutMask);
+  ASSERT_FALSE(pager->EvictPage(2));
+  pager->Unpin();
+  ASSERT_TRUE(pager->EvictPage(0));
+  ASSERT_NE(0, GetEntry(1) & mem::kPTE_SwappedOutMask);
+}
+
+TEST_F(PagerTest, ReadBackAfterEviction) {
+  FifoPolicy policy;
+  MakePager(policy);
+  for (Addr page = 0; page < kNFrames - 1; ++page) {
+    MapPage(1, page);
+  }
+
+  // Evict page 0, and reuse its frame for another page
+  MapPage(1, kNFrames);
+  ASSERT_TRUE(PageHolds(kNFrames, Pattern(kNFrames)));
+
+  // Reading page 0 back evicts page 1, and restores its contents
+  ASSERT_TRUE(pager->PageIn(1, PageVAddr(0), EntryAddr(0)));
+  ASSERT_EQ(1, pager->get_page_ins());
+  ASSERT_EQ(2, pager->get_evictions());
+  ASSERT_NE(0, GetEntry(1) & mem::kPTE_SwappedOutMask);
+  ASSERT_TRUE(PageHolds(0, Pattern(0)));
+  ASSERT_NE(0, GetEntry(0) & mem::kPTE_WritableMask);
+  ASSERT_TRUE(pager->PageIn(1, PageVAddr(1), EntryAddr(1)));
+  ASSERT_TRUE(PageHolds(1, Pattern(1)));
+  ASSERT_TRUE(PageHolds(kNFrames, Pattern(kNFrames)));
+}
+
+TEST_F(PagerTest, WriteBackDirtyOnly) {
+  FifoPolicy policy;
+  MakePager(policy);
+  MapPage(1, 0);
+  MapPage(2, 1);
+
+  // A page with no copy in swap is always written
+  ASSERT_TRUE(pager->EvictPage(2));
+  ASSERT_EQ(1, PagesWritten());
+  ASSERT_TRUE(pager->PageIn(2, PageVAddr(1), EntryAddr(1)));
+
+  // A clean page keeps its copy in swap, and is not written again
+  ASSERT_TRUE(pager->EvictPage(2));
+  ASSERT_EQ(1, PagesWritten());
+  ASSERT_TRUE(pager->PageIn(2, PageVAddr(1), EntryAddr(1)));
+  ASSERT_TRUE(PageHolds(1, Pattern(1)));
+
+  // A modified page is written back to its slot
+  Addr frame = GetEntry(1) & mem::kPTE_FrameMask;
+  memory->fill_bytes(frame, kPageSize, 0x5A);
+  SetEntry(1, GetEntry(1) | mem::kPTE_ModifiedMask);
+  ASSERT_TRUE(pager->EvictPage(2));
+  ASSERT_EQ(2, PagesWritten());
+  ASSERT_TRUE(pager->PageIn(2, PageVAddr(1), EntryAddr(1)));
+  ASSERT_TRUE(PageHolds(1, 0x5A));
+  ASSERT_EQ(3, pager->get_page_ins());
+}
+
+TEST_F(PagerTest, ClockVictim) {
+  ClockPolicy policy;
+  MakePager(policy);
+  for (Addr page = 0; page < kNFrames - 1; ++page) {
+    MapPage(1, page);
+  }
+  
+  // Accessed pages get a second chance, losing their Accessed bits
+  SetEntry(0, GetEntry(0) | mem::kPTE_AccessedMask);
+  SetEntry(1, GetEntry(1) | mem::kPTE_AccessedMask);
+  ASSERT_TRUE(pager->EvictPage(0));
+  ASSERT_NE(0, GetEntry(2) & mem::kPTE_SwappedOutMask);
+  ASSERT_EQ(0, GetEntry(0) & mem::kPTE_AccessedMask);
+  ASSERT_EQ(0, GetEntry(1) & mem::kPTE_AccessedMask);
+  
+  // The hand continues from where it stopped
+  SetEntry(3, GetEntry(3) | mem::kPTE_AccessedMask);
+  ASSERT_TRUE(pager->EvictPage(0));
+  ASSERT_NE(0, GetEntry(4) & mem::kPTE_SwappedOutMask);
+  ASSERT_EQ(0, GetEntry(3) & mem::kPTE_AccessedMask);
+  
+  // When every page has been accessed, the hand comes round to the page
+  // it started at
+  SetEntry(0, GetEntry(0) | mem::kPTE_AccessedMask);
+  SetEntry(1, GetEntry(1) | mem::kPTE_AccessedMask);
+  SetEntry(3, GetEntry(3) | mem::kPTE_AccessedMask);
+  SetEntry(5, GetEntry(5) | mem::kPTE_AccessedMask);
+  SetEntry(6, GetEntry(6) | mem::kPTE_AccessedMask);
+  ASSERT_TRUE(pager->EvictPage(0));
+  ASSERT_NE(0, GetEntry(5) & mem::kPTE_SwappedOutMask);
+}
+
+TEST_F(PagerTest, EnhancedClockVictim) {
+  EnhancedClockPolicy policy;
+  MakePager(policy);
+  for (Addr page = 0; page < 4; ++page) {
+    MapPage(1, page);
+  }
+  SetEntry(0, GetEntry(0) | mem::kPTE_AccessedMask | mem::kPTE_ModifiedMask);
+  SetEntry(1, GetEntry(1) | mem::kPTE_ModifiedMask);
+  SetEntry(2, GetEntry(2) | mem::kPTE_AccessedMask);
+  SetEntry(3, GetEntry(3) | mem::kPTE_AccessedMask | mem::kPTE_ModifiedMask);
+  
+  // No page is unaccessed and clean, so the unaccessed modified page is
+  // evicted, clearing Accessed bits on the way
+  ASSERT_TRUE(pager->EvictPage(0));
+  ASSERT_NE(0, GetEntry(1) & mem::kPTE_SwappedOutMask);
+  ASSERT_EQ(0, GetEntry(0) & mem::kPTE_AccessedMask);
+  ASSERT_NE(0, GetEntry(2) & mem::kPTE_AccessedMask);
+  
+  // Page 0 is now unaccessed and modified
+  ASSERT_TRUE(pager->EvictPage(0));
+  ASSERT_NE(0, GetEntry(0) & mem::kPTE_SwappedOutMask);
+  ASSERT_EQ(0, GetEntry(2) & mem::kPTE_AccessedMask);
+  ASSERT_EQ(0, GetEntry(3) & mem::kPTE_AccessedMask);
+  
+  // With all Accessed bits clear, the clean page is evicted before the 
+  // modified page
+  ASSERT_TRUE(pager->EvictPage(0));
+  ASSERT_NE(0, GetEntry(2) & mem::kPTE_SwappedOutMask);
+  ASSERT_NE(0, GetEntry(3) & mem::kPTE_PresentMask);
+}
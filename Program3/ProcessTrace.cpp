@@ -16,6 +16,10 @@
 #include <iostream>
 #include <sstream>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 using namespace mem;
 
 using std::cin;
@@ -26,13 +30,68 @@ using std::istringstream;
 using std::string;
 using std::vector;
 
-ProcessTrace::ProcessTrace(MMU &memory_, 
-                           PageFrameAllocator &allocator_, 
-                           string file_name_) 
-: memory(memory_), allocator(allocator_), file_name(file_name_), line_number(0) {
+namespace {
+
+/**
+ * FindMismatch - find the first byte which differs between two buffers
+ * 
+ * @param actual first buffer
+ * @param expected second buffer
+ * @param count number of bytes to compare
+ * @return index of first differing byte, or count if buffers are equal
+ */
+size_t FindMismatch(const uint8_t *actual, const uint8_t *expected, size_t count) {
+  size_t i = 0;
+#ifdef __SSE2__
+  // Compare 16 bytes at a time, and locate the mismatch within a block
+  // from the comparison mask
+  for (; i + 16 <= count; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(actual + i));
+    __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(expected + i));
+    unsigned int equal_mask = _mm_movemask_epi8(_mm_cmpeq_epi8(a, e));
+    if (equal_mask != 0xFFFF) {
+      return i + __builtin_ctz(~equal_mask);
+    }
+  }
+#endif
+  for (; i < count; ++i) {
+    if (actual[i] != expected[i]) break;
+  }
+  return i;
+}
+
+/**
+ * AllocateASID - get an address space identifier for a new process. 
+ *   Identifiers are reused after kMaxASID processes have been created.
+ * 
+ * @return address space identifier (never 0)
+ */
+ASID AllocateASID(void) {
+  static ASID next_asid = 1;
+  ASID asid = next_asid;
+  next_asid = (next_asid == kMaxASID) ? 1 : next_asid + 1;
+  return asid;
+}
+
+}  // namespace
+
+ProcessTrace::ProcessTrace(MMUInterface &memory_, 
+                           FrameAllocator &allocator_, 
+                           string file_name_,
+                           Pager *pager_) 
+: memory(memory_), levels(memory_.get_page_table_levels()), 
+  table_bits(memory_.get_page_table_bits()), 
+  table_entries(Addr(1) << table_bits), allocator(allocator_), 
+  file_name(file_name_), line_number(0), pager(pager_), quota_fault(false) {
     terminate_info = "";
     num_pages = 0;
     
+  // Pages are mapped in units of the standard page size
+  if (memory.get_page_bits() != kPageSizeBits) {
+    cerr << "ERROR: unsupported MMU page size for trace file: " 
+            << file_name << "\n";
+    exit(2);
+  }
     
   // Open the trace file.  Abort program if can't open.
   trace.open(file_name, std::ios_base::in);
@@ -43,6 +102,9 @@ ProcessTrace::ProcessTrace(MMU &memory_,
 }
 
 ProcessTrace::~ProcessTrace() {
+  if (memory.get_fault_handler() == this) {
+    memory.set_fault_handler(nullptr);
+  }
   trace.close();
 }
 
@@ -51,20 +113,124 @@ void ProcessTrace::Initialize(void){
   // Set up PMCB and empty 1st level page table
   vector<Addr> allocated;
   allocator.Allocate(1, allocated);
-  vmem_pmcb = mem::PMCB(true, allocated[0]);  // initialize PMCB
+  vmem_pmcb = mem::PMCB(true, allocated[0], AllocateASID());  // initialize PMCB
+  memory.FlushASID(vmem_pmcb.asid);  // in case identifier was reused
   memory.set_PMCB(vmem_pmcb);
 }
 
+void ProcessTrace::InitializeAsFork(ProcessTrace &parent) {
+  if (&parent.memory != &memory || &parent.allocator != &allocator) {
+    cerr << "ERROR: forked process must share memory with parent: " 
+            << file_name << "\n";
+    exit(2);
+  }
+  
+  // Switch to physical mode
+  memory.set_PMCB(pmem_pmcb);
+  
+  // Copy the parent's page tables, sharing its pages
+  ASID asid = AllocateASID();
+  Addr pt_base = ForkTable(parent, parent.vmem_pmcb.page_table_base, 0, 0, 
+                           asid);
+  
+  // Parent's cached translations may still allow writes
+  memory.FlushASID(parent.vmem_pmcb.asid);
+  
+  num_pages = parent.num_pages;
+  quota = parent.quota;
+  vmem_pmcb = mem::PMCB(true, pt_base, asid);
+  memory.FlushASID(vmem_pmcb.asid);  // in case identifier was reused
+  memory.set_PMCB(vmem_pmcb);
+}
+
+Addr ProcessTrace::ForkTable(ProcessTrace &parent, Addr parent_table, 
+                             int level, VAddr vaddr, ASID asid) {
+  // Read the parent's table
+  Addr table_bytes = sizeof(PageTableEntry) * table_entries;
+  PageTable page_table;  // first table_entries entries are used
+  memory.get_bytes(reinterpret_cast<uint8_t*> (&page_table),
+                   parent_table, table_bytes);
+  
+  // In the last level, make writable pages copy-on-write in the parent, and
+  // share all pages (including pages swapped out)
+  bool last_level = level == levels - 1;
+  if (last_level) {
+    for (Addr i = 0; i < table_entries; ++i) {
+      PageTableEntry &entry = page_table[i];
+      if ((entry & kPTE_PresentMask) != 0) {
+        if ((entry & kPTE_WritableMask) != 0) {
+          entry = (entry & ~kPTE_WritableMask) | kPTE_CopyOnWriteMask;
+        }
+        allocator.AddReference(entry & kPTE_FrameMask);
+      } else if (pager != nullptr && (entry & kPTE_SwappedOutMask) != 0) {
+        pager->AddSwapReference(entry);
+      }
+    }
+    memory.put_bytes(parent_table, table_bytes,
+                     reinterpret_cast<uint8_t*> (&page_table));
+  }
+  
+  // Allocate the table for this process
+  vector<Addr> allocated;
+  allocator.Allocate(1, allocated);
+  Addr table = allocated[0];
+  
+  for (Addr i = 0; i < table_entries; ++i) {
+    PageTableEntry &entry = page_table[i];
+    if ((entry & kPTE_PresentMask) == 0) {
+      continue;
+    }
+    VAddr entry_vaddr = vaddr | (static_cast<VAddr>(i) << IndexShift(level));
+    
+    // This process's copies of the pages may be evicted once they are no
+    // longer shared
+    if (last_level) {
+      if (pager != nullptr) {
+        pager->AddPage(asid, entry_vaddr, table + sizeof(PageTableEntry) * i);
+      }
+      continue;
+    }
+    
+    // Share a large page as 4 KiB pages, so that only the pages written 
+    // are copied
+    if ((entry & kPTE_LargePageMask) != 0) {
+      parent.SplitLargePage(entry_vaddr, 
+                            parent_table + sizeof(PageTableEntry) * i, entry);
+    }
+    
+    // Copy the next level table for this process
+    entry = ForkTable(parent, entry & kPTE_FrameMask, level + 1, entry_vaddr, 
+                      asid) | kPTE_PresentMask | kPTE_WritableMask;
+  }
+  memory.put_bytes(table, table_bytes,
+                   reinterpret_cast<uint8_t*> (&page_table));
+  return table;
+}
+
+Addr ProcessTrace::Idle(Addr max_frames) {
+  // Switch to physical mode
+  memory.set_PMCB(pmem_pmcb);
+  
+  Addr cleared = allocator.ZeroFreeFrames(max_frames);
+  
+  // Switch back to virtual mode, with no operation to resume
+  memory.set_PMCB(PMCB(true, vmem_pmcb.page_table_base, vmem_pmcb.asid));
+  return cleared;
+}
+
 bool ProcessTrace::Execute(void) {
     // Read and process commands
     string line;                // text line read
     string cmd;                 // command from line
-    vector<uint32_t> cmdArgs;   // arguments from line
+    vector<uint64_t> cmdArgs;   // arguments from line
     
     
     // store return value from ParseCommand
     int got_line = ParseCommand(line, cmd, cmdArgs);
     
+    // Another process may have run since this one
+    ActivateAddressSpace();
+    
     // Select the command to execute
     if (cmd == "quota" ) {
       CmdQuota(line, cmd, cmdArgs);    // set quota  
@@ -92,7 +258,7 @@ bool ProcessTrace::Execute(void) {
 }
 
 bool ProcessTrace::ParseCommand(
-    string &line, string &cmd, vector<uint32_t> &cmdArgs) {
+    string &line, string &cmd, vector<uint64_t> &cmdArgs) {
     cmdArgs.clear();
     line.clear();
     cmd.clear();
@@ -112,7 +278,7 @@ bool ProcessTrace::ParseCommand(
       lineStream >> cmd;
 
       // Get arguments
-      uint32_t arg;
+      uint64_t arg;
       while(lineStream >> std::hex >> arg) {
         cmdArgs.push_back(arg);
       }
@@ -129,22 +295,37 @@ bool ProcessTrace::ParseCommand(
 
 void ProcessTrace::CmdQuota(const string &line, 
                             const string &cmd, 
-                            const vector<uint32_t> &cmdArgs) {
+                            const vector<uint64_t> &cmdArgs) {
     quota = cmdArgs.at(0);
 }
 
-void ProcessTrace::CmdAlloc(uint32_t vaddr, uint32_t count) {  
+void ProcessTrace::CmdAlloc(VAddr vaddr, Addr count) {  
   // Switch to physical mode
   memory.get_PMCB(vmem_pmcb);
   memory.set_PMCB(pmem_pmcb);
   
   Addr pt_base = vmem_pmcb.page_table_base;
   
-  // Allocate pages, initialized to writable
-  while (count-- > 0) {
-    AllocateAndMapPage(vaddr);
-    vaddr += 0x1000;
-    num_pages++;
+  // Allocate pages, initialized to writable. Whole aligned large page 
+  // regions are mapped as large pages when enough contiguous frames are
+  // free.
+  VAddr large_page_size = static_cast<VAddr>(table_entries) << kPageSizeBits;
+  while (count > 0) {
+    if ((vaddr & (large_page_size - 1)) == 0 && count >= table_entries
+            && AllocateAndMapLargePage(vaddr)) {
+      vaddr += large_page_size;
+      count -= table_entries;
+      num_pages += table_entries;
+    } else {
+      // Map the pages in the rest of the last level table together
+      Addr table_pages = table_entries 
+              - ((vaddr >> kPageSizeBits) & (table_entries - 1));
+      Addr map_count = std::min(count, table_pages);
+      AllocateAndMapPages(vaddr, map_count);
+      vaddr += map_count * kPageSize;
+      count -= map_count;
+      num_pages += map_count;
+    }
   }
   
   // Switch back to virtual mode
@@ -153,171 +334,102 @@ void ProcessTrace::CmdAlloc(uint32_t vaddr, uint32_t count) {
 
 void ProcessTrace::CmdCompare(const string &line,
                               const string &cmd,
-                              const vector<uint32_t> &cmdArgs) {
-  uint32_t addr = cmdArgs.at(0);
+                              const vector<uint64_t> &cmdArgs) {
+  VAddr addr = cmdArgs.at(0);
+  
+  // Pack expected values into bytes
+  vector<uint8_t> expected(cmdArgs.begin() + 1, cmdArgs.end());
 
-  // Compare specified byte values
-  size_t num_bytes = cmdArgs.size() - 1;
-  uint8_t buffer[num_bytes];
+  // Compare specified byte values in place, one page at a time. Mismatches
+  // are reported individually.
+  size_t next = 0;  // index of next expected value to compare
   try {
-    memory.get_bytes(buffer, addr, num_bytes);
-    for(int i = 1; i < cmdArgs.size(); ++i) {
-      if(buffer[i - 1] != cmdArgs.at(i)) {
-        cout << "compare error at address " << std::hex << addr
-                << ", expected " << static_cast<uint32_t> (cmdArgs.at(i))
-                << ", actual is " << static_cast<uint32_t> (buffer[i - 1]) << "\n";
+    while (next < expected.size()) {
+      auto span = memory.map_page(addr, expected.size() - next, false);
+      size_t i = 0;
+      while ((i += FindMismatch(span.first + i, &expected[next + i], 
+                                span.second - i)) < span.second) {
+        cout << "compare error at address " << std::hex << addr + i
+                << ", expected " << static_cast<uint32_t> (expected[next + i])
+                << ", actual is " << static_cast<uint32_t> (span.first[i]) << "\n";
+        ++i;
       }
-      ++addr;
+      addr += span.second;
+      next += span.second;
     }
-  }  catch(PageFaultException e) {
+  }  catch(PageFaultException &e) {
     PrintAndClearException("PageFaultException", e);
   }
 }
 
 void ProcessTrace::CmdPut(const string &line,
                           const string &cmd,
-                          const vector<uint32_t> &cmdArgs) {
+                          const vector<uint64_t> &cmdArgs) {
   // Put multiple bytes starting at specified address
-  uint32_t addr = cmdArgs.at(0);
+  VAddr addr = cmdArgs.at(0);
   size_t num_bytes = cmdArgs.size() - 1;
   uint8_t buffer[num_bytes];
   
-  try {
-    for(int i = 1; i < cmdArgs.size(); ++i) {
-      buffer[i - 1] = cmdArgs.at(i);
-    }
-    
-    memory.put_bytes(addr, num_bytes, buffer);
-
-  }  catch(PageFaultException e) {
-    
-    // get pmcb to store current state of the process
-    memory.get_PMCB(vmem_pmcb);
-    
-    if(num_pages + vmem_pmcb.remaining_count/kPageSize < quota)
-    {
-	CmdAlloc(addr, vmem_pmcb.remaining_count);
-    }
-    else
-    {
-	terminate_info = "Exceeded quota";
-	vmem_pmcb.operation_state = PMCB::NONE;
-    }
-    
-    // set pmcb again to resume/stop operation
-    memory.set_PMCB(vmem_pmcb);
-    
-  }  catch(WritePermissionFaultException e) {
-    PrintAndClearException("WritePermissionFaultException", e);
+  for(int i = 1; i < cmdArgs.size(); ++i) {
+    buffer[i - 1] = cmdArgs.at(i);
   }
+    
+  ReportFault(memory.try_put_bytes(addr, num_bytes, buffer), true);
 }
 
 void ProcessTrace::CmdCopy(const string &line,
                            const string &cmd,
-                           const vector<uint32_t> &cmdArgs) {
+                           const vector<uint64_t> &cmdArgs) {
   // Copy specified number of bytes to destination from source
-  Addr dst = cmdArgs.at(0);
-  Addr src = cmdArgs.at(1);
+  VAddr dst = cmdArgs.at(0);
+  VAddr src = cmdArgs.at(1);
   Addr num_bytes = cmdArgs.at(2);
-  uint8_t buffer[num_bytes];
 
-  // Try reading bytes
-  Addr bytes_read = 0;  // number of successfully read bytes
-  try {
-    memory.get_bytes(buffer, src, num_bytes);
-    bytes_read = num_bytes;  // all bytes read
-  }  catch(PageFaultException e) {
-    PrintAndClearException("PageFaultException on read", e);
-    memory.get_PMCB(vmem_pmcb);  // get address which cause exception
-    bytes_read = vmem_pmcb.next_vaddress - src;  // number of bytes read
-  }
-  
-  // Try writing bytes
-  if(bytes_read != 0) {
-    try {
-      memory.put_bytes(dst, bytes_read, buffer);
-    } catch(PageFaultException e) {
-      
-      // get pmcb to store current state of the process
-    memory.get_PMCB(vmem_pmcb);
-    
-    if(num_pages + vmem_pmcb.remaining_count/kPageSize < quota)
-    {
-	CmdAlloc(dst, vmem_pmcb.remaining_count);
-    }
-    else
-    {
-	terminate_info = "Exceeded quota";
-	vmem_pmcb.operation_state = PMCB::NONE;
-    }
-
-    // set pmcb again to resume/stop operation
-    memory.set_PMCB(vmem_pmcb);
-    } catch(WritePermissionFaultException e) {
-      PrintAndClearException("WritePermissionFaultException", e);
-    }
-  }
+  MemoryFault fault = memory.try_copy_bytes(dst, src, num_bytes);
+  
+  // The source is translated first, so a fault at the source address was
+  // on the read
+  memory.get_PMCB(vmem_pmcb);
+  ReportFault(fault, vmem_pmcb.fault_vaddress != vmem_pmcb.next_src_vaddress);
 }
 
 void ProcessTrace::CmdFill(const string &line,
                            const string &cmd,
-                           const vector<uint32_t> &cmdArgs) {
+                           const vector<uint64_t> &cmdArgs) {
   // Fill a sequence of bytes with the specified value
-  Addr addr = cmdArgs.at(0);
+  VAddr addr = cmdArgs.at(0);
   Addr num_bytes = cmdArgs.at(1);
   uint8_t val = cmdArgs.at(2);
   
-  try {
-    for(int i = 0; i < num_bytes; ++i) {
-      memory.put_byte(addr++, &val);
-    }
-  } catch(PageFaultException e) {
-    
-    // get pmcb to store current state of the process
-    memory.get_PMCB(vmem_pmcb);
-    
-    if(num_pages + vmem_pmcb.remaining_count/kPageSize < quota)
-    {
-	CmdAlloc(addr, vmem_pmcb.remaining_count);
-        
-        
-    }
-    else
-    {
-	terminate_info = "Exceeded quota";
-	vmem_pmcb.operation_state = PMCB::NONE;
-    }
-    
-    // set pmcb again to resume/stop operation
-    memory.set_PMCB(vmem_pmcb);
-    
-  } catch(WritePermissionFaultException e) {
-    PrintAndClearException("WritePermissionFaultException", e);
-  }
+  ReportFault(memory.try_fill_bytes(addr, num_bytes, val), true);
 }
 
 void ProcessTrace::CmdDump(const string &line,
                            const string &cmd,
-                           const vector<uint32_t> &cmdArgs) {
-  uint32_t addr = cmdArgs.at(0);
+                           const vector<uint64_t> &cmdArgs) {
+  VAddr addr = cmdArgs.at(0);
   uint32_t count = cmdArgs.at(1);
 
   // Output the address
   cout << std::hex << addr;
 
-  // Output the specified number of bytes starting at the address
+  // Output the specified number of bytes starting at the address, reading
+  // them in place one page at a time
   try {
-    for(int i = 0; i < count; ++i) {
-      if((i % 16) == 0) { // line break every 16 bytes
-        cout << "\n";
+    uint32_t i = 0;
+    while (i < count) {
+      auto span = memory.map_page(addr, count - i, false);
+      for (Addr j = 0; j < span.second; ++j, ++i) {
+        if((i % 16) == 0) { // line break every 16 bytes
+          cout << "\n";
+        }
+        cout << " " << std::setfill('0') << std::setw(2)
+                << static_cast<uint32_t> (span.first[j]);
       }
-      uint8_t byte_val;
-      memory.get_byte(&byte_val, addr++);
-      cout << " " << std::setfill('0') << std::setw(2)
-              << static_cast<uint32_t> (byte_val);
+      addr += span.second;
     }
     cout << "\n";
-  } catch(PageFaultException e) {
+  } catch(PageFaultException &e) {
     cout << "\n";
     PrintAndClearException("PageFaultException", e);
   }
@@ -325,9 +437,9 @@ void ProcessTrace::CmdDump(const string &line,
 
 void ProcessTrace::CmdWritable(const string &line,
                                const string &cmd,
-                               const vector<uint32_t> &cmdArgs) {
+                               const vector<uint64_t> &cmdArgs) {
  // Get arguments
-  Addr vaddr = cmdArgs.at(0);
+  VAddr vaddr = cmdArgs.at(0);
   int count = cmdArgs.at(1) / kPageSize;
   bool writable = cmdArgs.at(2) != 0;
   
@@ -337,8 +449,9 @@ void ProcessTrace::CmdWritable(const string &line,
   
   Addr pt_base = vmem_pmcb.page_table_base;
   
-  // Modify pages in range
-  while (count-- > 0) {
+  // Modify pages in range (pages outside the address space are never 
+  // present)
+  while (count-- > 0 && InAddressSpace(vaddr)) {
     SetWritableStatus(vaddr, writable);
     vaddr += 0x1000;
   }
@@ -348,107 +461,322 @@ void ProcessTrace::CmdWritable(const string &line,
 }
 
 void ProcessTrace::PrintAndClearException(const string &type, 
-                                          MemorySubsystemException e) {
+                                          const MemorySubsystemException &e) {
   memory.get_PMCB(vmem_pmcb);
   cout << "Exception type " << type 
           << " occurred at input line " << std::dec << std::setw(1) 
           << line_number << " at virtual address 0x" 
           << std::hex << std::setw(8) << std::setfill('0') 
-          << vmem_pmcb.next_vaddress 
+          << vmem_pmcb.fault_vaddress 
           << ": " << e.what() << "\n";
   vmem_pmcb.operation_state = PMCB::NONE;
   memory.set_PMCB(vmem_pmcb);
 }
 
-void ProcessTrace::AllocateAndMapPage(Addr vaddr) {
-  // Get offset in L1 table of L2 entry for vaddr  
-  Addr pt_base = vmem_pmcb.page_table_base;
-  Addr pt_l1_offset = vaddr >> (kPageSizeBits + kPageTableSizeBits);
-
-  // Get L1 page table entry
-  Addr l1_entry_addr = pt_base + sizeof(PageTableEntry) * pt_l1_offset;
-  PageTableEntry l1_entry;
-  memory.get_bytes(reinterpret_cast<uint8_t*> (&l1_entry),
-                 l1_entry_addr, sizeof(PageTableEntry));
-
-  // If no L1 entry for page, allocate and map one
-  if((l1_entry & kPTE_PresentMask) == 0) {
-    vector<Addr> allocated;
-    allocator.Allocate(1, allocated);
-    l1_entry = allocated[0] | kPTE_PresentMask | kPTE_WritableMask;
-    memory.put_bytes(l1_entry_addr, sizeof(PageTableEntry),
-                     reinterpret_cast<uint8_t*> (&l1_entry));
-  }
-  
-  // Get L2 page table entry
-  Addr pt_l2_addr = l1_entry & kPageNumberMask;
-  Addr pt_l2_offset = (vaddr >> kPageSizeBits) & kPageTableIndexMask;
-  Addr l2_entry_addr = pt_l2_addr + sizeof(PageTableEntry) * pt_l2_offset;
-  PageTableEntry l2_entry;
-  memory.get_bytes(reinterpret_cast<uint8_t*> (&l2_entry),
-                 l2_entry_addr, sizeof(PageTableEntry));
+void ProcessTrace::ActivateAddressSpace(void) {
+  PMCB current;
+  memory.get_PMCB(current);
+  if (!current.vm_enable 
+          || current.page_table_base != vmem_pmcb.page_table_base
+          || current.asid != vmem_pmcb.asid) {
+    memory.set_PMCB(PMCB(true, vmem_pmcb.page_table_base, vmem_pmcb.asid));
+  }
+  memory.set_fault_handler(this);
+}
+
+bool ProcessTrace::HandleFault(MemoryFault fault, VAddr vaddress, bool write,
+                               const PMCB &fault_pmcb) {
+  // The MMU restores the PMCB of the faulting operation when this returns
+  vmem_pmcb = fault_pmcb;
+  memory.set_PMCB(pmem_pmcb);
+  quota_fault = false;
   
-  // Error if page already allocated
-  if ((l2_entry & kPTE_PresentMask) != 0) {
+  // Keep the other page of a copy resident while a page is loaded for it
+  if (pager != nullptr && vmem_pmcb.operation_state == PMCB::COPY_OP
+          && vmem_pmcb.remaining_count > 0) {
+    pager->Pin(vmem_pmcb.asid, write ? vmem_pmcb.next_src_vaddress 
+                                     : vmem_pmcb.next_vaddress);
+  }
+  bool resolved = fault == MemoryFault::kWritePermissionFault
+          ? CopyOnWrite(vaddress)
+          : MapFaultingPage(vaddress & ~static_cast<VAddr>(kPageOffsetMask), 
+                            write);
+  if (pager != nullptr) {
+    pager->Unpin();
+  }
+  return resolved;
+}
+
+bool ProcessTrace::MapFaultingPage(VAddr vaddr, bool write) {
+  Addr entry_addr;
+  PageTableEntry entry;
+  bool swapped_out = FindEntry(vaddr, levels - 1, false, entry_addr, entry)
+          && (entry & kPTE_SwappedOutMask) != 0;
+
+  // Reading unallocated memory is an error
+  if (!swapped_out && !write) {
+    return false;
+  }
+
+  if (!ReserveResidentPage()) {
+    terminate_info = "Exceeded quota";
+    quota_fault = true;
+    return false;
+  }
+
+  // Read the faulting page from swap, or map a new page
+  if (swapped_out) {
+    if (!pager->PageIn(vmem_pmcb.asid, vaddr, entry_addr)) {
+      cerr << "ERROR: no page frame for page in at vaddr = 0x" 
+              << std::hex << vaddr << "\n";
+      throw std::bad_alloc();
+    }
+  } else {
+    AllocateAndMapPages(vaddr, 1);
+    ++num_pages;
+  }
+  return true;
+}
+
+void ProcessTrace::ReportFault(MemoryFault fault, bool write) {
+  if (fault == MemoryFault::kNone) {
+    return;
+  }
+  
+  if (quota_fault) {
+    memory.get_PMCB(vmem_pmcb);
+    StopOperation();
+  } else if (fault == MemoryFault::kWritePermissionFault) {
+    PrintAndClearException("WritePermissionFaultException", 
+                           WritePermissionFaultException());
+  } else {
+    PrintAndClearException(write ? "PageFaultException on write" 
+                                 : "PageFaultException on read", 
+                           PageFaultException());
+  }
+}
+
+bool ProcessTrace::ReserveResidentPage(void) {
+  // Without paging, the quota limits the pages allocated. With paging, it
+  // limits the pages resident, and a page of this process is evicted to 
+  // make room.
+  if (pager == nullptr) {
+    return num_pages < quota;
+  }
+  return pager->get_resident_count(vmem_pmcb.asid) < quota
+          || pager->EvictPage(vmem_pmcb.asid);
+}
+
+void ProcessTrace::StopOperation(void) {
+  vmem_pmcb.operation_state = PMCB::NONE;
+  memory.set_PMCB(vmem_pmcb);
+}
+
+bool ProcessTrace::FindEntry(VAddr vaddr, int level, bool create,
+                             Addr &entry_addr, PageTableEntry &entry) {
+  // Walk down from the top level table
+  Addr table = vmem_pmcb.page_table_base;
+  for (int i = 0; ; ++i) {
+    entry_addr = table + sizeof(PageTableEntry) 
+            * ((vaddr >> IndexShift(i)) & (table_entries - 1));
+    memory.get_bytes(reinterpret_cast<uint8_t*> (&entry),
+                     entry_addr, sizeof(PageTableEntry));
+    if (i == level) {
+      return true;
+    }
+    
+    // Allocate a missing table if requested. A large page has no table 
+    // below it.
+    if ((entry & kPTE_PresentMask) == 0 && create) {
+      entry = AllocateFrame() | kPTE_PresentMask | kPTE_WritableMask;
+      memory.put_bytes(entry_addr, sizeof(PageTableEntry),
+                       reinterpret_cast<uint8_t*> (&entry));
+    } else if ((entry & (kPTE_PresentMask | kPTE_LargePageMask)) 
+            != kPTE_PresentMask) {
+      entry = 0;
+      return false;
+    }
+    table = entry & kPTE_FrameMask;
+  }
+}
+
+Addr ProcessTrace::AllocateFrame(void) {
+  frame_runs.clear();
+  AllocateFrames(1, frame_runs);
+  return frame_runs[0].frame;
+}
+
+void ProcessTrace::AllocateFrames(Addr count, vector<FrameRun> &runs) {
+  bool allocated = (pager != nullptr) ? pager->AllocateRuns(count, runs)
+                                      : allocator.AllocateRuns(count, runs);
+  if (!allocated) {
+    cerr << "ERROR: no free page frame\n";
+    throw std::bad_alloc();
+  }
+}
+
+bool ProcessTrace::CopyOnWrite(VAddr vaddr) {
+  // Get last level page table entry for faulting page (pages in large 
+  // pages are never copy-on-write). Genuine write protection error if page
+  // is not shared.
+  Addr entry_addr;
+  PageTableEntry entry;
+  if (!FindEntry(vaddr, levels - 1, false, entry_addr, entry)
+          || (entry & kPTE_CopyOnWriteMask) == 0) {
+    return false;
+  }
+  
+  // Copy the page unless this is the last process sharing it
+  Addr frame = entry & kPTE_FrameMask;
+  if (allocator.get_reference_count(frame) > 1) {
+    Addr copy = AllocateFrame();
+    memory.copy_bytes(copy, frame, kPageSize);
+    
+    // Release this process's reference to the shared frame
+    vector<Addr> frames(1, frame);
+    allocator.Deallocate(1, frames);
+    frame = copy;
+  }
+  entry = frame | kPTE_WritableMask
+          | (entry & kPageOffsetMask & ~kPTE_CopyOnWriteMask);
+  memory.put_bytes(entry_addr, sizeof(PageTableEntry),
+                   reinterpret_cast<uint8_t*> (&entry));
+  memory.FlushPage(vaddr, vmem_pmcb.asid);
+  return true;
+}
+
+void ProcessTrace::AllocateAndMapPages(VAddr vaddr, Addr count) {
+  // Get last level page table entry for the first page, allocating any 
+  // missing tables above it. Error if page already allocated as part of a
+  // large page.
+  Addr entry_addr;
+  PageTableEntry entry;
+  if (!FindEntry(vaddr, levels - 1, true, entry_addr, entry)) {
     cerr << "ERROR: duplicate allocated at vaddr = 0x" 
             << std::hex << vaddr << "\n";
     throw std::bad_alloc();
   }
   
-  // Allocate a page and set up page table entry
+  // Get last level page table entries
+  PageTable entries;  // first count entries are used
+  memory.get_bytes(reinterpret_cast<uint8_t*> (&entries),
+                 entry_addr, sizeof(PageTableEntry) * count);
+  
+  // Error if page already allocated
+  for (Addr i = 0; i < count; ++i) {
+    if ((entries[i] & (kPTE_PresentMask | kPTE_SwappedOutMask)) != 0) {
+      cerr << "ERROR: duplicate allocated at vaddr = 0x" 
+              << std::hex << vaddr + i * kPageSize << "\n";
+      throw std::bad_alloc();
+    }
+  }
+  
+  // Allocate pages and set up page table entries. Evicting a page to make
+  // room only changes entries of pages already mapped.
+  frame_runs.clear();
+  AllocateFrames(count, frame_runs);
+  Addr i = 0;
+  for (const FrameRun &run : frame_runs) {
+    for (Addr j = 0; j < run.count; ++j) {
+      entries[i++] = (run.frame + j * kPageSize) 
+              | kPTE_PresentMask | kPTE_WritableMask;
+    }
+  }
+  memory.put_bytes(entry_addr, sizeof(PageTableEntry) * count,
+                 reinterpret_cast<uint8_t*> (&entries));
+  if (pager != nullptr) {
+    for (i = 0; i < count; ++i) {
+      pager->AddPage(vmem_pmcb.asid, vaddr + i * kPageSize, 
+                     entry_addr + sizeof(PageTableEntry) * i);
+    }
+  }
+}
+
+bool ProcessTrace::AllocateAndMapLargePage(VAddr vaddr) {
+  // Get page table entry in the level above the last, allocating any 
+  // missing tables above it. Only map a large page if no part of the 
+  // region is mapped yet.
+  Addr entry_addr;
+  PageTableEntry entry;
+  if (!FindEntry(vaddr, levels - 2, true, entry_addr, entry)
+          || (entry & kPTE_PresentMask) != 0) {
+    return false;
+  }
+  
+  // Allocate an aligned run of frames and map it from the entry
   vector<Addr> allocated;
-  allocator.Allocate(1, allocated);
-  l2_entry = allocated[0] | kPTE_PresentMask | kPTE_WritableMask;
-  memory.put_bytes(l2_entry_addr, sizeof(PageTableEntry),
-                 reinterpret_cast<uint8_t*> (&l2_entry));
-  
-//  if ((l2_entry & kPTE_PresentMask) != 0) {
-//      
-//      l2_entry = allocated.back() | kPTE_PresentMask | kPTE_WritableMask;
-//      memory.put_bytes(l2_entry_addr, sizeof(PageTableEntry), reinterpret_cast<uint8_t*> (&l2_entry));
-//  }
-//  else
-//  {
-//      allocator.Allocate(1, allocated);
-//      l2_entry = allocated.back() | kPTE_PresentMask | kPTE_WritableMask;
-//      memory.put_bytes(l2_entry_addr, sizeof(PageTableEntry), reinterpret_cast<uint8_t*> (&l2_entry));
-//      
-//  }
-//  
-//  memory.set_PMCB(vmem_pmcb);
-}
-
-void ProcessTrace::SetWritableStatus(Addr vaddr, bool writable) {
-  // Get offset in L1 table of L2 entry for vaddr  
-  Addr pt_base = vmem_pmcb.page_table_base;
-  Addr pt_l1_offset = vaddr >> (kPageSizeBits + kPageTableSizeBits);
+  if (!allocator.AllocateContiguous(table_entries, allocated)) {
+    return false;
+  }
+  entry = allocated[0] 
+          | kPTE_PresentMask | kPTE_WritableMask | kPTE_LargePageMask;
+  memory.put_bytes(entry_addr, sizeof(PageTableEntry),
+                   reinterpret_cast<uint8_t*> (&entry));
+  return true;
+}
 
-  // Get L1 page table entry
-  Addr l1_entry_addr = pt_base + sizeof(PageTableEntry) * pt_l1_offset;
-  PageTableEntry l1_entry;
-  memory.get_bytes(reinterpret_cast<uint8_t*> (&l1_entry),
-                 l1_entry_addr, sizeof(PageTableEntry));
+void ProcessTrace::SplitLargePage(VAddr vaddr, Addr entry_addr, 
+                                  PageTableEntry &entry) {
+  // Build a last level table mapping the same frames with the same flags
+  Addr large_page_size = table_entries << kPageSizeBits;
+  PageTable page_table;  // first table_entries entries are used
+  PageTableEntry flags = entry & kPageOffsetMask & ~kPTE_LargePageMask;
+  Addr frame = entry & ~(large_page_size - 1);
+  for (Addr i = 0; i < table_entries; ++i) {
+    page_table[i] = (frame + i * kPageSize) | flags;
+  }
+  vector<Addr> allocated;
+  allocator.Allocate(1, allocated);
+  memory.put_bytes(allocated[0], sizeof(PageTableEntry) * table_entries,
+                   reinterpret_cast<uint8_t*> (&page_table));
+  
+  // Point the entry at the new table, and drop the cached large page
+  // translation (one TLB entry covers the whole large page)
+  entry = allocated[0] | kPTE_PresentMask | kPTE_WritableMask;
+  memory.put_bytes(entry_addr, sizeof(PageTableEntry),
+                   reinterpret_cast<uint8_t*> (&entry));
+  memory.FlushPage(vaddr & ~static_cast<VAddr>(large_page_size - 1), 
+                   vmem_pmcb.asid);
+}
 
-  // If no L1 entry for page, ignore request
-  if((l1_entry & kPTE_PresentMask) == 0) {
+void ProcessTrace::SetWritableStatus(VAddr vaddr, bool writable) {
+  // Get page table entry in the level above the last. If no table maps the
+  // page, ignore request.
+  Addr upper_entry_addr;
+  PageTableEntry upper_entry;
+  if (!FindEntry(vaddr, levels - 2, false, upper_entry_addr, upper_entry)
+          || (upper_entry & kPTE_PresentMask) == 0) {
     return;
   }
   
-  // Get L2 page table entry
-  Addr pt_l2_addr = l1_entry & kPageNumberMask;
-  Addr pt_l2_offset = (vaddr >> kPageSizeBits) & kPageTableIndexMask;
-  Addr l2_entry_addr = pt_l2_addr + sizeof(PageTableEntry) * pt_l2_offset;
-  PageTableEntry l2_entry;
-  memory.get_bytes(reinterpret_cast<uint8_t*> (&l2_entry),
-                 l2_entry_addr, sizeof(PageTableEntry));
+  // A large page must be split into 4 KiB pages so that only this page 
+  // is changed
+  if ((upper_entry & kPTE_LargePageMask) != 0) {
+    SplitLargePage(vaddr, upper_entry_addr, upper_entry);
+  }
+  
+  // Get last level page table entry
+  Addr entry_addr = (upper_entry & kPTE_FrameMask) + sizeof(PageTableEntry) 
+          * ((vaddr >> kPageSizeBits) & (table_entries - 1));
+  PageTableEntry entry;
+  memory.get_bytes(reinterpret_cast<uint8_t*> (&entry),
+                 entry_addr, sizeof(PageTableEntry));
   
-  // Ignore request if page not present
-  if ((l2_entry & kPTE_PresentMask) == 0) {
+  // Ignore request if page not present (a page which is swapped out is
+  // still allocated)
+  if ((entry & (kPTE_PresentMask | kPTE_SwappedOutMask)) == 0) {
     return;
   }
   
-  // Set status to requested value and rewrite entry
-  l2_entry = (l2_entry & ~kPTE_WritableMask) | (writable ? kPTE_WritableMask : 0);
-  memory.put_bytes(l2_entry_addr, sizeof(PageTableEntry),
-                 reinterpret_cast<uint8_t*> (&l2_entry));
+  // Set status to requested value and rewrite entry. A copy-on-write page
+  // stays read-only until it is copied; making it read-only means it is 
+  // no longer copied on write.
+  if ((entry & kPTE_CopyOnWriteMask) != 0 && writable) {
+    return;
+  }
+  entry = (entry & ~(kPTE_WritableMask | kPTE_CopyOnWriteMask))
+          | (writable ? kPTE_WritableMask : 0);
+  memory.put_bytes(entry_addr, sizeof(PageTableEntry),
+                 reinterpret_cast<uint8_t*> (&entry));
+  memory.FlushPage(vaddr, vmem_pmcb.asid);
 }
@@ -78,25 +78,30 @@
 #ifndef PROCESSTRACE_H
 #define PROCESSTRACE_H
 
-#include "PageFrameAllocator.h"
+#include "FrameAllocator.h"
+#include "Pager.h"
 
 #include <MMU.h>
 
 #include <fstream>
 #include <string>
+#include <utility>
 #include <vector>
 
-class ProcessTrace {
+class ProcessTrace : public mem::FaultHandler {
 public:
   /**
    * Constructor - open trace file, initialize processing
    * 
    * @param memory_ MMU to use for memory
    * @param file_name_ source of trace commands
+   * @param pager_ pager for demand paging, or nullptr to terminate the 
+   *   process when it exceeds its quota
    */
-  ProcessTrace(mem::MMU &memory_,
-               PageFrameAllocator &allocator,
-               std::string file_name_);
+  ProcessTrace(mem::MMUInterface &memory_,
+               FrameAllocator &allocator,
+               std::string file_name_,
+               Pager *pager_ = nullptr);
   
   /**
    * Destructor - close trace file, clean up processing
@@ -117,6 +122,38 @@ public:
   
   void Initialize(void);
   
+  /**
+   * InitializeAsFork - set up the address space as a copy of the parent's 
+   *   address space, instead of calling Initialize. Only the page tables are
+   *   copied: both processes share the parent's page frames, and writable 
+   *   pages become read-only copy-on-write pages in both processes. A shared
+   *   page is copied on the first write to it by either process. The parent 
+   *   must use the same MMU and allocator.
+   * 
+   * @param parent process to copy
+   */
+  void InitializeAsFork(ProcessTrace &parent);
+  
+  /**
+   * Idle - use idle time to clear free page frames to 0, so that later page
+   *   faults can use them without clearing them
+   * 
+   * @param max_frames maximum number of page frames to clear
+   * @return number of page frames cleared
+   */
+  mem::Addr Idle(mem::Addr max_frames);
+  
+  /**
+   * HandleFault - called by the MMU for a fault in this process's address 
+   *   space, while it is active (see mem::FaultHandler). A page fault on a 
+   *   swapped out page reads the page from swap; a page fault on a write 
+   *   allocates the faulting page (if within quota); a write permission 
+   *   fault on a copy-on-write page copies the page. Other faults are not
+   *   resolved, and are reported by the command which faulted.
+   */
+  bool HandleFault(mem::MemoryFault fault, mem::VAddr vaddress, bool write,
+                   const mem::PMCB &fault_pmcb) override;
+  
     std::string terminate_info;
 private:
   // Trace file
@@ -128,14 +165,29 @@ private:
   
 
   // Memory contents
-  mem::MMU &memory;
+  mem::MMUInterface &memory;
+  
+  // Page table geometry of memory: number of levels, and index bits and 
+  // entries of each table
+  int levels;
+  int table_bits;
+  mem::Addr table_entries;
   
   // Virtual and physical mode PMCBs
   mem::PMCB vmem_pmcb;
   mem::PMCB pmem_pmcb;
   
   // Memory allocator
-  PageFrameAllocator &allocator;
+  FrameAllocator &allocator;
+  
+  // Pager for demand paging (nullptr if none)
+  Pager *pager;
+  
+  // True if the last fault was not resolved because the quota is exceeded
+  bool quota_fault;
+  
+  // Runs of page frames allocated, reused by each allocation
+  std::vector<FrameRun> frame_runs;
   
   /**
    * ParseCommand - parse a trace file command.
@@ -143,11 +195,11 @@ private:
    * 
    * @param line return the original command line
    * @param cmd return the command name
-   * @param cmdArgs returns a vector of argument bytes
+   * @param cmdArgs returns a vector of arguments (addresses may be 64 bits)
    * @return true if command parsed, false if end of file
    */
   bool ParseCommand(
-      std::string &line, std::string &cmd, std::vector<uint32_t> &cmdArgs);
+      std::string &line, std::string &cmd, std::vector<uint64_t> &cmdArgs);
   
   /**
    * Command executors. Arguments are the same for each command.
@@ -158,26 +210,26 @@ private:
    */
   void CmdQuota(const std::string &line, 
                 const std::string &cmd, 
-                const std::vector<uint32_t> &cmdArgs);
-  void CmdAlloc(uint32_t vaddr, uint32_t count);
+                const std::vector<uint64_t> &cmdArgs);
+  void CmdAlloc(mem::VAddr vaddr, mem::Addr count);
   void CmdCompare(const std::string &line, 
               const std::string &cmd, 
-              const std::vector<uint32_t> &cmdArgs);
+              const std::vector<uint64_t> &cmdArgs);
   void CmdPut(const std::string &line, 
               const std::string &cmd, 
-              const std::vector<uint32_t> &cmdArgs);
+              const std::vector<uint64_t> &cmdArgs);
   void CmdFill(const std::string &line, 
                const std::string &cmd, 
-               const std::vector<uint32_t> &cmdArgs);
+               const std::vector<uint64_t> &cmdArgs);
   void CmdCopy(const std::string &line, 
                const std::string &cmd, 
-               const std::vector<uint32_t> &cmdArgs);
+               const std::vector<uint64_t> &cmdArgs);
   void CmdDump(const std::string &line, 
                const std::string &cmd, 
-               const std::vector<uint32_t> &cmdArgs);
+               const std::vector<uint64_t> &cmdArgs);
   void CmdWritable(const std::string &line, 
                    const std::string &cmd, 
-                   const std::vector<uint32_t> &cmdArgs);
+                   const std::vector<uint64_t> &cmdArgs);
   
   /**
    * PrintAndClearException - print a memory exception and clear operation
@@ -187,14 +239,166 @@ private:
    * @param e exception object
    */
   void PrintAndClearException(const std::string &type, 
-                              mem::MemorySubsystemException e);
+                              const mem::MemorySubsystemException &e);
+  
+  /**
+   * ActivateAddressSpace - load the PMCB for this process's address space, 
+   *   if another address space is active in the MMU, and handle its faults
+   */
+  void ActivateAddressSpace(void);
+  
+  /**
+   * ReportFault - report a fault which was not resolved by HandleFault, and
+   *   abandon the faulting operation
+   * 
+   * @param fault fault returned by the operation (nothing is done for 
+   *   MemoryFault::kNone)
+   * @param write true if the fault was on a write, false if on a read
+   */
+  void ReportFault(mem::MemoryFault fault, bool write);
+  
+  /**
+   * CopyOnWrite - handle a write permission fault. If the faulting page is
+   *   copy-on-write, give this process a private writable copy of the page 
+   *   (or just make it writable if no other process still shares it). Must
+   *   be called in physical mode.
+   * 
+   * @param vaddr virtual address which faulted
+   * @return true if the page was copy-on-write, false if the fault is a 
+   *   genuine write protection error
+   */
+  bool CopyOnWrite(mem::VAddr vaddr);
+  
+  /**
+   * MapFaultingPage - handle a page fault by reading the page from swap if
+   *   it is swapped out, or else allocating it if the access is a write. 
+   *   Must be called in physical mode.
+   * 
+   * @param vaddr virtual address of faulting page
+   * @param write true if the faulting access was a write
+   * @return true if the page was mapped, false if reading unallocated 
+   *   memory or the quota is exceeded
+   */
+  bool MapFaultingPage(mem::VAddr vaddr, bool write);
+  
+  /**
+   * ReserveResidentPage - check that another page may be made resident 
+   *   within the quota, evicting a page of this process if paging. Must be
+   *   called in physical mode.
+   * 
+   * @return true if a page may be made resident
+   */
+  bool ReserveResidentPage(void);
+  
+  /**
+   * StopOperation - switch back to virtual mode, abandoning the current 
+   *   memory operation
+   */
+  void StopOperation(void);
+  
+  /**
+   * IndexShift - get the position of the virtual address bits which index
+   *   the page tables of one level
+   * 
+   * @param level page table level (0 for the top level)
+   * @return shift of the index bits
+   */
+  int IndexShift(int level) const {
+    return mem::kPageSizeBits + table_bits * (levels - 1 - level);
+  }
+  
+  /**
+   * InAddressSpace - check whether a virtual address is in the MMU's 
+   *   virtual address space
+   */
+  bool InAddressSpace(mem::VAddr vaddr) const {
+    return memory.get_vaddr_bits() >= 64 
+            || (vaddr >> memory.get_vaddr_bits()) == 0;
+  }
+  
+  /**
+   * FindEntry - get the page table entry for a page in one level of the 
+   *   page table. Must be called in physical mode.
+   * 
+   * @param vaddr virtual address in page
+   * @param level page table level (0 for the top level, levels - 1 for the
+   *   last level)
+   * @param create true to allocate missing tables in the levels down to 
+   *   level
+   * @param entry_addr set to physical address of entry
+   * @param entry set to the entry (0 if not found)
+   * @return true if found, false if a table is missing or a large page is
+   *   mapped above level
+   */
+  bool FindEntry(mem::VAddr vaddr, int level, bool create, 
+                 mem::Addr &entry_addr, mem::PageTableEntry &entry);
+  
+  /**
+   * AllocateFrame - allocate a page frame, evicting a page if paging.
+   *   Must be called in physical mode.
+   * 
+   * @return address of frame, cleared to all 0
+   * @throws std::bad_alloc if no frame is free
+   */
+  mem::Addr AllocateFrame(void);
+  
+  /**
+   * AllocateFrames - allocate page frames as runs of consecutive frames, 
+   *   evicting pages if paging. Must be called in physical mode.
+   * 
+   * @param count number of page frames to allocate
+   * @param runs runs allocated are pushed on back, cleared to all 0
+   * @throws std::bad_alloc if too few frames are free
+   */
+  void AllocateFrames(mem::Addr count, std::vector<FrameRun> &runs);
+  
+  /**
+   * AllocateAndMapPages - allocate new user pages and add them to the page 
+   *   table, writing their last level entries together
+   * 
+   * @param vaddr virtual address of first page to be mapped
+   * @param count number of pages to map (all must be in the same last level
+   *   table)
+   */
+  void AllocateAndMapPages(mem::VAddr vaddr, mem::Addr count);
+  
+  /**
+   * AllocateAndMapLargePage - allocate a large page of contiguous frames and
+   *   map it directly from the level above the last
+   * 
+   * @param vaddr virtual address of large page to be mapped (must be a 
+   *   multiple of the large page size)
+   * @return true if mapped, false if region already partly mapped or no 
+   *   suitable run of frames is free
+   */
+  bool AllocateAndMapLargePage(mem::VAddr vaddr);
+  
+  /**
+   * SplitLargePage - replace a large page mapping with a last level page 
+   *   table mapping the same frames as 4 KiB pages, and flush the cached 
+   *   translation of the large page
+   * 
+   * @param vaddr virtual address in the large page
+   * @param entry_addr physical address of the entry mapping the large page
+   * @param entry the entry; updated to point to the new table
+   */
+  void SplitLargePage(mem::VAddr vaddr, mem::Addr entry_addr, 
+                      mem::PageTableEntry &entry);
   
   /**
-   * AllocateAndMapPage - allocate a new user page and add it to the page table
+   * ForkTable - copy one of the parent's page tables, and the tables below
+   *   it, for this process (see InitializeAsFork). Must be called in 
+   *   physical mode.
    * 
-   * @param vaddr virtual address of page to be mapped
+   * @param parent process being copied
+   * @param parent_table physical address of the parent's table
+   * @param level level of the table (0 for the top level)
+   * @param vaddr first virtual address mapped by the table
+   * @param asid address space identifier of this process
+   * @return physical address of this process's copy of the table
    */
-  void AllocateAndMapPage(mem::Addr vaddr);
+  mem::Addr ForkTable(ProcessTrace &parent, mem::Addr parent_table, int level,
+                      mem::VAddr vaddr, mem::ASID asid);
   
   /**
    * SetWritableStatus - set the writable status of the page
@@ -202,7 +406,7 @@ private:
    * @param vaddr virtual address of page to modify
    * @param writable true to make writable, false to make read-only
    */
-  void SetWritableStatus(mem::Addr vaddr, bool writable);
+  void SetWritableStatus(mem::VAddr vaddr, bool writable);
 };
 
 #endif /* PROCESSTRACE_H */
@@ -0,0 +1,138 @@
+/* 
+ * File:   ProcessTraceTest
+ * Author: agent <agent@local>
+ *
+ * Created on October 18, 2026
+ */
+
+#include <gtest/gtest.h>
+
+#include "PageFrameAllocator.h"
+#include "ProcessTrace.h"
+
+#include <MMU.h>
+
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+using mem::Addr;
+
+class ProcessTraceTest : public testing::Test {
+protected:
+
+  void SetUp() {
+    file_name = "/tmp/ProcessTraceTest_" + std::to_string(getpid()) + ".txt";
+  }
+
+  void TearDown() {
+    unlink(file_name.c_str());
+  }
+  
+  /**
+   * RunTrace - write a trace file and run it to the end in a new process
+   * 
+   * @param memory MMU for the process
+   * @param allocator allocator for memory
+   * @param commands contents of trace file
+   * @return standard output of the process
+   */
+  std::string RunTrace(mem::MMUInterface &memory, FrameAllocator &allocator, 
+                       const std::string &commands) {
+    std::ofstream(file_name) << commands;
+    testing::internal::CaptureStdout();
+    {
+      ProcessTrace trace(memory, allocator, file_name);
+      trace.Initialize();
+      while (trace.Execute()) {
+      }
+    }
+    return testing::internal::GetCapturedStdout();
+  }
+  
+  std::string file_name;
+};
+
+// Making a page read-only must take effect even though the TLB holds a 
+// writable translation for it (ASIDs keep the TLB across PMCB changes)
+TEST_F(ProcessTraceTest, WritableFlushesTLB) {
+  mem::MMU memory(64, 16);
+  PageFrameAllocator allocator(memory);
+  std::string output = RunTrace(memory, allocator,
+          "quota 4\n"
+          "put 1000 11\n"
+          "writable 1000 1000 0\n"
+          "put 1000 22\n"
+          "compare 1000 11\n");
+  ASSERT_NE(std::string::npos, 
+            output.find("Exception type WritePermissionFaultException"));
+}
+
+// Unresolved page faults are reported as being on a read or a write
+TEST_F(ProcessTraceTest, FaultDirection) {
+  mem::MMU memory(64, 16);
+  PageFrameAllocator allocator(memory);
+  std::string output = RunTrace(memory, allocator,
+          "quota 4\n"
+          "put 1000 11\n"
+          "put 100000000 22\n"
+          "copy 1000 100000000 1\n"
+          "copy 100000000 1000 1\n");
+  size_t put = output.find("PageFaultException on write");
+  ASSERT_NE(std::string::npos, put);
+  size_t copy_from = output.find("PageFaultException on read", put);
+  ASSERT_NE(std::string::npos, copy_from);
+  ASSERT_NE(std::string::npos, 
+            output.find("PageFaultException on write", copy_from));
+}
+
+// With an MMU64, addresses above 4 GiB are mapped through four levels of 
+// page tables
+TEST_F(ProcessTraceTest, MMU64Addresses) {
+  mem::MMU64 memory(64, 16);
+  PageFrameAllocator allocator(memory);
+  std::string output = RunTrace(memory, allocator,
+          "quota 8\n"
+          "put 1000000400 ab\n"
+          "put 1000 11\n"
+          "compare 1000000400 ab\n"
+          "writable 1000000000 1000 0\n"
+          "put 1000000400 cd\n"
+          "compare 1000000400 ab\n"
+          "compare 1000 11\n");
+  ASSERT_EQ(std::string::npos, output.find("PageFaultException"));
+  ASSERT_EQ(std::string::npos, output.find("compare error"));
+  ASSERT_NE(std::string::npos, 
+            output.find("Exception type WritePermissionFaultException"));
+}
+
+// A forked process shares the parent's pages copy-on-write through every
+// level of the page table
+TEST_F(ProcessTraceTest, MMU64Fork) {
+  mem::MMU64 memory(64, 16);
+  PageFrameAllocator allocator(memory);
+  std::string child_file_name = file_name + ".child";
+  std::ofstream(file_name) << "quota 8\n"
+                              "put 1000000400 ab\n"
+                              "compare 1000000400 ab\n";
+  std::ofstream(child_file_name) << "put 1000000400 cd\n"
+                                    "compare 1000000400 cd\n";
+  testing::internal::CaptureStdout();
+  {
+    ProcessTrace parent(memory, allocator, file_name);
+    parent.Initialize();
+    parent.Execute();
+    parent.Execute();
+    ProcessTrace child(memory, allocator, child_file_name);
+    child.InitializeAsFork(parent);
+    while (child.Execute()) {
+    }
+    while (parent.Execute()) {
+    }
+  }
+  std::string output = testing::internal::GetCapturedStdout();
+  unlink(child_file_name.c_str());
+  ASSERT_EQ(std::string::npos, output.find("Exception"));
+  ASSERT_EQ(std::string::npos, output.find("compare error"));
+}
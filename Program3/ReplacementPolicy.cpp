@@ -0,0 +1,77 @@
+/*  ReplacementPolicy - choose pages to evict from memory
+ *
+ * File:   ReplacementPolicy.cpp
+ * Author: agent <agent@local>
+ *
+ * Created on October 17, 2026
+ */
+
+#include "ReplacementPolicy.h"
+
+#include "Pager.h"
+
+size_t FifoPolicy::SelectVictim(Pager &pager, mem::ASID asid) {
+  size_t count = pager.get_resident_pages().size();
+  for (size_t index = 0; index < count; ++index) {
+    if (pager.IsEvictable(index, asid)) {
+      return index;
+    }
+  }
+  return kNoVictim;
+}
+
+size_t ClockPolicy::SelectVictim(Pager &pager, mem::ASID asid) {
+  // The first sweep clears Accessed bits, so a victim is found by the end
+  // of the second unless no page may be evicted
+  size_t count = pager.get_resident_pages().size();
+  for (size_t scanned = 0; scanned < 2 * count; ++scanned) {
+    size_t index = Advance(count);
+    if (!pager.IsEvictable(index, asid)) {
+      continue;
+    }
+    mem::PageTableEntry entry = pager.GetEntry(index);
+    if ((entry & mem::kPTE_AccessedMask) == 0) {
+      return index;
+    }
+    pager.SetEntry(index, entry & ~mem::kPTE_AccessedMask);
+  }
+  return kNoVictim;
+}
+
+void ClockPolicy::PageRemoved(size_t index) {
+  // Pages after a removed page move down one place, so move the hand with
+  // them
+  if (index < hand) {
+    --hand;
+  }
+}
+
+size_t ClockPolicy::Advance(size_t count) {
+  if (hand >= count) {
+    hand = 0;
+  }
+  return hand++;
+}
+
+size_t EnhancedClockPolicy::SelectVictim(Pager &pager, mem::ASID asid) {
+  size_t count = pager.get_resident_pages().size();
+  for (int sweep = 0; sweep < 4; ++sweep) {
+    bool want_modified = (sweep % 2) != 0;
+    for (size_t scanned = 0; scanned < count; ++scanned) {
+      size_t index = Advance(count);
+      if (!pager.IsEvictable(index, asid)) {
+        continue;
+      }
+      mem::PageTableEntry entry = pager.GetEntry(index);
+      bool accessed = (entry & mem::kPTE_AccessedMask) != 0;
+      bool modified = (entry & mem::kPTE_ModifiedMask) != 0;
+      if (!accessed && modified == want_modified) {
+        return index;
+      }
+      if (accessed && want_modified) {
+        pager.SetEntry(index, entry & ~mem::kPTE_AccessedMask);
+      }
+    }
+  }
+  return kNoVictim;
+}
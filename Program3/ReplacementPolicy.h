@@ -0,0 +1,101 @@
+/*  ReplacementPolicy - choose pages to evict from memory
+ *
+ * A policy chooses a victim from the pager's list of resident pages, in 
+ * which pages are kept in the order they were made resident. A policy may
+ * examine and change the page table entries of resident pages through the
+ * pager (e.g. to test and clear the Accessed and Modified bits).
+ *
+ * File:   ReplacementPolicy.h
+ * Author: agent <agent@local>
+ *
+ * Created on October 17, 2026
+ */
+
+#ifndef REPLACEMENTPOLICY_H
+#define REPLACEMENTPOLICY_H
+
+#include <MMU.h>
+
+#include <cstddef>
+
+class Pager;
+
+class ReplacementPolicy {
+public:
+  ReplacementPolicy() {}
+  virtual ~ReplacementPolicy() {}
+  
+  // Disallow copy/move
+  ReplacementPolicy(const ReplacementPolicy &other) = delete;
+  ReplacementPolicy(ReplacementPolicy &&other) = delete;
+  ReplacementPolicy &operator=(const ReplacementPolicy &other) = delete;
+  ReplacementPolicy &operator=(ReplacementPolicy &&other) = delete;
+  
+  /**
+   * SelectVictim - choose a resident page to evict
+   * 
+   * @param pager pager holding the resident pages
+   * @param asid choose only pages of this address space, or any page if 0
+   * @return index of page in the pager's resident page list, or kNoVictim
+   *   if no page may be evicted
+   */
+  virtual size_t SelectVictim(Pager &pager, mem::ASID asid) = 0;
+  
+  /**
+   * PageRemoved - notification that a page has been removed from the 
+   *   resident page list. Later pages in the list move down by one.
+   * 
+   * @param index former index of page
+   */
+  virtual void PageRemoved(size_t /*index*/) {}
+  
+  static const size_t kNoVictim = static_cast<size_t>(-1);
+};
+
+/**
+ * FifoPolicy - evict the page which has been resident longest
+ */
+class FifoPolicy : public ReplacementPolicy {
+public:
+  size_t SelectVictim(Pager &pager, mem::ASID asid) override;
+};
+
+/**
+ * ClockPolicy - second chance replacement. A hand sweeps the resident 
+ *   pages in a circle; a page which has been accessed since the hand last 
+ *   passed it has its Accessed bit cleared and is skipped, and the first 
+ *   page not accessed is evicted.
+ */
+class ClockPolicy : public ReplacementPolicy {
+public:
+  ClockPolicy() : hand(0) {}
+  size_t SelectVictim(Pager &pager, mem::ASID asid) override;
+  void PageRemoved(size_t index) override;
+protected:
+  // Index of next page to examine
+  size_t hand;
+  
+  /**
+   * Advance - return the page under the hand and move the hand to the next
+   *   page
+   * 
+   * @param count number of resident pages (must be > 0)
+   * @return index of page
+   */
+  size_t Advance(size_t count);
+};
+
+/**
+ * EnhancedClockPolicy - not recently used replacement. Pages are classed 
+ *   by their Accessed and Modified bits, and the hand looks for a page in
+ *   the lowest class: not accessed and not modified, then not accessed but
+ *   modified (clearing Accessed bits as it passes), and then the same again
+ *   with the Accessed bits cleared. Evicting unmodified pages first avoids
+ *   writing them to swap.
+ */
+class EnhancedClockPolicy : public ClockPolicy {
+public:
+  size_t SelectVictim(Pager &pager, mem::ASID asid) override;
+};
+
+#endif /* REPLACEMENTPOLICY_H */
@@ -0,0 +1,193 @@
+/*  SwapFile - backing store for pages evicted from memory
+ *
+ * File:   SwapFile.cpp
+ * Author: agent <agent@local>
+ *
+ * Created on October 17, 2026
+ */
+
+#include "SwapFile.h"
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using mem::Addr;
+using mem::kPageSize;
+
+namespace {
+
+// Limit on queued writes, in batches, before Write waits for write-back
+const size_t kMaxQueuedBatches = 4;
+
+}  // namespace
+
+SwapFile::SwapFile(const std::string &file_name_, size_t batch_size_)
+: file_name(file_name_), fd(-1), batch_size(batch_size_ > 0 ? batch_size_ : 1),
+  flush_requested(false), stopping(false), pages_written(0), batches_written(0)
+{
+  fd = open(file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(),
+                            "SwapFile: cannot create " + file_name);
+  }
+  writer = std::thread(&SwapFile::WriteBack, this);
+}
+
+SwapFile::~SwapFile() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  work_ready.notify_one();
+  writer.join();
+  close(fd);
+  unlink(file_name.c_str());
+}
+
+Addr SwapFile::AllocateSlot(void) {
+  Addr slot;
+  if (!free_slots.empty()) {
+    slot = free_slots.back();
+    free_slots.pop_back();
+  } else if (slot_references.size() < kMaxSlots) {
+    slot = slot_references.size();
+    slot_references.push_back(0);
+  } else {
+    throw std::bad_alloc();
+  }
+  slot_references[slot] = 1;
+  return slot;
+}
+
+void SwapFile::FreeSlot(Addr slot) {
+  if (--slot_references.at(slot) > 0) {
+    return;
+  }
+
+  // A queued write to the slot is no longer needed
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.erase(slot);
+  }
+  free_slots.push_back(slot);
+}
+
+void SwapFile::Write(Addr slot, const uint8_t *page) {
+  std::unique_lock<std::mutex> lock(mutex);
+  CheckWriteError();
+
+  // Limit memory used by queued pages if write-back falls behind
+  work_done.wait(lock, [this] {
+    return pending.size() < kMaxQueuedBatches * batch_size || write_error;
+  });
+
+  std::unique_ptr<Page> &queued = pending[slot];
+  if (!queued) {
+    queued.reset(new Page);
+  }
+  memcpy(queued->data(), page, kPageSize);
+  if (pending.size() >= batch_size) {
+    work_ready.notify_one();
+  }
+}
+
+void SwapFile::Read(Addr slot, uint8_t *page) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    CheckWriteError();
+
+    // Newest contents may still be queued
+    const Page *queued = nullptr;
+    auto pending_write = pending.find(slot);
+    if (pending_write != pending.end()) {
+      queued = pending_write->second.get();
+    } else {
+      auto batch_write = writing.find(slot);
+      if (batch_write != writing.end()) {
+        queued = batch_write->second.get();
+      }
+    }
+    if (queued != nullptr) {
+      memcpy(page, queued->data(), kPageSize);
+      return;
+    }
+  }
+
+  // Otherwise the file holds the newest contents. Any part of the slot
+  // beyond the end of the file reads as 0.
+  ssize_t count = pread(fd, page, kPageSize, static_cast<off_t>(slot) * kPageSize);
+  if (count < 0) {
+    throw std::system_error(errno, std::generic_category(),
+                            "SwapFile: cannot read " + file_name);
+  }
+  memset(page + count, 0, kPageSize - count);
+}
+
+void SwapFile::Flush(void) {
+  std::unique_lock<std::mutex> lock(mutex);
+  flush_requested = true;
+  work_ready.notify_one();
+  work_done.wait(lock, [this] {
+    return (pending.empty() && writing.empty()) || write_error;
+  });
+  CheckWriteError();
+}
+
+uint64_t SwapFile::get_pages_written(void) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return pages_written;
+}
+
+uint64_t SwapFile::get_batches_written(void) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return batches_written;
+}
+
+void SwapFile::WriteBack(void) {
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    work_ready.wait(lock, [this] {
+      return stopping || flush_requested || pending.size() >= batch_size;
+    });
+    if (pending.empty() || write_error) {
+      pending.clear();  // after an error, nothing more is written
+      flush_requested = false;
+      work_done.notify_all();
+      if (stopping) return;
+      continue;
+    }
+
+    // Write the batch without holding the lock. Entries in the batch are
+    // not changed until it has been written.
+    writing.swap(pending);
+    lock.unlock();
+    int error = 0;
+    for (const auto &queued : writing) {
+      ssize_t count = pwrite(fd, queued.second->data(), kPageSize,
+                             static_cast<off_t>(queued.first) * kPageSize);
+      if (count != static_cast<ssize_t>(kPageSize)) {
+        error = (count < 0) ? errno : EIO;
+        break;
+      }
+    }
+    lock.lock();
+
+    if (error != 0) {
+      write_error = std::error_code(error, std::generic_category());
+    }
+    pages_written += writing.size();
+    ++batches_written;
+    writing.clear();
+    work_done.notify_all();
+  }
+}
+
+void SwapFile::CheckWriteError(void) const {
+  if (write_error) {
+    throw std::system_error(write_error, "SwapFile: cannot write " + file_name);
+  }
+}
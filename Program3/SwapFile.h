@@ -0,0 +1,169 @@
+/*  SwapFile - backing store for pages evicted from memory
+ *
+ * Pages are stored in page-sized slots of a host file. Writes are queued
+ * and written to the file in batches by a background thread, so that
+ * evicting a modified page does not wait for the write to complete. A read
+ * of a slot with a queued write is satisfied from the queue.
+ *
+ * File:   SwapFile.h
+ * Author: agent <agent@local>
+ *
+ * Created on October 17, 2026
+ */
+
+#ifndef SWAPFILE_H
+#define SWAPFILE_H
+
+#include <MMU.h>
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+class SwapFile {
+public:
+  /**
+   * Constructor - create the swap file (replacing any existing file) and
+   *   start the write-back thread
+   *
+   * @param file_name_ host file to use; removed when the swap file is
+   *   destroyed
+   * @param batch_size_ number of queued writes which starts a write-back
+   * @throws std::system_error if the file cannot be created
+   */
+  SwapFile(const std::string &file_name_,
+           size_t batch_size_ = kDefaultBatchSize);
+
+  /**
+   * Destructor - finish queued writes, stop the write-back thread, and
+   *   remove the file
+   */
+  virtual ~SwapFile();
+
+  // Disallow copy/move
+  SwapFile(const SwapFile &other) = delete;
+  SwapFile(SwapFile &&other) = delete;
+  SwapFile &operator=(const SwapFile &other) = delete;
+  SwapFile &operator=(SwapFile &&other) = delete;
+
+  /**
+   * AllocateSlot - allocate an unused slot, with one reference
+   *
+   * @return slot number
+   * @throws std::bad_alloc if all slots are in use
+   */
+  mem::Addr AllocateSlot(void);
+
+  /**
+   * AddReference - add a reference to an allocated slot, so that it is
+   *   shared until each reference has been freed
+   *
+   * @param slot slot number
+   */
+  void AddReference(mem::Addr slot) { ++slot_references.at(slot); }
+
+  /**
+   * get_reference_count - get number of references to a slot
+   *
+   * @param slot slot number
+   * @return number of references (0 if slot is free)
+   */
+  uint32_t get_reference_count(mem::Addr slot) const {
+    return slot_references.at(slot);
+  }
+
+  /**
+   * FreeSlot - release one reference to a slot. The slot is reused after
+   *   the last reference is released.
+   *
+   * @param slot slot number
+   */
+  void FreeSlot(mem::Addr slot);
+
+  /**
+   * Write - queue a page to be written to a slot
+   *
+   * @param slot slot number
+   * @param page page contents (copied before returning)
+   * @throws std::system_error if an earlier write failed
+   */
+  void Write(mem::Addr slot, const uint8_t *page);
+
+  /**
+   * Read - read the page last written to a slot
+   *
+   * @param slot slot number
+   * @param page buffer for page contents
+   * @throws std::system_error if the read, or an earlier write, failed
+   */
+  void Read(mem::Addr slot, uint8_t *page);
+
+  /**
+   * Flush - wait until all queued writes have been written to the file
+   *
+   * @throws std::system_error if a write failed
+   */
+  void Flush(void);
+
+  // Access to statistics
+  uint64_t get_pages_written(void) const;
+  uint64_t get_batches_written(void) const;
+
+  // Slot numbers are stored in place of frame numbers in page table entries
+  static const mem::Addr kMaxSlots = (1 << (32 - mem::kPageSizeBits));
+
+  static const size_t kDefaultBatchSize = 16;
+private:
+  typedef std::array<uint8_t, mem::kPageSize> Page;
+
+  // Host file
+  std::string file_name;
+  int fd;
+
+  // Number of queued writes which starts a write-back
+  size_t batch_size;
+
+  // Number of references to each slot ever allocated, indexed by slot,
+  // and list of free slots
+  std::vector<uint32_t> slot_references;
+  std::vector<mem::Addr> free_slots;
+
+  // Queued writes, and the batch being written by the write-back thread,
+  // indexed by slot. Each batch is written in slot order.
+  std::map<mem::Addr, std::unique_ptr<Page>> pending;
+  std::map<mem::Addr, std::unique_ptr<Page>> writing;
+
+  // Write-back thread state, guarded by mutex
+  mutable std::mutex mutex;
+  std::condition_variable work_ready;   // batch ready, flush, or stop
+  std::condition_variable work_done;    // batch written
+  bool flush_requested;
+  bool stopping;
+  std::error_code write_error;
+  uint64_t pages_written;
+  uint64_t batches_written;
+  std::thread writer;
+
+  /**
+   * WriteBack - body of write-back thread. Writes batches of queued pages
+   *   until stopped.
+   */
+  void WriteBack(void);
+
+  /**
+   * CheckWriteError - throw if the write-back thread failed. Must be called
+   *   with mutex held.
+   *
+   * @throws std::system_error if a write failed
+   */
+  void CheckWriteError(void) const;
+};
+
+#endif /* SWAPFILE_H */
@@ -11,13 +11,19 @@
  */
 
 
-#include "PageFrameAllocator.h"
+#include "BuddyFrameAllocator.h"
+#include "FrameMagazine.h"
+#include "Pager.h"
 #include "ProcessTrace.h"
+#include "ReplacementPolicy.h"
+#include "SwapFile.h"
 
 #include <MMU.h>
 
 #include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <string>
 
 /*
  * 
@@ -30,6 +36,7 @@ int main(int argc, char* argv[]) {
 //  }
     
     std::vector<ProcessTrace*> scheduler;
+    std::vector<FrameAllocator*> allocators;
     std::vector<std::string> trace_names;
     
     trace_names.push_back("trace4v_multi-l2-tables.txt");
@@ -39,14 +46,61 @@ int main(int argc, char* argv[]) {
 
     
     uint32_t time_slice = 1;
+    
+    // Page frames cleared by each waiting trace per time slice (each trace 
+    // has its own memory, so waiting traces' memory is idle). A single
+    // trace's memory is idle between its slices.
+    mem::Addr idle_zero_frames = 4;
+    
+    // An initial -64 option gives each trace an MMU with 48 bit virtual
+    // addresses and four page table levels (MMU64)
+    bool use_mmu64 = argc > 1 && std::string(argv[1]) == "-64";
+    if (use_mmu64) {
+        --argc;
+        ++argv;
+    }
+    
+    // Optional arguments enable demand paging to the named swap file, in
+    // place of terminating processes which exceed their quota, using the
+    // named replacement policy (fifo, clock, or nru)
+    std::unique_ptr<SwapFile> swap;
+    std::string policy_name = (argc > 2) ? argv[2] : "fifo";
+    if (argc > 1) {
+        swap.reset(new SwapFile(argv[1]));
+    }
+    if (policy_name != "fifo" && policy_name != "clock" && policy_name != "nru") {
+        std::cerr << "usage: program3 [-64] [swap_file [fifo|clock|nru]]\n";
+        exit(1);
+    }
   
  
   
     // add process traces to vector
     for (int i=0; i<trace_names.size(); i++){
-        mem::MMU* memory = new mem::MMU(1024);
-        PageFrameAllocator* allocator = new PageFrameAllocator(*memory);       
-        scheduler.push_back(new ProcessTrace(*memory, *allocator, trace_names[i]));
+        mem::MMUInterface* memory;
+        if (use_mmu64) {
+            memory = new mem::MMU64(1024);
+        } else {
+            memory = new mem::MMU(1024);
+        }
+        FrameAllocator* frames = new BuddyFrameAllocator(*memory);
+        SharedFramePool* pool = new SharedFramePool(*memory, *frames);
+        FrameAllocator* allocator = new FrameMagazine(*pool);
+        allocators.push_back(allocator);
+        Pager* pager = nullptr;
+        if (swap) {
+            ReplacementPolicy* policy;
+            if (policy_name == "clock") {
+                policy = new ClockPolicy();
+            } else if (policy_name == "nru") {
+                policy = new EnhancedClockPolicy();
+            } else {
+                policy = new FifoPolicy();
+            }
+            pager = new Pager(*memory, *allocator, *swap, *policy);
+        }
+        scheduler.push_back(new ProcessTrace(*memory, *allocator, trace_names[i], 
+                                             pager));
     }
     
     // initialize each process trace
@@ -67,6 +121,11 @@ int main(int argc, char* argv[]) {
             std::cout << t+j << ":" << i % scheduler.size() + 1<< ":";
             scheduler[i%scheduler.size()]->Execute();
         }
+        for (int k=0; k<scheduler.size(); k++){
+            if (k != i % scheduler.size() || scheduler.size() == 1) {
+                scheduler[k]->Idle(idle_zero_frames);
+            }
+        }
         t+=time_slice;
     }
 
@@ -76,6 +135,16 @@ int main(int argc, char* argv[]) {
   
   //ProcessTrace trace(memory, allocator, "trace2v_multi-page.txt");
   
+    // report page frame zeroing for each trace's memory
+    std::cout << "\n";
+    for (int i=0; i<allocators.size(); i++){
+        ZeroingStats stats = allocators[i]->get_zeroing_stats();
+        std::cout << std::dec << trace_names[i] << ": frames zeroed " 
+                << stats.frames_zeroed << ", pre-zeroed " 
+                << stats.frames_prezeroed << ", zeroing avoided " 
+                << stats.zeroing_avoided << "\n";
+    }
+  
     
     // clean up memory
     for (int i=0; i<scheduler.size(); i++){
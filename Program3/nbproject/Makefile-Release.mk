@@ -35,8 +35,14 @@ OBJECTDIR=${CND_BUILDDIR}/${CND_CONF}/${CND_PLATFORM}
 
 # Object Files
 OBJECTFILES= \
+	${OBJECTDIR}/BuddyFrameAllocator.o \
+	${OBJECTDIR}/FrameAllocator.o \
+	${OBJECTDIR}/FrameMagazine.o \
 	${OBJECTDIR}/PageFrameAllocator.o \
+	${OBJECTDIR}/Pager.o \
 	${OBJECTDIR}/ProcessTrace.o \
+	${OBJECTDIR}/ReplacementPolicy.o \
+	${OBJECTDIR}/SwapFile.o \
 	${OBJECTDIR}/main.o
 
 # Test Directory
@@ -48,7 +54,11 @@ TESTFILES= \
 
 # Test Object Files
 TESTOBJECTFILES= \
-	${TESTDIR}/MemAllocatorTest.o
+	${TESTDIR}/BuddyFrameAllocatorTest.o \
+	${TESTDIR}/FrameMagazineTest.o \
+	${TESTDIR}/MemAllocatorTest.o \
+	${TESTDIR}/PagerTest.o \
+	${TESTDIR}/ProcessTraceTest.o
 
 # C Compiler Flags
 CFLAGS=
@@ -74,16 +84,46 @@ ${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}/program3: ${OBJECTFILES}
 	${MKDIR} -p ${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}
 	${LINK.cc} -o ${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}/program3 ${OBJECTFILES} ${LDLIBSOPTIONS}
 
+${OBJECTDIR}/BuddyFrameAllocator.o: BuddyFrameAllocator.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/BuddyFrameAllocator.o BuddyFrameAllocator.cpp
+
+${OBJECTDIR}/FrameAllocator.o: FrameAllocator.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/FrameAllocator.o FrameAllocator.cpp
+
+${OBJECTDIR}/FrameMagazine.o: FrameMagazine.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/FrameMagazine.o FrameMagazine.cpp
+
 ${OBJECTDIR}/PageFrameAllocator.o: PageFrameAllocator.cpp
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
 	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/PageFrameAllocator.o PageFrameAllocator.cpp
 
+${OBJECTDIR}/Pager.o: Pager.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/Pager.o Pager.cpp
+
 ${OBJECTDIR}/ProcessTrace.o: ProcessTrace.cpp
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
 	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/ProcessTrace.o ProcessTrace.cpp
 
+${OBJECTDIR}/ReplacementPolicy.o: ReplacementPolicy.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/ReplacementPolicy.o ReplacementPolicy.cpp
+
+${OBJECTDIR}/SwapFile.o: SwapFile.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/SwapFile.o SwapFile.cpp
+
 ${OBJECTDIR}/main.o: main.cpp
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
@@ -96,7 +136,7 @@ ${OBJECTDIR}/main.o: main.cpp
 .build-tests-conf: .build-tests-subprojects .build-conf ${TESTFILES}
 .build-tests-subprojects:
 
-${TESTDIR}/TestFiles/f1: ${TESTDIR}/MemAllocatorTest.o ${OBJECTFILES:%.o=%_nomain.o}
+${TESTDIR}/TestFiles/f1: ${TESTDIR}/BuddyFrameAllocatorTest.o ${TESTDIR}/FrameMagazineTest.o ${TESTDIR}/MemAllocatorTest.o ${TESTDIR}/PagerTest.o ${TESTDIR}/ProcessTraceTest.o ${OBJECTFILES:%.o=%_nomain.o}
 	${MKDIR} -p ${TESTDIR}/TestFiles
 	${LINK.cc} -o ${TESTDIR}/TestFiles/f1 $^ ${LDLIBSOPTIONS}   
 
@@ -107,6 +147,69 @@ ${TESTDIR}/MemAllocatorTest.o: MemAllocatorTest.cpp
 	$(COMPILE.cc) -O2 -I. -MMD -MP -MF "$@.d" -o ${TESTDIR}/MemAllocatorTest.o MemAllocatorTest.cpp
 
 
+${TESTDIR}/ProcessTraceTest.o: ProcessTraceTest.cpp 
+	${MKDIR} -p ${TESTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -I. -MMD -MP -MF "$@.d" -o ${TESTDIR}/ProcessTraceTest.o ProcessTraceTest.cpp
+
+
+${TESTDIR}/PagerTest.o: PagerTest.cpp 
+	${MKDIR} -p ${TESTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -I. -MMD -MP -MF "$@.d" -o ${TESTDIR}/PagerTest.o PagerTest.cpp
+
+
+${TESTDIR}/BuddyFrameAllocatorTest.o: BuddyFrameAllocatorTest.cpp 
+	${MKDIR} -p ${TESTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -I. -MMD -MP -MF "$@.d" -o ${TESTDIR}/BuddyFrameAllocatorTest.o BuddyFrameAllocatorTest.cpp
+
+
+${TESTDIR}/FrameMagazineTest.o: FrameMagazineTest.cpp 
+	${MKDIR} -p ${TESTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -I. -MMD -MP -MF "$@.d" -o ${TESTDIR}/FrameMagazineTest.o FrameMagazineTest.cpp
+
+
+${OBJECTDIR}/BuddyFrameAllocator_nomain.o: ${OBJECTDIR}/BuddyFrameAllocator.o BuddyFrameAllocator.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	@NMOUTPUT=`${NM} ${OBJECTDIR}/BuddyFrameAllocator.o`; \
+	if (echo "$$NMOUTPUT" | ${GREP} '|main$$') || \
+	   (echo "$$NMOUTPUT" | ${GREP} 'T main$$') || \
+	   (echo "$$NMOUTPUT" | ${GREP} 'T _main$$'); \
+	then  \
+	    ${RM} "$@.d";\
+	    $(COMPILE.cc) -O2 -Dmain=__nomain -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/BuddyFrameAllocator_nomain.o BuddyFrameAllocator.cpp;\
+	else  \
+	    ${CP} ${OBJECTDIR}/BuddyFrameAllocator.o ${OBJECTDIR}/BuddyFrameAllocator_nomain.o;\
+	fi
+
+${OBJECTDIR}/FrameAllocator_nomain.o: ${OBJECTDIR}/FrameAllocator.o FrameAllocator.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	@NMOUTPUT=`${NM} ${OBJECTDIR}/FrameAllocator.o`; \
+	if (echo "$$NMOUTPUT" | ${GREP} '|main$$') || \
+	   (echo "$$NMOUTPUT" | ${GREP} 'T main$$') || \
+	   (echo "$$NMOUTPUT" | ${GREP} 'T _main$$'); \
+	then  \
+	    ${RM} "$@.d";\
+	    $(COMPILE.cc) -O2 -Dmain=__nomain -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/FrameAllocator_nomain.o FrameAllocator.cpp;\
+	else  \
+	    ${CP} ${OBJECTDIR}/FrameAllocator.o ${OBJECTDIR}/FrameAllocator_nomain.o;\
+	fi
+
+${OBJECTDIR}/FrameMagazine_nomain.o: ${OBJECTDIR}/FrameMagazine.o FrameMagazine.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	@NMOUTPUT=`${NM} ${OBJECTDIR}/FrameMagazine.o`; \
+	if (echo "$$NMOUTPUT" | ${GREP} '|main$$') || \
+	   (echo "$$NMOUTPUT" | ${GREP} 'T main$$') || \
+	   (echo "$$NMOUTPUT" | ${GREP} 'T _main$$'); \
+	then  \
+	    ${RM} "$@.d";\
+	    $(COMPILE.cc) -O2 -Dmain=__nomain -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/FrameMagazine_nomain.o FrameMagazine.cpp;\
+	else  \
+	    ${CP} ${OBJECTDIR}/FrameMagazine.o ${OBJECTDIR}/FrameMagazine_nomain.o;\
+	fi
+
 ${OBJECTDIR}/PageFrameAllocator_nomain.o: ${OBJECTDIR}/PageFrameAllocator.o PageFrameAllocator.cpp 
 	${MKDIR} -p ${OBJECTDIR}
 	@NMOUTPUT=`${NM} ${OBJECTDIR}/PageFrameAllocator.o`; \
@@ -120,6 +223,19 @@ ${OBJECTDIR}/PageFrameAllocator_nomain.o: ${OBJECTDIR}/PageFrameAllocator.o Page
 	    ${CP} ${OBJECTDIR}/PageFrameAllocator.o ${OBJECTDIR}/PageFrameAllocator_nomain.o;\
 	fi
 
+${OBJECTDIR}/Pager_nomain.o: ${OBJECTDIR}/Pager.o Pager.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	@NMOUTPUT=`${NM} ${OBJECTDIR}/Pager.o`; \
+	if (echo "$$NMOUTPUT" | ${GREP} '|main$$') || \
+	   (echo "$$NMOUTPUT" | ${GREP} 'T main$$') || \
+	   (echo "$$NMOUTPUT" | ${GREP} 'T _main$$'); \
+	then  \
+	    ${RM} "$@.d";\
+	    $(COMPILE.cc) -O2 -Dmain=__nomain -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/Pager_nomain.o Pager.cpp;\
+	else  \
+	    ${CP} ${OBJECTDIR}/Pager.o ${OBJECTDIR}/Pager_nomain.o;\
+	fi
+
 ${OBJECTDIR}/ProcessTrace_nomain.o: ${OBJECTDIR}/ProcessTrace.o ProcessTrace.cpp 
 	${MKDIR} -p ${OBJECTDIR}
 	@NMOUTPUT=`${NM} ${OBJECTDIR}/ProcessTrace.o`; \
@@ -133,6 +249,32 @@ ${OBJECTDIR}/ProcessTrace_nomain.o: ${OBJECTDIR}/ProcessTrace.o ProcessTrace.cpp
 	    ${CP} ${OBJECTDIR}/ProcessTrace.o ${OBJECTDIR}/ProcessTrace_nomain.o;\
 	fi
 
+${OBJECTDIR}/ReplacementPolicy_nomain.o: ${OBJECTDIR}/ReplacementPolicy.o ReplacementPolicy.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	@NMOUTPUT=`${NM} ${OBJECTDIR}/ReplacementPolicy.o`; \
+	if (echo "$$NMOUTPUT" | ${GREP} '|main$$') || \
+	   (echo "$$NMOUTPUT" | ${GREP} 'T main$$') || \
+	   (echo "$$NMOUTPUT" | ${GREP} 'T _main$$'); \
+	then  \
+	    ${RM} "$@.d";\
+	    $(COMPILE.cc) -O2 -Dmain=__nomain -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/ReplacementPolicy_nomain.o ReplacementPolicy.cpp;\
+	else  \
+	    ${CP} ${OBJECTDIR}/ReplacementPolicy.o ${OBJECTDIR}/ReplacementPolicy_nomain.o;\
+	fi
+
+${OBJECTDIR}/SwapFile_nomain.o: ${OBJECTDIR}/SwapFile.o SwapFile.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	@NMOUTPUT=`${NM} ${OBJECTDIR}/SwapFile.o`; \
+	if (echo "$$NMOUTPUT" | ${GREP} '|main$$') || \
+	   (echo "$$NMOUTPUT" | ${GREP} 'T main$$') || \
+	   (echo "$$NMOUTPUT" | ${GREP} 'T _main$$'); \
+	then  \
+	    ${RM} "$@.d";\
+	    $(COMPILE.cc) -O2 -Dmain=__nomain -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/SwapFile_nomain.o SwapFile.cpp;\
+	else  \
+	    ${CP} ${OBJECTDIR}/SwapFile.o ${OBJECTDIR}/SwapFile_nomain.o;\
+	fi
+
 ${OBJECTDIR}/main_nomain.o: ${OBJECTDIR}/main.o main.cpp 
 	${MKDIR} -p ${OBJECTDIR}
 	@NMOUTPUT=`${NM} ${OBJECTDIR}/main.o`; \